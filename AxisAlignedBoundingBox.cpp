@@ -8,6 +8,8 @@
  * A C++ module implementing a 3D axis-aligned bounding box
  */
 
+#include <algorithm>
+
 #include "AxisAlignedBoundingBox.h"
 
 /**
@@ -24,55 +26,13 @@ AxisAlignedBoundingBox::AxisAlignedBoundingBox()
     /* empty */
 } /* Default constructor */
 
-/**
- * Calculates and returns the center point of the box
- * @return - The center point of the box
- */
-Point3 AxisAlignedBoundingBox::GetCenter() const
-{
-    float center[] = {(left + right) / 2, (bottom + top) / 2, (back + front) / 2, 1.0f};
-    float modelviewInverse[16];
-
-    /* Invert the modelview matrix */
-    if (gluInvertMatrix(modelview, modelviewInverse))
-    {
-        /* Undo the camera transformation matrix but keep the model's rotation, scale, and
-         * translation transformation matrix in order to calculate the bounding box's center
-         * in model space and get its proper location
-         */
-        matMultVec4f(center, center, modelviewInverse);
-        matMultVec4f(center, center, transform);
-    }
-    else
-    {
-        /* The modelview matrix is not invertible, so just return garbage */
-        center[0] = 999999999.0f;
-        center[1] = 999999999.0f;
-        center[2] = 999999999.0f;
-    }
-
-    return Point3(center[0], center[1], center[2]);
-} /* AxisAlignedBoundingBox::GetCenter() */
-
 /**
  * Recalculates the axis-aligned bounding box based on the model's current modelview matrix
  * @param faceList - The model's face list
  * @param modelview - The model's modelview matrix
  */
-void AxisAlignedBoundingBox::Recalculate(FaceList* faceList, float mv[], float tform[])
+void AxisAlignedBoundingBox::Recalculate(const FaceList* faceList, const float modelview[])
 {
-    /* Save the modelview matrix */
-    for (int i =0; i < 16; i++)
-    {
-        modelview[i] = mv[i];
-    }
-
-    /* Save the model's transform (rotate, scale, translate) matrix */
-    for (int i =0; i < 16; i++)
-    {
-        transform[i] = tform[i];
-    }
-
     /* Start with the first vertex */
     bool isFirstVertex = true;
 
@@ -135,3 +95,37 @@ void AxisAlignedBoundingBox::Recalculate(FaceList* faceList, float mv[], float t
         }
     }
 } /* AxisAlignedBoundingBox::Recalculate() */
+
+/**
+ * Recalculates the axis-aligned bounding box around a box in model space, such as a mesh's
+ * bounds or a placeholder for a model which has not loaded yet
+ * @param bounds - The box in model space as minimum x, y, z then maximum x, y, z
+ * @param modelview - The model's modelview matrix
+ */
+void AxisAlignedBoundingBox::RecalculateBox(const float bounds[6], const float modelview[])
+{
+    /* Bound the box's eight corners */
+    for (int i = 0; i < 8; i++)
+    {
+        float point[] = {bounds[i & 1 ? 3 : 0], bounds[i & 2 ? 4 : 1], bounds[i & 4 ? 5 : 2], 1.0f};
+        float vector[4];
+
+        matMultVec4f(vector, point, modelview);
+
+        if (0 == i)
+        {
+            left = right = vector[0];
+            bottom = top = vector[1];
+            back = front = vector[2];
+        }
+        else
+        {
+            left = std::min(left, vector[0]);
+            right = std::max(right, vector[0]);
+            bottom = std::min(bottom, vector[1]);
+            top = std::max(top, vector[1]);
+            back = std::min(back, vector[2]);
+            front = std::max(front, vector[2]);
+        }
+    }
+} /* AxisAlignedBoundingBox::RecalculateBox() */
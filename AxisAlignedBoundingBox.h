@@ -12,7 +12,6 @@
 #define AXISALIGNEDBOUNDINGBOX_H_
 
 #include "FaceList.h"
-#include "Point3.h"
 #include "VecMath.h"
 
 class AxisAlignedBoundingBox
@@ -30,13 +29,8 @@ public:
     AxisAlignedBoundingBox();
 
     /* Member functions */
-    Point3 GetCenter() const;
-    void Recalculate(FaceList* faceList, float modelview[], float transform[]);
-
-private:
-    /* Private data members */
-    float modelview[16];
-    float transform[16];
+    void Recalculate(const FaceList* faceList, const float modelview[]);
+    void RecalculateBox(const float bounds[6], const float modelview[]);
 }; /* class AxisAlignedBoundingBox */
 
 #endif /* AXISALIGNEDBOUNDINGBOX_H_ */
@@ -0,0 +1,244 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: BoundingBoxBatch.cpp
+ *
+ * A C++ module implementing a batch of axis-aligned
+ * bounding boxes which are drawn together with a single
+ * instanced draw call of a unit cube, either as
+ * translucent solids or as wireframes.
+ */
+
+#include <algorithm>
+#include <cstddef>
+
+#include "BoundingBoxBatch.h"
+#include "GLSLShader.h"
+
+/* Vertex attribute locations bound before the shader program is linked */
+#define ATTRIB_UNIT_POSITION 0
+#define ATTRIB_BOX_MIN 1
+#define ATTRIB_BOX_MAX 2
+
+/* Layout of the unit cube buffer */
+#define CUBE_TRIANGLE_VERTICES 36
+#define CUBE_EDGE_VERTICES 24
+
+/* Converts a byte offset into a buffer object into the pointer argument OpenGL expects */
+#define BUFFER_OFFSET(offset) (reinterpret_cast<const GLvoid*>(offset))
+
+/**
+ * Default constructor creates an empty batch
+ * Init() must be called once an OpenGL context exists
+ */
+BoundingBoxBatch::BoundingBoxBatch()
+    : isInstanced(false)
+    , program(NULL)
+    , uColor(-1)
+    , cubeBuffer(0)
+    , instanceBuffer(0)
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Builds the shader program and the unit cube buffer
+ * @param state - The state cache used to bind the buffers
+ * @param vertexShaderSource - The file name of the unit cube vertex shader
+ * @param fragmentShaderSource - The file name of the flat color fragment shader
+ */
+void BoundingBoxBatch::Init(GLStateCache& state, const char* vertexShaderSource,
+        const char* fragmentShaderSource)
+{
+    isInstanced = GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+
+    /* Load the shader program, binding the unit cube to attribute 0 so it is always drawn */
+    FragmentShader fragmentShader(fragmentShaderSource);
+    VertexShader vertexShader(vertexShaderSource);
+    program = new GLSLProgram();
+    program->attach(vertexShader);
+    program->attach(fragmentShader);
+    glBindAttribLocation(program->id(), ATTRIB_UNIT_POSITION, "unitPosition");
+    glBindAttribLocation(program->id(), ATTRIB_BOX_MIN, "boxMin");
+    glBindAttribLocation(program->id(), ATTRIB_BOX_MAX, "boxMax");
+    if (!program->link())
+    {
+        fprintf(stderr, "Bounding box shader program did not link correctly. Exiting.\n");
+        exit(1);
+    }
+    uColor = glGetUniformLocation(program->id(), "color");
+
+    /* The six faces of the unit cube, counter-clockwise when seen from outside */
+    const float faces[6][4][3] =
+    {
+        {{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}},   /* right */
+        {{0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}},   /* left */
+        {{0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}},   /* top */
+        {{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1}},   /* bottom */
+        {{0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}},   /* front */
+        {{0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}}    /* back */
+    };
+    const int quadToTriangles[] = {0, 1, 2, 0, 2, 3};
+    std::vector<float> cube;
+
+    for (int i = 0; i < 6; i++)
+    {
+        for (int j = 0; j < 6; j++)
+        {
+            cube.insert(cube.end(), faces[i][quadToTriangles[j]], faces[i][quadToTriangles[j]] + 3);
+        }
+    }
+
+    /* The twelve edges of the unit cube, four along each axis */
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int corner = 0; corner < 4; corner++)
+        {
+            float start[3];
+            start[axis] = 0.0f;
+            start[(axis + 1) % 3] = static_cast<float>(corner & 1);
+            start[(axis + 2) % 3] = static_cast<float>((corner >> 1) & 1);
+
+            float end[3] = {start[0], start[1], start[2]};
+            end[axis] = 1.0f;
+
+            cube.insert(cube.end(), start, start + 3);
+            cube.insert(cube.end(), end, end + 3);
+        }
+    }
+
+    glGenBuffers(1, &cubeBuffer);
+    state.BindBuffer(GL_ARRAY_BUFFER, cubeBuffer);
+    glBufferData(GL_ARRAY_BUFFER, cube.size() * sizeof(float), &cube[0], GL_STATIC_DRAW);
+
+    if (isInstanced)
+    {
+        glGenBuffers(1, &instanceBuffer);
+    }
+} /* BoundingBoxBatch::Init() */
+
+/**
+ * Removes all the boxes from the batch, keeping the allocated storage for the next frame
+ */
+void BoundingBoxBatch::Clear()
+{
+    instances.clear();
+} /* BoundingBoxBatch::Clear() */
+
+/**
+ * Adds a box to the batch
+ * @param box - An axis-aligned bounding box in eye space
+ */
+void BoundingBoxBatch::Add(const AxisAlignedBoundingBox& box)
+{
+    Instance instance =
+    {
+        {box.left, box.bottom, box.back},
+        {box.right, box.top, box.front}
+    };
+
+    instances.push_back(instance);
+} /* BoundingBoxBatch::Add() */
+
+/**
+ * Returns the number of boxes in the batch
+ * @return - The number of boxes added since the last Clear()
+ */
+size_t BoundingBoxBatch::GetSize() const
+{
+    return instances.size();
+} /* BoundingBoxBatch::GetSize() */
+
+/**
+ * Returns true if the batch is drawn with a single instanced draw call
+ * @return - True if instanced arrays are supported; otherwise, false
+ */
+bool BoundingBoxBatch::IsInstanced() const
+{
+    return isInstanced;
+} /* BoundingBoxBatch::IsInstanced() */
+
+/**
+ * Draws all the boxes in the batch, farthest first so that they blend correctly
+ * Leaves the batch's shader program bound
+ * @param state - The state cache used to bind the program and buffers
+ * @param isWireframe - True to draw the edges of the boxes instead of their faces
+ */
+void BoundingBoxBatch::Draw(GLStateCache& state, bool isWireframe)
+{
+    if (instances.empty())
+    {
+        return;
+    }
+
+    std::sort(instances.begin(), instances.end(), IsFartherThan);
+
+    /* The boxes are already in eye space, so only the projection matrix is applied */
+    const float color[] = {1.0f, 0.33f, 1.0f, 0.5f};
+    state.UseProgram(program->id());
+    state.Uniform4fv(uColor, color);
+
+    /* The fixed function arrays may alias the generic attributes on some drivers */
+    state.DisableClientState(GL_VERTEX_ARRAY);
+    state.DisableClientState(GL_NORMAL_ARRAY);
+    state.DisableClientState(GL_COLOR_ARRAY);
+
+    state.BindBuffer(GL_ARRAY_BUFFER, cubeBuffer);
+    glEnableVertexAttribArray(ATTRIB_UNIT_POSITION);
+    glVertexAttribPointer(ATTRIB_UNIT_POSITION, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+
+    GLenum mode = isWireframe ? GL_LINES : GL_TRIANGLES;
+    GLint first = isWireframe ? CUBE_TRIANGLE_VERTICES : 0;
+    GLsizei count = isWireframe ? CUBE_EDGE_VERTICES : CUBE_TRIANGLE_VERTICES;
+
+    if (isInstanced)
+    {
+        /* Orphan last frame's storage so the upload does not wait for the GPU */
+        GLsizeiptr size = instances.size() * sizeof(Instance);
+        state.BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, &instances[0]);
+
+        glEnableVertexAttribArray(ATTRIB_BOX_MIN);
+        glEnableVertexAttribArray(ATTRIB_BOX_MAX);
+        glVertexAttribPointer(ATTRIB_BOX_MIN, 3, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                BUFFER_OFFSET(offsetof(Instance, boxMin)));
+        glVertexAttribPointer(ATTRIB_BOX_MAX, 3, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                BUFFER_OFFSET(offsetof(Instance, boxMax)));
+        glVertexAttribDivisorARB(ATTRIB_BOX_MIN, 1);
+        glVertexAttribDivisorARB(ATTRIB_BOX_MAX, 1);
+
+        glDrawArraysInstancedARB(mode, first, count, static_cast<GLsizei>(instances.size()));
+
+        glVertexAttribDivisorARB(ATTRIB_BOX_MIN, 0);
+        glVertexAttribDivisorARB(ATTRIB_BOX_MAX, 0);
+        glDisableVertexAttribArray(ATTRIB_BOX_MIN);
+        glDisableVertexAttribArray(ATTRIB_BOX_MAX);
+    }
+    else
+    {
+        /* Without instancing, the corners are passed as constant attributes per box */
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            glVertexAttrib3fv(ATTRIB_BOX_MIN, instances[i].boxMin);
+            glVertexAttrib3fv(ATTRIB_BOX_MAX, instances[i].boxMax);
+            glDrawArrays(mode, first, count);
+        }
+    }
+
+    glDisableVertexAttribArray(ATTRIB_UNIT_POSITION);
+} /* BoundingBoxBatch::Draw() */
+
+/**
+ * Compares two boxes by the depth of their centers
+ * @param a - The first box
+ * @param b - The second box
+ * @return - True if box a is farther from the eye than box b
+ */
+bool BoundingBoxBatch::IsFartherThan(const Instance& a, const Instance& b)
+{
+    /* The eye looks down the -z axis, so farther boxes have smaller z */
+    return a.boxMin[2] + a.boxMax[2] < b.boxMin[2] + b.boxMax[2];
+} /* BoundingBoxBatch::IsFartherThan() */
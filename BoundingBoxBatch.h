@@ -0,0 +1,66 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: BoundingBoxBatch.h
+ *
+ * A C++ module implementing a batch of axis-aligned
+ * bounding boxes which are drawn together with a single
+ * instanced draw call of a unit cube, either as
+ * translucent solids or as wireframes.
+ */
+
+#ifndef BOUNDINGBOXBATCH_H_
+#define BOUNDINGBOXBATCH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "AxisAlignedBoundingBox.h"
+#include "GLStateCache.h"
+
+/* Forward declarations */
+class GLSLProgram;
+
+/* Batches larger than this are drawn as wireframes to keep the fill rate down */
+#define BOUNDING_BOX_WIREFRAME_THRESHOLD 4096
+
+class BoundingBoxBatch
+{
+public:
+    /* Default constructor */
+    BoundingBoxBatch();
+
+    /* Member functions */
+    void Init(GLStateCache& state, const char* vertexShaderSource,
+            const char* fragmentShaderSource);
+    void Clear();
+    void Add(const AxisAlignedBoundingBox& box);
+    size_t GetSize() const;
+    bool IsInstanced() const;
+    void Draw(GLStateCache& state, bool isWireframe);
+
+private:
+    /* Per-instance data stored in the instance buffer */
+    struct Instance
+    {
+        float boxMin[3];
+        float boxMax[3];
+    };
+
+    /* Private data members */
+    std::vector<Instance> instances;    /* the boxes added since the last Clear() */
+    bool isInstanced;                   /* true if instanced arrays are supported */
+    GLSLProgram* program;               /* the shader program which stretches the unit cube */
+    GLint uColor;                       /* the location of the color uniform */
+    GLuint cubeBuffer;                  /* unit cube triangles followed by its edges */
+    GLuint instanceBuffer;              /* the instances of the current frame */
+
+    /* Private helper functions */
+    static bool IsFartherThan(const Instance& a, const Instance& b);
+}; /* BoundingBoxBatch class */
+
+#endif /* BOUNDINGBOXBATCH_H_ */
@@ -29,6 +29,7 @@ Camera::Camera(float eyeX, float eyeY, float eyeZ,
     : eyePosition(eyeX, eyeY, eyeZ)
     , refPoint(refX, refY, refZ)
     , upVector(upX, upY, upZ)
+    , version(0)
 {
     upVector = upVector.Normalize();
 }/* Default constructor */
@@ -52,8 +53,39 @@ void Camera::Rotate(Quaternion rotation)
 
     /* Calculate the new up vector */
     upVector = cross(rightVector, gazeVector).Normalize();
+
+    version++;
 } /* Camera::Rotate() */
 
+/**
+ * Moves the camera to an eye position and reference point, keeping its up vector
+ * The camera's version only changes if the camera actually moves
+ * @param eye - The new eye position
+ * @param ref - The new reference point
+ */
+void Camera::MoveTo(const Point3& eye, const Point3& ref)
+{
+    if (eye.x == eyePosition.x && eye.y == eyePosition.y && eye.z == eyePosition.z
+            && ref.x == refPoint.x && ref.y == refPoint.y && ref.z == refPoint.z)
+    {
+        return;
+    }
+
+    eyePosition = eye;
+    refPoint = ref;
+    version++;
+} /* Camera::MoveTo() */
+
+/**
+ * Returns the camera's version, which changes whenever the camera moves, so that work which
+ * only depends on the view can be skipped while it stays the same
+ * @return - The number of times the camera has moved
+ */
+unsigned long Camera::GetVersion() const
+{
+    return version;
+} /* Camera::GetVersion() */
+
 /**
  * Returns the camera's gaze vector
  * @return - The camera's gaze vector
@@ -31,11 +31,16 @@ public:
 
     /* Member functions */
     void Rotate(Quaternion rotation);
+    void MoveTo(const Point3& eye, const Point3& ref);
+    unsigned long GetVersion() const;
 
 private:
     /* Private helper functions */
     Vec3 GetGazeVector() const;
     Vec3 GetRightVector() const;
+
+    /* Private data members */
+    unsigned long version;  /* counts the changes made through the member functions */
 }; /* Camera class */
 
 #endif /* CAMERA_H_ */
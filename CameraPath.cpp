@@ -0,0 +1,141 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: CameraPath.cpp
+ *
+ * A C++ module implementing a camera path which is read
+ * from a text file of keyframes and moves a camera along
+ * straight lines between them.
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "CameraPath.h"
+
+/* Longest line accepted in a camera path file */
+#define CAMERA_PATH_MAX_LINE 256
+
+/**
+ * Default constructor creates an empty path
+ */
+CameraPath::CameraPath()
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Reads the keyframes from a text file, replacing any previous ones
+ * Each keyframe is a line holding the eye position and the reference point as six numbers;
+ * blank lines and lines starting with '#' are skipped
+ * @param filename - The name of the camera path file
+ * @return - True if the file was read and holds at least one keyframe; otherwise, false
+ */
+bool CameraPath::Load(const char* filename)
+{
+    FILE* file = fopen(filename, "r");
+
+    keyframes.clear();
+
+    if (NULL == file)
+    {
+        perror(filename);
+        return false;
+    }
+
+    char line[CAMERA_PATH_MAX_LINE];
+    int lineNumber = 0;
+    bool isValid = true;
+
+    while (isValid && NULL != fgets(line, sizeof(line), file))
+    {
+        Keyframe keyframe;
+        char first = '\0';
+
+        lineNumber++;
+
+        /* Skip comments and blank lines */
+        if (1 != sscanf(line, " %c", &first) || '#' == first)
+        {
+            continue;
+        }
+
+        if (6 == sscanf(line, "%f %f %f %f %f %f",
+                &keyframe.eyePosition.x, &keyframe.eyePosition.y, &keyframe.eyePosition.z,
+                &keyframe.refPoint.x, &keyframe.refPoint.y, &keyframe.refPoint.z))
+        {
+            keyframes.push_back(keyframe);
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: expected an eye position and a reference point\n",
+                    filename, lineNumber);
+            isValid = false;
+        }
+    }
+
+    fclose(file);
+
+    if (isValid && keyframes.empty())
+    {
+        fprintf(stderr, "%s: the camera path has no keyframes\n", filename);
+        isValid = false;
+    }
+
+    if (!isValid)
+    {
+        keyframes.clear();
+    }
+
+    return isValid;
+} /* CameraPath::Load() */
+
+/**
+ * Returns true if the path has no keyframes
+ * @return - True if nothing has been loaded; otherwise, false
+ */
+bool CameraPath::IsEmpty() const
+{
+    return keyframes.empty();
+} /* CameraPath::IsEmpty() */
+
+/**
+ * Returns the number of keyframes on the path
+ * @return - The number of keyframes read by Load()
+ */
+size_t CameraPath::GetKeyframeCount() const
+{
+    return keyframes.size();
+} /* CameraPath::GetKeyframeCount() */
+
+/**
+ * Moves a camera to a point along the path, keeping its up vector
+ * The keyframes are spaced evenly over the path
+ * @param t - The position along the path, from 0 at the first keyframe to 1 at the last one
+ * @param camera - The camera to move
+ */
+void CameraPath::Apply(float t, Camera* camera) const
+{
+    if (keyframes.empty())
+    {
+        return;
+    }
+
+    /* Find the segment containing t and the position within it */
+    float position = std::max(0.0f, std::min(t, 1.0f)) * (keyframes.size() - 1);
+    size_t segment = std::min(static_cast<size_t>(position), keyframes.size() - 1);
+    size_t next = std::min(segment + 1, keyframes.size() - 1);
+    float s = position - segment;
+
+    const Keyframe& a = keyframes[segment];
+    const Keyframe& b = keyframes[next];
+
+    camera->eyePosition = Point3(a.eyePosition.x + s * (b.eyePosition.x - a.eyePosition.x),
+                                 a.eyePosition.y + s * (b.eyePosition.y - a.eyePosition.y),
+                                 a.eyePosition.z + s * (b.eyePosition.z - a.eyePosition.z));
+    camera->refPoint = Point3(a.refPoint.x + s * (b.refPoint.x - a.refPoint.x),
+                              a.refPoint.y + s * (b.refPoint.y - a.refPoint.y),
+                              a.refPoint.z + s * (b.refPoint.z - a.refPoint.z));
+} /* CameraPath::Apply() */
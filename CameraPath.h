@@ -0,0 +1,46 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: CameraPath.h
+ *
+ * A C++ module implementing a camera path which is read
+ * from a text file of keyframes and moves a camera along
+ * straight lines between them.
+ */
+
+#ifndef CAMERAPATH_H_
+#define CAMERAPATH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "Camera.h"
+#include "Point3.h"
+
+class CameraPath
+{
+public:
+    /* Default constructor */
+    CameraPath();
+
+    /* Member functions */
+    bool Load(const char* filename);
+    bool IsEmpty() const;
+    size_t GetKeyframeCount() const;
+    void Apply(float t, Camera* camera) const;
+
+private:
+    /* A camera pose along the path */
+    struct Keyframe
+    {
+        Point3 eyePosition;
+        Point3 refPoint;
+    };
+
+    /* Private data members */
+    std::vector<Keyframe> keyframes;    /* the poses, visited in file order */
+}; /* CameraPath class */
+
+#endif /* CAMERAPATH_H_ */
@@ -107,6 +107,7 @@ public:
 
   ~FaceList( ){
 		msFree2D( vertices, vc, 3 );
+		msFree2D( colors, vc, 3 );
 		msFree2D( v_normals, vc, 3 );
 		msFree2D( f_normals, fc, 3 );
     msFree2D( faces, fc, 3 );
@@ -0,0 +1,223 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: FramePipeline.cpp
+ *
+ * A C++ module implementing a two stage frame pipeline in
+ * which a worker thread updates, bounds and culls the scene
+ * into the next render list while the OpenGL thread draws
+ * the current one.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "FramePipeline.h"
+
+/**
+ * Default constructor creates a stopped pipeline
+ */
+FramePipeline::FramePipeline()
+    : producer(NULL)
+    , isThreaded(false)
+    , isStopping(false)
+    , isPending(false)
+    , hasFrame(false)
+    , pendingList(NULL)
+    , front(0)
+{
+    memset(&pendingInput, 0, sizeof(pendingInput));
+    memset(lists[0].view, 0, sizeof(lists[0].view));
+    memset(lists[1].view, 0, sizeof(lists[1].view));
+    lists[0].isEveryModelReady = false;
+    lists[1].isEveryModelReady = false;
+    lists[0].animationTime = 0.0f;
+    lists[1].animationTime = 0.0f;
+    memset(&lists[0].counters, 0, sizeof(lists[0].counters));
+    memset(&lists[1].counters, 0, sizeof(lists[1].counters));
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&condition, NULL);
+} /* Default constructor */
+
+/**
+ * Destructor stops the worker thread
+ */
+FramePipeline::~FramePipeline()
+{
+    Stop();
+    pthread_cond_destroy(&condition);
+    pthread_mutex_destroy(&mutex);
+} /* Destructor */
+
+/**
+ * Starts producing frames
+ * @param producer - The function which fills a render list from a frame's input
+ * @param isThreaded - True to produce the next frame on a worker thread while the current one
+ * is drawn; false to produce each frame when it is drawn
+ * @return - True if the pipeline started as requested; false if it fell back to producing
+ * frames on the calling thread
+ */
+bool FramePipeline::Start(FrameProducer producer, bool isThreaded)
+{
+    this->producer = producer;
+    this->isThreaded = false;
+    isStopping = false;
+    hasFrame = false;
+
+    if (isThreaded)
+    {
+        if (0 != pthread_create(&thread, NULL, Run, this))
+        {
+            fprintf(stderr, "Frame pipeline: the worker thread could not be created.\n");
+            return false;
+        }
+
+        this->isThreaded = true;
+    }
+
+    return true;
+} /* FramePipeline::Start() */
+
+/**
+ * Finishes the worker thread's job, if any, and joins the worker thread
+ */
+void FramePipeline::Stop()
+{
+    if (!isThreaded)
+    {
+        return;
+    }
+
+    Wait();
+
+    pthread_mutex_lock(&mutex);
+    isStopping = true;
+    pthread_cond_broadcast(&condition);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, NULL);
+    isThreaded = false;
+} /* FramePipeline::Stop() */
+
+/**
+ * Returns whether frames are produced on a worker thread
+ * @return - True if the worker thread is running
+ */
+bool FramePipeline::IsThreaded() const
+{
+    return isThreaded;
+} /* FramePipeline::IsThreaded() */
+
+/**
+ * Hands the pipeline the input of a new frame and returns the render list to draw now
+ * When threaded, the returned list was produced from the previous frame's input while that
+ * frame was drawn, and the new input is produced while the returned list is drawn, so the
+ * frame takes the longer of the two stages instead of their sum at the cost of a frame of
+ * latency; the very first list is produced at once
+ * @param input - The input of the new frame
+ * @return - The render list to draw, which stays unchanged until the next call
+ */
+const RenderList& FramePipeline::Advance(const FrameInput& input)
+{
+    if (!isThreaded)
+    {
+        producer(input, lists[front]);
+        return lists[front];
+    }
+
+    if (!hasFrame)
+    {
+        /* Draw the first frame without waiting a frame; its ticks have then already run */
+        producer(input, lists[front]);
+        hasFrame = true;
+
+        FrameInput next = input;
+        next.tickCount = 0;
+        Kick(next, &lists[1 - front]);
+    }
+    else
+    {
+        Wait();
+        front = 1 - front;
+        Kick(input, &lists[1 - front]);
+    }
+
+    return lists[front];
+} /* FramePipeline::Advance() */
+
+/**
+ * Returns the render list drawn last
+ * @return - The render list most recently returned by Advance()
+ */
+const RenderList& FramePipeline::GetFront() const
+{
+    return lists[front];
+} /* FramePipeline::GetFront() */
+
+/**
+ * Runs the worker thread, producing each render list it is handed
+ * @param pipeline - The pipeline which owns the worker thread
+ * @return - Always NULL
+ */
+void* FramePipeline::Run(void* pipeline)
+{
+    FramePipeline* self = static_cast<FramePipeline*>(pipeline);
+
+    pthread_mutex_lock(&self->mutex);
+    for (;;)
+    {
+        while (!self->isPending && !self->isStopping)
+        {
+            pthread_cond_wait(&self->condition, &self->mutex);
+        }
+
+        if (self->isStopping)
+        {
+            break;
+        }
+
+        /* Produce the list without holding the lock; the OpenGL thread does not touch it */
+        FrameInput input = self->pendingInput;
+        RenderList* list = self->pendingList;
+        pthread_mutex_unlock(&self->mutex);
+
+        self->producer(input, *list);
+
+        pthread_mutex_lock(&self->mutex);
+        self->isPending = false;
+        pthread_cond_broadcast(&self->condition);
+    }
+    pthread_mutex_unlock(&self->mutex);
+
+    return NULL;
+} /* FramePipeline::Run() */
+
+/**
+ * Hands the worker thread a render list to produce
+ * @param input - The input of the frame to produce
+ * @param list - The render list to fill, which the worker thread owns until Wait() returns
+ */
+void FramePipeline::Kick(const FrameInput& input, RenderList* list)
+{
+    pthread_mutex_lock(&mutex);
+    pendingInput = input;
+    pendingList = list;
+    isPending = true;
+    pthread_cond_broadcast(&condition);
+    pthread_mutex_unlock(&mutex);
+} /* FramePipeline::Kick() */
+
+/**
+ * Blocks until the worker thread has finished its render list
+ */
+void FramePipeline::Wait()
+{
+    pthread_mutex_lock(&mutex);
+    while (isPending)
+    {
+        pthread_cond_wait(&condition, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+} /* FramePipeline::Wait() */
@@ -0,0 +1,112 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: FramePipeline.h
+ *
+ * A C++ module implementing a two stage frame pipeline in
+ * which a worker thread updates, bounds and culls the scene
+ * into the next render list while the OpenGL thread draws
+ * the current one.
+ */
+
+#ifndef FRAMEPIPELINE_H_
+#define FRAMEPIPELINE_H_
+
+#include <pthread.h>
+#include <vector>
+
+#include "AxisAlignedBoundingBox.h"
+#include "FrameScheduler.h"
+#include "MeshCache.h"
+#include "ModelInstanceBatch.h"
+#include "RenderQueue.h"
+
+/* What the OpenGL thread hands the worker to produce a frame */
+struct FrameInput
+{
+    float projection[16];                               /* the projection matrix to cull against */
+    bool isUsingGLSLShader;                             /* chooses the program in the sort keys */
+    bool isAnimatingOnGpu;                              /* lets the vertex shader pose the models */
+    int tickCount;                                      /* the number of simulation ticks to run */
+    double tickTimes[SIMULATION_MAX_TICKS_PER_FRAME];   /* the simulation time of each tick */
+    double alpha;                                       /* the interpolation factor between ticks */
+    double animationTime;                               /* the time between the last two ticks */
+    bool isUsingLod;                                    /* draws distant models coarser */
+    int viewportHeight;                                 /* the height of the view in pixels */
+}; /* FrameInput struct */
+
+/* How much work producing a render list did, and how much it skipped */
+struct ProduceCounters
+{
+    int sweptOutsideCount;  /* models culled by their swept boxes */
+    int sweptInsideCount;   /* models kept by their swept boxes */
+    int exactCount;         /* models culled by their exact boxes */
+    int updateSkippedCount; /* models not animated, since the clock stood still */
+    int cullSkippedCount;   /* models whose last culling was kept, since nothing changed */
+    int subtreeCulledCount; /* models culled along with the subtree they are in */
+    int posedCount;         /* models posed again in world space */
+    int lodCounts[MESH_LOD_COUNT]; /* visible models drawn at each level of detail */
+    int triangleCount;      /* triangles the visible models are drawn with */
+    int fullDetailTriangleCount; /* triangles they would be drawn with at full detail */
+    bool isViewChanged;     /* whether the camera or the projection changed */
+}; /* ProduceCounters struct */
+
+/* Everything the OpenGL thread needs to draw a frame; it does not change while drawn */
+struct RenderList
+{
+    RenderQueue queue;                                  /* the sorted draw items */
+    std::vector<AxisAlignedBoundingBox> boxes;          /* the visible bounding volumes in eye space */
+    std::vector<ModelInstanceList> instanceLists;       /* the visible models the shader animates */
+    ModelInstanceList highlightedInstances;             /* the hovered model, if the shader
+                                                         * animates it */
+    size_t instanceCount;                               /* the instances of every list */
+    bool isAnimatingOnGpu;                              /* whether the shader poses the models */
+    float animationTime;                                /* the time the shader poses the models at */
+    float view[16];                                     /* the viewing matrix */
+    bool isEveryModelReady;                             /* whether every model was drawable */
+    ProduceCounters counters;                           /* the work producing the list did */
+}; /* RenderList struct */
+
+/* Fills a render list from the frame's input; runs on the worker thread when threaded */
+typedef void (*FrameProducer)(const FrameInput& input, RenderList& list);
+
+class FramePipeline
+{
+public:
+    /* Default constructor */
+    FramePipeline();
+
+    /* Destructor */
+    ~FramePipeline();
+
+    /* Member functions */
+    bool Start(FrameProducer producer, bool isThreaded);
+    void Stop();
+    bool IsThreaded() const;
+    const RenderList& Advance(const FrameInput& input);
+    const RenderList& GetFront() const;
+
+private:
+    /* Private helper functions */
+    static void* Run(void* pipeline);
+    void Kick(const FrameInput& input, RenderList* list);
+    void Wait();
+
+    /* Private data members */
+    FrameProducer producer;     /* fills the render lists */
+    bool isThreaded;            /* true if the worker thread is running */
+    bool isStopping;            /* tells the worker thread to exit */
+    bool isPending;             /* true while the worker thread owns a render list */
+    bool hasFrame;              /* true once the first render list has been produced */
+    pthread_t thread;           /* the worker thread */
+    pthread_mutex_t mutex;      /* guards the handoff between the threads */
+    pthread_cond_t condition;   /* signals a new job or a finished one */
+    FrameInput pendingInput;    /* the input of the worker's job */
+    RenderList* pendingList;    /* the render list of the worker's job */
+    RenderList lists[2];        /* the render list being drawn and the one being produced */
+    int front;                  /* the index of the render list being drawn */
+}; /* FramePipeline class */
+
+#endif /* FRAMEPIPELINE_H_ */
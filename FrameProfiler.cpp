@@ -0,0 +1,191 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: FrameProfiler.cpp
+ *
+ * A C++ module implementing a CPU profiler which records
+ * the wall clock time spent in each phase of a frame and
+ * summarizes the samples once the run is over.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ctime>
+
+#include "FrameProfiler.h"
+
+/**
+ * Default constructor creates a disabled profiler without samples
+ */
+FrameProfiler::FrameProfiler()
+    : isEnabled(false)
+{
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        startTimes[i] = 0.0;
+    }
+} /* Default constructor */
+
+/**
+ * Turns recording on or off; a disabled profiler does not read the clock at all
+ * @param flag - True to record samples; otherwise, false
+ */
+void FrameProfiler::SetEnabled(bool flag)
+{
+    isEnabled = flag;
+} /* FrameProfiler::SetEnabled() */
+
+/**
+ * Returns true if the profiler is recording samples
+ * @return - True if the profiler is enabled; otherwise, false
+ */
+bool FrameProfiler::IsEnabled() const
+{
+    return isEnabled;
+} /* FrameProfiler::IsEnabled() */
+
+/**
+ * Starts timing a phase
+ * @param phase - The phase about to run
+ */
+void FrameProfiler::Begin(ProfilePhase phase)
+{
+    if (isEnabled)
+    {
+        startTimes[phase] = GetMilliseconds();
+    }
+} /* FrameProfiler::Begin() */
+
+/**
+ * Stops timing a phase and records its duration as one sample
+ * @param phase - The phase which just finished
+ */
+void FrameProfiler::End(ProfilePhase phase)
+{
+    if (isEnabled)
+    {
+        samples[phase].push_back(GetMilliseconds() - startTimes[phase]);
+    }
+} /* FrameProfiler::End() */
+
+/**
+ * Discards the recorded samples
+ */
+void FrameProfiler::Reset()
+{
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        samples[i].clear();
+    }
+} /* FrameProfiler::Reset() */
+
+/**
+ * Returns the number of samples recorded for a phase
+ * @param phase - The phase to query
+ * @return - The number of times the phase was timed since the last reset
+ */
+unsigned long FrameProfiler::GetSampleCount(ProfilePhase phase) const
+{
+    return samples[phase].size();
+} /* FrameProfiler::GetSampleCount() */
+
+/**
+ * Returns the average duration of a phase
+ * @param phase - The phase to query
+ * @return - The average duration in milliseconds, or 0 without samples
+ */
+double FrameProfiler::GetAverageMilliseconds(ProfilePhase phase) const
+{
+    double total = 0.0;
+
+    for (size_t i = 0; i < samples[phase].size(); i++)
+    {
+        total += samples[phase][i];
+    }
+
+    return samples[phase].empty() ? 0.0 : total / samples[phase].size();
+} /* FrameProfiler::GetAverageMilliseconds() */
+
+/**
+ * Returns the shortest duration of a phase
+ * @param phase - The phase to query
+ * @return - The shortest duration in milliseconds, or 0 without samples
+ */
+double FrameProfiler::GetMinMilliseconds(ProfilePhase phase) const
+{
+    return samples[phase].empty() ? 0.0
+            : *std::min_element(samples[phase].begin(), samples[phase].end());
+} /* FrameProfiler::GetMinMilliseconds() */
+
+/**
+ * Returns the longest duration of a phase
+ * @param phase - The phase to query
+ * @return - The longest duration in milliseconds, or 0 without samples
+ */
+double FrameProfiler::GetMaxMilliseconds(ProfilePhase phase) const
+{
+    return samples[phase].empty() ? 0.0
+            : *std::max_element(samples[phase].begin(), samples[phase].end());
+} /* FrameProfiler::GetMaxMilliseconds() */
+
+/**
+ * Returns a percentile of the durations of a phase using the nearest-rank method
+ * @param phase - The phase to query
+ * @param percentile - The percentile between 0 and 100
+ * @return - The duration in milliseconds which the given percent of the samples do not exceed,
+ * or 0 without samples
+ */
+double FrameProfiler::GetPercentileMilliseconds(ProfilePhase phase, double percentile) const
+{
+    return GetPercentile(samples[phase], percentile);
+} /* FrameProfiler::GetPercentileMilliseconds() */
+
+/**
+ * Returns a percentile of a set of values using the nearest-rank method
+ * @param values - The values, in any order
+ * @param percentile - The percentile between 0 and 100
+ * @return - The value which the given percent of the values do not exceed, or 0 without values
+ */
+double FrameProfiler::GetPercentile(const std::vector<double>& values, double percentile)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+
+    size_t rank = static_cast<size_t>(ceil(percentile / 100.0 * sorted.size()));
+    rank = std::min(std::max(rank, static_cast<size_t>(1)), sorted.size());
+
+    return sorted[rank - 1];
+} /* FrameProfiler::GetPercentile() */
+
+/**
+ * Returns the name of a phase as used in reports
+ * @param phase - The phase to name
+ * @return - The lowercase name of the phase
+ */
+const char* FrameProfiler::GetPhaseName(ProfilePhase phase)
+{
+    static const char* names[PHASE_COUNT] = {"update", "cull", "sort", "submit", "wait", "frame"};
+
+    return names[phase];
+} /* FrameProfiler::GetPhaseName() */
+
+/**
+ * Reads the monotonic clock, which setting the system time does not move
+ * @return - The current time in milliseconds since an arbitrary starting point
+ */
+double FrameProfiler::GetMilliseconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+} /* FrameProfiler::GetMilliseconds() */
@@ -0,0 +1,58 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: FrameProfiler.h
+ *
+ * A C++ module implementing a CPU profiler which records
+ * the wall clock time spent in each phase of a frame and
+ * summarizes the samples once the run is over.
+ */
+
+#ifndef FRAMEPROFILER_H_
+#define FRAMEPROFILER_H_
+
+#include <vector>
+
+/* The phases of a frame which are timed separately */
+enum ProfilePhase
+{
+    PHASE_UPDATE,   /* animating the models */
+    PHASE_CULL,     /* transforming, bounding and culling the models */
+    PHASE_SORT,     /* sorting the render queue */
+    PHASE_SUBMIT,   /* issuing the draw calls */
+    PHASE_WAIT,     /* waiting for the worker thread to finish the next render list */
+    PHASE_FRAME,    /* the whole frame, including waiting for the GPU */
+    PHASE_COUNT
+}; /* ProfilePhase enum */
+
+class FrameProfiler
+{
+public:
+    /* Default constructor */
+    FrameProfiler();
+
+    /* Member functions */
+    void SetEnabled(bool flag);
+    bool IsEnabled() const;
+    void Begin(ProfilePhase phase);
+    void End(ProfilePhase phase);
+    void Reset();
+    unsigned long GetSampleCount(ProfilePhase phase) const;
+    double GetAverageMilliseconds(ProfilePhase phase) const;
+    double GetMinMilliseconds(ProfilePhase phase) const;
+    double GetMaxMilliseconds(ProfilePhase phase) const;
+    double GetPercentileMilliseconds(ProfilePhase phase, double percentile) const;
+    static const char* GetPhaseName(ProfilePhase phase);
+    static double GetMilliseconds();
+    static double GetPercentile(const std::vector<double>& values, double percentile);
+
+private:
+    /* Private data members */
+    bool isEnabled;                             /* true if Begin() and End() record samples */
+    double startTimes[PHASE_COUNT];             /* the time each phase last began */
+    std::vector<double> samples[PHASE_COUNT];   /* the duration of each phase per frame */
+}; /* FrameProfiler class */
+
+#endif /* FRAMEPROFILER_H_ */
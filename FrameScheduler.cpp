@@ -0,0 +1,231 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: FrameScheduler.cpp
+ *
+ * A C++ module implementing a frame scheduler which runs
+ * the simulation in fixed time steps independently of the
+ * frame rate, paces the frames in one of several modes,
+ * and keeps statistics about the recent frame times.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "FrameProfiler.h"
+#include "FrameScheduler.h"
+
+/* Slack for the rounding error of accumulating tick lengths */
+#define SIMULATION_TICK_EPSILON 1e-9
+
+/* Frame rate of FRAME_MODE_TARGET unless set otherwise */
+#define FRAME_DEFAULT_TARGET_FPS 60.0
+
+/**
+ * Default constructor creates a scheduler synchronized to the display
+ */
+FrameScheduler::FrameScheduler()
+    : mode(FRAME_MODE_VSYNC)
+    , targetFps(FRAME_DEFAULT_TARGET_FPS)
+    , lastFrameTime(0.0)
+    , nextFrameTime(0.0)
+    , accumulator(0.0)
+    , simulationTime(-SIMULATION_TICK_SECONDS)
+    , ticksDue(0)
+    , tickCount(0)
+    , frameCount(0)
+{
+    frameTimes.reserve(FRAME_TIME_HISTORY);
+} /* Default constructor */
+
+/**
+ * Changes how the frames are paced, discarding the frame time statistics
+ * The caller is responsible for the display's swap interval
+ * @param mode - The new pacing mode
+ */
+void FrameScheduler::SetMode(FrameMode mode)
+{
+    this->mode = mode;
+    frameTimes.clear();
+} /* FrameScheduler::SetMode() */
+
+/**
+ * Returns how the frames are paced
+ * @return - The current pacing mode
+ */
+FrameMode FrameScheduler::GetMode() const
+{
+    return mode;
+} /* FrameScheduler::GetMode() */
+
+/**
+ * Sets the frame rate of FRAME_MODE_TARGET
+ * @param fps - The number of frames per second, greater than 0
+ */
+void FrameScheduler::SetTargetFps(double fps)
+{
+    targetFps = fps;
+} /* FrameScheduler::SetTargetFps() */
+
+/**
+ * Returns the frame rate of FRAME_MODE_TARGET
+ * @return - The number of frames per second
+ */
+double FrameScheduler::GetTargetFps() const
+{
+    return targetFps;
+} /* FrameScheduler::GetTargetFps() */
+
+/**
+ * Returns how long to wait before the next frame is due
+ * Only FRAME_MODE_TARGET waits; vsync is paced by swapping the buffers
+ * @param now - The current time in seconds
+ * @return - The time until the next frame in seconds, or 0 if it is due
+ */
+double FrameScheduler::GetDelaySeconds(double now) const
+{
+    if (FRAME_MODE_TARGET != mode || 0 == frameCount)
+    {
+        return 0.0;
+    }
+
+    return std::max(0.0, nextFrameTime - now);
+} /* FrameScheduler::GetDelaySeconds() */
+
+/**
+ * Starts a frame, working out how many simulation ticks have fallen due since the last one
+ * The very first frame runs a single tick at simulation time 0
+ * @param now - The current time in seconds
+ */
+void FrameScheduler::BeginFrame(double now)
+{
+    if (0 == frameCount)
+    {
+        ticksDue = 1;
+        nextFrameTime = now;
+    }
+    else
+    {
+        double elapsed = now - lastFrameTime;
+
+        /* Keep the most recent frame times in a ring */
+        if (frameTimes.size() < FRAME_TIME_HISTORY)
+        {
+            frameTimes.push_back(elapsed * 1000.0);
+        }
+        else
+        {
+            frameTimes[(frameCount - 1) % FRAME_TIME_HISTORY] = elapsed * 1000.0;
+        }
+
+        accumulator += elapsed;
+        ticksDue = static_cast<int>(floor((accumulator + SIMULATION_TICK_EPSILON)
+                / SIMULATION_TICK_SECONDS));
+
+        /* After a long stall the simulation skips ahead instead of running every tick */
+        if (SIMULATION_MAX_TICKS_PER_FRAME < ticksDue)
+        {
+            ticksDue = SIMULATION_MAX_TICKS_PER_FRAME;
+            accumulator = fmod(accumulator, SIMULATION_TICK_SECONDS);
+        }
+        else
+        {
+            accumulator = std::max(0.0, accumulator - ticksDue * SIMULATION_TICK_SECONDS);
+        }
+    }
+
+    /* A late frame makes the next one due at once rather than a whole period later */
+    nextFrameTime = std::max(nextFrameTime + 1.0 / targetFps, now);
+
+    lastFrameTime = now;
+    frameCount++;
+} /* FrameScheduler::BeginFrame() */
+
+/**
+ * Advances the simulation by one tick if one is due in this frame
+ * @return - True if the caller should update the simulation to GetSimulationTime(); false once
+ * the frame's ticks are done
+ */
+bool FrameScheduler::Tick()
+{
+    if (0 >= ticksDue)
+    {
+        return false;
+    }
+
+    ticksDue--;
+    tickCount++;
+    simulationTime += SIMULATION_TICK_SECONDS;
+
+    return true;
+} /* FrameScheduler::Tick() */
+
+/**
+ * Returns the time of the latest tick
+ * @return - The simulation time in seconds
+ */
+double FrameScheduler::GetSimulationTime() const
+{
+    return simulationTime;
+} /* FrameScheduler::GetSimulationTime() */
+
+/**
+ * Returns how far the frame lies between the previous tick and the latest one
+ * @return - The interpolation factor between 0 (previous tick) and 1 (latest tick)
+ */
+double FrameScheduler::GetAlpha() const
+{
+    return std::min(1.0, accumulator / SIMULATION_TICK_SECONDS);
+} /* FrameScheduler::GetAlpha() */
+
+/**
+ * Returns the number of simulation ticks run
+ * @return - The number of ticks since the scheduler was created
+ */
+unsigned long FrameScheduler::GetTickCount() const
+{
+    return tickCount;
+} /* FrameScheduler::GetTickCount() */
+
+/**
+ * Returns the number of frames begun
+ * @return - The number of frames since the scheduler was created
+ */
+unsigned long FrameScheduler::GetFrameCount() const
+{
+    return frameCount;
+} /* FrameScheduler::GetFrameCount() */
+
+/**
+ * Returns the number of frame times kept for the statistics
+ * @return - The number of recent frame times, at most FRAME_TIME_HISTORY
+ */
+size_t FrameScheduler::GetFrameTimeCount() const
+{
+    return frameTimes.size();
+} /* FrameScheduler::GetFrameTimeCount() */
+
+/**
+ * Returns a percentile of the recent frame times using the nearest-rank method
+ * @param percentile - The percentile between 0 and 100
+ * @return - The frame time in milliseconds which the given percent of the recent frames do not
+ * exceed, or 0 without frame times
+ */
+double FrameScheduler::GetFrameTimePercentile(double percentile) const
+{
+    return FrameProfiler::GetPercentile(frameTimes, percentile);
+} /* FrameScheduler::GetFrameTimePercentile() */
+
+/**
+ * Returns the name of a pacing mode as printed to the console
+ * @param mode - The pacing mode to name
+ * @return - The name of the mode
+ */
+const char* FrameScheduler::GetModeName(FrameMode mode)
+{
+    static const char* names[] = {"vsync", "uncapped", "target"};
+
+    return names[mode];
+} /* FrameScheduler::GetModeName() */
@@ -0,0 +1,73 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: FrameScheduler.h
+ *
+ * A C++ module implementing a frame scheduler which runs
+ * the simulation in fixed time steps independently of the
+ * frame rate, paces the frames in one of several modes,
+ * and keeps statistics about the recent frame times.
+ */
+
+#ifndef FRAMESCHEDULER_H_
+#define FRAMESCHEDULER_H_
+
+#include <cstddef>
+#include <vector>
+
+/* Length of a simulation tick in seconds */
+#define SIMULATION_TICK_SECONDS (1.0 / 60.0)
+
+/* Most ticks run in one frame; the rest of a long stall is dropped rather than caught up */
+#define SIMULATION_MAX_TICKS_PER_FRAME 8
+
+/* Number of recent frame times kept for the statistics */
+#define FRAME_TIME_HISTORY 1024
+
+/* How the frames are paced */
+enum FrameMode
+{
+    FRAME_MODE_VSYNC,       /* one frame per display refresh */
+    FRAME_MODE_UNCAPPED,    /* frames as fast as possible */
+    FRAME_MODE_TARGET       /* frames at a fixed rate */
+}; /* FrameMode enum */
+
+class FrameScheduler
+{
+public:
+    /* Default constructor */
+    FrameScheduler();
+
+    /* Member functions */
+    void SetMode(FrameMode mode);
+    FrameMode GetMode() const;
+    void SetTargetFps(double fps);
+    double GetTargetFps() const;
+    double GetDelaySeconds(double now) const;
+    void BeginFrame(double now);
+    bool Tick();
+    double GetSimulationTime() const;
+    double GetAlpha() const;
+    unsigned long GetTickCount() const;
+    unsigned long GetFrameCount() const;
+    size_t GetFrameTimeCount() const;
+    double GetFrameTimePercentile(double percentile) const;
+    static const char* GetModeName(FrameMode mode);
+
+private:
+    /* Private data members */
+    FrameMode mode;                     /* how the frames are paced */
+    double targetFps;                   /* the frame rate of FRAME_MODE_TARGET */
+    double lastFrameTime;               /* the time the previous frame began in seconds */
+    double nextFrameTime;               /* the time the next paced frame is due in seconds */
+    double accumulator;                 /* the time not yet simulated in seconds */
+    double simulationTime;              /* the time of the latest tick in seconds */
+    int ticksDue;                       /* the ticks left to run in this frame */
+    unsigned long tickCount;            /* the number of ticks run */
+    unsigned long frameCount;           /* the number of frames begun */
+    std::vector<double> frameTimes;     /* the recent frame times in milliseconds, a ring */
+}; /* FrameScheduler class */
+
+#endif /* FRAMESCHEDULER_H_ */
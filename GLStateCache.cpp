@@ -0,0 +1,406 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: GLStateCache.cpp
+ *
+ * A C++ module implementing a thin shadow of the OpenGL
+ * state which skips redundant state changes and answers
+ * state queries without asking the driver.
+ */
+
+#include "GLStateCache.h"
+
+/**
+ * Default constructor starts with every piece of state unknown
+ */
+GLStateCache::GLStateCache()
+{
+    Invalidate();
+
+    totalCounters.issued = 0;
+    totalCounters.elided = 0;
+    frameCounters = totalCounters;
+    lastFrameCounters = totalCounters;
+} /* Default constructor */
+
+/**
+ * Forgets all the shadowed state so the next call of each kind is issued
+ * Use this after any code changes the OpenGL state without going through the cache
+ */
+void GLStateCache::Invalidate()
+{
+    isProgramKnown = false;
+    program = 0;
+    buffers.clear();
+    capabilities.clear();
+    clientStates.clear();
+    isBlendFuncKnown = false;
+    blendSrcFactor = GL_ONE;
+    blendDstFactor = GL_ZERO;
+    isDepthFuncKnown = false;
+    depthFunc = GL_LESS;
+    isDepthMaskKnown = false;
+    depthMask = GL_TRUE;
+    isColorMaskKnown = false;
+    colorMask = GL_TRUE;
+    uniforms.clear();
+} /* GLStateCache::Invalidate() */
+
+/**
+ * Marks the start of a new frame, saving the counters of the previous one
+ */
+void GLStateCache::BeginFrame()
+{
+    lastFrameCounters = frameCounters;
+    frameCounters.issued = 0;
+    frameCounters.elided = 0;
+} /* GLStateCache::BeginFrame() */
+
+/**
+ * Returns the counters of the last completed frame
+ * @return - The number of calls issued and elided during the last frame
+ */
+const GLStateCounters& GLStateCache::GetFrameCounters() const
+{
+    return lastFrameCounters;
+} /* GLStateCache::GetFrameCounters() */
+
+/**
+ * Returns the counters accumulated since the program started
+ * @return - The total number of calls issued and elided
+ */
+const GLStateCounters& GLStateCache::GetTotalCounters() const
+{
+    return totalCounters;
+} /* GLStateCache::GetTotalCounters() */
+
+/**
+ * Binds a shader program unless it is already bound
+ * @param program - The shader program to bind, or 0 for the fixed function pipeline
+ */
+void GLStateCache::UseProgram(GLuint program)
+{
+    if (isProgramKnown && this->program == program)
+    {
+        CountElided();
+        return;
+    }
+
+    glUseProgram(program);
+    isProgramKnown = true;
+    this->program = program;
+    CountIssued();
+} /* GLStateCache::UseProgram() */
+
+/**
+ * Returns the shadowed shader program
+ * @return - The currently bound shader program
+ */
+GLuint GLStateCache::GetProgram() const
+{
+    return program;
+} /* GLStateCache::GetProgram() */
+
+/**
+ * Tests if a shader program is bound without querying the driver
+ * @param program - The shader program to test
+ * @return - True if the shader program is bound; otherwise, false
+ */
+bool GLStateCache::IsProgramActive(GLuint program) const
+{
+    return isProgramKnown && this->program == program;
+} /* GLStateCache::IsProgramActive() */
+
+/**
+ * Binds a buffer object unless it is already bound to the target
+ * @param target - The buffer binding target, such as GL_ARRAY_BUFFER
+ * @param buffer - The buffer object to bind, or 0 to unbind
+ */
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+    std::map<GLenum, GLuint>::iterator itr = buffers.find(target);
+
+    if (itr != buffers.end() && itr->second == buffer)
+    {
+        CountElided();
+        return;
+    }
+
+    glBindBuffer(target, buffer);
+    buffers[target] = buffer;
+    CountIssued();
+} /* GLStateCache::BindBuffer() */
+
+/**
+ * Enables a server-side capability unless it is already enabled
+ * @param capability - The capability to enable, such as GL_BLEND
+ */
+void GLStateCache::Enable(GLenum capability)
+{
+    SetCapability(capability, true);
+} /* GLStateCache::Enable() */
+
+/**
+ * Disables a server-side capability unless it is already disabled
+ * @param capability - The capability to disable, such as GL_BLEND
+ */
+void GLStateCache::Disable(GLenum capability)
+{
+    SetCapability(capability, false);
+} /* GLStateCache::Disable() */
+
+/**
+ * Tests if a capability is enabled without querying the driver
+ * @param capability - The capability to test
+ * @return - True if the capability is known to be enabled; otherwise, false
+ */
+bool GLStateCache::IsEnabled(GLenum capability) const
+{
+    std::map<GLenum, bool>::const_iterator itr = capabilities.find(capability);
+    return itr != capabilities.end() && itr->second;
+} /* GLStateCache::IsEnabled() */
+
+/**
+ * Sets the blending factors unless they are already set
+ * @param srcFactor - The source blending factor
+ * @param dstFactor - The destination blending factor
+ */
+void GLStateCache::BlendFunc(GLenum srcFactor, GLenum dstFactor)
+{
+    if (isBlendFuncKnown && blendSrcFactor == srcFactor && blendDstFactor == dstFactor)
+    {
+        CountElided();
+        return;
+    }
+
+    glBlendFunc(srcFactor, dstFactor);
+    isBlendFuncKnown = true;
+    blendSrcFactor = srcFactor;
+    blendDstFactor = dstFactor;
+    CountIssued();
+} /* GLStateCache::BlendFunc() */
+
+/**
+ * Sets the depth comparison function unless it is already set
+ * @param func - The depth comparison function, such as GL_LEQUAL
+ */
+void GLStateCache::DepthFunc(GLenum func)
+{
+    if (isDepthFuncKnown && depthFunc == func)
+    {
+        CountElided();
+        return;
+    }
+
+    glDepthFunc(func);
+    isDepthFuncKnown = true;
+    depthFunc = func;
+    CountIssued();
+} /* GLStateCache::DepthFunc() */
+
+/**
+ * Enables or disables writing to the depth buffer unless it is already set
+ * @param flag - GL_TRUE to write to the depth buffer; otherwise, GL_FALSE
+ */
+void GLStateCache::DepthMask(GLboolean flag)
+{
+    if (isDepthMaskKnown && depthMask == flag)
+    {
+        CountElided();
+        return;
+    }
+
+    glDepthMask(flag);
+    isDepthMaskKnown = true;
+    depthMask = flag;
+    CountIssued();
+} /* GLStateCache::DepthMask() */
+
+/**
+ * Enables or disables writing to all the color channels unless it is already set
+ * @param flag - GL_TRUE to write to the color buffer; otherwise, GL_FALSE
+ */
+void GLStateCache::ColorMask(GLboolean flag)
+{
+    if (isColorMaskKnown && colorMask == flag)
+    {
+        CountElided();
+        return;
+    }
+
+    glColorMask(flag, flag, flag, flag);
+    isColorMaskKnown = true;
+    colorMask = flag;
+    CountIssued();
+} /* GLStateCache::ColorMask() */
+
+/**
+ * Enables a client-side vertex array unless it is already enabled
+ * @param array - The vertex array to enable, such as GL_NORMAL_ARRAY
+ */
+void GLStateCache::EnableClientState(GLenum array)
+{
+    std::map<GLenum, bool>::iterator itr = clientStates.find(array);
+
+    if (itr != clientStates.end() && itr->second)
+    {
+        CountElided();
+        return;
+    }
+
+    glEnableClientState(array);
+    clientStates[array] = true;
+    CountIssued();
+} /* GLStateCache::EnableClientState() */
+
+/**
+ * Disables a client-side vertex array unless it is already disabled
+ * @param array - The vertex array to disable, such as GL_NORMAL_ARRAY
+ */
+void GLStateCache::DisableClientState(GLenum array)
+{
+    std::map<GLenum, bool>::iterator itr = clientStates.find(array);
+
+    if (itr != clientStates.end() && !itr->second)
+    {
+        CountElided();
+        return;
+    }
+
+    glDisableClientState(array);
+    clientStates[array] = false;
+    CountIssued();
+} /* GLStateCache::DisableClientState() */
+
+/**
+ * Sets a float uniform of the bound shader program unless it already has the value
+ * @param location - The location of the uniform variable
+ * @param value - The value to set
+ */
+void GLStateCache::Uniform1f(GLint location, float value)
+{
+    if (SetUniform(location, 1, &value))
+    {
+        glUniform1f(location, value);
+    }
+} /* GLStateCache::Uniform1f() */
+
+/**
+ * Sets a vec4 uniform of the bound shader program unless it already has the value
+ * @param location - The location of the uniform variable
+ * @param value - The four components to set
+ */
+void GLStateCache::Uniform4fv(GLint location, const float value[4])
+{
+    if (SetUniform(location, 4, value))
+    {
+        glUniform4fv(location, 1, value);
+    }
+} /* GLStateCache::Uniform4fv() */
+
+/**
+ * Enables or disables a capability unless it already has the requested state
+ * @param capability - The capability to change
+ * @param enabled - True to enable the capability; false to disable it
+ */
+void GLStateCache::SetCapability(GLenum capability, bool enabled)
+{
+    std::map<GLenum, bool>::iterator itr = capabilities.find(capability);
+
+    if (itr != capabilities.end() && itr->second == enabled)
+    {
+        CountElided();
+        return;
+    }
+
+    if (enabled)
+    {
+        glEnable(capability);
+    }
+    else
+    {
+        glDisable(capability);
+    }
+
+    capabilities[capability] = enabled;
+    CountIssued();
+} /* GLStateCache::SetCapability() */
+
+/**
+ * Records a new uniform value for the bound shader program
+ * @param location - The location of the uniform variable
+ * @param count - The number of float components in the value
+ * @param value - The components of the value
+ * @return - True if the caller must issue the uniform call; false if it is redundant
+ */
+bool GLStateCache::SetUniform(GLint location, int count, const float value[])
+{
+    /* OpenGL silently ignores location -1, so the call is redundant */
+    if (-1 == location)
+    {
+        CountElided();
+        return false;
+    }
+
+    /* Without a known program the value cannot be cached, so pass the call through and let
+     * OpenGL report it if no program is bound
+     */
+    if (!isProgramKnown || 0 == program)
+    {
+        CountIssued();
+        return true;
+    }
+
+    UniformKey key(program, location);
+    std::map<UniformKey, UniformValue>::iterator itr = uniforms.find(key);
+
+    if (itr != uniforms.end() && itr->second.count == count)
+    {
+        bool isSame = true;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (itr->second.value[i] != value[i])
+            {
+                isSame = false;
+                break;
+            }
+        }
+
+        if (isSame)
+        {
+            CountElided();
+            return false;
+        }
+    }
+
+    UniformValue& cached = uniforms[key];
+    cached.count = count;
+    for (int i = 0; i < count; i++)
+    {
+        cached.value[i] = value[i];
+    }
+
+    CountIssued();
+    return true;
+} /* GLStateCache::SetUniform() */
+
+/**
+ * Counts a call that was passed on to the driver
+ */
+void GLStateCache::CountIssued()
+{
+    frameCounters.issued++;
+    totalCounters.issued++;
+} /* GLStateCache::CountIssued() */
+
+/**
+ * Counts a call that was skipped because it would not change the state
+ */
+void GLStateCache::CountElided()
+{
+    frameCounters.elided++;
+    totalCounters.elided++;
+} /* GLStateCache::CountElided() */
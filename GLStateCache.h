@@ -0,0 +1,92 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: GLStateCache.h
+ *
+ * A C++ module implementing a thin shadow of the OpenGL
+ * state which skips redundant state changes and answers
+ * state queries without asking the driver.
+ */
+
+#ifndef GLSTATECACHE_H_
+#define GLSTATECACHE_H_
+
+#include <map>
+#include <utility>
+
+#include <GL/glew.h>
+
+/* Number of calls issued to and elided from the driver */
+struct GLStateCounters
+{
+    unsigned long issued;
+    unsigned long elided;
+}; /* GLStateCounters struct */
+
+class GLStateCache
+{
+public:
+    /* Default constructor */
+    GLStateCache();
+
+    /* Member functions */
+    void Invalidate();
+    void BeginFrame();
+    const GLStateCounters& GetFrameCounters() const;
+    const GLStateCounters& GetTotalCounters() const;
+    void UseProgram(GLuint program);
+    GLuint GetProgram() const;
+    bool IsProgramActive(GLuint program) const;
+    void BindBuffer(GLenum target, GLuint buffer);
+    void Enable(GLenum capability);
+    void Disable(GLenum capability);
+    bool IsEnabled(GLenum capability) const;
+    void BlendFunc(GLenum srcFactor, GLenum dstFactor);
+    void DepthFunc(GLenum func);
+    void DepthMask(GLboolean flag);
+    void ColorMask(GLboolean flag);
+    void EnableClientState(GLenum array);
+    void DisableClientState(GLenum array);
+    void Uniform1f(GLint location, float value);
+    void Uniform4fv(GLint location, const float value[4]);
+
+private:
+    /* Cached value of a uniform variable of up to four floats */
+    struct UniformValue
+    {
+        int count;
+        float value[4];
+    };
+
+    typedef std::pair<GLuint, GLint> UniformKey;
+
+    /* Private data members */
+    bool isProgramKnown;                        /* false until the first UseProgram() */
+    GLuint program;                             /* the currently bound shader program */
+    std::map<GLenum, GLuint> buffers;           /* the bound buffer object per target */
+    std::map<GLenum, bool> capabilities;        /* enabled state per glEnable() capability */
+    std::map<GLenum, bool> clientStates;        /* enabled state per client-side vertex array */
+    bool isBlendFuncKnown;                      /* false until the first BlendFunc() */
+    GLenum blendSrcFactor;                      /* the current source blending factor */
+    GLenum blendDstFactor;                      /* the current destination blending factor */
+    bool isDepthFuncKnown;                      /* false until the first DepthFunc() */
+    GLenum depthFunc;                           /* the current depth comparison function */
+    bool isDepthMaskKnown;                      /* false until the first DepthMask() */
+    GLboolean depthMask;                        /* the current depth buffer write mask */
+    bool isColorMaskKnown;                      /* false until the first ColorMask() */
+    GLboolean colorMask;                        /* the current write mask of all color channels */
+    std::map<UniformKey, UniformValue> uniforms;/* uniform values per program and location */
+    GLStateCounters frameCounters;              /* counters for the frame in progress */
+    GLStateCounters lastFrameCounters;          /* counters for the last completed frame */
+    GLStateCounters totalCounters;              /* counters since the program started */
+
+    /* Private helper functions */
+    void SetCapability(GLenum capability, bool enabled);
+    bool SetUniform(GLint location, int count, const float value[]);
+    void CountIssued();
+    void CountElided();
+}; /* GLStateCache class */
+
+#endif /* GLSTATECACHE_H_ */
@@ -0,0 +1,227 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: GpuMesh.cpp
+ *
+ * A C++ module implementing static indexed geometry which
+ * is uploaded once into vertex and index buffer objects
+ * and then drawn with a single call.
+ */
+
+#include <cstddef>
+#include <pthread.h>
+
+#include "GpuMesh.h"
+
+/* Converts a byte offset into a buffer object into the pointer argument OpenGL expects */
+#define BUFFER_OFFSET(offset) (reinterpret_cast<const GLvoid*>(offset))
+
+/* The buffer objects of the meshes destroyed since the OpenGL thread last deleted them, made
+ * on first use so that a mesh destroyed as the program exits never finds the list gone
+ */
+static std::vector<GLuint>* releasedBuffers = NULL;
+static pthread_mutex_t releasedMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Default constructor creates an empty mesh
+ * Upload() must be called once an OpenGL context exists
+ */
+GpuMesh::GpuMesh()
+    : vertexBuffer(0)
+    , indexBuffer(0)
+    , vertexCount(0)
+    , indexCount(0)
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Destructor leaves the buffer objects for DeleteReleasedBuffers(), since the mesh may be
+ * destroyed on a thread without the OpenGL context
+ */
+GpuMesh::~GpuMesh()
+{
+    if (0 == vertexBuffer)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&releasedMutex);
+    if (NULL == releasedBuffers)
+    {
+        releasedBuffers = new std::vector<GLuint>();
+    }
+    releasedBuffers->push_back(vertexBuffer);
+    releasedBuffers->push_back(indexBuffer);
+    pthread_mutex_unlock(&releasedMutex);
+} /* Destructor */
+
+/**
+ * Uploads triangles into static buffer objects, replacing any previous contents
+ * @param state - The state cache used to bind the buffers
+ * @param vertices - The interleaved vertices
+ * @param indices - Three indices into the vertices per triangle, counter-clockwise
+ */
+void GpuMesh::Upload(GLStateCache& state, const std::vector<GpuVertex>& vertices,
+        const std::vector<GLuint>& indices)
+{
+    if (0 == vertexBuffer)
+    {
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+    }
+
+    vertexCount = static_cast<GLsizei>(vertices.size());
+    indexCount = static_cast<GLsizei>(indices.size());
+
+    state.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GpuVertex),
+            vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+            indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+} /* GpuMesh::Upload() */
+
+/**
+ * Uploads the triangles of a PLY model's face list
+ * @param state - The state cache used to bind the buffers
+ * @param faceList - The face list to upload
+ */
+void GpuMesh::Upload(GLStateCache& state, const FaceList* faceList)
+{
+    std::vector<GpuVertex> vertices;
+    std::vector<GLuint> indices;
+
+    BuildArrays(faceList, vertices, indices);
+    Upload(state, vertices, indices);
+} /* GpuMesh::Upload() */
+
+/**
+ * Converts a PLY model's face list into the arrays Upload() takes
+ * This needs no OpenGL context, so it may run on any thread ahead of the upload
+ * @param faceList - The face list to convert
+ * @param vertices - Returned with the interleaved vertices
+ * @param indices - Returned with three indices per triangle
+ */
+void GpuMesh::BuildArrays(const FaceList* faceList, std::vector<GpuVertex>& vertices,
+        std::vector<GLuint>& indices)
+{
+    vertices.resize(faceList->vc);
+    indices.resize(3 * faceList->fc);
+
+    for (int i = 0; i < faceList->vc; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            vertices[i].position[j] = static_cast<float>(faceList->vertices[i][j]);
+            vertices[i].normal[j] = static_cast<float>(faceList->v_normals[i][j]);
+            vertices[i].color[j] = static_cast<float>(faceList->colors[i][j]);
+        }
+    }
+
+    for (int i = 0; i < faceList->fc; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            indices[3 * i + j] = static_cast<GLuint>(faceList->faces[i][j]);
+        }
+    }
+} /* GpuMesh::BuildArrays() */
+
+/**
+ * Returns true once the mesh has been uploaded
+ * @return - True if the mesh has buffer objects; otherwise, false
+ */
+bool GpuMesh::IsUploaded() const
+{
+    return 0 != vertexBuffer;
+} /* GpuMesh::IsUploaded() */
+
+/**
+ * Returns the number of vertices in the mesh
+ * @return - The number of vertices in the vertex buffer
+ */
+GLsizei GpuMesh::GetVertexCount() const
+{
+    return vertexCount;
+} /* GpuMesh::GetVertexCount() */
+
+/**
+ * Returns the number of indices in the mesh
+ * @return - The number of indices in the index buffer, three per triangle
+ */
+GLsizei GpuMesh::GetIndexCount() const
+{
+    return indexCount;
+} /* GpuMesh::GetIndexCount() */
+
+/**
+ * Draws the mesh with the current modelview matrix, material and shader program
+ * @param state - The state cache used to bind the buffers and enable the vertex arrays
+ * @param isDepthOnly - True to source only the positions, as the depth pre-pass needs
+ * @param instanceCount - The number of instances to draw with the instance arrays the caller
+ *                        set up, or 0 to draw the mesh once without instancing
+ */
+void GpuMesh::Draw(GLStateCache& state, bool isDepthOnly, GLsizei instanceCount) const
+{
+    if (0 == indexCount)
+    {
+        return;
+    }
+
+    state.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    state.EnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(GpuVertex), BUFFER_OFFSET(offsetof(GpuVertex, position)));
+
+    if (isDepthOnly)
+    {
+        state.DisableClientState(GL_NORMAL_ARRAY);
+        state.DisableClientState(GL_COLOR_ARRAY);
+    }
+    else
+    {
+        state.EnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, sizeof(GpuVertex), BUFFER_OFFSET(offsetof(GpuVertex, normal)));
+        state.EnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(3, GL_FLOAT, sizeof(GpuVertex), BUFFER_OFFSET(offsetof(GpuVertex, color)));
+    }
+
+    if (0 < instanceCount)
+    {
+        glDrawElementsInstancedARB(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, BUFFER_OFFSET(0),
+                instanceCount);
+    }
+    else
+    {
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+    }
+} /* GpuMesh::Draw() */
+
+/**
+ * Deletes the buffer objects of the meshes destroyed since the last call; must be called with
+ * the OpenGL context current
+ * @return - The number of buffer objects deleted
+ */
+int GpuMesh::DeleteReleasedBuffers()
+{
+    pthread_mutex_lock(&releasedMutex);
+    std::vector<GLuint>* buffers = releasedBuffers;
+    releasedBuffers = NULL;
+    pthread_mutex_unlock(&releasedMutex);
+
+    if (NULL == buffers)
+    {
+        return 0;
+    }
+
+    int count = static_cast<int>(buffers->size());
+    glDeleteBuffers(count, &(*buffers)[0]);
+    delete buffers;
+
+    return count;
+} /* GpuMesh::DeleteReleasedBuffers() */
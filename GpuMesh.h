@@ -0,0 +1,66 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: GpuMesh.h
+ *
+ * A C++ module implementing static indexed geometry which
+ * is uploaded once into vertex and index buffer objects
+ * and then drawn with a single call. A mesh destroyed on
+ * any thread leaves its buffer objects for the OpenGL
+ * thread to delete.
+ */
+
+#ifndef GPUMESH_H_
+#define GPUMESH_H_
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "FaceList.h"
+#include "GLStateCache.h"
+
+/* Interleaved vertex layout stored in the vertex buffer */
+struct GpuVertex
+{
+    float position[3];
+    float normal[3];
+    float color[3];
+}; /* GpuVertex struct */
+
+class GpuMesh
+{
+public:
+    /* Default constructor */
+    GpuMesh();
+
+    /* Destructor */
+    ~GpuMesh();
+
+    /* Member functions */
+    void Upload(GLStateCache& state, const std::vector<GpuVertex>& vertices,
+            const std::vector<GLuint>& indices);
+    void Upload(GLStateCache& state, const FaceList* faceList);
+    static void BuildArrays(const FaceList* faceList, std::vector<GpuVertex>& vertices,
+            std::vector<GLuint>& indices);
+    bool IsUploaded() const;
+    GLsizei GetVertexCount() const;
+    GLsizei GetIndexCount() const;
+    void Draw(GLStateCache& state, bool isDepthOnly, GLsizei instanceCount = 0) const;
+    static int DeleteReleasedBuffers();
+
+private:
+    /* The buffer objects belong to one mesh, so it is never copied */
+    GpuMesh(const GpuMesh& mesh);
+    GpuMesh& operator=(const GpuMesh& mesh);
+
+    /* Private data members */
+    GLuint vertexBuffer;    /* the buffer object holding the interleaved vertices */
+    GLuint indexBuffer;     /* the buffer object holding the triangle indices */
+    GLsizei vertexCount;    /* the number of vertices in the vertex buffer */
+    GLsizei indexCount;     /* the number of indices in the index buffer */
+}; /* GpuMesh class */
+
+#endif /* GPUMESH_H_ */
@@ -0,0 +1,185 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: GpuTimer.cpp
+ *
+ * A C++ module implementing a GPU timer which measures the
+ * time the GPU spends on a span of commands using a ring of
+ * GL_TIME_ELAPSED queries, so reading a result never stalls
+ * the pipeline.
+ */
+
+#include "GpuTimer.h"
+
+/**
+ * Default constructor
+ * Init() must be called once an OpenGL context exists
+ */
+GpuTimer::GpuTimer()
+    : isSupported(false)
+    , isRunning(false)
+    , oldest(0)
+    , pending(0)
+    , lastMilliseconds(0.0)
+    , totalMilliseconds(0.0)
+    , sampleCount(0)
+{
+    for (int i = 0; i < 2 * GPU_TIMER_QUERY_COUNT; i++)
+    {
+        queries[i] = 0;
+    }
+} /* Default constructor */
+
+/**
+ * Creates the timer queries if the OpenGL implementation supports them
+ */
+void GpuTimer::Init()
+{
+    isSupported = GLEW_ARB_timer_query;
+
+    if (isSupported)
+    {
+        glGenQueries(2 * GPU_TIMER_QUERY_COUNT, queries);
+    }
+} /* GpuTimer::Init() */
+
+/**
+ * Returns true if the timer can measure GPU time
+ * @return - True if timer queries are supported; otherwise, false
+ */
+bool GpuTimer::IsSupported() const
+{
+    return isSupported;
+} /* GpuTimer::IsSupported() */
+
+/**
+ * Starts timing the commands issued after this call
+ * If every query is still in flight the span is not timed rather than waiting for the GPU;
+ * unlike GL_TIME_ELAPSED queries, the timestamps let other timers run inside the span
+ */
+void GpuTimer::Begin()
+{
+    if (!isSupported || isRunning)
+    {
+        return;
+    }
+
+    Collect();
+
+    if (pending < GPU_TIMER_QUERY_COUNT)
+    {
+        glQueryCounter(queries[2 * ((oldest + pending) % GPU_TIMER_QUERY_COUNT)], GL_TIMESTAMP);
+        isRunning = true;
+    }
+} /* GpuTimer::Begin() */
+
+/**
+ * Stops timing; the result becomes available a few frames later
+ */
+void GpuTimer::End()
+{
+    if (!isRunning)
+    {
+        return;
+    }
+
+    glQueryCounter(queries[2 * ((oldest + pending) % GPU_TIMER_QUERY_COUNT) + 1], GL_TIMESTAMP);
+    isRunning = false;
+    pending++;
+} /* GpuTimer::End() */
+
+/**
+ * Waits for every query still in flight and collects its result
+ */
+void GpuTimer::Finish()
+{
+    if (!isSupported)
+    {
+        return;
+    }
+
+    End();
+
+    /* Reading the results blocks until the GPU has finished the spans */
+    while (pending > 0)
+    {
+        ReadOldest();
+    }
+} /* GpuTimer::Finish() */
+
+/**
+ * Discards the accumulated results
+ */
+void GpuTimer::Reset()
+{
+    lastMilliseconds = 0.0;
+    totalMilliseconds = 0.0;
+    sampleCount = 0;
+} /* GpuTimer::Reset() */
+
+/**
+ * Returns the most recently collected result
+ * @return - The GPU time of the most recently completed span in milliseconds
+ */
+double GpuTimer::GetLastMilliseconds() const
+{
+    return lastMilliseconds;
+} /* GpuTimer::GetLastMilliseconds() */
+
+/**
+ * Returns the average of the collected results
+ * @return - The average GPU time of the completed spans in milliseconds
+ */
+double GpuTimer::GetAverageMilliseconds() const
+{
+    return sampleCount ? totalMilliseconds / sampleCount : 0.0;
+} /* GpuTimer::GetAverageMilliseconds() */
+
+/**
+ * Returns the number of collected results
+ * @return - The number of completed spans since the last reset
+ */
+unsigned long GpuTimer::GetSampleCount() const
+{
+    return sampleCount;
+} /* GpuTimer::GetSampleCount() */
+
+/**
+ * Reads back every query whose result is already available, oldest first
+ */
+void GpuTimer::Collect()
+{
+    while (pending > 0)
+    {
+        /* The span's end is written after its start, so its start is available too */
+        GLint isAvailable = 0;
+        glGetQueryObjectiv(queries[2 * oldest + 1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isAvailable)
+        {
+            break;
+        }
+
+        ReadOldest();
+    }
+} /* GpuTimer::Collect() */
+
+/**
+ * Reads back the oldest pending span's timestamps, waiting for them if need be, and adds the
+ * time between them to the results
+ */
+void GpuTimer::ReadOldest()
+{
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(queries[2 * oldest], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries[2 * oldest + 1], GL_QUERY_RESULT, &end);
+
+    lastMilliseconds = (end - start) / 1000000.0;
+    totalMilliseconds += lastMilliseconds;
+    sampleCount++;
+
+    oldest = (oldest + 1) % GPU_TIMER_QUERY_COUNT;
+    pending--;
+} /* GpuTimer::ReadOldest() */
@@ -0,0 +1,56 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: GpuTimer.h
+ *
+ * A C++ module implementing a GPU timer which measures the
+ * time the GPU spends on a span of commands using a ring of
+ * pairs of GL_TIMESTAMP queries, so reading a result never
+ * stalls the pipeline and the spans of several timers may
+ * nest.
+ */
+
+#ifndef GPUTIMER_H_
+#define GPUTIMER_H_
+
+#include <GL/glew.h>
+
+#define GPU_TIMER_QUERY_COUNT 4
+
+class GpuTimer
+{
+public:
+    /* Default constructor */
+    GpuTimer();
+
+    /* Member functions */
+    void Init();
+    bool IsSupported() const;
+    void Begin();
+    void End();
+    void Finish();
+    void Reset();
+    double GetLastMilliseconds() const;
+    double GetAverageMilliseconds() const;
+    unsigned long GetSampleCount() const;
+
+private:
+    /* Private data members */
+    bool isSupported;                           /* true if timer queries are available */
+    bool isRunning;                             /* true between Begin() and End() */
+    GLuint queries[2 * GPU_TIMER_QUERY_COUNT];  /* the ring of timestamp queries, each span's
+                                                 * start then its end */
+    int oldest;                                 /* the index of the oldest pending query */
+    int pending;                                /* the number of queries awaiting results */
+    double lastMilliseconds;                    /* the most recent result */
+    double totalMilliseconds;                   /* the sum of all results since Reset() */
+    unsigned long sampleCount;                  /* the number of results since Reset() */
+
+    /* Private helper functions */
+    void Collect();
+    void ReadOldest();
+}; /* GpuTimer class */
+
+#endif /* GPUTIMER_H_ */
@@ -0,0 +1,254 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: HeadlessContext.cpp
+ *
+ * A C++ module implementing an OpenGL context which needs
+ * no window or display, created through EGL, along with
+ * the framebuffer object it renders into.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef HAVE_EGL
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "HeadlessContext.h"
+
+/**
+ * Default constructor
+ * CreateContext() must be called before any OpenGL call
+ */
+HeadlessContext::HeadlessContext()
+    : display(NULL)
+    , context(NULL)
+    , framebuffer(0)
+    , colorBuffer(0)
+    , depthBuffer(0)
+    , width(0)
+    , height(0)
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Destructor releases the context and its framebuffer object
+ */
+HeadlessContext::~HeadlessContext()
+{
+    Destroy();
+} /* Destructor */
+
+/**
+ * Creates an OpenGL context without a surface and makes it current
+ * Mesa's surfaceless platform is preferred since it needs neither a display server
+ * nor a GPU; otherwise the default EGL display is used
+ * @return - True if the context is current; otherwise, false
+ */
+bool HeadlessContext::CreateContext()
+{
+#ifdef HAVE_EGL
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (NULL != clientExtensions && NULL != strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+        if (NULL != getPlatformDisplay)
+        {
+            eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+    }
+#endif
+
+    if (EGL_NO_DISPLAY == eglDisplay)
+    {
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (EGL_NO_DISPLAY == eglDisplay || !eglInitialize(eglDisplay, &major, &minor))
+    {
+        fprintf(stderr, "Headless: no EGL display could be initialized.\n");
+        return false;
+    }
+    display = eglDisplay;
+
+    /* Rendering goes into a framebuffer object, so the context needs no surface */
+    const char* displayExtensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    if (NULL == displayExtensions || NULL == strstr(displayExtensions, "EGL_KHR_surfaceless_context"))
+    {
+        fprintf(stderr, "Headless: EGL %d.%d does not support surfaceless contexts.\n", major, minor);
+        Destroy();
+        return false;
+    }
+
+    /* The surface type defaults to windows, which a surfaceless display has none of */
+    const EGLint configAttribs[] =
+    {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_SURFACE_TYPE, 0,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+
+    if (!eglBindAPI(EGL_OPENGL_API)
+            || !eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs)
+            || 0 == numConfigs)
+    {
+        fprintf(stderr, "Headless: EGL has no desktop OpenGL configuration.\n");
+        Destroy();
+        return false;
+    }
+
+    /* Without attributes EGL creates a compatibility context, which the fixed function
+     * pipeline and the GLSL 1.20 shaders need
+     */
+    EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, NULL);
+    if (EGL_NO_CONTEXT == eglContext)
+    {
+        fprintf(stderr, "Headless: the EGL context could not be created.\n");
+        Destroy();
+        return false;
+    }
+    context = eglContext;
+
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+    {
+        fprintf(stderr, "Headless: the EGL context could not be made current.\n");
+        Destroy();
+        return false;
+    }
+
+    return true;
+#else
+    fprintf(stderr, "Headless: this build has no EGL support.\n");
+    return false;
+#endif
+} /* HeadlessContext::CreateContext() */
+
+/**
+ * Creates the framebuffer object every frame is drawn into and binds it
+ * Must be called after the OpenGL entry points have been loaded
+ * @param width - The width of the framebuffer in pixels
+ * @param height - The height of the framebuffer in pixels
+ * @return - True if the framebuffer object is complete; otherwise, false
+ */
+bool HeadlessContext::CreateFramebuffer(int width, int height)
+{
+    if (!GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object)
+    {
+        fprintf(stderr, "Headless: framebuffer objects are not supported.\n");
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    /* Without a window there is no default framebuffer to draw or read */
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+    {
+        fprintf(stderr, "Headless: the %dx%d framebuffer object is incomplete.\n", width, height);
+        return false;
+    }
+
+    return true;
+} /* HeadlessContext::CreateFramebuffer() */
+
+/**
+ * Deletes the framebuffer object and releases the context
+ */
+void HeadlessContext::Destroy()
+{
+#ifdef HAVE_EGL
+    if (NULL != context)
+    {
+        if (0 != framebuffer)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+        }
+
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+
+    if (NULL != display)
+    {
+        eglTerminate(display);
+    }
+#endif
+
+    display = NULL;
+    context = NULL;
+    framebuffer = 0;
+    colorBuffer = 0;
+    depthBuffer = 0;
+} /* HeadlessContext::Destroy() */
+
+/**
+ * Writes the current contents of the framebuffer object to a binary PPM image
+ * @param filename - The name of the image file to write
+ * @return - True if the image was written; otherwise, false
+ */
+bool HeadlessContext::WriteImage(const char* filename) const
+{
+    if (0 == framebuffer)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> pixels(3 * width * height);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    FILE* file = fopen(filename, "wb");
+    if (NULL == file)
+    {
+        perror(filename);
+        return false;
+    }
+
+    /* OpenGL's rows start at the bottom, while the image's rows start at the top */
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int row = height - 1; row >= 0; row--)
+    {
+        fwrite(&pixels[3 * width * row], 1, 3 * width, file);
+    }
+
+    return 0 == fclose(file);
+} /* HeadlessContext::WriteImage() */
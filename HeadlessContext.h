@@ -0,0 +1,44 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: HeadlessContext.h
+ *
+ * A C++ module implementing an OpenGL context which needs
+ * no window or display, created through EGL, along with
+ * the framebuffer object it renders into.
+ */
+
+#ifndef HEADLESSCONTEXT_H_
+#define HEADLESSCONTEXT_H_
+
+#include <GL/glew.h>
+
+class HeadlessContext
+{
+public:
+    /* Default constructor */
+    HeadlessContext();
+
+    /* Destructor */
+    ~HeadlessContext();
+
+    /* Member functions */
+    bool CreateContext();
+    bool CreateFramebuffer(int width, int height);
+    void Destroy();
+    bool WriteImage(const char* filename) const;
+
+private:
+    /* Private data members */
+    void* display;          /* the EGL display, or NULL before CreateContext() */
+    void* context;          /* the EGL context, or NULL before CreateContext() */
+    GLuint framebuffer;     /* the framebuffer object every frame is drawn into */
+    GLuint colorBuffer;     /* the color attachment of the framebuffer object */
+    GLuint depthBuffer;     /* the depth attachment of the framebuffer object */
+    int width;              /* the width of the framebuffer object in pixels */
+    int height;             /* the height of the framebuffer object in pixels */
+}; /* HeadlessContext class */
+
+#endif /* HEADLESSCONTEXT_H_ */
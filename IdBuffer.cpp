@@ -0,0 +1,305 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: IdBuffer.cpp
+ *
+ * A C++ module implementing an offscreen buffer which the
+ * models are drawn into by their ids, scissored down to the
+ * pixel under the cursor, and read back through a ring of
+ * pixel buffer objects without waiting for the GPU.
+ */
+
+#include <cstdio>
+
+#include "IdBuffer.h"
+
+/**
+ * Default constructor
+ * Init() must be called once an OpenGL context exists
+ */
+IdBuffer::IdBuffer()
+    : isSupported(false)
+    , isSyncSupported(false)
+    , framebuffer(0)
+    , colorBuffer(0)
+    , depthBuffer(0)
+    , width(0)
+    , height(0)
+    , previousFramebuffer(0)
+    , x(0)
+    , y(0)
+    , tag(0)
+    , oldest(0)
+    , pending(0)
+    , readbackCount(0)
+    , skippedCount(0)
+{
+    for (int i = 0; i < ID_BUFFER_READBACK_COUNT; i++)
+    {
+        pixelBuffers[i] = 0;
+        fences[i] = 0;
+        tags[i] = 0;
+    }
+} /* Default constructor */
+
+/**
+ * Creates the framebuffer and pixel buffer objects if the OpenGL implementation supports them;
+ * the buffers the ids are drawn into are sized by the first Begin()
+ */
+void IdBuffer::Init()
+{
+    isSupported = (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object)
+            && (GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object);
+    isSyncSupported = GLEW_VERSION_3_2 || GLEW_ARB_sync;
+
+    if (!isSupported)
+    {
+        return;
+    }
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glGenBuffers(ID_BUFFER_READBACK_COUNT, pixelBuffers);
+    for (int i = 0; i < ID_BUFFER_READBACK_COUNT; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+} /* IdBuffer::Init() */
+
+/**
+ * Returns true if the ids can be drawn and read back
+ * @return - True if framebuffer and pixel buffer objects are supported; otherwise, false
+ */
+bool IdBuffer::IsSupported() const
+{
+    return isSupported;
+} /* IdBuffer::IsSupported() */
+
+/**
+ * Binds the id buffer and clears the one pixel which is read back, so the ids drawn until
+ * End() only touch that pixel however large the view is
+ * If every readback is still in flight the pixel is skipped rather than waiting for the GPU
+ * @param state - The state cache used to enable the scissor test
+ * @param width - The width of the view in pixels
+ * @param height - The height of the view in pixels
+ * @param x - The pixel's distance from the left of the view
+ * @param y - The pixel's distance from the bottom of the view
+ * @param tag - What the caller wants the pixel for, returned with its id by Poll()
+ * @return - True if the ids are to be drawn now; otherwise, false
+ */
+bool IdBuffer::Begin(GLStateCache& state, int width, int height, int x, int y, int tag)
+{
+    if (!isSupported || 0 > x || width <= x || 0 > y || height <= y)
+    {
+        return false;
+    }
+
+    if (ID_BUFFER_READBACK_COUNT <= pending)
+    {
+        skippedCount++;
+        return false;
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    if ((width != this->width || height != this->height) && !Resize(width, height))
+    {
+        return false;
+    }
+
+    this->x = x;
+    this->y = y;
+    this->tag = tag;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    state.Enable(GL_SCISSOR_TEST);
+    glScissor(x, y, 1, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    return true;
+} /* IdBuffer::Begin() */
+
+/**
+ * Starts reading the pixel back into the next pixel buffer object, which returns at once,
+ * then binds the framebuffer bound before Begin() again
+ * @param state - The state cache used to bind the pixel buffer object
+ */
+void IdBuffer::End(GLStateCache& state)
+{
+    int slot = (oldest + pending) % ID_BUFFER_READBACK_COUNT;
+
+    state.BindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    state.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (isSyncSupported)
+    {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    tags[slot] = tag;
+    pending++;
+
+    state.Disable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+} /* IdBuffer::End() */
+
+/**
+ * Collects the oldest readback if the GPU has finished it
+ * @param state - The state cache used to bind the pixel buffer object
+ * @param readback - Returned with the pixel's id and tag
+ * @return - True if a readback was collected; otherwise, false
+ */
+bool IdBuffer::Poll(GLStateCache& state, IdReadback& readback)
+{
+    if (0 == pending || !IsReady(oldest))
+    {
+        return false;
+    }
+
+    Read(state, oldest, readback);
+    return true;
+} /* IdBuffer::Poll() */
+
+/**
+ * Waits for every readback still in flight and discards it
+ * @param state - The state cache used to bind the pixel buffer object
+ */
+void IdBuffer::Finish(GLStateCache& state)
+{
+    while (0 < pending)
+    {
+        /* Mapping the buffer blocks until the GPU has finished the readback */
+        IdReadback readback;
+        Read(state, oldest, readback);
+    }
+} /* IdBuffer::Finish() */
+
+/**
+ * Returns the number of readbacks collected
+ * @return - The readbacks collected by Poll() and Finish()
+ */
+unsigned long IdBuffer::GetReadbackCount() const
+{
+    return readbackCount;
+} /* IdBuffer::GetReadbackCount() */
+
+/**
+ * Returns the number of pixels not drawn because every readback was still in flight
+ * @return - The number of times Begin() skipped the pixel
+ */
+unsigned long IdBuffer::GetSkippedCount() const
+{
+    return skippedCount;
+} /* IdBuffer::GetSkippedCount() */
+
+/**
+ * Encodes an id as the color it is drawn with, 8 bits per channel, which blending and
+ * multisampling must not touch
+ * @param id - The id, less than 2^24
+ * @param color - Returned with the red, green, blue and alpha of the id
+ */
+void IdBuffer::EncodeId(unsigned int id, float color[4])
+{
+    color[0] = (id & 0xff) / 255.0f;
+    color[1] = ((id >> 8) & 0xff) / 255.0f;
+    color[2] = ((id >> 16) & 0xff) / 255.0f;
+    color[3] = 1.0f;
+} /* IdBuffer::EncodeId() */
+
+/**
+ * Decodes the id a pixel was drawn with
+ * @param pixel - The pixel's red, green, blue and alpha bytes
+ * @return - The id
+ */
+unsigned int IdBuffer::DecodeId(const GLubyte pixel[4])
+{
+    return pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+} /* IdBuffer::DecodeId() */
+
+/**
+ * Sizes the id and depth buffers to match the view
+ * @param width - The width of the view in pixels
+ * @param height - The height of the view in pixels
+ * @return - True if the framebuffer object is complete; otherwise, false
+ */
+bool IdBuffer::Resize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    bool isComplete = GL_FRAMEBUFFER_COMPLETE == glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    if (!isComplete)
+    {
+        fprintf(stderr, "The %dx%d id buffer is incomplete; picking on the GPU is off.\n",
+                width, height);
+        isSupported = false;
+    }
+
+    return isComplete;
+} /* IdBuffer::Resize() */
+
+/**
+ * Tells whether the GPU has finished a readback, without waiting for it
+ * Without fences a readback counts as finished once every other one is in flight behind it,
+ * by which time the GPU has drawn a few frames since
+ * @param slot - The readback's index in the ring
+ * @return - True if mapping its pixel buffer object will not wait
+ */
+bool IdBuffer::IsReady(int slot)
+{
+    if (!isSyncSupported)
+    {
+        return ID_BUFFER_READBACK_COUNT <= pending;
+    }
+
+    GLenum status = glClientWaitSync(fences[slot], 0, 0);
+    return GL_ALREADY_SIGNALED == status || GL_CONDITION_SATISFIED == status;
+} /* IdBuffer::IsReady() */
+
+/**
+ * Maps a readback's pixel buffer object and decodes its pixel, freeing its slot
+ * @param state - The state cache used to bind the pixel buffer object
+ * @param slot - The readback's index in the ring, which is the oldest
+ * @param readback - Returned with the pixel's id and tag
+ */
+void IdBuffer::Read(GLStateCache& state, int slot, IdReadback& readback)
+{
+    readback.id = ID_BUFFER_NONE;
+    readback.tag = tags[slot];
+
+    state.BindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    const GLubyte* pixel = static_cast<const GLubyte*>(
+            glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+    if (NULL != pixel)
+    {
+        readback.id = DecodeId(pixel);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    state.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (isSyncSupported)
+    {
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+
+    oldest = (oldest + 1) % ID_BUFFER_READBACK_COUNT;
+    pending--;
+    readbackCount++;
+} /* IdBuffer::Read() */
@@ -0,0 +1,84 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: IdBuffer.h
+ *
+ * A C++ module implementing an offscreen buffer which the
+ * models are drawn into by their ids, scissored down to the
+ * pixel under the cursor, and read back through a ring of
+ * pixel buffer objects without waiting for the GPU.
+ */
+
+#ifndef IDBUFFER_H_
+#define IDBUFFER_H_
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+
+/* The number of readbacks which can be in flight at once */
+#define ID_BUFFER_READBACK_COUNT 3
+
+/* The id of a pixel which no model covers */
+#define ID_BUFFER_NONE 0
+
+/* A pixel read back from the id buffer */
+struct IdReadback
+{
+    unsigned int id;    /* the id drawn at the pixel, or ID_BUFFER_NONE */
+    int tag;            /* what the caller asked for the pixel for */
+}; /* IdReadback struct */
+
+class IdBuffer
+{
+public:
+    /* Default constructor */
+    IdBuffer();
+
+    /* Member functions */
+    void Init();
+    bool IsSupported() const;
+    bool Begin(GLStateCache& state, int width, int height, int x, int y, int tag);
+    void End(GLStateCache& state);
+    bool Poll(GLStateCache& state, IdReadback& readback);
+    void Finish(GLStateCache& state);
+    unsigned long GetReadbackCount() const;
+    unsigned long GetSkippedCount() const;
+
+    /* Static member functions */
+    static void EncodeId(unsigned int id, float color[4]);
+    static unsigned int DecodeId(const GLubyte pixel[4]);
+
+private:
+    /* Private helper functions */
+    bool Resize(int width, int height);
+    bool IsReady(int slot);
+    void Read(GLStateCache& state, int slot, IdReadback& readback);
+
+    /* Private data members */
+    bool isSupported;                               /* true if framebuffer and pixel buffer
+                                                     * objects are available */
+    bool isSyncSupported;                           /* true if fences tell when a readback
+                                                     * is done */
+    GLuint framebuffer;                             /* the framebuffer object drawn into */
+    GLuint colorBuffer;                             /* the ids, one per pixel */
+    GLuint depthBuffer;                             /* the depth of the nearest model */
+    int width;                                      /* the width of the buffers in pixels */
+    int height;                                     /* the height of the buffers in pixels */
+    GLint previousFramebuffer;                      /* the framebuffer bound before Begin() */
+    GLuint pixelBuffers[ID_BUFFER_READBACK_COUNT];  /* the ring of pixel buffer objects */
+    GLsync fences[ID_BUFFER_READBACK_COUNT];        /* signaled once each readback is done */
+    int tags[ID_BUFFER_READBACK_COUNT];             /* the caller's tag of each readback */
+    int x;                                          /* the pixel being drawn */
+    int y;
+    int tag;                                        /* the tag of the pixel being drawn */
+    int oldest;                                     /* the index of the oldest readback */
+    int pending;                                    /* the number of readbacks in flight */
+    unsigned long readbackCount;                    /* the readbacks collected so far */
+    unsigned long skippedCount;                     /* the pixels not drawn because every
+                                                     * readback was in flight */
+}; /* IdBuffer class */
+
+#endif /* IDBUFFER_H_ */
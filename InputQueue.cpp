@@ -0,0 +1,75 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: InputQueue.cpp
+ *
+ * A C++ module implementing a lock-free queue which carries
+ * input events from the thread handling the window to the
+ * thread running the simulation, with a single producer
+ * and a single consumer.
+ */
+
+#include "InputQueue.h"
+
+/**
+ * Default constructor creates an empty queue
+ */
+InputQueue::InputQueue()
+    : head(0)
+    , tail(0)
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Adds an event to the back of the queue
+ * Only one thread may push events
+ * @param event - The event to add
+ * @return - True if the event was added; false if the queue is full
+ */
+bool InputQueue::Push(const InputEvent& event)
+{
+    unsigned int position = tail;
+
+    /* The counts wrap around together, so their difference is always the queue's size */
+    if (INPUT_QUEUE_CAPACITY == position - head)
+    {
+        return false;
+    }
+
+    events[position & (INPUT_QUEUE_CAPACITY - 1)] = event;
+
+    /* Publish the event before the new tail */
+    __sync_synchronize();
+    tail = position + 1;
+
+    return true;
+} /* InputQueue::Push() */
+
+/**
+ * Removes the event at the front of the queue
+ * Only one thread may pop events
+ * @param event - The returned event
+ * @return - True if an event was removed; false if the queue is empty
+ */
+bool InputQueue::Pop(InputEvent& event)
+{
+    unsigned int position = head;
+
+    if (position == tail)
+    {
+        return false;
+    }
+
+    /* Read the event only after seeing the tail which published it */
+    __sync_synchronize();
+    event = events[position & (INPUT_QUEUE_CAPACITY - 1)];
+
+    /* Finish reading the event before its slot is handed back */
+    __sync_synchronize();
+    head = position + 1;
+
+    return true;
+} /* InputQueue::Pop() */
@@ -0,0 +1,63 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: InputQueue.h
+ *
+ * A C++ module implementing a lock-free queue which carries
+ * input events from the thread handling the window to the
+ * thread running the simulation, with a single producer
+ * and a single consumer.
+ */
+
+#ifndef INPUTQUEUE_H_
+#define INPUTQUEUE_H_
+
+#include <cstddef>
+
+#include "Point3.h"
+#include "Quaternion.h"
+
+/* Number of events the queue holds; must be a power of 2 */
+#define INPUT_QUEUE_CAPACITY 256
+
+/* The kinds of input the simulation reacts to */
+enum InputEventType
+{
+    INPUT_ROTATE_CAMERA,        /* rotate the camera by the rotation */
+    INPUT_SET_CAMERA,           /* move the camera's eye and reference point to the points */
+    INPUT_PICK,                 /* pick along the ray from the first point to the second */
+    INPUT_PICK_MODEL,           /* pick the model the id buffer found under a click */
+    INPUT_HOVER,                /* highlight the model the id buffer found under the cursor */
+    INPUT_SHOW_BOUNDING_BOXES   /* draw every model's bounding volume if the flag is set */
+}; /* InputEventType enum */
+
+/* A single input event; the members used depend on the type */
+struct InputEvent
+{
+    InputEventType type;    /* the kind of input */
+    Quaternion rotation;    /* the camera rotation of INPUT_ROTATE_CAMERA */
+    Point3 points[2];       /* the eye and reference point, or the ends of the picking ray */
+    bool flag;              /* the setting of INPUT_SHOW_BOUNDING_BOXES */
+    size_t index;           /* the model of INPUT_PICK_MODEL and INPUT_HOVER, or MODEL_NO_INDEX */
+}; /* InputEvent struct */
+
+class InputQueue
+{
+public:
+    /* Default constructor */
+    InputQueue();
+
+    /* Member functions */
+    bool Push(const InputEvent& event);
+    bool Pop(InputEvent& event);
+
+private:
+    /* Private data members */
+    InputEvent events[INPUT_QUEUE_CAPACITY];    /* the events, a ring */
+    volatile unsigned int head;                 /* the count of events popped, only popping writes it */
+    volatile unsigned int tail;                 /* the count of events pushed, only pushing writes it */
+}; /* InputQueue class */
+
+#endif /* INPUTQUEUE_H_ */
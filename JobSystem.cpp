@@ -0,0 +1,719 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: JobSystem.cpp
+ *
+ * A C++ module implementing a work-stealing job system in
+ * which each worker thread keeps its own deque of jobs and
+ * idle workers steal from the others, with parallel loops
+ * over index ranges, child jobs and dependencies, and a
+ * queue of long background jobs which only the worker
+ * threads take.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <sched.h>
+#include <unistd.h>
+
+#include "FrameProfiler.h"
+#include "JobSystem.h"
+
+/* Number of ranges each worker gets from a parallel loop without a grain size */
+#define JOB_RANGES_PER_WORKER 4
+
+/* A unit of work along with what it waits for and what waits for it */
+struct Job
+{
+    JobFunction function;               /* the job's work, or NULL */
+    JobRangeFunction rangeFunction;     /* the job's work over a range of indices, or NULL */
+    void* data;                         /* passed to the work */
+    size_t begin;                       /* the first index of the range */
+    size_t end;                         /* one past the last index of the range */
+    Job* parent;                        /* the job which does not finish before this one, or NULL */
+    bool isBackground;                  /* true if the job waits in the background queue */
+    volatile int unfinished;            /* one for the job itself plus its unfinished children */
+    volatile int dependencies;          /* the unfinished dependencies, plus one until Run() */
+    volatile int references;            /* the caller's handle plus the system's until it finishes */
+    volatile int isFinished;            /* 1 once the job and its children have run */
+    std::vector<Job*> continuations;    /* the jobs which depend on this one */
+}; /* Job struct */
+
+/**
+ * Default constructor creates a deterministic system without worker threads, in which every
+ * job runs as soon as it is ready on the thread which makes it ready
+ */
+JobSystem::JobSystem()
+    : isDeterministic(true)
+    , isStopping(false)
+    , hasThreads(false)
+    , queuedJobs(0)
+    , hook(NULL)
+{
+    pthread_key_create(&workerKey, NULL);
+    pthread_key_create(&backgroundKey, NULL);
+    pthread_mutex_init(&backgroundMutex, NULL);
+    pthread_mutex_init(&sleepMutex, NULL);
+    pthread_cond_init(&sleepCondition, NULL);
+    pthread_mutex_init(&dependencyMutex, NULL);
+
+    Worker* worker = new Worker();
+    worker->system = this;
+    worker->index = 0;
+    worker->hasThread = false;
+    worker->jobCount = 0;
+    worker->stealCount = 0;
+    worker->busyMicroseconds = 0;
+    pthread_mutex_init(&worker->mutex, NULL);
+    workers.push_back(worker);
+} /* Default constructor */
+
+/**
+ * Destructor stops the worker threads
+ */
+JobSystem::~JobSystem()
+{
+    Stop();
+
+    pthread_mutex_destroy(&workers[0]->mutex);
+    delete workers[0];
+
+    pthread_mutex_destroy(&dependencyMutex);
+    pthread_cond_destroy(&sleepCondition);
+    pthread_mutex_destroy(&sleepMutex);
+    pthread_mutex_destroy(&backgroundMutex);
+    pthread_key_delete(backgroundKey);
+    pthread_key_delete(workerKey);
+} /* Destructor */
+
+/**
+ * Starts the worker threads
+ * The threads which submit jobs share worker 0, so workerCount - 1 threads are created
+ * @param workerCount - The number of workers, from 1 to JOB_MAX_WORKERS
+ * @param isDeterministic - True to create no threads and run every job as soon as it is ready,
+ * so that jobs always run in the same order
+ * @return - True if every worker thread was created; false if fewer were
+ */
+bool JobSystem::Start(int workerCount, bool isDeterministic)
+{
+    Stop();
+
+    this->isDeterministic = isDeterministic;
+    isStopping = false;
+
+    if (isDeterministic)
+    {
+        return true;
+    }
+
+    /* Every worker exists before any thread starts looking through them for jobs */
+    workerCount = std::min(std::max(workerCount, 1), JOB_MAX_WORKERS);
+    for (int i = 1; i < workerCount; i++)
+    {
+        Worker* worker = new Worker();
+        worker->system = this;
+        worker->index = i;
+        worker->hasThread = false;
+        worker->jobCount = 0;
+        worker->stealCount = 0;
+        worker->busyMicroseconds = 0;
+        pthread_mutex_init(&worker->mutex, NULL);
+        workers.push_back(worker);
+    }
+
+    /* A worker without a thread only has an empty deque, which costs the others nothing */
+    int threadCount = 0;
+    for (int i = 1; i < workerCount; i++)
+    {
+        workers[i]->hasThread = 0 == pthread_create(&workers[i]->thread, NULL, RunWorker, workers[i]);
+        threadCount += workers[i]->hasThread ? 1 : 0;
+    }
+    hasThreads = 0 < threadCount;
+
+    if (threadCount < workerCount - 1)
+    {
+        fprintf(stderr, "Job system: only %d of %d worker threads could be started.\n",
+                threadCount, workerCount - 1);
+        return false;
+    }
+
+    return true;
+} /* JobSystem::Start() */
+
+/**
+ * Stops and joins the worker threads once the queued jobs are done
+ * Jobs queued afterwards run on the threads which wait for them
+ */
+void JobSystem::Stop()
+{
+    /* Help finish the queued jobs, since the threads which wait for them may be gone */
+    while (0 < __sync_fetch_and_add(&queuedJobs, 0))
+    {
+        if (!RunPendingJob(workers[0], true))
+        {
+            sched_yield();
+        }
+    }
+
+    pthread_mutex_lock(&sleepMutex);
+    isStopping = true;
+    pthread_cond_broadcast(&sleepCondition);
+    pthread_mutex_unlock(&sleepMutex);
+
+    /* Join every thread before any worker goes away, since each looks through all of them */
+    for (size_t i = 1; i < workers.size(); i++)
+    {
+        if (workers[i]->hasThread)
+        {
+            pthread_join(workers[i]->thread, NULL);
+        }
+    }
+
+    while (workers.size() > 1)
+    {
+        pthread_mutex_destroy(&workers.back()->mutex);
+        delete workers.back();
+        workers.pop_back();
+    }
+
+    hasThreads = false;
+    isStopping = false;
+} /* JobSystem::Stop() */
+
+/**
+ * Returns the number of workers
+ * @return - The number of worker threads plus one for the threads which submit jobs
+ */
+int JobSystem::GetWorkerCount() const
+{
+    return static_cast<int>(workers.size());
+} /* JobSystem::GetWorkerCount() */
+
+/**
+ * Returns whether jobs run in a fixed order
+ * @return - True if every job runs as soon as it is ready on the thread which makes it ready
+ */
+bool JobSystem::IsDeterministic() const
+{
+    return isDeterministic;
+} /* JobSystem::IsDeterministic() */
+
+/**
+ * Creates a job which does not run until Run() is called
+ * The caller must pass the returned handle to Wait() or Release() exactly once
+ * @param function - The job's work, or NULL for a job which only groups others
+ * @param data - Passed to the work
+ * @return - The job
+ */
+Job* JobSystem::Create(JobFunction function, void* data)
+{
+    Job* job = Allocate(NULL);
+    job->function = function;
+    job->data = data;
+
+    return job;
+} /* JobSystem::Create() */
+
+/**
+ * Creates a job which its parent waits for: the parent is not finished until the child is
+ * Must be called before the parent finishes, such as from the parent's own work
+ * The caller must pass the returned handle to Wait() or Release() exactly once
+ * @param parent - The job which waits for the new one
+ * @param function - The job's work, or NULL for a job which only groups others
+ * @param data - Passed to the work
+ * @return - The job
+ */
+Job* JobSystem::CreateChild(Job* parent, JobFunction function, void* data)
+{
+    Job* job = Allocate(parent);
+    job->function = function;
+    job->data = data;
+
+    return job;
+} /* JobSystem::CreateChild() */
+
+/**
+ * Creates a long job, such as loading a file, which only the worker threads take, so that
+ * threads waiting on short jobs such as a frame's never get stuck in one; the jobs it creates
+ * while running are background jobs too
+ * Without worker threads, or in deterministic mode, the job runs as soon as it is ready on the
+ * thread which makes it ready
+ * The caller must pass the returned handle to Wait() or Release() exactly once
+ * @param function - The job's work
+ * @param data - Passed to the work
+ * @return - The job
+ */
+Job* JobSystem::CreateBackground(JobFunction function, void* data)
+{
+    Job* job = Allocate(NULL);
+    job->function = function;
+    job->data = data;
+    job->isBackground = true;
+
+    return job;
+} /* JobSystem::CreateBackground() */
+
+/**
+ * Makes a job wait for another to finish before it runs, which makes it a continuation of
+ * the other job; must be called before Run() is called for the waiting job
+ * @param job - The job which waits
+ * @param dependency - The job which must finish first
+ */
+void JobSystem::AddDependency(Job* job, Job* dependency)
+{
+    pthread_mutex_lock(&dependencyMutex);
+    if (0 == dependency->isFinished)
+    {
+        __sync_add_and_fetch(&job->dependencies, 1);
+        dependency->continuations.push_back(job);
+    }
+    pthread_mutex_unlock(&dependencyMutex);
+} /* JobSystem::AddDependency() */
+
+/**
+ * Lets a job run as soon as its dependencies have finished
+ * @param job - The job to run
+ */
+void JobSystem::Run(Job* job)
+{
+    if (0 == __sync_sub_and_fetch(&job->dependencies, 1))
+    {
+        Enqueue(job);
+    }
+} /* JobSystem::Run() */
+
+/**
+ * Runs other jobs until a job and its children have finished, then releases the handle
+ * @param job - The job to wait for, which must have been passed to Run()
+ */
+void JobSystem::Wait(Job* job)
+{
+    Worker* worker = GetCurrentWorker();
+
+    /* Only a worker thread, or a thread which is already in a background job, may take one */
+    bool canRunBackground = worker->hasThread || IsInBackgroundJob();
+
+    /* The atomic read also orders reading what the job wrote after seeing it finish */
+    while (0 == __sync_fetch_and_add(&job->isFinished, 0))
+    {
+        if (!RunPendingJob(worker, canRunBackground))
+        {
+            sched_yield();
+        }
+    }
+
+    Release(job);
+} /* JobSystem::Wait() */
+
+/**
+ * Gives up a handle to a job without waiting for it
+ * @param job - The job whose handle is no longer needed
+ */
+void JobSystem::Release(Job* job)
+{
+    if (0 == __sync_sub_and_fetch(&job->references, 1))
+    {
+        delete job;
+    }
+} /* JobSystem::Release() */
+
+/**
+ * Runs a function over the indices from 0 up to but not including count, split into ranges
+ * which the workers share, and returns once every range is done
+ * In deterministic mode the ranges run one after another in order
+ * @param count - The number of indices
+ * @param grainSize - The most indices in one range, or 0 to give each worker a few ranges
+ * @param function - The work over a range of indices
+ * @param data - Passed to the work
+ */
+void JobSystem::ParallelFor(size_t count, size_t grainSize, JobRangeFunction function, void* data)
+{
+    if (0 == count)
+    {
+        return;
+    }
+
+    if (0 == grainSize)
+    {
+        grainSize = std::max(count / (workers.size() * JOB_RANGES_PER_WORKER),
+                static_cast<size_t>(1));
+    }
+
+    /* A single range needs no jobs at all */
+    if (count <= grainSize)
+    {
+        function(data, 0, count);
+        return;
+    }
+
+    Job* root = Create(NULL, NULL);
+    for (size_t begin = 0; begin < count; begin += grainSize)
+    {
+        Job* range = CreateChild(root, NULL, data);
+        range->rangeFunction = function;
+        range->begin = begin;
+        range->end = std::min(begin + grainSize, count);
+        Run(range);
+        Release(range);
+    }
+
+    Run(root);
+    Wait(root);
+} /* JobSystem::ParallelFor() */
+
+/**
+ * Runs a function over the indices from 0 up to but not including count on a job system, or
+ * all at once on the calling thread without one
+ * @param jobs - The job system, or NULL
+ * @param count - The number of indices
+ * @param grainSize - The most indices in one range on the job system
+ * @param function - The work over a range of indices
+ * @param data - Passed to the work
+ */
+void JobSystem::ParallelFor(JobSystem* jobs, size_t count, size_t grainSize,
+        JobRangeFunction function, void* data)
+{
+    if (NULL == jobs)
+    {
+        function(data, 0, count);
+    }
+    else
+    {
+        jobs->ParallelFor(count, grainSize, function, data);
+    }
+} /* JobSystem::ParallelFor() */
+
+/**
+ * Sets the function called after each job, for tracing the workers
+ * @param hook - The function to call, or NULL for none
+ */
+void JobSystem::SetHook(JobHook hook)
+{
+    this->hook = hook;
+} /* JobSystem::SetHook() */
+
+/**
+ * Returns how much work a worker has done since the statistics were reset
+ * @param worker - The index of the worker, less than GetWorkerCount()
+ * @return - The worker's statistics
+ */
+JobWorkerStats JobSystem::GetWorkerStats(int worker) const
+{
+    JobWorkerStats stats;
+
+    stats.jobs = workers[worker]->jobCount;
+    stats.steals = workers[worker]->stealCount;
+    stats.busyMilliseconds = workers[worker]->busyMicroseconds / 1000.0;
+
+    return stats;
+} /* JobSystem::GetWorkerStats() */
+
+/**
+ * Resets every worker's statistics
+ */
+void JobSystem::ResetStats()
+{
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->jobCount = 0;
+        workers[i]->stealCount = 0;
+        workers[i]->busyMicroseconds = 0;
+    }
+} /* JobSystem::ResetStats() */
+
+/**
+ * Returns the number of processors available to run threads
+ * @return - The number of online processors, at least 1
+ */
+int JobSystem::GetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return 0 < count ? static_cast<int>(count) : 1;
+} /* JobSystem::GetProcessorCount() */
+
+/**
+ * Runs a worker thread, taking jobs until the system stops and sleeping while there are none
+ * @param worker - The worker which owns the thread
+ * @return - Always NULL
+ */
+void* JobSystem::RunWorker(void* worker)
+{
+    Worker* self = static_cast<Worker*>(worker);
+    JobSystem* system = self->system;
+
+    pthread_setspecific(system->workerKey, self);
+
+    for (;;)
+    {
+        if (system->RunPendingJob(self, true))
+        {
+            continue;
+        }
+
+        /* Jobs are counted before the sleepers are woken, so none is missed */
+        pthread_mutex_lock(&system->sleepMutex);
+        while (0 == __sync_fetch_and_add(&system->queuedJobs, 0) && !system->isStopping)
+        {
+            pthread_cond_wait(&system->sleepCondition, &system->sleepMutex);
+        }
+        bool isStopping = system->isStopping && 0 == __sync_fetch_and_add(&system->queuedJobs, 0);
+        pthread_mutex_unlock(&system->sleepMutex);
+
+        if (isStopping)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+} /* JobSystem::RunWorker() */
+
+/**
+ * Returns the worker of the calling thread
+ * @return - The calling thread's worker, or worker 0 for threads the system did not create
+ */
+JobSystem::Worker* JobSystem::GetCurrentWorker() const
+{
+    Worker* worker = static_cast<Worker*>(pthread_getspecific(workerKey));
+
+    return NULL == worker ? workers[0] : worker;
+} /* JobSystem::GetCurrentWorker() */
+
+/**
+ * Returns whether the calling thread is running a background job
+ * @return - True if a background job is on the calling thread's stack
+ */
+bool JobSystem::IsInBackgroundJob() const
+{
+    return NULL != pthread_getspecific(backgroundKey);
+} /* JobSystem::IsInBackgroundJob() */
+
+/**
+ * Allocates a job which is not yet ready to run
+ * @param parent - The job which waits for the new one, or NULL
+ * @return - The job
+ */
+Job* JobSystem::Allocate(Job* parent)
+{
+    Job* job = new Job();
+
+    job->function = NULL;
+    job->rangeFunction = NULL;
+    job->data = NULL;
+    job->begin = 0;
+    job->end = 0;
+    job->parent = parent;
+    job->isBackground = IsInBackgroundJob();
+    job->unfinished = 1;
+    job->dependencies = 1;
+    job->references = 2;
+    job->isFinished = 0;
+
+    if (NULL != parent)
+    {
+        __sync_add_and_fetch(&parent->unfinished, 1);
+    }
+
+    return job;
+} /* JobSystem::Allocate() */
+
+/**
+ * Queues a job which is ready to run on the calling thread's worker, or in the background
+ * queue if it is a background job
+ * In deterministic mode, or for a background job without worker threads, the job runs at once
+ * instead
+ * @param job - The job to queue
+ */
+void JobSystem::Enqueue(Job* job)
+{
+    if (isDeterministic || (job->isBackground && !hasThreads))
+    {
+        Execute(job, GetCurrentWorker());
+        return;
+    }
+
+    if (job->isBackground)
+    {
+        pthread_mutex_lock(&backgroundMutex);
+        backgroundJobs.push_back(job);
+        pthread_mutex_unlock(&backgroundMutex);
+    }
+    else
+    {
+        Worker* worker = GetCurrentWorker();
+
+        pthread_mutex_lock(&worker->mutex);
+        worker->jobs.push_back(job);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+
+    __sync_add_and_fetch(&queuedJobs, 1);
+
+    pthread_mutex_lock(&sleepMutex);
+    pthread_cond_signal(&sleepCondition);
+    pthread_mutex_unlock(&sleepMutex);
+} /* JobSystem::Enqueue() */
+
+/**
+ * Runs one queued job, if there is any
+ * @param worker - The worker to run the job on
+ * @param canRunBackground - True if the job may be a background job
+ * @return - True if a job was run; false if there was none to take
+ */
+bool JobSystem::RunPendingJob(Worker* worker, bool canRunBackground)
+{
+    bool isStolen = false;
+    Job* job = TakeJob(worker, canRunBackground, isStolen);
+
+    if (NULL == job)
+    {
+        return false;
+    }
+
+    if (isStolen)
+    {
+        __sync_add_and_fetch(&worker->stealCount, 1);
+    }
+
+    Execute(job, worker);
+
+    return true;
+} /* JobSystem::RunPendingJob() */
+
+/**
+ * Takes the newest job from a worker's own deque, or else the oldest from another worker's,
+ * or else a background job
+ * @param worker - The worker looking for a job
+ * @param canRunBackground - True if the job may be a background job
+ * @param isStolen - Returned as true if the job came from another worker
+ * @return - The job, or NULL if every deque is empty
+ */
+Job* JobSystem::TakeJob(Worker* worker, bool canRunBackground, bool& isStolen)
+{
+    Job* job = NULL;
+
+    /* The newest job is the most likely to share data with the last one */
+    pthread_mutex_lock(&worker->mutex);
+    if (!worker->jobs.empty())
+    {
+        job = worker->jobs.back();
+        worker->jobs.pop_back();
+    }
+    pthread_mutex_unlock(&worker->mutex);
+
+    /* The oldest job of another worker is the most likely to split into more work */
+    for (size_t i = 1; NULL == job && i < workers.size(); i++)
+    {
+        Worker* victim = workers[(worker->index + i) % workers.size()];
+
+        pthread_mutex_lock(&victim->mutex);
+        if (!victim->jobs.empty())
+        {
+            job = victim->jobs.front();
+            victim->jobs.pop_front();
+            isStolen = true;
+        }
+        pthread_mutex_unlock(&victim->mutex);
+    }
+
+    /* A background job waiting for its children takes the newest, which are likely its own;
+     * an idle worker takes the oldest, which has waited longest
+     */
+    if (NULL == job && canRunBackground)
+    {
+        bool isNewestFirst = IsInBackgroundJob();
+
+        pthread_mutex_lock(&backgroundMutex);
+        if (!backgroundJobs.empty() && isNewestFirst)
+        {
+            job = backgroundJobs.back();
+            backgroundJobs.pop_back();
+        }
+        else if (!backgroundJobs.empty())
+        {
+            job = backgroundJobs.front();
+            backgroundJobs.pop_front();
+        }
+        pthread_mutex_unlock(&backgroundMutex);
+    }
+
+    if (NULL != job)
+    {
+        __sync_sub_and_fetch(&queuedJobs, 1);
+    }
+
+    return job;
+} /* JobSystem::TakeJob() */
+
+/**
+ * Runs a job's work and finishes the job unless it still has children running
+ * @param job - The job to run
+ * @param worker - The worker running the job
+ */
+void JobSystem::Execute(Job* job, Worker* worker)
+{
+    double beginTime = FrameProfiler::GetMilliseconds();
+
+    /* Remember whether the thread is in a background job, so the jobs it creates inherit it */
+    void* outerBackgroundJob = pthread_getspecific(backgroundKey);
+    pthread_setspecific(backgroundKey, job->isBackground ? job : NULL);
+
+    if (NULL != job->rangeFunction)
+    {
+        job->rangeFunction(job->data, job->begin, job->end);
+    }
+    else if (NULL != job->function)
+    {
+        job->function(job->data);
+    }
+
+    pthread_setspecific(backgroundKey, outerBackgroundJob);
+
+    double endTime = FrameProfiler::GetMilliseconds();
+    __sync_add_and_fetch(&worker->jobCount, 1);
+    __sync_add_and_fetch(&worker->busyMicroseconds,
+            static_cast<unsigned long>((endTime - beginTime) * 1000.0));
+
+    if (NULL != hook)
+    {
+        hook(worker->index, beginTime, endTime);
+    }
+
+    Finish(job);
+} /* JobSystem::Execute() */
+
+/**
+ * Marks one part of a job as done; once the job and all its children are done, the jobs
+ * which depend on it are made ready and its parent is told
+ * @param job - The job with a part done
+ */
+void JobSystem::Finish(Job* job)
+{
+    if (0 != __sync_sub_and_fetch(&job->unfinished, 1))
+    {
+        return;
+    }
+
+    /* The atomic write publishes the job's results before anyone can see it finished */
+    std::vector<Job*> continuations;
+    pthread_mutex_lock(&dependencyMutex);
+    __sync_fetch_and_add(&job->isFinished, 1);
+    continuations.swap(job->continuations);
+    pthread_mutex_unlock(&dependencyMutex);
+
+    for (size_t i = 0; i < continuations.size(); i++)
+    {
+        Run(continuations[i]);
+    }
+
+    if (NULL != job->parent)
+    {
+        Finish(job->parent);
+    }
+
+    /* Drop the system's handle, which kept the job alive for its children and dependencies */
+    Release(job);
+} /* JobSystem::Finish() */
@@ -0,0 +1,118 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: JobSystem.h
+ *
+ * A C++ module implementing a work-stealing job system in
+ * which each worker thread keeps its own deque of jobs and
+ * idle workers steal from the others, with parallel loops
+ * over index ranges, child jobs and dependencies, and a
+ * queue of long background jobs which only the worker
+ * threads take.
+ */
+
+#ifndef JOBSYSTEM_H_
+#define JOBSYSTEM_H_
+
+#include <cstddef>
+#include <deque>
+#include <pthread.h>
+#include <vector>
+
+/* Most workers the system runs, including the threads which submit jobs */
+#define JOB_MAX_WORKERS 64
+
+/* A job's work */
+typedef void (*JobFunction)(void* data);
+
+/* A parallel loop's work over the indices from begin up to but not including end */
+typedef void (*JobRangeFunction)(void* data, size_t begin, size_t end);
+
+/* Called after each job with the worker which ran it and when it ran, for tracing */
+typedef void (*JobHook)(int worker, double beginMilliseconds, double endMilliseconds);
+
+/* A unit of work; only the job system looks inside */
+struct Job;
+
+/* How much work a worker has done since the statistics were reset */
+struct JobWorkerStats
+{
+    unsigned long jobs;         /* the number of jobs run */
+    unsigned long steals;       /* the number of those jobs taken from another worker */
+    double busyMilliseconds;    /* the time spent running jobs */
+}; /* JobWorkerStats struct */
+
+class JobSystem
+{
+public:
+    /* Default constructor */
+    JobSystem();
+
+    /* Destructor */
+    ~JobSystem();
+
+    /* Member functions */
+    bool Start(int workerCount, bool isDeterministic);
+    void Stop();
+    int GetWorkerCount() const;
+    bool IsDeterministic() const;
+    Job* Create(JobFunction function, void* data);
+    Job* CreateChild(Job* parent, JobFunction function, void* data);
+    Job* CreateBackground(JobFunction function, void* data);
+    void AddDependency(Job* job, Job* dependency);
+    void Run(Job* job);
+    void Wait(Job* job);
+    void Release(Job* job);
+    void ParallelFor(size_t count, size_t grainSize, JobRangeFunction function, void* data);
+    static void ParallelFor(JobSystem* jobs, size_t count, size_t grainSize,
+            JobRangeFunction function, void* data);
+    void SetHook(JobHook hook);
+    JobWorkerStats GetWorkerStats(int worker) const;
+    void ResetStats();
+    static int GetProcessorCount();
+
+private:
+    /* A thread which runs jobs, along with the deque it owns */
+    struct Worker
+    {
+        JobSystem* system;                      /* the job system the worker belongs to */
+        int index;                              /* the worker's index in the job system */
+        pthread_t thread;                       /* the worker's thread, if it has one */
+        bool hasThread;                         /* false for worker 0 and threads which failed */
+        pthread_mutex_t mutex;                  /* guards the deque */
+        std::deque<Job*> jobs;                  /* the owner works at the back, thieves at the front */
+        volatile unsigned long jobCount;        /* the number of jobs run */
+        volatile unsigned long stealCount;      /* the number of jobs stolen */
+        volatile unsigned long busyMicroseconds; /* the time spent running jobs */
+    }; /* Worker struct */
+
+    /* Private helper functions */
+    static void* RunWorker(void* worker);
+    Worker* GetCurrentWorker() const;
+    Job* Allocate(Job* parent);
+    void Enqueue(Job* job);
+    bool RunPendingJob(Worker* worker, bool canRunBackground);
+    Job* TakeJob(Worker* worker, bool canRunBackground, bool& isStolen);
+    bool IsInBackgroundJob() const;
+    void Execute(Job* job, Worker* worker);
+    void Finish(Job* job);
+
+    /* Private data members */
+    std::vector<Worker*> workers;       /* worker 0 is shared by the threads which submit jobs */
+    bool isDeterministic;               /* true if jobs run at once on the thread which runs them */
+    volatile bool isStopping;           /* tells the worker threads to exit */
+    bool hasThreads;                    /* true if any worker thread is running */
+    volatile int queuedJobs;            /* the number of jobs waiting in all the deques */
+    JobHook hook;                       /* called after each job, or NULL */
+    pthread_key_t workerKey;            /* the worker of the current thread */
+    pthread_key_t backgroundKey;        /* the background job the current thread runs, or NULL */
+    pthread_mutex_t backgroundMutex;    /* guards the background jobs */
+    std::deque<Job*> backgroundJobs;    /* jobs which only the worker threads take */
+    pthread_mutex_t sleepMutex;         /* guards sleeping while there is no work */
+    pthread_cond_t sleepCondition;      /* wakes the sleeping workers when work is queued */
+    pthread_mutex_t dependencyMutex;    /* guards finishing jobs against adding dependencies */
+}; /* JobSystem class */
+
+#endif /* JOBSYSTEM_H_ */
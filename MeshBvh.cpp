@@ -0,0 +1,775 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshBvh.cpp
+ *
+ * A C++ module implementing a bounding volume hierarchy
+ * over a face list's triangles, split by the surface area
+ * heuristic over binned centroids, which finds the nearest
+ * triangle a ray in model space hits, or that each ray of a
+ * packet hits with the rays tested four at a time.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "MeshBvh.h"
+
+#ifdef __SSE2__
+/**
+ * Narrows four rays' spans inside a box to one of its slabs; a ray along one of the slab's
+ * planes gives NaN, and since it lies within that slab its span is left alone
+ * @param t0 - Where each ray crosses the slab's minimum plane
+ * @param t1 - Where each ray crosses the slab's maximum plane
+ * @param near - Each ray's entry into the box so far, updated
+ * @param far - Each ray's exit from the box so far, updated
+ */
+static inline void clipSlab(__m128 t0, __m128 t1, __m128& near, __m128& far)
+{
+    __m128 isOrdered = _mm_cmpord_ps(t0, t1);
+    near = _mm_max_ps(_mm_or_ps(_mm_and_ps(isOrdered, _mm_min_ps(t0, t1)),
+            _mm_andnot_ps(isOrdered, near)), near);
+    far = _mm_min_ps(_mm_or_ps(_mm_and_ps(isOrdered, _mm_max_ps(t0, t1)),
+            _mm_andnot_ps(isOrdered, far)), far);
+} /* clipSlab() */
+#endif
+
+/* The number of bins the centroids are sorted into along each axis to price the splits */
+#define BVH_BIN_COUNT 16
+
+/* The relative costs of stepping into a node and of testing a triangle */
+#define BVH_TRAVERSAL_COST 2.0f
+#define BVH_INTERSECTION_COST 1.0f
+
+/* The most triangles a leaf holds unless they cannot be told apart */
+#define BVH_MAX_LEAF_SIZE 8
+
+/* The deepest a node lies below the root, so that a traversal's stack never overflows */
+#define BVH_MAX_DEPTH 60
+#define BVH_STACK_SIZE 64
+
+/* A range of triangles waiting to become a node */
+struct BuildTask
+{
+    int begin;          /* the first triangle in the order */
+    int end;            /* one past the last triangle in the order */
+    int parent;         /* the inner node whose second child this is, or -1 */
+    int depth;          /* the number of nodes above this one */
+}; /* BuildTask struct */
+
+/* Tells whether a triangle's centroid falls into a bin no later than a split's */
+struct BinPredicate
+{
+    const float* centroids;     /* each triangle's centroid */
+    int axis;                   /* the axis the bins lie along */
+    float minimum;              /* where the first bin starts */
+    float scale;                /* the number of bins per unit along the axis */
+    int split;                  /* the last bin on the near side of the split */
+
+    /**
+     * Tells which side of the split a triangle lies on
+     * @param face - The index of the triangle
+     * @return - True if it lies on the near side
+     */
+    bool operator()(int face) const
+    {
+        int bin = static_cast<int>((centroids[3 * face + axis] - minimum) * scale);
+        return std::min(bin, BVH_BIN_COUNT - 1) <= split;
+    } /* operator()() */
+}; /* BinPredicate struct */
+
+/**
+ * Empties a box, so that growing it by anything yields that thing
+ * @param bounds - The box, minimum x, y, z then maximum x, y, z
+ */
+static void clearBounds(float bounds[6])
+{
+    for (int j = 0; j < 3; j++)
+    {
+        bounds[j] = FLT_MAX;
+        bounds[3 + j] = -FLT_MAX;
+    }
+} /* clearBounds() */
+
+/**
+ * Grows a box to contain another
+ * @param bounds - The box to grow
+ * @param box - The box to contain
+ */
+static void growBounds(float bounds[6], const float box[6])
+{
+    for (int j = 0; j < 3; j++)
+    {
+        bounds[j] = std::min(bounds[j], box[j]);
+        bounds[3 + j] = std::max(bounds[3 + j], box[3 + j]);
+    }
+} /* growBounds() */
+
+/**
+ * Returns half the surface area of a box, which is all the heuristic needs
+ * @param bounds - The box
+ * @return - The half area, or 0 if the box is empty
+ */
+static float getHalfArea(const float bounds[6])
+{
+    float dx = bounds[3] - bounds[0];
+    float dy = bounds[4] - bounds[1];
+    float dz = bounds[5] - bounds[2];
+
+    return 0.0f > dx ? 0.0f : dx * dy + dy * dz + dz * dx;
+} /* getHalfArea() */
+
+/**
+ * Finds where to split a range of triangles into two children by pricing the boundaries
+ * between the bins along each axis with the surface area heuristic, then sorts the triangles
+ * on either side of it apart
+ * @param boxes - Each triangle's box
+ * @param centroids - Each triangle's centroid
+ * @param order - The triangles, returned with the range split
+ * @param begin - The first triangle of the range in the order
+ * @param end - One past the last triangle of the range in the order
+ * @param bounds - The box around the range's triangles
+ * @param centroidBounds - The box around the range's centroids
+ * @return - Where the second child's triangles start, or -1 if the range is a leaf
+ */
+static int splitTriangles(const float* boxes, const float* centroids, int* order, int begin,
+        int end, const float bounds[6], const float centroidBounds[6])
+{
+    int count = end - begin;
+    if (1 >= count)
+    {
+        return -1;
+    }
+
+    /* Price the costs relative to the parent's area, so that a flat parent does not divide
+     * by zero
+     */
+    float parentArea = getHalfArea(bounds);
+    float leafCost = BVH_INTERSECTION_COST * count * parentArea;
+    float bestCost = FLT_MAX;
+    BinPredicate best = {centroids, -1, 0.0f, 0.0f, 0};
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidBounds[3 + axis] - centroidBounds[axis];
+        if (0.0f >= extent)
+        {
+            continue;
+        }
+
+        BinPredicate predicate = {centroids, axis, centroidBounds[axis],
+                BVH_BIN_COUNT / extent, 0};
+        int binCounts[BVH_BIN_COUNT] = {0};
+        float binBounds[BVH_BIN_COUNT][6];
+        for (int b = 0; b < BVH_BIN_COUNT; b++)
+        {
+            clearBounds(binBounds[b]);
+        }
+        for (int i = begin; i < end; i++)
+        {
+            int face = order[i];
+            int bin = static_cast<int>((centroids[3 * face + axis] - predicate.minimum)
+                    * predicate.scale);
+            bin = std::min(bin, BVH_BIN_COUNT - 1);
+            binCounts[bin]++;
+            growBounds(binBounds[bin], &boxes[6 * face]);
+        }
+
+        /* Sweep from the far end for the far side's areas, then from the near end */
+        float farAreas[BVH_BIN_COUNT];
+        int farCounts[BVH_BIN_COUNT];
+        float sideBounds[6];
+        clearBounds(sideBounds);
+        int sideCount = 0;
+        for (int b = BVH_BIN_COUNT - 1; b > 0; b--)
+        {
+            growBounds(sideBounds, binBounds[b]);
+            sideCount += binCounts[b];
+            farAreas[b] = getHalfArea(sideBounds);
+            farCounts[b] = sideCount;
+        }
+
+        clearBounds(sideBounds);
+        sideCount = 0;
+        for (int b = 0; b < BVH_BIN_COUNT - 1; b++)
+        {
+            growBounds(sideBounds, binBounds[b]);
+            sideCount += binCounts[b];
+            if (0 == sideCount || 0 == farCounts[b + 1])
+            {
+                continue;
+            }
+
+            float cost = BVH_TRAVERSAL_COST * parentArea + BVH_INTERSECTION_COST
+                    * (getHalfArea(sideBounds) * sideCount + farAreas[b + 1] * farCounts[b + 1]);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                best = predicate;
+                best.split = b;
+            }
+        }
+    }
+
+    /* Keep a small range whole when splitting it costs more than testing all of it */
+    if (0 > best.axis || (bestCost >= leafCost && BVH_MAX_LEAF_SIZE >= count))
+    {
+        /* The centroids all coincide, so only their order can split a large range */
+        return BVH_MAX_LEAF_SIZE >= count ? -1 : begin + count / 2;
+    }
+
+    return static_cast<int>(std::partition(order + begin, order + end, best) - order);
+} /* splitTriangles() */
+
+/**
+ * Builds the hierarchy over a face list's triangles, replacing any built before
+ * @param faceList - The triangles, in model space
+ */
+void MeshBvh::Build(const FaceList* faceList)
+{
+    nodes.clear();
+    triangles.clear();
+    faces.clear();
+
+    int faceCount = faceList->fc;
+    if (0 == faceCount)
+    {
+        return;
+    }
+
+    /* Bound each triangle and find its box's center */
+    std::vector<float> boxes(6 * faceCount);
+    std::vector<float> centroids(3 * faceCount);
+    std::vector<int> order(faceCount);
+    for (int i = 0; i < faceCount; i++)
+    {
+        float* box = &boxes[6 * i];
+        clearBounds(box);
+        for (int k = 0; k < 3; k++)
+        {
+            const double* vertex = faceList->vertices[faceList->faces[i][k]];
+            for (int j = 0; j < 3; j++)
+            {
+                box[j] = std::min(box[j], static_cast<float>(vertex[j]));
+                box[3 + j] = std::max(box[3 + j], static_cast<float>(vertex[j]));
+            }
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            centroids[3 * i + j] = 0.5f * (box[j] + box[3 + j]);
+        }
+        order[i] = i;
+    }
+
+    /* Split depth first, so that each inner node's first child comes right after it */
+    nodes.reserve(2 * faceCount / BVH_MAX_LEAF_SIZE + 1);
+    std::vector<BuildTask> tasks;
+    BuildTask root = {0, faceCount, -1, 0};
+    tasks.push_back(root);
+    while (!tasks.empty())
+    {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+
+        int index = static_cast<int>(nodes.size());
+        if (0 <= task.parent)
+        {
+            nodes[task.parent].start = index;
+        }
+
+        BvhNode node;
+        float centroidBounds[6];
+        clearBounds(node.bounds);
+        clearBounds(centroidBounds);
+        for (int i = task.begin; i < task.end; i++)
+        {
+            const float* centroid = &centroids[3 * order[i]];
+            float point[6] = {centroid[0], centroid[1], centroid[2],
+                    centroid[0], centroid[1], centroid[2]};
+            growBounds(node.bounds, &boxes[6 * order[i]]);
+            growBounds(centroidBounds, point);
+        }
+
+        int middle = BVH_MAX_DEPTH > task.depth ? splitTriangles(&boxes[0], &centroids[0],
+                &order[0], task.begin, task.end, node.bounds, centroidBounds) : -1;
+        if (0 > middle)
+        {
+            node.start = task.begin;
+            node.count = task.end - task.begin;
+            nodes.push_back(node);
+            continue;
+        }
+
+        node.start = -1;
+        node.count = 0;
+        nodes.push_back(node);
+
+        /* The first child is popped next, so it lands right after its parent */
+        BuildTask second = {middle, task.end, index, task.depth + 1};
+        BuildTask first = {task.begin, middle, -1, task.depth + 1};
+        tasks.push_back(second);
+        tasks.push_back(first);
+    }
+
+    /* Store the triangles in the leaves' order, ready for the ray test */
+    triangles.resize(9 * faceCount);
+    faces.swap(order);
+    for (int i = 0; i < faceCount; i++)
+    {
+        const int* face = faceList->faces[faces[i]];
+        const double* v0 = faceList->vertices[face[0]];
+        const double* v1 = faceList->vertices[face[1]];
+        const double* v2 = faceList->vertices[face[2]];
+        float* triangle = &triangles[9 * i];
+        for (int j = 0; j < 3; j++)
+        {
+            triangle[j] = static_cast<float>(v0[j]);
+            triangle[3 + j] = static_cast<float>(v1[j] - v0[j]);
+            triangle[6 + j] = static_cast<float>(v2[j] - v0[j]);
+        }
+    }
+} /* MeshBvh::Build() */
+
+/**
+ * Finds how far along a ray it enters a box, by the slab test
+ * @param bounds - The box
+ * @param origin - The ray's origin
+ * @param inverse - The reciprocals of the ray direction's components
+ * @param maxDistance - The farthest along the ray that counts
+ * @param entry - Returned with the distance the ray enters the box at, or 0 if it starts in it
+ * @return - True if the ray enters the box before the farthest distance
+ */
+bool MeshBvh::IntersectBox(const float bounds[6], const float origin[3],
+        const float inverse[3], float maxDistance, float& entry)
+{
+    float near = 0.0f;
+    float far = maxDistance;
+
+    /* A ray along a slab's plane gives NaN, and it lies within that slab */
+    for (int j = 0; j < 3; j++)
+    {
+        float t0 = (bounds[j] - origin[j]) * inverse[j];
+        float t1 = (bounds[3 + j] - origin[j]) * inverse[j];
+        if (t0 != t0 || t1 != t1)
+        {
+            continue;
+        }
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        near = t0 > near ? t0 : near;
+        far = t1 < far ? t1 : far;
+    }
+
+    entry = near;
+    return near <= far;
+} /* MeshBvh::IntersectBox() */
+
+/**
+ * Tells which rays of a packet enter a box, by the slab test four rays at a time
+ * @param bounds - The box
+ * @param packet - The rays, each counting only out to its farthest distance
+ * @return - A mask with bit i set if ray i enters the box before its farthest distance
+ */
+int MeshBvh::IntersectBoxPacket(const float bounds[6], const RayPacket& packet)
+{
+#ifdef __SSE2__
+    __m128 near = _mm_setzero_ps();
+    __m128 far = _mm_loadu_ps(packet.maxDistances);
+    for (int j = 0; j < 3; j++)
+    {
+        __m128 origin = _mm_loadu_ps(packet.origins[j]);
+        __m128 inverse = _mm_loadu_ps(packet.inverses[j]);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds[j]), origin), inverse);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds[3 + j]), origin), inverse);
+        clipSlab(t0, t1, near, far);
+    }
+
+    return _mm_movemask_ps(_mm_cmple_ps(near, far));
+#else
+    int mask = 0;
+    for (int k = 0; k < RAY_PACKET_SIZE; k++)
+    {
+        float origin[3] = {packet.origins[0][k], packet.origins[1][k], packet.origins[2][k]};
+        float inverse[3] = {packet.inverses[0][k], packet.inverses[1][k], packet.inverses[2][k]};
+        float entry;
+        if (IntersectBox(bounds, origin, inverse, packet.maxDistances[k], entry))
+        {
+            mask |= 1 << k;
+        }
+    }
+
+    return mask;
+#endif
+} /* MeshBvh::IntersectBoxPacket() */
+
+/**
+ * Finds where a ray hits a triangle, by Moller and Trumbore's test
+ * @param triangle - The triangle's first vertex and its two edges from it
+ * @param origin - The ray's origin
+ * @param direction - The ray's direction
+ * @param maxDistance - The farthest along the ray that counts
+ * @param isCullingBackFaces - Whether a triangle wound clockwise as the ray sees it is missed
+ * @param hit - Returned with the distance and barycentric weights if the ray hits
+ * @return - True if the ray hits the triangle before the farthest distance
+ */
+static bool intersectTriangle(const float triangle[9], const float origin[3],
+        const float direction[3], float maxDistance, bool isCullingBackFaces, RayHit& hit)
+{
+    const float* e1 = &triangle[3];
+    const float* e2 = &triangle[6];
+    float p[3] =
+    {
+        direction[1] * e2[2] - direction[2] * e2[1],
+        direction[2] * e2[0] - direction[0] * e2[2],
+        direction[0] * e2[1] - direction[1] * e2[0]
+    };
+    float determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+
+    /* The determinant is positive when the triangle faces the ray's origin */
+    if (0.0f == determinant || (isCullingBackFaces && 0.0f > determinant))
+    {
+        return false;
+    }
+
+    float inverse = 1.0f / determinant;
+    float s[3] = {origin[0] - triangle[0], origin[1] - triangle[1], origin[2] - triangle[2]};
+    float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (0.0f > u || 1.0f < u)
+    {
+        return false;
+    }
+
+    float q[3] =
+    {
+        s[1] * e1[2] - s[2] * e1[1],
+        s[2] * e1[0] - s[0] * e1[2],
+        s[0] * e1[1] - s[1] * e1[0]
+    };
+    float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (0.0f > v || 1.0f < u + v)
+    {
+        return false;
+    }
+
+    float distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+    if (0.0f > distance || distance >= maxDistance)
+    {
+        return false;
+    }
+
+    hit.distance = distance;
+    hit.u = u;
+    hit.v = v;
+    return true;
+} /* intersectTriangle() */
+
+/**
+ * Finds the nearest triangle a ray hits, visiting the nearer child of each node first so that
+ * the farther one can often be skipped
+ * @param origin - The ray's origin in model space
+ * @param direction - The ray's direction in model space, which need not be unit length
+ * @param maxDistance - The farthest along the ray that counts, in lengths of the direction
+ * @param hit - Returned with the nearest hit if there is one
+ * @param isCullingBackFaces - Whether triangles facing away from the ray are missed, as
+ *                             OpenGL culls them
+ * @return - True if the ray hits a triangle before the farthest distance
+ */
+bool MeshBvh::Intersect(const float origin[3], const float direction[3], float maxDistance,
+        RayHit& hit, bool isCullingBackFaces) const
+{
+    float entry;
+    float inverse[3] = {1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2]};
+    if (nodes.empty() || !IntersectBox(nodes[0].bounds, origin, inverse, maxDistance, entry))
+    {
+        return false;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    float entries[BVH_STACK_SIZE];
+    int top = 0;
+    int index = 0;
+    bool isHit = false;
+
+    for (;;)
+    {
+        const BvhNode& node = nodes[index];
+        if (0 == node.count)
+        {
+            int first = index + 1;
+            int second = node.start;
+            float firstEntry;
+            float secondEntry;
+            bool isFirstHit = IntersectBox(nodes[first].bounds, origin, inverse, maxDistance,
+                    firstEntry);
+            bool isSecondHit = IntersectBox(nodes[second].bounds, origin, inverse, maxDistance,
+                    secondEntry);
+
+            if (isFirstHit && isSecondHit)
+            {
+                if (secondEntry < firstEntry)
+                {
+                    std::swap(first, second);
+                    std::swap(firstEntry, secondEntry);
+                }
+                stack[top] = second;
+                entries[top++] = secondEntry;
+                index = first;
+                continue;
+            }
+            else if (isFirstHit || isSecondHit)
+            {
+                index = isFirstHit ? first : second;
+                continue;
+            }
+        }
+        else
+        {
+            for (int i = node.start; i < node.start + node.count; i++)
+            {
+                if (intersectTriangle(&triangles[9 * i], origin, direction, maxDistance,
+                        isCullingBackFaces, hit))
+                {
+                    maxDistance = hit.distance;
+                    hit.face = faces[i];
+                    isHit = true;
+                }
+            }
+        }
+
+        /* Resume at the nearest node put off which still lies nearer than the best hit */
+        while (0 < top && entries[top - 1] > maxDistance)
+        {
+            top--;
+        }
+        if (0 == top)
+        {
+            break;
+        }
+        index = stack[--top];
+    }
+
+    return isHit;
+} /* MeshBvh::Intersect() */
+
+/**
+ * Finds the nearest triangle each ray of a packet hits, walking the hierarchy once for the
+ * whole packet: a node is entered if any of the rays still needs it, and its boxes and
+ * triangles are tested against the four rays at once with SSE2
+ * The nearer child is the one lying ahead along the first ray with room left, so the rays
+ * should be coherent; without SSE2 each ray walks the hierarchy on its own
+ * @param packet - The rays in model space
+ * @param hits - Returned with each ray's nearest hit, or a face of -1 if it hits nothing
+ * @param isCullingBackFaces - Whether triangles facing away from the rays are missed
+ * @return - A mask with bit i set if ray i hits a triangle
+ */
+int MeshBvh::IntersectPacket(const RayPacket& packet, RayHit hits[RAY_PACKET_SIZE],
+        bool isCullingBackFaces) const
+{
+#ifdef __SSE2__
+    __m128 origin[3];
+    __m128 direction[3];
+    __m128 inverse[3];
+    for (int j = 0; j < 3; j++)
+    {
+        origin[j] = _mm_loadu_ps(packet.origins[j]);
+        direction[j] = _mm_loadu_ps(packet.directions[j]);
+        inverse[j] = _mm_loadu_ps(packet.inverses[j]);
+    }
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 best = _mm_loadu_ps(packet.maxDistances);
+    __m128 bestU = zero;
+    __m128 bestV = zero;
+    __m128i bestFace = _mm_set1_epi32(-1);
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    int index = 0;
+
+    while (!nodes.empty())
+    {
+        /* Skip a node which every ray misses or has found a nearer hit than */
+        const BvhNode& node = nodes[index];
+        __m128 near = zero;
+        __m128 far = best;
+        for (int j = 0; j < 3; j++)
+        {
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds[j]), origin[j]),
+                    inverse[j]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds[3 + j]), origin[j]),
+                    inverse[j]);
+            clipSlab(t0, t1, near, far);
+        }
+        int active = _mm_movemask_ps(_mm_cmple_ps(near, far));
+
+        if (0 != active && 0 == node.count)
+        {
+            /* Visit first the child whose center lies farther ahead along the first active
+             * ray, which the rest of the packet mostly agrees with
+             */
+            int lane = 0;
+            while (0 == (active & (1 << lane)))
+            {
+                lane++;
+            }
+            int first = index + 1;
+            int second = node.start;
+            const float* a = nodes[first].bounds;
+            const float* b = nodes[second].bounds;
+            float ahead = 0.0f;
+            for (int j = 0; j < 3; j++)
+            {
+                ahead += (b[j] + b[3 + j] - a[j] - a[3 + j]) * packet.directions[j][lane];
+            }
+            if (0.0f > ahead)
+            {
+                std::swap(first, second);
+            }
+            stack[top++] = second;
+            index = first;
+            continue;
+        }
+        else if (0 != active)
+        {
+            for (int i = node.start; i < node.start + node.count; i++)
+            {
+                /* Moller and Trumbore's test against all four rays */
+                const float* triangle = &triangles[9 * i];
+                __m128 v0[3];
+                __m128 e1[3];
+                __m128 e2[3];
+                for (int j = 0; j < 3; j++)
+                {
+                    v0[j] = _mm_set1_ps(triangle[j]);
+                    e1[j] = _mm_set1_ps(triangle[3 + j]);
+                    e2[j] = _mm_set1_ps(triangle[6 + j]);
+                }
+                __m128 p[3] =
+                {
+                    _mm_sub_ps(_mm_mul_ps(direction[1], e2[2]), _mm_mul_ps(direction[2], e2[1])),
+                    _mm_sub_ps(_mm_mul_ps(direction[2], e2[0]), _mm_mul_ps(direction[0], e2[2])),
+                    _mm_sub_ps(_mm_mul_ps(direction[0], e2[1]), _mm_mul_ps(direction[1], e2[0]))
+                };
+                __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], p[0]),
+                        _mm_mul_ps(e1[1], p[1])), _mm_mul_ps(e1[2], p[2]));
+                __m128 reciprocal = _mm_div_ps(one, determinant);
+                __m128 t[3] =
+                {
+                    _mm_sub_ps(origin[0], v0[0]),
+                    _mm_sub_ps(origin[1], v0[1]),
+                    _mm_sub_ps(origin[2], v0[2])
+                };
+                __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], p[0]),
+                        _mm_mul_ps(t[1], p[1])), _mm_mul_ps(t[2], p[2])), reciprocal);
+                __m128 q[3] =
+                {
+                    _mm_sub_ps(_mm_mul_ps(t[1], e1[2]), _mm_mul_ps(t[2], e1[1])),
+                    _mm_sub_ps(_mm_mul_ps(t[2], e1[0]), _mm_mul_ps(t[0], e1[2])),
+                    _mm_sub_ps(_mm_mul_ps(t[0], e1[1]), _mm_mul_ps(t[1], e1[0]))
+                };
+                __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], q[0]),
+                        _mm_mul_ps(direction[1], q[1])), _mm_mul_ps(direction[2], q[2])),
+                        reciprocal);
+                __m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], q[0]),
+                        _mm_mul_ps(e2[1], q[1])), _mm_mul_ps(e2[2], q[2])), reciprocal);
+
+                /* The same bounds as the test of a single ray; a NaN fails every one */
+                __m128 isFacing = isCullingBackFaces ? _mm_cmpgt_ps(determinant, zero)
+                        : _mm_cmpneq_ps(determinant, zero);
+                __m128 isHit = _mm_and_ps(isFacing,
+                        _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+                isHit = _mm_and_ps(isHit, _mm_and_ps(_mm_cmpge_ps(v, zero),
+                        _mm_cmple_ps(_mm_add_ps(u, v), one)));
+                isHit = _mm_and_ps(isHit, _mm_and_ps(_mm_cmpge_ps(distance, zero),
+                        _mm_cmplt_ps(distance, best)));
+                if (0 == _mm_movemask_ps(isHit))
+                {
+                    continue;
+                }
+
+                best = _mm_or_ps(_mm_and_ps(isHit, distance), _mm_andnot_ps(isHit, best));
+                bestU = _mm_or_ps(_mm_and_ps(isHit, u), _mm_andnot_ps(isHit, bestU));
+                bestV = _mm_or_ps(_mm_and_ps(isHit, v), _mm_andnot_ps(isHit, bestV));
+                __m128i isFace = _mm_castps_si128(isHit);
+                bestFace = _mm_or_si128(_mm_and_si128(isFace, _mm_set1_epi32(faces[i])),
+                        _mm_andnot_si128(isFace, bestFace));
+            }
+        }
+
+        if (0 == top)
+        {
+            break;
+        }
+        index = stack[--top];
+    }
+
+    float distances[RAY_PACKET_SIZE];
+    float us[RAY_PACKET_SIZE];
+    float vs[RAY_PACKET_SIZE];
+    int faceIndices[RAY_PACKET_SIZE];
+    _mm_storeu_ps(distances, best);
+    _mm_storeu_ps(us, bestU);
+    _mm_storeu_ps(vs, bestV);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(faceIndices), bestFace);
+
+    int mask = 0;
+    for (int k = 0; k < RAY_PACKET_SIZE; k++)
+    {
+        hits[k].distance = distances[k];
+        hits[k].face = faceIndices[k];
+        hits[k].u = us[k];
+        hits[k].v = vs[k];
+        mask |= 0 <= faceIndices[k] ? 1 << k : 0;
+    }
+
+    return mask;
+#else
+    int mask = 0;
+    for (int k = 0; k < RAY_PACKET_SIZE; k++)
+    {
+        float origin[3] = {packet.origins[0][k], packet.origins[1][k], packet.origins[2][k]};
+        float direction[3] =
+        {
+            packet.directions[0][k], packet.directions[1][k], packet.directions[2][k]
+        };
+        hits[k].distance = packet.maxDistances[k];
+        hits[k].face = -1;
+        if (0.0f <= packet.maxDistances[k]
+                && Intersect(origin, direction, packet.maxDistances[k], hits[k],
+                        isCullingBackFaces))
+        {
+            mask |= 1 << k;
+        }
+    }
+
+    return mask;
+#endif
+} /* MeshBvh::IntersectPacket() */
+
+/**
+ * Returns the number of nodes in the hierarchy
+ * @return - The number of inner nodes and leaves
+ */
+int MeshBvh::GetNodeCount() const
+{
+    return static_cast<int>(nodes.size());
+} /* MeshBvh::GetNodeCount() */
+
+/**
+ * Returns the memory the hierarchy takes up
+ * @return - The number of bytes in its nodes and triangles
+ */
+size_t MeshBvh::GetByteCount() const
+{
+    return nodes.size() * sizeof(BvhNode) + triangles.size() * sizeof(float)
+            + faces.size() * sizeof(int);
+} /* MeshBvh::GetByteCount() */
@@ -0,0 +1,83 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshBvh.h
+ *
+ * A C++ module implementing a bounding volume hierarchy
+ * over a face list's triangles, split by the surface area
+ * heuristic over binned centroids, which finds the nearest
+ * triangle a ray in model space hits, or that each ray of a
+ * packet hits with the rays tested four at a time.
+ */
+
+#ifndef MESHBVH_H_
+#define MESHBVH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "FaceList.h"
+
+/* The number of rays in a packet, which SSE2 tests together */
+#define RAY_PACKET_SIZE 4
+
+/* A node of the hierarchy; an inner node's first child follows it */
+struct BvhNode
+{
+    float bounds[6];    /* the box around the node's triangles, minimum x, y, z then maximum
+                         * x, y, z */
+    int start;          /* a leaf's first triangle, or an inner node's second child */
+    int count;          /* a leaf's number of triangles, or 0 for an inner node */
+}; /* BvhNode struct */
+
+/* Where a ray first hits a mesh */
+struct RayHit
+{
+    float distance;     /* how far along the ray the hit lies, in lengths of its direction */
+    int face;           /* the index of the face hit in the face list */
+    float u;            /* the barycentric weight of the face's second vertex */
+    float v;            /* the barycentric weight of the face's third vertex */
+}; /* RayHit struct */
+
+/* Rays which start close together and point much the same way, laid out by axis so that a box
+ * or a triangle is tested against all of them at once
+ */
+struct RayPacket
+{
+    float origins[3][RAY_PACKET_SIZE];      /* the rays' origins, x then y then z */
+    float directions[3][RAY_PACKET_SIZE];   /* the rays' directions, which need not be unit
+                                             * length */
+    float inverses[3][RAY_PACKET_SIZE];     /* the reciprocals of the directions' components */
+    float maxDistances[RAY_PACKET_SIZE];    /* the farthest along each ray that counts, or a
+                                             * negative for a lane with no ray */
+}; /* RayPacket struct */
+
+class MeshBvh
+{
+public:
+    /* Member functions */
+    void Build(const FaceList* faceList);
+    bool Intersect(const float origin[3], const float direction[3], float maxDistance,
+            RayHit& hit, bool isCullingBackFaces = false) const;
+    int IntersectPacket(const RayPacket& packet, RayHit hits[RAY_PACKET_SIZE],
+            bool isCullingBackFaces = false) const;
+    int GetNodeCount() const;
+    size_t GetByteCount() const;
+
+    /* Static member functions */
+    static bool IntersectBox(const float bounds[6], const float origin[3],
+            const float inverse[3], float maxDistance, float& entry);
+    static int IntersectBoxPacket(const float bounds[6], const RayPacket& packet);
+
+private:
+    /* Private data members */
+    std::vector<BvhNode> nodes;         /* the nodes, depth first from the root */
+    std::vector<float> triangles;       /* each triangle's first vertex then its two edges from
+                                         * it, in the leaves' order */
+    std::vector<int> faces;             /* each triangle's index in the face list, in the
+                                         * leaves' order */
+}; /* MeshBvh class */
+
+#endif /* MESHBVH_H_ */
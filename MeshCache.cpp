@@ -0,0 +1,460 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshCache.cpp
+ *
+ * A C++ module implementing a cache of the meshes loaded
+ * from PLY files, keyed by canonical path and content hash,
+ * so that every model loaded from the same file shares one
+ * reference-counted, immutable copy of its triangles.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include "MeshCache.h"
+#include "MeshSimplifier.h"
+#include "PlyModel.h"
+
+/* The 64-bit FNV-1a offset basis and prime, built from 32-bit halves for C++98 */
+#define FNV_OFFSET_BASIS ((static_cast<uint64_t>(0xCBF29CE4u) << 32) | 0x84222325u)
+#define FNV_PRIME ((static_cast<uint64_t>(0x00000100u) << 32) | 0x000001B3u)
+
+/* The share of the full detail triangles each level of detail keeps */
+static const double lodRatios[MESH_LOD_COUNT] = {1.0, 0.4, 0.15, 0.05};
+
+/**
+ * Default constructor creates an empty cache
+ */
+MeshCache::MeshCache()
+    : nextId(0)
+    , weldEpsilon(MESH_DEFAULT_WELD_EPSILON)
+    , normalWeighting(NORMALS_UNIFORM)
+{
+    pthread_mutex_init(&mutex, NULL);
+} /* Default constructor */
+
+/**
+ * Destructor frees the meshes which are still cached
+ */
+MeshCache::~MeshCache()
+{
+    for (std::map<Key, MeshAsset*>::iterator itr = meshes.begin(); itr != meshes.end(); itr++)
+    {
+        delete itr->second->faceList;
+        delete itr->second;
+    }
+
+    pthread_mutex_destroy(&mutex);
+} /* Destructor */
+
+/**
+ * Returns the mesh of a PLY file, loading it if no model shares it yet
+ * A mesh loaded by another thread may still be loading when it is returned, so callers check
+ * its state before using its triangles; the mesh loads on the calling thread otherwise, with
+ * its preprocessing spread over the job system
+ * The caller must pass the returned mesh to Release() exactly once
+ * @param filename - The name of the PLY file
+ * @param jobs - The job system which preprocesses the mesh in parallel, or NULL
+ * @return - The mesh
+ */
+MeshAsset* MeshCache::Acquire(const char* filename, JobSystem* jobs)
+{
+    std::string path = GetCanonicalPath(filename);
+    Key key(path, GetFileHash(path));
+
+    pthread_mutex_lock(&mutex);
+    std::map<Key, MeshAsset*>::iterator itr = meshes.find(key);
+    if (meshes.end() != itr)
+    {
+        itr->second->references++;
+        pthread_mutex_unlock(&mutex);
+        return itr->second;
+    }
+
+    MeshAsset* mesh = new MeshAsset();
+    mesh->path = path;
+    mesh->hash = key.second;
+    mesh->id = nextId++;
+    mesh->references = 1;
+    mesh->state = MESH_LOADING;
+    mesh->faceList = NULL;
+    meshes[key] = mesh;
+    pthread_mutex_unlock(&mutex);
+
+    /* Load outside the lock, so the other files load at the same time; the colors are seeded
+     * by the contents, so they do not depend on the order the files load in
+     */
+    mesh->faceList = readPlyModel(path.c_str(), jobs, static_cast<unsigned int>(mesh->hash),
+            normalWeighting);
+
+    /* Merge the vertices the file repeats, so the normals are smooth across them and every
+     * later pass touches fewer vertices
+     */
+    FaceList* welded = MeshWelder::Weld(mesh->faceList, weldEpsilon, normalWeighting, jobs,
+            mesh->weldStats);
+    if (NULL != welded)
+    {
+        delete mesh->faceList;
+        mesh->faceList = welded;
+    }
+
+    /* Bound the triangles once for every model which shares them, both by a box and by a
+     * cylinder around the y axis which contains them however they spin about it
+     */
+    FaceList* faceList = mesh->faceList;
+    float axisRadiusSquared = 0.0f;
+    for (int j = 0; j < 3; j++)
+    {
+        mesh->bounds[j] = 0 < faceList->vc ? static_cast<float>(faceList->vertices[0][j]) : 0.0f;
+        mesh->bounds[3 + j] = mesh->bounds[j];
+    }
+    for (int i = 0; i < faceList->vc; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            float coordinate = static_cast<float>(faceList->vertices[i][j]);
+            mesh->bounds[j] = std::min(mesh->bounds[j], coordinate);
+            mesh->bounds[3 + j] = std::max(mesh->bounds[3 + j], coordinate);
+        }
+
+        float x = static_cast<float>(faceList->vertices[i][0]);
+        float z = static_cast<float>(faceList->vertices[i][2]);
+        axisRadiusSquared = std::max(axisRadiusSquared, x * x + z * z);
+    }
+    mesh->axisRadius = sqrtf(axisRadiusSquared);
+
+    /* Build the hierarchy which picking casts rays against once, in model space, so every
+     * model sharing the mesh casts against it however it is placed
+     */
+    mesh->bvh.Build(faceList);
+
+    /* Convert the triangles now, so the OpenGL thread only has to copy them */
+    GpuMesh::BuildArrays(faceList, mesh->vertices[0], mesh->indices[0]);
+
+    /* Simplify the triangles into coarser levels of detail, each from the one before, which
+     * only the drawing uses; the culling and picking keep the full detail triangles
+     */
+    MeshSimplifier simplifier(faceList, normalWeighting);
+    for (int level = 1; level < MESH_LOD_COUNT; level++)
+    {
+        FaceList* simplified = simplifier.Simplify(
+                static_cast<int>(lodRatios[level] * faceList->fc));
+        GpuMesh::BuildArrays(simplified, mesh->vertices[level], mesh->indices[level]);
+        delete simplified;
+    }
+
+    /* Reorder each level's triangles for the post-transform vertex cache, then its vertices
+     * for fetching, so the GPU transforms and fetches fewer vertices every frame
+     */
+    mesh->originalCacheStats = MeshOptimizer::AnalyzeVertexCache(mesh->indices[0],
+            mesh->vertices[0].size());
+    for (int level = 0; level < MESH_LOD_COUNT; level++)
+    {
+        MeshOptimizer::OptimizeVertexCache(mesh->indices[level], mesh->vertices[level].size());
+        MeshOptimizer::OptimizeVertexFetch(mesh->vertices[level], mesh->indices[level]);
+    }
+    mesh->optimizedCacheStats = MeshOptimizer::AnalyzeVertexCache(mesh->indices[0],
+            mesh->vertices[0].size());
+
+    /* The atomic write publishes the loaded mesh before anyone can see its new state */
+    __sync_bool_compare_and_swap(&mesh->state, MESH_LOADING, MESH_LOADED);
+
+    return mesh;
+} /* MeshCache::Acquire() */
+
+/**
+ * Gives up a model's share of a mesh, freeing the mesh once no model shares it
+ * This needs no OpenGL context; the mesh's buffer objects wait for the OpenGL thread's next
+ * call to GpuMesh::DeleteReleasedBuffers()
+ * @param mesh - The mesh returned by Acquire()
+ */
+void MeshCache::Release(MeshAsset* mesh)
+{
+    pthread_mutex_lock(&mutex);
+    bool isUnused = 0 == --mesh->references;
+    if (isUnused)
+    {
+        meshes.erase(Key(mesh->path, mesh->hash));
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (isUnused)
+    {
+        delete mesh->faceList;
+        delete mesh;
+    }
+} /* MeshCache::Release() */
+
+/**
+ * Returns how far a mesh has loaded
+ * @param mesh - The mesh
+ * @return - The mesh's state
+ */
+MeshState MeshCache::GetState(const MeshAsset* mesh)
+{
+    /* The atomic read also orders reading what the load wrote after seeing its state */
+    return static_cast<MeshState>(
+            __sync_fetch_and_add(const_cast<volatile int*>(&mesh->state), 0));
+} /* MeshCache::GetState() */
+
+/**
+ * Uploads every level of detail of the meshes which have finished loading into buffer
+ * objects, which makes them MESH_READY; must be called with the OpenGL context current
+ * @param state - The state cache used to bind the buffers
+ * @return - The number of meshes uploaded now
+ */
+int MeshCache::Upload(GLStateCache& state)
+{
+    int uploadCount = 0;
+
+    pthread_mutex_lock(&mutex);
+    for (std::map<Key, MeshAsset*>::iterator itr = meshes.begin(); itr != meshes.end(); itr++)
+    {
+        MeshAsset* mesh = itr->second;
+        if (MESH_LOADED != GetState(mesh))
+        {
+            continue;
+        }
+
+        for (int level = 0; level < MESH_LOD_COUNT; level++)
+        {
+            mesh->gpuMeshes[level].Upload(state, mesh->vertices[level], mesh->indices[level]);
+
+            /* The buffer objects hold the triangles now */
+            std::vector<GpuVertex>().swap(mesh->vertices[level]);
+            std::vector<GLuint>().swap(mesh->indices[level]);
+        }
+
+        __sync_bool_compare_and_swap(&mesh->state, MESH_LOADED, MESH_READY);
+        uploadCount++;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return uploadCount;
+} /* MeshCache::Upload() */
+
+/**
+ * Returns the number of meshes in the cache
+ * @return - The number of distinct meshes the models share
+ */
+int MeshCache::GetMeshCount() const
+{
+    pthread_mutex_lock(&mutex);
+    int count = static_cast<int>(meshes.size());
+    pthread_mutex_unlock(&mutex);
+
+    return count;
+} /* MeshCache::GetMeshCount() */
+
+/**
+ * Returns the number of models sharing the cached meshes
+ * @return - The sum of the meshes' reference counts
+ */
+int MeshCache::GetReferenceCount() const
+{
+    int count = 0;
+
+    pthread_mutex_lock(&mutex);
+    for (std::map<Key, MeshAsset*>::const_iterator itr = meshes.begin(); itr != meshes.end();
+            itr++)
+    {
+        count += itr->second->references;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return count;
+} /* MeshCache::GetReferenceCount() */
+
+/**
+ * Sums how the full detail triangles of the meshes which have loaded use the post-transform
+ * vertex cache, both in their files' order and once optimized
+ * @param original - Returned with the statistics in the files' order
+ * @param optimized - Returned with the statistics in the optimized order
+ */
+void MeshCache::GetVertexCacheStats(VertexCacheStats& original, VertexCacheStats& optimized) const
+{
+    VertexCacheStats none = {0, 0, 0};
+    original = none;
+    optimized = none;
+
+    pthread_mutex_lock(&mutex);
+    for (std::map<Key, MeshAsset*>::const_iterator itr = meshes.begin(); itr != meshes.end();
+            itr++)
+    {
+        const MeshAsset* mesh = itr->second;
+        if (MESH_LOADING == GetState(mesh))
+        {
+            continue;
+        }
+
+        original.triangleCount += mesh->originalCacheStats.triangleCount;
+        original.vertexCount += mesh->originalCacheStats.vertexCount;
+        original.transformCount += mesh->originalCacheStats.transformCount;
+        optimized.triangleCount += mesh->optimizedCacheStats.triangleCount;
+        optimized.vertexCount += mesh->optimizedCacheStats.vertexCount;
+        optimized.transformCount += mesh->optimizedCacheStats.transformCount;
+    }
+    pthread_mutex_unlock(&mutex);
+} /* MeshCache::GetVertexCacheStats() */
+
+/**
+ * Sums how many vertices welding the meshes which have loaded merged
+ * @param stats - Returned with the sums of the meshes' weld statistics
+ */
+void MeshCache::GetWeldStats(WeldStats& stats) const
+{
+    WeldStats none = {0, 0, 0};
+    stats = none;
+
+    pthread_mutex_lock(&mutex);
+    for (std::map<Key, MeshAsset*>::const_iterator itr = meshes.begin(); itr != meshes.end();
+            itr++)
+    {
+        const MeshAsset* mesh = itr->second;
+        if (MESH_LOADING == GetState(mesh))
+        {
+            continue;
+        }
+
+        stats.originalVertexCount += mesh->weldStats.originalVertexCount;
+        stats.weldedVertexCount += mesh->weldStats.weldedVertexCount;
+        stats.removedFaceCount += mesh->weldStats.removedFaceCount;
+    }
+    pthread_mutex_unlock(&mutex);
+} /* MeshCache::GetWeldStats() */
+
+/**
+ * Returns the size of the triangle hierarchies of the meshes which have finished loading
+ * @param nodeCount - Returned with the total number of nodes
+ * @param byteCount - Returned with the total memory the hierarchies take up
+ */
+void MeshCache::GetBvhStats(long& nodeCount, long& byteCount) const
+{
+    nodeCount = 0;
+    byteCount = 0;
+
+    pthread_mutex_lock(&mutex);
+    for (std::map<Key, MeshAsset*>::const_iterator itr = meshes.begin(); itr != meshes.end();
+            itr++)
+    {
+        const MeshAsset* mesh = itr->second;
+        if (MESH_LOADING == GetState(mesh))
+        {
+            continue;
+        }
+
+        nodeCount += mesh->bvh.GetNodeCount();
+        byteCount += static_cast<long>(mesh->bvh.GetByteCount());
+    }
+    pthread_mutex_unlock(&mutex);
+} /* MeshCache::GetBvhStats() */
+
+/**
+ * Sets the distance within which the vertices of the meshes loaded from now on are welded
+ * Must be called before the models which load the meshes are inserted
+ * @param epsilon - The distance relative to each mesh's radius; 0 only welds exact duplicates
+ */
+void MeshCache::SetWeldEpsilon(double epsilon)
+{
+    weldEpsilon = epsilon;
+} /* MeshCache::SetWeldEpsilon() */
+
+/**
+ * Sets how the faces around each vertex weight its normal in the meshes loaded from now on
+ * Must be called before the models which load the meshes are inserted
+ * @param weighting - The weighting
+ */
+void MeshCache::SetNormalWeighting(NormalWeighting weighting)
+{
+    normalWeighting = weighting;
+} /* MeshCache::SetNormalWeighting() */
+
+/**
+ * Resolves a filename into a canonical path, so that every way of naming a file finds the
+ * same mesh
+ * @param filename - The name of the file
+ * @return - The absolute path without symbolic links, or the filename if it cannot be resolved
+ */
+std::string MeshCache::GetCanonicalPath(const char* filename)
+{
+    char path[PATH_MAX];
+
+    return NULL == realpath(filename, path) ? std::string(filename) : std::string(path);
+} /* MeshCache::GetCanonicalPath() */
+
+/**
+ * Returns the hash of a file's contents, only reading the file again if its size or
+ * modification time changed since it was last hashed, so that inserting many models of the
+ * same file does not read it over and over
+ * @param path - The canonical path of the file
+ * @return - The hash of the file's contents
+ */
+uint64_t MeshCache::GetFileHash(const std::string& path)
+{
+    struct stat status;
+    if (0 != stat(path.c_str(), &status))
+    {
+        return HashFile(path);
+    }
+
+    pthread_mutex_lock(&mutex);
+    std::map<std::string, FileStamp>::const_iterator itr = fileStamps.find(path);
+    if (fileStamps.end() != itr && status.st_size == itr->second.size
+            && status.st_mtime == itr->second.modified)
+    {
+        uint64_t hash = itr->second.hash;
+        pthread_mutex_unlock(&mutex);
+        return hash;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    /* Hash outside the lock, so the other files are hashed at the same time */
+    FileStamp stamp;
+    stamp.size = status.st_size;
+    stamp.modified = status.st_mtime;
+    stamp.hash = HashFile(path);
+
+    pthread_mutex_lock(&mutex);
+    fileStamps[path] = stamp;
+    pthread_mutex_unlock(&mutex);
+
+    return stamp.hash;
+} /* MeshCache::GetFileHash() */
+
+/**
+ * Hashes a file's contents with 64-bit FNV-1a, so that a file which changed on disk is not
+ * mistaken for the mesh loaded from it before
+ * @param path - The path of the file
+ * @return - The hash, or the hash of no bytes if the file cannot be read
+ */
+uint64_t MeshCache::HashFile(const std::string& path)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (NULL == file)
+    {
+        return hash;
+    }
+
+    unsigned char buffer[65536];
+    size_t size;
+    while (0 < (size = fread(buffer, 1, sizeof(buffer), file)))
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ buffer[i]) * FNV_PRIME;
+        }
+    }
+
+    fclose(file);
+
+    return hash;
+} /* MeshCache::HashFile() */
@@ -0,0 +1,126 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshCache.h
+ *
+ * A C++ module implementing a cache of the meshes loaded
+ * from PLY files, keyed by canonical path and content hash,
+ * so that every model loaded from the same file shares one
+ * reference-counted, immutable copy of its triangles.
+ */
+
+#ifndef MESHCACHE_H_
+#define MESHCACHE_H_
+
+#include <map>
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+#include "FaceList.h"
+#include "GLStateCache.h"
+#include "GpuMesh.h"
+#include "JobSystem.h"
+#include "MeshBvh.h"
+#include "MeshOptimizer.h"
+#include "MeshWelder.h"
+
+/* The number of levels of detail each mesh is drawn at, the full detail triangles first */
+#define MESH_LOD_COUNT 4
+
+/* The distance within which a mesh's vertices are welded, relative to its radius, by default
+ * and at most
+ */
+#define MESH_DEFAULT_WELD_EPSILON 1e-6
+#define MESH_MAX_WELD_EPSILON 0.01
+
+/* How far a mesh has got from its file to the GPU */
+enum MeshState
+{
+    MESH_LOADING,   /* the file is being read and preprocessed */
+    MESH_LOADED,    /* the triangles are ready to upload into buffer objects */
+    MESH_READY      /* the triangles are uploaded, so the mesh can be drawn */
+}; /* MeshState enum */
+
+/* A PLY file's triangles, shared by every model loaded from it; nothing changes them once
+ * they are loaded
+ */
+struct MeshAsset
+{
+    std::string path;                   /* the canonical path of the file */
+    uint64_t hash;                      /* the hash of the file's contents */
+    int id;                             /* the mesh's index among the meshes ever cached */
+    int references;                     /* the number of models sharing the mesh */
+    volatile int state;                 /* the mesh's MeshState */
+    FaceList* faceList;                 /* the triangles, centered on their bounding sphere */
+    WeldStats weldStats;                /* how many of the file's vertices were duplicates */
+    float bounds[6];                    /* the box around the triangles, minimum x, y, z then
+                                         * maximum x, y, z */
+    float axisRadius;                   /* the farthest any vertex lies from the y axis */
+    MeshBvh bvh;                        /* the hierarchy over the full detail triangles which
+                                         * rays are cast against */
+    std::vector<GpuVertex> vertices[MESH_LOD_COUNT]; /* each level's vertices waiting to be
+                                                      * uploaded */
+    std::vector<GLuint> indices[MESH_LOD_COUNT];    /* each level's indices waiting to be
+                                                     * uploaded */
+    GpuMesh gpuMeshes[MESH_LOD_COUNT];  /* each level's triangles in buffer objects, finest
+                                         * first */
+    VertexCacheStats originalCacheStats; /* how the full detail triangles used the vertex cache
+                                          * in the file's order */
+    VertexCacheStats optimizedCacheStats; /* how they use it once reordered */
+}; /* MeshAsset struct */
+
+class MeshCache
+{
+public:
+    /* Default constructor */
+    MeshCache();
+
+    /* Destructor */
+    ~MeshCache();
+
+    /* Member functions */
+    MeshAsset* Acquire(const char* filename, JobSystem* jobs);
+    void Release(MeshAsset* mesh);
+    static MeshState GetState(const MeshAsset* mesh);
+    int Upload(GLStateCache& state);
+    int GetMeshCount() const;
+    int GetReferenceCount() const;
+    void GetVertexCacheStats(VertexCacheStats& original, VertexCacheStats& optimized) const;
+    void GetWeldStats(WeldStats& stats) const;
+    void GetBvhStats(long& nodeCount, long& byteCount) const;
+    void SetWeldEpsilon(double epsilon);
+    void SetNormalWeighting(NormalWeighting weighting);
+
+private:
+    /* The key of a mesh: its file's canonical path and content hash */
+    typedef std::pair<std::string, uint64_t> Key;
+
+    /* A file's hash along with what identifies the contents it was computed from */
+    struct FileStamp
+    {
+        off_t size;                     /* the file's size in bytes */
+        time_t modified;                /* the file's modification time */
+        uint64_t hash;                  /* the hash of the file's contents */
+    }; /* FileStamp struct */
+
+    /* Private helper functions */
+    static std::string GetCanonicalPath(const char* filename);
+    uint64_t GetFileHash(const std::string& path);
+    static uint64_t HashFile(const std::string& path);
+
+    /* Private data members */
+    std::map<Key, MeshAsset*> meshes;   /* the cached meshes */
+    std::map<std::string, FileStamp> fileStamps; /* the hashes of the files seen so far */
+    int nextId;                         /* the id of the next mesh cached */
+    double weldEpsilon;                 /* the distance within which vertices are welded */
+    NormalWeighting normalWeighting;    /* how the faces around a vertex weight its normal */
+    mutable pthread_mutex_t mutex;      /* guards the maps and the reference counts */
+}; /* MeshCache class */
+
+#endif /* MESHCACHE_H_ */
@@ -0,0 +1,521 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshNormals.cpp
+ *
+ * A C++ module implementing the generation of a face list's
+ * face and vertex normals in parallel: the face normals two
+ * at a time with SSE2 over the positions laid out by axis,
+ * then each vertex's normal gathered from the faces around
+ * it, weighted evenly, by area or by angle.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "MeshNormals.h"
+
+/* The most vertices or faces in one job's range */
+#define NORMALS_GRAIN 4096
+
+/* The coefficients of atan(a) / a in a * a after Abramowitz and Stegun 4.4.49, which is within
+ * 2e-8 of exact for a from 0 to 1
+ */
+#define ATAN_C2 -0.3333314528
+#define ATAN_C4 0.1999355085
+#define ATAN_C6 -0.1420889944
+#define ATAN_C8 0.1065626393
+#define ATAN_C10 -0.0752896400
+#define ATAN_C12 0.0429096138
+#define ATAN_C14 -0.0161657367
+#define ATAN_C16 0.0028662257
+
+/* What the jobs which find a face list's normals share */
+struct NormalBatch
+{
+    FaceList* faceList;                 /* the triangles whose normals are found */
+    NormalWeighting weighting;          /* how the faces around a vertex are weighted */
+    std::vector<double> xs;             /* each vertex's x coordinate */
+    std::vector<double> ys;             /* each vertex's y coordinate */
+    std::vector<double> zs;             /* each vertex's z coordinate */
+    std::vector<double> cornerWeights;  /* each face's weight at each of its 3 corners */
+    std::vector<int> cornerStarts;      /* where each vertex's corners start */
+    std::vector<int> vertexCorners;     /* the corners at each vertex in the order of the faces */
+}; /* NormalBatch struct */
+
+/**
+ * Copies a range of vertices' positions into an array per axis, so the face normals load
+ * their corners' coordinates from three compact arrays rather than a row per vertex
+ * @param batch - The normals' shared state
+ * @param begin - The index of the first vertex
+ * @param end - One past the index of the last vertex
+ */
+static void gatherPositions(void* batch, size_t begin, size_t end)
+{
+    NormalBatch* normals = static_cast<NormalBatch*>(batch);
+    double** vertices = normals->faceList->vertices;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        normals->xs[i] = vertices[i][0];
+        normals->ys[i] = vertices[i][1];
+        normals->zs[i] = vertices[i][2];
+    }
+} /* gatherPositions() */
+
+/**
+ * Finds the angle of a triangle's corner from the length of the cross product of its edges and
+ * their dot product, as atan2() would but within 2e-8 of it
+ * This is the scalar lane of cornerAngles(), and gives the same bits as its SSE2 lanes
+ * @param length - The length of the cross product, which is never negative
+ * @param dot - The dot product
+ * @return - The angle in radians, from 0 to pi
+ */
+static double cornerAngle(double length, double dot)
+{
+    double absDot = fabs(dot);
+    bool isSteep = absDot < length;
+    double low = isSteep ? absDot : length;
+    double high = isSteep ? length : absDot;
+    double a = 0.0 < high ? low / high : 0.0;
+    double s = a * a;
+    double p = ATAN_C16;
+    p = p * s + ATAN_C14;
+    p = p * s + ATAN_C12;
+    p = p * s + ATAN_C10;
+    p = p * s + ATAN_C8;
+    p = p * s + ATAN_C6;
+    p = p * s + ATAN_C4;
+    p = p * s + ATAN_C2;
+    p = p * s + 1.0;
+    double angle = p * a;
+
+    /* Reflect the angle out of the first octant */
+    angle = isSteep ? M_PI_2 - angle : angle;
+    return 0.0 > dot ? M_PI - angle : angle;
+} /* cornerAngle() */
+
+#ifdef __SSE2__
+/**
+ * Finds the angles of two triangles' corners, as cornerAngle() does for one
+ * @param length - The lengths of the cross products of the corners' edges
+ * @param dot - The dot products of the corners' edges
+ * @return - The angles in radians
+ */
+static __m128d cornerAngles(__m128d length, __m128d dot)
+{
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    const __m128d zero = _mm_setzero_pd();
+
+    __m128d absDot = _mm_andnot_pd(signMask, dot);
+    __m128d isSteep = _mm_cmplt_pd(absDot, length);
+    __m128d low = _mm_or_pd(_mm_and_pd(isSteep, absDot), _mm_andnot_pd(isSteep, length));
+    __m128d high = _mm_or_pd(_mm_and_pd(isSteep, length), _mm_andnot_pd(isSteep, absDot));
+    __m128d a = _mm_and_pd(_mm_cmplt_pd(zero, high), _mm_div_pd(low, high));
+    __m128d s = _mm_mul_pd(a, a);
+    __m128d p = _mm_set1_pd(ATAN_C16);
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C14));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C12));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C10));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C8));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C6));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C4));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C2));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(1.0));
+    __m128d angle = _mm_mul_pd(p, a);
+
+    /* Reflect the angles out of the first octant */
+    angle = _mm_or_pd(_mm_and_pd(isSteep, _mm_sub_pd(_mm_set1_pd(M_PI_2), angle)),
+            _mm_andnot_pd(isSteep, angle));
+    __m128d isObtuse = _mm_cmplt_pd(dot, zero);
+    return _mm_or_pd(_mm_and_pd(isObtuse, _mm_sub_pd(_mm_set1_pd(M_PI), angle)),
+            _mm_andnot_pd(isObtuse, angle));
+} /* cornerAngles() */
+#endif
+
+/**
+ * Finds a face's unit normal and its weights at its corners, reading the positions from the
+ * face list's rows
+ * This is the scalar lane of findFaceNormals(), and gives the same bits as the SSE2 lanes
+ * @param faceList - The triangles
+ * @param weighting - How the faces around a vertex are weighted
+ * @param f - The index of the face
+ * @param weights - Returned with the face's weights at its 3 corners, or NULL if uniform
+ */
+static void findFaceNormal(FaceList* faceList, NormalWeighting weighting, size_t f,
+        double* weights)
+{
+    const int* face = faceList->faces[f];
+    const double* a = faceList->vertices[face[0]];
+    const double* b = faceList->vertices[face[1]];
+    const double* c = faceList->vertices[face[2]];
+
+    double ux = b[0] - a[0];
+    double uy = b[1] - a[1];
+    double uz = b[2] - a[2];
+    double vx = c[0] - a[0];
+    double vy = c[1] - a[1];
+    double vz = c[2] - a[2];
+    double nx = uy * vz - uz * vy;
+    double ny = uz * vx - ux * vz;
+    double nz = ux * vy - uy * vx;
+
+    /* The cross product's length is twice the face's area */
+    double length = sqrt(nx * nx + ny * ny + nz * nz);
+    double scale = 0.0 < length ? 1.0 / length : 0.0;
+    double* n = faceList->f_normals[f];
+    n[0] = nx * scale;
+    n[1] = ny * scale;
+    n[2] = nz * scale;
+
+    if (NORMALS_BY_AREA == weighting)
+    {
+        weights[0] = length;
+        weights[1] = length;
+        weights[2] = length;
+    }
+    else if (NORMALS_BY_ANGLE == weighting)
+    {
+        /* Every corner's edges span the same cross product, so only their dot products
+         * differ
+         */
+        double wx = vx - ux;
+        double wy = vy - uy;
+        double wz = vz - uz;
+        weights[0] = cornerAngle(length, ux * vx + uy * vy + uz * vz);
+        weights[1] = cornerAngle(length, -(ux * wx + uy * wy + uz * wz));
+        weights[2] = cornerAngle(length, vx * wx + vy * wy + vz * wz);
+    }
+} /* findFaceNormal() */
+
+/**
+ * Finds the unit normals of a range of faces and their weights at their corners, two faces
+ * at a time where SSE2 is available
+ * @param batch - The normals' shared state
+ * @param begin - The index of the first face
+ * @param end - One past the index of the last face
+ */
+static void findFaceNormals(void* batch, size_t begin, size_t end)
+{
+    NormalBatch* normals = static_cast<NormalBatch*>(batch);
+    size_t f = begin;
+
+#ifdef __SSE2__
+    int** faces = normals->faceList->faces;
+    const double* xs = &normals->xs[0];
+    const double* ys = &normals->ys[0];
+    const double* zs = &normals->zs[0];
+    double** faceNormals = normals->faceList->f_normals;
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+
+    for (; f + 2 <= end; f += 2)
+    {
+        const int* p = faces[f];
+        const int* q = faces[f + 1];
+
+        /* Each register holds the first face in its low lane and the second in its high */
+        __m128d ax = _mm_set_pd(xs[q[0]], xs[p[0]]);
+        __m128d ay = _mm_set_pd(ys[q[0]], ys[p[0]]);
+        __m128d az = _mm_set_pd(zs[q[0]], zs[p[0]]);
+        __m128d ux = _mm_sub_pd(_mm_set_pd(xs[q[1]], xs[p[1]]), ax);
+        __m128d uy = _mm_sub_pd(_mm_set_pd(ys[q[1]], ys[p[1]]), ay);
+        __m128d uz = _mm_sub_pd(_mm_set_pd(zs[q[1]], zs[p[1]]), az);
+        __m128d vx = _mm_sub_pd(_mm_set_pd(xs[q[2]], xs[p[2]]), ax);
+        __m128d vy = _mm_sub_pd(_mm_set_pd(ys[q[2]], ys[p[2]]), ay);
+        __m128d vz = _mm_sub_pd(_mm_set_pd(zs[q[2]], zs[p[2]]), az);
+        __m128d nx = _mm_sub_pd(_mm_mul_pd(uy, vz), _mm_mul_pd(uz, vy));
+        __m128d ny = _mm_sub_pd(_mm_mul_pd(uz, vx), _mm_mul_pd(ux, vz));
+        __m128d nz = _mm_sub_pd(_mm_mul_pd(ux, vy), _mm_mul_pd(uy, vx));
+
+        __m128d length = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, nx),
+                _mm_mul_pd(ny, ny)), _mm_mul_pd(nz, nz)));
+        __m128d scale = _mm_and_pd(_mm_cmplt_pd(zero, length), _mm_div_pd(one, length));
+        nx = _mm_mul_pd(nx, scale);
+        ny = _mm_mul_pd(ny, scale);
+        nz = _mm_mul_pd(nz, scale);
+
+        /* Transpose the lanes back into a normal per face */
+        _mm_storeu_pd(faceNormals[f], _mm_unpacklo_pd(nx, ny));
+        _mm_store_sd(faceNormals[f] + 2, nz);
+        _mm_storeu_pd(faceNormals[f + 1], _mm_unpackhi_pd(nx, ny));
+        _mm_storeh_pd(faceNormals[f + 1] + 2, nz);
+
+        double* weights = NORMALS_UNIFORM != normals->weighting
+                ? &normals->cornerWeights[3 * f] : NULL;
+        if (NORMALS_BY_AREA == normals->weighting)
+        {
+            _mm_storeu_pd(weights, _mm_unpacklo_pd(length, length));
+            _mm_storeu_pd(weights + 2, length);
+            _mm_storeu_pd(weights + 4, _mm_unpackhi_pd(length, length));
+        }
+        else if (NORMALS_BY_ANGLE == normals->weighting)
+        {
+            __m128d wx = _mm_sub_pd(vx, ux);
+            __m128d wy = _mm_sub_pd(vy, uy);
+            __m128d wz = _mm_sub_pd(vz, uz);
+            __m128d a = cornerAngles(length, _mm_add_pd(_mm_add_pd(_mm_mul_pd(ux, vx),
+                    _mm_mul_pd(uy, vy)), _mm_mul_pd(uz, vz)));
+            __m128d b = cornerAngles(length, _mm_xor_pd(signMask, _mm_add_pd(_mm_add_pd(
+                    _mm_mul_pd(ux, wx), _mm_mul_pd(uy, wy)), _mm_mul_pd(uz, wz))));
+            __m128d c = cornerAngles(length, _mm_add_pd(_mm_add_pd(_mm_mul_pd(vx, wx),
+                    _mm_mul_pd(vy, wy)), _mm_mul_pd(vz, wz)));
+            _mm_storeu_pd(weights, _mm_unpacklo_pd(a, b));
+            _mm_storeu_pd(weights + 2, _mm_unpacklo_pd(c, _mm_unpackhi_pd(a, a)));
+            _mm_storeu_pd(weights + 4, _mm_unpackhi_pd(b, c));
+        }
+    }
+#endif
+
+    for (; f < end; f++)
+    {
+        findFaceNormal(normals->faceList, normals->weighting, f,
+                NORMALS_UNIFORM != normals->weighting ? &normals->cornerWeights[3 * f] : NULL);
+    }
+} /* findFaceNormals() */
+
+/**
+ * Stores a vertex's summed normal scaled to unit length, or a zero normal if the sum is zero
+ * @param faceList - The triangles
+ * @param i - The index of the vertex
+ * @param n - The sum of the weighted normals of the faces around the vertex
+ */
+static void storeVertexNormal(FaceList* faceList, size_t i, const double n[3])
+{
+    double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    double scale = 0.0 < length ? 1.0 / length : 0.0;
+    double* vertexNormal = faceList->v_normals[i];
+    for (int j = 0; j < 3; j++)
+    {
+        vertexNormal[j] = n[j] * scale;
+    }
+} /* storeVertexNormal() */
+
+/**
+ * Counts the corners at each vertex of a range of faces into the start of the next vertex
+ * @param batch - The normals' shared state
+ * @param begin - The index of the first face
+ * @param end - One past the index of the last face
+ */
+static void countCorners(void* batch, size_t begin, size_t end)
+{
+    NormalBatch* normals = static_cast<NormalBatch*>(batch);
+    int** faces = normals->faceList->faces;
+    int* starts = &normals->cornerStarts[0];
+
+    for (size_t f = begin; f < end; f++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            __sync_fetch_and_add(&starts[faces[f][j] + 1], 1);
+        }
+    }
+} /* countCorners() */
+
+/**
+ * Lists the corners of a range of faces at their vertices, advancing each vertex's start past
+ * the corners listed, so the jobs list each vertex's corners in no particular order
+ * @param batch - The normals' shared state
+ * @param begin - The index of the first face
+ * @param end - One past the index of the last face
+ */
+static void listCorners(void* batch, size_t begin, size_t end)
+{
+    NormalBatch* normals = static_cast<NormalBatch*>(batch);
+    int** faces = normals->faceList->faces;
+    int* starts = &normals->cornerStarts[0];
+
+    for (size_t f = begin; f < end; f++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            int slot = __sync_fetch_and_add(&starts[faces[f][j]], 1);
+            normals->vertexCorners[slot] = static_cast<int>(3 * f + j);
+        }
+    }
+} /* listCorners() */
+
+/**
+ * Sums the weighted normals of the faces around each of a range of vertices into its unit
+ * normal, gathering them so that no two jobs write the same vertex
+ * @param batch - The normals' shared state
+ * @param begin - The index of the first vertex
+ * @param end - One past the index of the last vertex
+ */
+static void sumVertexNormals(void* batch, size_t begin, size_t end)
+{
+    NormalBatch* normals = static_cast<NormalBatch*>(batch);
+    bool isWeighted = NORMALS_UNIFORM != normals->weighting;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        /* Sort the vertex's few corners into the order of their faces, which the jobs that
+         * listed them in parallel did not keep, so the sum is the same every time
+         */
+        int* first = &normals->vertexCorners[0] + normals->cornerStarts[i];
+        int* last = &normals->vertexCorners[0] + normals->cornerStarts[i + 1];
+        for (int* k = first + 1; k < last; k++)
+        {
+            int corner = *k;
+            int* j = k;
+            for (; j > first && *(j - 1) > corner; j--)
+            {
+                *j = *(j - 1);
+            }
+            *j = corner;
+        }
+
+        double n[3] = {0.0, 0.0, 0.0};
+        for (int k = normals->cornerStarts[i]; k < normals->cornerStarts[i + 1]; k++)
+        {
+            int corner = normals->vertexCorners[k];
+            const double* faceNormal = normals->faceList->f_normals[corner / 3];
+            double weight = isWeighted ? normals->cornerWeights[corner] : 1.0;
+            for (int j = 0; j < 3; j++)
+            {
+                n[j] += faceNormal[j] * weight;
+            }
+        }
+        storeVertexNormal(normals->faceList, i, n);
+    }
+} /* sumVertexNormals() */
+
+/**
+ * Finds the unit normal of every face of a face list and the smooth unit normal of every
+ * vertex from the faces around it, replacing any normals it held; a vertex whose faces'
+ * normals cancel out, or which no face uses, gets a zero normal
+ * On one thread each face's normal is found from the face list's rows and scattered into its
+ * vertices' sums at once; with more than one worker, the positions are copied into an array
+ * per axis, the face normals are found in parallel, and the corners at each vertex are then
+ * listed so the vertices gather their sums in parallel without two jobs ever writing the same
+ * vertex; either way every vertex sums its faces in their order in the list, so the normals do
+ * not depend on the number of workers
+ * @param faceList - The triangles
+ * @param weighting - How much each face around a vertex counts toward its normal
+ * @param jobs - The job system which finds the normals in parallel, or NULL
+ */
+void MeshNormals::Generate(FaceList* faceList, NormalWeighting weighting, JobSystem* jobs)
+{
+    size_t vertexCount = static_cast<size_t>(faceList->vc);
+    size_t faceCount = static_cast<size_t>(faceList->fc);
+    if (0 == faceCount)
+    {
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            memset(faceList->v_normals[i], 0, 3 * sizeof(double));
+        }
+        return;
+    }
+
+    /* On one thread, copying the positions out costs more than the paired faces save, so each
+     * face is found from the rows and scattered into its vertices' sums in order
+     */
+    if (NULL == jobs || jobs->IsDeterministic() || 1 >= jobs->GetWorkerCount())
+    {
+        double weights[3] = {1.0, 1.0, 1.0};
+        double* faceWeights = NORMALS_UNIFORM != weighting ? weights : NULL;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            memset(faceList->v_normals[i], 0, 3 * sizeof(double));
+        }
+        for (size_t f = 0; f < faceCount; f++)
+        {
+            findFaceNormal(faceList, weighting, f, faceWeights);
+            const double* faceNormal = faceList->f_normals[f];
+            for (int j = 0; j < 3; j++)
+            {
+                double* n = faceList->v_normals[faceList->faces[f][j]];
+                for (int k = 0; k < 3; k++)
+                {
+                    n[k] += faceNormal[k] * weights[j];
+                }
+            }
+        }
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            storeVertexNormal(faceList, i, faceList->v_normals[i]);
+        }
+        return;
+    }
+
+    NormalBatch batch;
+    batch.faceList = faceList;
+    batch.weighting = weighting;
+    batch.xs.resize(vertexCount);
+    batch.ys.resize(vertexCount);
+    batch.zs.resize(vertexCount);
+    if (NORMALS_UNIFORM != weighting)
+    {
+        batch.cornerWeights.resize(3 * faceCount);
+    }
+    JobSystem::ParallelFor(jobs, vertexCount, NORMALS_GRAIN, gatherPositions, &batch);
+    JobSystem::ParallelFor(jobs, faceCount, NORMALS_GRAIN, findFaceNormals, &batch);
+
+    /* Otherwise count the corners at each vertex into the start of the next, then list each
+     * vertex's corners by advancing its start, which leaves each start where the next began
+     */
+    batch.cornerStarts.assign(vertexCount + 1, 0);
+    batch.vertexCorners.resize(3 * faceCount);
+    JobSystem::ParallelFor(jobs, faceCount, NORMALS_GRAIN, countCorners, &batch);
+    int* starts = &batch.cornerStarts[0];
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        starts[i + 1] += starts[i];
+    }
+    JobSystem::ParallelFor(jobs, faceCount, NORMALS_GRAIN, listCorners, &batch);
+    for (size_t i = vertexCount; i > 0; i--)
+    {
+        starts[i] = starts[i - 1];
+    }
+    starts[0] = 0;
+    JobSystem::ParallelFor(jobs, vertexCount, NORMALS_GRAIN, sumVertexNormals, &batch);
+} /* MeshNormals::Generate() */
+
+/**
+ * Parses the name of a weighting
+ * @param name - uniform, area or angle
+ * @param weighting - Returned with the weighting named
+ * @return - True if the name is one of the weightings
+ */
+bool MeshNormals::Parse(const char* name, NormalWeighting& weighting)
+{
+    static const NormalWeighting weightings[] = {NORMALS_UNIFORM, NORMALS_BY_AREA,
+            NORMALS_BY_ANGLE};
+
+    for (size_t i = 0; i < sizeof(weightings) / sizeof(weightings[0]); i++)
+    {
+        if (0 == strcmp(name, GetName(weightings[i])))
+        {
+            weighting = weightings[i];
+            return true;
+        }
+    }
+
+    return false;
+} /* MeshNormals::Parse() */
+
+/**
+ * Returns the name of a weighting, as Parse() reads it
+ * @param weighting - The weighting
+ * @return - uniform, area or angle
+ */
+const char* MeshNormals::GetName(NormalWeighting weighting)
+{
+    switch (weighting)
+    {
+    case NORMALS_BY_AREA:
+        return "area";
+    case NORMALS_BY_ANGLE:
+        return "angle";
+    default:
+        return "uniform";
+    }
+} /* MeshNormals::GetName() */
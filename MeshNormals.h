@@ -0,0 +1,38 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshNormals.h
+ *
+ * A C++ module implementing the generation of a face list's
+ * face and vertex normals in parallel: the face normals two
+ * at a time with SSE2 over the positions laid out by axis,
+ * then each vertex's normal gathered from the faces around
+ * it, weighted evenly, by area or by angle.
+ */
+
+#ifndef MESHNORMALS_H_
+#define MESHNORMALS_H_
+
+#include "FaceList.h"
+#include "JobSystem.h"
+
+/* How much each face around a vertex counts toward the vertex's normal */
+enum NormalWeighting
+{
+    NORMALS_UNIFORM,    /* every face counts the same */
+    NORMALS_BY_AREA,    /* each face counts by its area */
+    NORMALS_BY_ANGLE    /* each face counts by its angle at the vertex */
+}; /* NormalWeighting enum */
+
+class MeshNormals
+{
+public:
+    /* Static member functions */
+    static void Generate(FaceList* faceList, NormalWeighting weighting, JobSystem* jobs);
+    static bool Parse(const char* name, NormalWeighting& weighting);
+    static const char* GetName(NormalWeighting weighting);
+}; /* MeshNormals class */
+
+#endif /* MESHNORMALS_H_ */
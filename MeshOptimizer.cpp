@@ -0,0 +1,297 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshOptimizer.cpp
+ *
+ * A C++ module implementing the load time optimizations of
+ * a mesh's buffers: reordering the triangles for the GPU's
+ * post-transform vertex cache after Forsyth, then numbering
+ * the vertices in the order the triangles first use them so
+ * that fetching them walks the vertex buffer forward.
+ */
+
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+/* The weights of Forsyth's vertex score: the vertices of the last triangle drawn score a
+ * fixed amount, the rest of the cache decays toward its end, and vertices with few triangles
+ * left are boosted so that no lone triangles are left behind
+ */
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+/**
+ * Scores how much drawing a vertex's triangles next would reuse the cache
+ * @param cachePosition - The vertex's position in the cache, or -1 if it is not in it
+ * @param valence - The number of the vertex's triangles not drawn yet
+ * @return - The vertex's score, or -1 if it has no triangles left
+ */
+static float scoreVertex(int cachePosition, int valence)
+{
+    if (0 == valence)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (0 <= cachePosition && 3 > cachePosition)
+    {
+        score = FORSYTH_LAST_TRIANGLE_SCORE;
+    }
+    else if (0 <= cachePosition)
+    {
+        float scale = 1.0f / (MESH_OPTIMIZER_CACHE_SIZE - 3);
+        score = powf(1.0f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+    }
+
+    return score + FORSYTH_VALENCE_BOOST_SCALE
+            * powf(static_cast<float>(valence), -FORSYTH_VALENCE_BOOST_POWER);
+} /* scoreVertex() */
+
+/**
+ * Reorders the triangles so that each one reuses as many of the vertices the GPU has just
+ * transformed as it can, by Forsyth's linear-speed greedy algorithm: it simulates a least
+ * recently used cache and always draws the triangle whose vertices score the highest
+ * @param indices - The three indices of each triangle, returned in the new order
+ * @param vertexCount - The number of vertices the indices refer to
+ */
+void MeshOptimizer::OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (0 == triangleCount)
+    {
+        return;
+    }
+
+    /* List each vertex's triangles; the first valences[v] of them are the ones left */
+    std::vector<int> valences(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        valences[indices[i]]++;
+    }
+
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + valences[v];
+    }
+
+    std::vector<int> triangles(indices.size());
+    std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        triangles[cursors[indices[i]]++] = static_cast<int>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = scoreVertex(-1, valences[v]);
+    }
+
+    int best = 0;
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]]
+                + vertexScores[indices[3 * t + 2]];
+        if (triangleScores[t] > triangleScores[best])
+        {
+            best = static_cast<int>(t);
+        }
+    }
+
+    std::vector<char> isDrawn(triangleCount, 0);
+    std::vector<GLuint> ordered;
+    ordered.reserve(indices.size());
+    int cache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t nextUndrawn = 0;
+
+    for (size_t drawnCount = 0; drawnCount < triangleCount; drawnCount++)
+    {
+        /* When no triangle touches the cache, start again from any triangle left */
+        if (0 > best)
+        {
+            while (isDrawn[nextUndrawn])
+            {
+                nextUndrawn++;
+            }
+            best = static_cast<int>(nextUndrawn);
+        }
+
+        const GLuint* triangle = &indices[3 * best];
+        isDrawn[best] = 1;
+        ordered.insert(ordered.end(), triangle, triangle + 3);
+
+        /* Take the triangle off its vertices' lists of triangles left */
+        for (int j = 0; j < 3; j++)
+        {
+            GLuint v = triangle[j];
+            size_t last = offsets[v] + valences[v] - 1;
+            for (size_t k = offsets[v]; k <= last; k++)
+            {
+                if (best == triangles[k])
+                {
+                    triangles[k] = triangles[last];
+                    triangles[last] = best;
+                    break;
+                }
+            }
+            valences[v]--;
+        }
+
+        /* The triangle's vertices move to the front of the cache and push the rest back */
+        int newCache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            int v = static_cast<int>(triangle[j]);
+            bool isRepeated = false;
+            for (int i = 0; i < newCount; i++)
+            {
+                isRepeated = isRepeated || v == newCache[i];
+            }
+            if (!isRepeated)
+            {
+                newCache[newCount++] = v;
+            }
+        }
+        for (int i = 0; i < cacheCount; i++)
+        {
+            int v = cache[i];
+            if (v != static_cast<int>(triangle[0]) && v != static_cast<int>(triangle[1])
+                    && v != static_cast<int>(triangle[2]))
+            {
+                newCache[newCount++] = v;
+            }
+        }
+
+        /* Score the vertices which moved or fell out again, then the triangles around them,
+         * which are the candidates for the next triangle
+         */
+        for (int i = 0; i < newCount; i++)
+        {
+            int v = newCache[i];
+            cachePositions[v] = MESH_OPTIMIZER_CACHE_SIZE > i ? i : -1;
+            vertexScores[v] = scoreVertex(cachePositions[v], valences[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCount; i++)
+        {
+            int v = newCache[i];
+            for (size_t k = offsets[v]; k < offsets[v] + valences[v]; k++)
+            {
+                int t = triangles[k];
+                triangleScores[t] = vertexScores[indices[3 * t]]
+                        + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+                if (triangleScores[t] > bestScore)
+                {
+                    best = t;
+                    bestScore = triangleScores[t];
+                }
+            }
+        }
+
+        cacheCount = MESH_OPTIMIZER_CACHE_SIZE < newCount ? MESH_OPTIMIZER_CACHE_SIZE : newCount;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            cache[i] = newCache[i];
+        }
+    }
+
+    indices.swap(ordered);
+} /* MeshOptimizer::OptimizeVertexCache() */
+
+/**
+ * Numbers the vertices in the order the triangles first use them and moves them to match, so
+ * that the GPU fetches them from the vertex buffer in nearly sequential order; vertices which
+ * no triangle uses are dropped
+ * @param vertices - The vertices, returned in the new order
+ * @param indices - The three indices of each triangle, returned with the new numbers
+ */
+void MeshOptimizer::OptimizeVertexFetch(std::vector<GpuVertex>& vertices,
+        std::vector<GLuint>& indices)
+{
+    const GLuint unnumbered = ~static_cast<GLuint>(0);
+    std::vector<GLuint> numbers(vertices.size(), unnumbered);
+    std::vector<GpuVertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        GLuint& number = numbers[indices[i]];
+        if (unnumbered == number)
+        {
+            number = static_cast<GLuint>(ordered.size());
+            ordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = number;
+    }
+
+    vertices.swap(ordered);
+} /* MeshOptimizer::OptimizeVertexFetch() */
+
+/**
+ * Measures how often drawing the triangles in order would miss a first in, first out
+ * post-transform cache of MESH_ANALYZER_CACHE_SIZE vertices
+ * @param indices - The three indices of each triangle
+ * @param vertexCount - The number of vertices the indices refer to
+ * @return - The number of triangles, distinct vertices and vertex transforms
+ */
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<GLuint>& indices,
+        size_t vertexCount)
+{
+    VertexCacheStats stats = {static_cast<long>(indices.size() / 3), 0, 0};
+
+    /* A vertex is still cached unless a cache's worth of misses came after its own */
+    std::vector<long> missTimes(vertexCount, -1);
+    long time = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        long& missTime = missTimes[indices[i]];
+        if (0 > missTime)
+        {
+            stats.vertexCount++;
+        }
+        if (0 > missTime || MESH_ANALYZER_CACHE_SIZE < time - missTime)
+        {
+            missTime = time++;
+            stats.transformCount++;
+        }
+    }
+
+    return stats;
+} /* MeshOptimizer::AnalyzeVertexCache() */
+
+/**
+ * Returns the average cache miss ratio, the vertices transformed per triangle, which is 3
+ * at worst and about 0.5 at best for a large closed mesh
+ * @param stats - The statistics of an index buffer
+ * @return - The ratio, or 0 if there are no triangles
+ */
+double MeshOptimizer::GetAcmr(const VertexCacheStats& stats)
+{
+    return 0 < stats.triangleCount
+            ? static_cast<double>(stats.transformCount) / stats.triangleCount : 0.0;
+} /* MeshOptimizer::GetAcmr() */
+
+/**
+ * Returns the average transform to vertex ratio, the times each vertex is transformed, which
+ * is 1 at best
+ * @param stats - The statistics of an index buffer
+ * @return - The ratio, or 0 if there are no vertices
+ */
+double MeshOptimizer::GetAtvr(const VertexCacheStats& stats)
+{
+    return 0 < stats.vertexCount
+            ? static_cast<double>(stats.transformCount) / stats.vertexCount : 0.0;
+} /* MeshOptimizer::GetAtvr() */
@@ -0,0 +1,53 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshOptimizer.h
+ *
+ * A C++ module implementing the load time optimizations of
+ * a mesh's buffers: reordering the triangles for the GPU's
+ * post-transform vertex cache after Forsyth, then numbering
+ * the vertices in the order the triangles first use them so
+ * that fetching them walks the vertex buffer forward.
+ */
+
+#ifndef MESHOPTIMIZER_H_
+#define MESHOPTIMIZER_H_
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GpuMesh.h"
+
+/* The number of vertices in the least recently used cache the triangles are ordered for */
+#define MESH_OPTIMIZER_CACHE_SIZE 32
+
+/* The number of vertices in the first in, first out cache the orders are measured with, which
+ * is what most GPUs have
+ */
+#define MESH_ANALYZER_CACHE_SIZE 16
+
+/* How well an index buffer reuses the post-transform vertex cache */
+struct VertexCacheStats
+{
+    long triangleCount;     /* the triangles drawn */
+    long vertexCount;       /* the distinct vertices they use */
+    long transformCount;    /* the vertices the GPU transforms, one per cache miss */
+}; /* VertexCacheStats struct */
+
+class MeshOptimizer
+{
+public:
+    /* Static member functions */
+    static void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+    static void OptimizeVertexFetch(std::vector<GpuVertex>& vertices,
+            std::vector<GLuint>& indices);
+    static VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint>& indices,
+            size_t vertexCount);
+    static double GetAcmr(const VertexCacheStats& stats);
+    static double GetAtvr(const VertexCacheStats& stats);
+}; /* MeshOptimizer class */
+
+#endif /* MESHOPTIMIZER_H_ */
@@ -0,0 +1,669 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshSimplifier.cpp
+ *
+ * A C++ module implementing a mesh simplifier which
+ * collapses the edges of a face list in the order of their
+ * quadric error, after Garland and Heckbert, so that one
+ * pass yields a chain of ever coarser levels of detail.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "MeshSimplifier.h"
+
+/* How much more a boundary edge resists moving away from its line than a face from its plane */
+#define SIMPLIFIER_BOUNDARY_WEIGHT 100.0
+
+/* How small the quadric's determinant may get, relative to its diagonal, before the merged
+ * vertex is placed on the edge instead of at the quadric's minimum
+ */
+#define SIMPLIFIER_SINGULAR_EPSILON 1e-9
+
+/**
+ * Returns the error of a position under a quadric, which is the weighted sum of its squared
+ * distances from the quadric's planes
+ * @param q - The quadric's 10 unique elements
+ * @param p - The position
+ * @return - The quadric error
+ */
+static double evaluateQuadric(const double* q, const double* p)
+{
+    double x = p[0];
+    double y = p[1];
+    double z = p[2];
+
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+         + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+         + q[7] * z * z + 2.0 * q[8] * z
+         + q[9];
+} /* evaluateQuadric() */
+
+/**
+ * Finds the unnormalized normal of a triangle, whose length is twice its area
+ * @param n - Returned with the normal
+ * @param a - The triangle's first vertex
+ * @param b - The triangle's second vertex
+ * @param c - The triangle's third vertex
+ */
+static void calcTriangleNormal(double* n, const double* a, const double* b, const double* c)
+{
+    double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+} /* calcTriangleNormal() */
+
+/**
+ * Overloaded constructor builds the quadric of every vertex from the planes of the faces
+ * around it, and of the boundary edges it lies on, then queues the collapse of every edge
+ * @param faceList - The full detail triangles, which must outlive the simplifier
+ * @param weighting - How the faces around a vertex are weighted in the simplified normals
+ */
+MeshSimplifier::MeshSimplifier(const FaceList* faceList, NormalWeighting weighting)
+    : source(faceList)
+    , normalWeighting(weighting)
+    , positions(3 * faceList->vc)
+    , quadrics(10 * faceList->vc, 0.0)
+    , versions(faceList->vc, 0)
+    , isVertexRemoved(faceList->vc, 0)
+    , vertexFaces(faceList->vc)
+    , faces(3 * faceList->fc)
+    , isFaceRemoved(faceList->fc, 0)
+    , faceCount(0)
+    , marks(faceList->vc, 0)
+    , mark(0)
+{
+    for (int i = 0; i < faceList->vc; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            positions[3 * i + j] = faceList->vertices[i][j];
+        }
+    }
+
+    /* Drop the faces which have no area by their indices or repeat an earlier face */
+    std::vector<std::pair<std::pair<int, int>, std::pair<int, int> > > sortedFaces;
+    sortedFaces.reserve(faceList->fc);
+    for (int i = 0; i < faceList->fc; i++)
+    {
+        int corners[3];
+        for (int j = 0; j < 3; j++)
+        {
+            faces[3 * i + j] = faceList->faces[i][j];
+            corners[j] = faceList->faces[i][j];
+        }
+        std::sort(corners, corners + 3);
+
+        if (corners[0] == corners[1] || corners[1] == corners[2])
+        {
+            isFaceRemoved[i] = 1;
+            continue;
+        }
+        sortedFaces.push_back(std::make_pair(std::make_pair(corners[0], corners[1]),
+                std::make_pair(corners[2], i)));
+    }
+    std::sort(sortedFaces.begin(), sortedFaces.end());
+    for (size_t i = 1; i < sortedFaces.size(); i++)
+    {
+        if (sortedFaces[i - 1].first == sortedFaces[i].first
+                && sortedFaces[i - 1].second.first == sortedFaces[i].second.first)
+        {
+            isFaceRemoved[sortedFaces[i].second.second] = 1;
+        }
+    }
+
+    /* Each face adds its plane to its vertices, weighted by its area */
+    std::vector<std::pair<std::pair<int, int>, int> > edges;
+    edges.reserve(3 * faceList->fc);
+    for (int i = 0; i < faceList->fc; i++)
+    {
+        const int* face = &faces[3 * i];
+        if (isFaceRemoved[i])
+        {
+            continue;
+        }
+
+        faceCount++;
+        for (int j = 0; j < 3; j++)
+        {
+            vertexFaces[face[j]].push_back(i);
+
+            int a = face[j];
+            int b = face[(j + 1) % 3];
+            edges.push_back(std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)), i));
+        }
+
+        double normal[3];
+        calcTriangleNormal(normal, &positions[3 * face[0]], &positions[3 * face[1]],
+                &positions[3 * face[2]]);
+        double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                + normal[2] * normal[2]);
+        if (0.0 == length)
+        {
+            continue;
+        }
+
+        double plane[4];
+        for (int j = 0; j < 3; j++)
+        {
+            plane[j] = normal[j] / length;
+        }
+        plane[3] = -(plane[0] * positions[3 * face[0]] + plane[1] * positions[3 * face[0] + 1]
+                + plane[2] * positions[3 * face[0] + 2]);
+        for (int j = 0; j < 3; j++)
+        {
+            AddPlane(face[j], plane, 0.5 * length);
+        }
+    }
+
+    /* An edge which only one face uses lies on a boundary, which is kept in place by a plane
+     * through the edge perpendicular to the face
+     */
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        bool isFirst = 0 == i || edges[i - 1].first != edges[i].first;
+        bool isLast = edges.size() == i + 1 || edges[i + 1].first != edges[i].first;
+        if (!isFirst || !isLast)
+        {
+            continue;
+        }
+
+        const int* face = &faces[3 * edges[i].second];
+        const double* a = &positions[3 * edges[i].first.first];
+        const double* b = &positions[3 * edges[i].first.second];
+        double normal[3];
+        calcTriangleNormal(normal, &positions[3 * face[0]], &positions[3 * face[1]],
+                &positions[3 * face[2]]);
+
+        double edge[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double perpendicular[3] =
+        {
+            edge[1] * normal[2] - edge[2] * normal[1],
+            edge[2] * normal[0] - edge[0] * normal[2],
+            edge[0] * normal[1] - edge[1] * normal[0]
+        };
+        double length = sqrt(perpendicular[0] * perpendicular[0]
+                + perpendicular[1] * perpendicular[1] + perpendicular[2] * perpendicular[2]);
+        if (0.0 == length)
+        {
+            continue;
+        }
+
+        double plane[4];
+        for (int j = 0; j < 3; j++)
+        {
+            plane[j] = perpendicular[j] / length;
+        }
+        plane[3] = -(plane[0] * a[0] + plane[1] * a[1] + plane[2] * a[2]);
+
+        double weight = SIMPLIFIER_BOUNDARY_WEIGHT
+                * (edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]);
+        AddPlane(edges[i].first.first, plane, weight);
+        AddPlane(edges[i].first.second, plane, weight);
+    }
+
+    /* Queue the collapse of every edge once the quadrics are complete */
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        if (0 == i || edges[i - 1].first != edges[i].first)
+        {
+            PushCollapse(edges[i].first.first, edges[i].first.second);
+        }
+    }
+} /* Overloaded constructor */
+
+/**
+ * Collapses the cheapest edges until no more than a number of faces are left, then copies
+ * what is left into a new face list
+ * Successive calls continue from where the last one stopped, so each level of detail is
+ * simplified from the one before it; the collapses run out early if every edge left would
+ * fold the surface over
+ * @param targetFaceCount - The number of faces to simplify down to
+ * @return - The simplified triangles, which the caller must delete
+ */
+FaceList* MeshSimplifier::Simplify(int targetFaceCount)
+{
+    while (faceCount > targetFaceCount && !queue.empty())
+    {
+        EdgeCollapse collapse = queue.top();
+        queue.pop();
+
+        if (IsCollapseValid(collapse))
+        {
+            Collapse(collapse);
+        }
+    }
+
+    return BuildFaceList();
+} /* MeshSimplifier::Simplify() */
+
+/**
+ * Returns the number of faces left after the collapses so far
+ * @return - The number of faces
+ */
+int MeshSimplifier::GetFaceCount() const
+{
+    return faceCount;
+} /* MeshSimplifier::GetFaceCount() */
+
+/**
+ * Adds the squared distance from a plane to a vertex's quadric
+ * @param vertex - The index of the vertex
+ * @param plane - The plane's unit normal followed by its offset
+ * @param weight - How much the plane counts
+ */
+void MeshSimplifier::AddPlane(int vertex, const double plane[4], double weight)
+{
+    double* q = &quadrics[10 * vertex];
+    int k = 0;
+
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = row; column < 4; column++)
+        {
+            q[k++] += weight * plane[row] * plane[column];
+        }
+    }
+} /* MeshSimplifier::AddPlane() */
+
+/**
+ * Finds where merging the endpoints of an edge costs the least and queues the collapse
+ * The merged vertex goes to the minimum of the summed quadrics if it is well defined and
+ * near the edge; otherwise, to the cheaper endpoint or the midpoint
+ * @param a - The index of one endpoint
+ * @param b - The index of the other endpoint
+ */
+void MeshSimplifier::PushCollapse(int a, int b)
+{
+    double q[10];
+    for (int k = 0; k < 10; k++)
+    {
+        q[k] = quadrics[10 * a + k] + quadrics[10 * b + k];
+    }
+
+    const double* pa = &positions[3 * a];
+    const double* pb = &positions[3 * b];
+    double midpoint[3] = {0.5 * (pa[0] + pb[0]), 0.5 * (pa[1] + pb[1]), 0.5 * (pa[2] + pb[2])};
+    double lengthSquared = (pb[0] - pa[0]) * (pb[0] - pa[0]) + (pb[1] - pa[1]) * (pb[1] - pa[1])
+            + (pb[2] - pa[2]) * (pb[2] - pa[2]);
+
+    EdgeCollapse collapse;
+    collapse.cost = evaluateQuadric(q, midpoint);
+    for (int j = 0; j < 3; j++)
+    {
+        collapse.position[j] = midpoint[j];
+    }
+
+    /* Solve the gradient of the quadric for zero by Cramer's rule */
+    double det = q[0] * (q[4] * q[7] - q[5] * q[5]) - q[1] * (q[1] * q[7] - q[5] * q[2])
+            + q[2] * (q[1] * q[5] - q[4] * q[2]);
+    if (fabs(det) > SIMPLIFIER_SINGULAR_EPSILON * fabs(q[0] * q[4] * q[7]))
+    {
+        double optimum[3] =
+        {
+            -(q[3] * (q[4] * q[7] - q[5] * q[5]) - q[1] * (q[6] * q[7] - q[5] * q[8])
+                    + q[2] * (q[6] * q[5] - q[4] * q[8])) / det,
+            -(q[0] * (q[6] * q[7] - q[8] * q[5]) - q[3] * (q[1] * q[7] - q[5] * q[2])
+                    + q[2] * (q[1] * q[8] - q[6] * q[2])) / det,
+            -(q[0] * (q[4] * q[8] - q[5] * q[6]) - q[1] * (q[1] * q[8] - q[6] * q[2])
+                    + q[3] * (q[1] * q[5] - q[4] * q[2])) / det
+        };
+
+        /* A minimum far from the edge is too sensitive to trust */
+        double distanceSquared = (optimum[0] - midpoint[0]) * (optimum[0] - midpoint[0])
+                + (optimum[1] - midpoint[1]) * (optimum[1] - midpoint[1])
+                + (optimum[2] - midpoint[2]) * (optimum[2] - midpoint[2]);
+        double cost = evaluateQuadric(q, optimum);
+        if (distanceSquared <= lengthSquared && cost < collapse.cost)
+        {
+            collapse.cost = cost;
+            for (int j = 0; j < 3; j++)
+            {
+                collapse.position[j] = optimum[j];
+            }
+        }
+    }
+
+    double costA = evaluateQuadric(q, pa);
+    double costB = evaluateQuadric(q, pb);
+    if (costA < collapse.cost || costB < collapse.cost)
+    {
+        const double* endpoint = costA <= costB ? pa : pb;
+        collapse.cost = std::min(costA, costB);
+        for (int j = 0; j < 3; j++)
+        {
+            collapse.position[j] = endpoint[j];
+        }
+    }
+
+    /* The endpoint nearer to the merged vertex survives, so it keeps the closer color */
+    double distanceA = 0.0;
+    double distanceB = 0.0;
+    for (int j = 0; j < 3; j++)
+    {
+        distanceA += (collapse.position[j] - pa[j]) * (collapse.position[j] - pa[j]);
+        distanceB += (collapse.position[j] - pb[j]) * (collapse.position[j] - pb[j]);
+    }
+    collapse.kept = distanceA <= distanceB ? a : b;
+    collapse.removed = distanceA <= distanceB ? b : a;
+    collapse.keptVersion = versions[collapse.kept];
+    collapse.removedVersion = versions[collapse.removed];
+
+    queue.push(collapse);
+} /* MeshSimplifier::PushCollapse() */
+
+/**
+ * Checks whether a queued collapse still applies and keeps the surface a manifold without
+ * folding any face over
+ * @param collapse - The collapse popped from the queue
+ * @return - True if the collapse can be done; otherwise, false
+ */
+bool MeshSimplifier::IsCollapseValid(const EdgeCollapse& collapse)
+{
+    int kept = collapse.kept;
+    int removed = collapse.removed;
+
+    if (isVertexRemoved[kept] || isVertexRemoved[removed]
+            || versions[kept] != collapse.keptVersion
+            || versions[removed] != collapse.removedVersion)
+    {
+        return false;
+    }
+
+    /* The endpoints of an edge share no neighbors but the vertices opposite it in the faces
+     * on it; sharing more would pinch the surface once they merge
+     */
+    int edgeFaceCount = 0;
+    const std::vector<int>& keptFaces = vertexFaces[kept];
+    for (size_t i = 0; i < keptFaces.size(); i++)
+    {
+        const int* face = &faces[3 * keptFaces[i]];
+        if (!isFaceRemoved[keptFaces[i]]
+                && (removed == face[0] || removed == face[1] || removed == face[2]))
+        {
+            edgeFaceCount++;
+        }
+    }
+
+    std::vector<int> neighbors;
+    GatherNeighbors(kept, neighbors);
+    mark++;
+    for (size_t i = 0; i < neighbors.size(); i++)
+    {
+        marks[neighbors[i]] = mark;
+    }
+
+    GatherNeighbors(removed, neighbors);
+    int sharedCount = 0;
+    for (size_t i = 0; i < neighbors.size(); i++)
+    {
+        if (mark == marks[neighbors[i]])
+        {
+            sharedCount++;
+        }
+    }
+    if (edgeFaceCount < sharedCount)
+    {
+        return false;
+    }
+
+    /* No face which survives the collapse may turn over */
+    for (int endpoint = 0; endpoint < 2; endpoint++)
+    {
+        const std::vector<int>& around = vertexFaces[0 == endpoint ? kept : removed];
+        for (size_t i = 0; i < around.size(); i++)
+        {
+            int f = around[i];
+            const int* face = &faces[3 * f];
+            bool hasKept = kept == face[0] || kept == face[1] || kept == face[2];
+            bool hasRemoved = removed == face[0] || removed == face[1] || removed == face[2];
+            if (isFaceRemoved[f] || (hasKept && hasRemoved))
+            {
+                continue;
+            }
+
+            const double* corners[3];
+            const double* moved[3];
+            for (int j = 0; j < 3; j++)
+            {
+                corners[j] = &positions[3 * face[j]];
+                moved[j] = kept == face[j] || removed == face[j]
+                        ? collapse.position : corners[j];
+            }
+
+            double before[3];
+            double after[3];
+            calcTriangleNormal(before, corners[0], corners[1], corners[2]);
+            calcTriangleNormal(after, moved[0], moved[1], moved[2]);
+            double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+            bool isDegenerate = 0.0 == before[0] && 0.0 == before[1] && 0.0 == before[2];
+            if (!isDegenerate && dot <= 0.0)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+} /* MeshSimplifier::IsCollapseValid() */
+
+/**
+ * Merges an edge's endpoints into the kept one at the collapse's position, removes the faces
+ * which collapse to a line and queues the edges around the merged vertex again
+ * @param collapse - A valid collapse
+ */
+void MeshSimplifier::Collapse(const EdgeCollapse& collapse)
+{
+    int kept = collapse.kept;
+    int removed = collapse.removed;
+
+    for (int j = 0; j < 3; j++)
+    {
+        positions[3 * kept + j] = collapse.position[j];
+    }
+    for (int k = 0; k < 10; k++)
+    {
+        quadrics[10 * kept + k] += quadrics[10 * removed + k];
+    }
+    isVertexRemoved[removed] = 1;
+    versions[kept]++;
+    versions[removed]++;
+
+    /* Hand the removed vertex's faces to the kept one, except those on the edge */
+    std::vector<int>& keptFaces = vertexFaces[kept];
+    const std::vector<int>& removedFaces = vertexFaces[removed];
+    for (size_t i = 0; i < removedFaces.size(); i++)
+    {
+        int f = removedFaces[i];
+        int* face = &faces[3 * f];
+        if (isFaceRemoved[f])
+        {
+            continue;
+        }
+
+        if (kept == face[0] || kept == face[1] || kept == face[2])
+        {
+            isFaceRemoved[f] = 1;
+            faceCount--;
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            if (removed == face[j])
+            {
+                face[j] = kept;
+            }
+        }
+        keptFaces.push_back(f);
+    }
+    std::vector<int>().swap(vertexFaces[removed]);
+
+    /* Faces which the collapse laid on top of each other only need to be kept once */
+    size_t liveCount = 0;
+    for (size_t i = 0; i < keptFaces.size(); i++)
+    {
+        int f = keptFaces[i];
+        if (isFaceRemoved[f])
+        {
+            continue;
+        }
+
+        for (size_t k = 0; k < liveCount; k++)
+        {
+            if (IsSameFace(f, keptFaces[k]))
+            {
+                isFaceRemoved[f] = 1;
+                faceCount--;
+                break;
+            }
+        }
+        if (!isFaceRemoved[f])
+        {
+            keptFaces[liveCount++] = f;
+        }
+    }
+    keptFaces.resize(liveCount);
+
+    /* The merged vertex's quadric and position changed every edge around it */
+    std::vector<int> neighbors;
+    GatherNeighbors(kept, neighbors);
+    for (size_t i = 0; i < neighbors.size(); i++)
+    {
+        PushCollapse(kept, neighbors[i]);
+    }
+} /* MeshSimplifier::Collapse() */
+
+/**
+ * Checks whether two faces have the same vertices, whatever their winding
+ * @param a - The index of one face
+ * @param b - The index of the other face
+ * @return - True if the faces have the same vertices; otherwise, false
+ */
+bool MeshSimplifier::IsSameFace(int a, int b) const
+{
+    const int* faceA = &faces[3 * a];
+    const int* faceB = &faces[3 * b];
+
+    for (int j = 0; j < 3; j++)
+    {
+        if (faceB[0] != faceA[j] && faceB[1] != faceA[j] && faceB[2] != faceA[j])
+        {
+            return false;
+        }
+    }
+
+    return true;
+} /* MeshSimplifier::IsSameFace() */
+
+/**
+ * Finds the vertices which share a face with a vertex
+ * @param vertex - The index of the vertex
+ * @param neighbors - Returned with the neighbors' indices, sorted and without repeats
+ */
+void MeshSimplifier::GatherNeighbors(int vertex, std::vector<int>& neighbors)
+{
+    const std::vector<int>& around = vertexFaces[vertex];
+
+    neighbors.clear();
+    for (size_t i = 0; i < around.size(); i++)
+    {
+        if (isFaceRemoved[around[i]])
+        {
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            int neighbor = faces[3 * around[i] + j];
+            if (vertex != neighbor)
+            {
+                neighbors.push_back(neighbor);
+            }
+        }
+    }
+
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+} /* MeshSimplifier::GatherNeighbors() */
+
+/**
+ * Copies the faces left and the vertices they use into a new face list, with the normals
+ * found again the way the PLY reader finds them
+ * @return - The face list, which the caller must delete
+ */
+FaceList* MeshSimplifier::BuildFaceList() const
+{
+    /* Number the vertices still in use in their original order */
+    std::vector<int> remap(source->vc, -1);
+    int vertexCount = 0;
+    for (int i = 0; i < source->fc; i++)
+    {
+        if (isFaceRemoved[i])
+        {
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            remap[faces[3 * i + j]] = 0;
+        }
+    }
+    for (int i = 0; i < source->vc; i++)
+    {
+        if (0 == remap[i])
+        {
+            remap[i] = vertexCount++;
+        }
+    }
+
+    FaceList* faceList = new FaceList(vertexCount, faceCount);
+    faceList->radius = source->radius;
+    for (int j = 0; j < 3; j++)
+    {
+        faceList->center[j] = source->center[j];
+    }
+
+    for (int i = 0; i < source->vc; i++)
+    {
+        if (-1 == remap[i])
+        {
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            faceList->vertices[remap[i]][j] = positions[3 * i + j];
+            faceList->colors[remap[i]][j] = source->colors[i][j];
+        }
+    }
+
+    int f = 0;
+    for (int i = 0; i < source->fc; i++)
+    {
+        if (isFaceRemoved[i])
+        {
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            faceList->faces[f][j] = remap[faces[3 * i + j]];
+        }
+        f++;
+    }
+
+    /* Simplifying already runs in a loading job, so the normals are found on this thread */
+    MeshNormals::Generate(faceList, normalWeighting, NULL);
+
+    return faceList;
+} /* MeshSimplifier::BuildFaceList() */
@@ -0,0 +1,82 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshSimplifier.h
+ *
+ * A C++ module implementing a mesh simplifier which
+ * collapses the edges of a face list in the order of their
+ * quadric error, after Garland and Heckbert, so that one
+ * pass yields a chain of ever coarser levels of detail.
+ */
+
+#ifndef MESHSIMPLIFIER_H_
+#define MESHSIMPLIFIER_H_
+
+#include <queue>
+#include <vector>
+
+#include "FaceList.h"
+#include "MeshNormals.h"
+
+/* An edge collapse waiting in the queue, valid while neither endpoint changed since */
+struct EdgeCollapse
+{
+    double cost;            /* the quadric error of the merged vertex */
+    double position[3];     /* where the merged vertex goes */
+    int kept;               /* the endpoint which survives the collapse */
+    int removed;            /* the endpoint merged into the kept one */
+    int keptVersion;        /* the kept endpoint's version when the cost was found */
+    int removedVersion;     /* the removed endpoint's version when the cost was found */
+}; /* EdgeCollapse struct */
+
+/* Orders the queue so that the cheapest collapse is on top */
+struct EdgeCollapseOrder
+{
+    bool operator()(const EdgeCollapse& a, const EdgeCollapse& b) const
+    {
+        return a.cost > b.cost;
+    }
+}; /* EdgeCollapseOrder struct */
+
+class MeshSimplifier
+{
+public:
+    /* Overloaded constructor */
+    explicit MeshSimplifier(const FaceList* faceList,
+            NormalWeighting weighting = NORMALS_UNIFORM);
+
+    /* Member functions */
+    FaceList* Simplify(int targetFaceCount);
+    int GetFaceCount() const;
+
+private:
+    /* Private helper functions */
+    void AddPlane(int vertex, const double plane[4], double weight);
+    void PushCollapse(int a, int b);
+    bool IsCollapseValid(const EdgeCollapse& collapse);
+    void Collapse(const EdgeCollapse& collapse);
+    bool IsSameFace(int a, int b) const;
+    void GatherNeighbors(int vertex, std::vector<int>& neighbors);
+    FaceList* BuildFaceList() const;
+
+    /* Private data members */
+    const FaceList* source;             /* the full detail triangles, which are not changed */
+    NormalWeighting normalWeighting;    /* how the simplified normals weight the faces */
+    std::vector<double> positions;      /* each vertex's position, 3 doubles apiece */
+    std::vector<double> quadrics;       /* each vertex's error quadric, the upper triangle of a
+                                         * symmetric 4x4 matrix in 10 doubles apiece */
+    std::vector<int> versions;          /* bumped whenever a vertex moves or is removed */
+    std::vector<char> isVertexRemoved;  /* whether the vertex was merged into another */
+    std::vector<std::vector<int> > vertexFaces; /* the faces around each vertex, some of which
+                                                 * may have been removed since */
+    std::vector<int> faces;             /* each face's vertices, 3 ints apiece */
+    std::vector<char> isFaceRemoved;    /* whether the face collapsed to a line */
+    int faceCount;                      /* the number of faces left */
+    std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, EdgeCollapseOrder> queue;
+    std::vector<int> marks;             /* scratch stamps for finding shared neighbors */
+    int mark;                           /* the stamp of the current search */
+}; /* MeshSimplifier class */
+
+#endif /* MESHSIMPLIFIER_H_ */
@@ -0,0 +1,305 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshWelder.cpp
+ *
+ * A C++ module implementing a vertex welder which merges
+ * the vertices of a face list lying within a distance of
+ * each other, found through a spatial hash, then rebuilds
+ * the faces' indices and the smooth vertex normals.
+ */
+
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+#include "GpuMesh.h"
+#include "MeshWelder.h"
+
+/* The smallest cell of the spatial hash relative to the mesh's radius, so that a welding
+ * distance of zero still hashes every exact duplicate into the same cell
+ */
+#define WELD_MIN_CELL_SIZE 1e-9
+
+/* The most vertices or faces in one job's range */
+#define WELD_GRAIN 1024
+
+/* What the jobs which weld a mesh share */
+struct WeldBatch
+{
+    const FaceList* source;             /* the triangles as read */
+    FaceList* welded;                   /* the triangles with their duplicates merged */
+    double cellSize;                    /* the side of a cell of the spatial hash */
+    double epsilonSquared;              /* the squared distance within which vertices merge */
+    size_t bucketMask;                  /* the number of hash buckets less one */
+    std::vector<int64_t> cells;         /* each vertex's cell, 3 coordinates apiece */
+    std::vector<size_t> bucketStarts;   /* where each bucket's vertices start */
+    std::vector<int> bucketVertices;    /* the vertices in each bucket, in ascending order */
+    std::vector<int> representatives;   /* the vertex each vertex merges into, never after it */
+    std::vector<int> numbers;           /* each vertex's index once welded */
+    std::vector<int> faceNumbers;       /* each face's index once welded, or -1 if removed */
+}; /* WeldBatch struct */
+
+/**
+ * Hashes a cell of the spatial hash into a bucket
+ * @param cell - The cell's x, y and z coordinates
+ * @param mask - The number of buckets less one, which is a power of two less one
+ * @return - The cell's bucket
+ */
+static size_t hashCell(const int64_t cell[3], size_t mask)
+{
+    uint64_t hash = static_cast<uint64_t>(cell[0]) * 73856093u
+            ^ static_cast<uint64_t>(cell[1]) * 19349663u
+            ^ static_cast<uint64_t>(cell[2]) * 83492791u;
+
+    return static_cast<size_t>(hash ^ (hash >> 29)) & mask;
+} /* hashCell() */
+
+/**
+ * Finds the cell of the spatial hash each of a range of vertices lies in
+ * @param batch - The weld's shared state
+ * @param begin - The index of the first vertex
+ * @param end - One past the index of the last vertex
+ */
+static void findCells(void* batch, size_t begin, size_t end)
+{
+    WeldBatch* weld = static_cast<WeldBatch*>(batch);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            weld->cells[3 * i + j] = static_cast<int64_t>(
+                    floor(weld->source->vertices[i][j] / weld->cellSize));
+        }
+    }
+} /* findCells() */
+
+/**
+ * Finds the first vertex each of a range of vertices lies within the welding distance of,
+ * searching its own cell and the 26 around it, since the cells are no smaller than the
+ * distance
+ * @param batch - The weld's shared state
+ * @param begin - The index of the first vertex
+ * @param end - One past the index of the last vertex
+ */
+static void findRepresentatives(void* batch, size_t begin, size_t end)
+{
+    WeldBatch* weld = static_cast<WeldBatch*>(batch);
+    double** vertices = weld->source->vertices;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        int representative = static_cast<int>(i);
+
+        for (int neighbor = 0; neighbor < 27; neighbor++)
+        {
+            int64_t cell[3] =
+            {
+                weld->cells[3 * i] + neighbor % 3 - 1,
+                weld->cells[3 * i + 1] + neighbor / 3 % 3 - 1,
+                weld->cells[3 * i + 2] + neighbor / 9 - 1
+            };
+            size_t bucket = hashCell(cell, weld->bucketMask);
+
+            /* The bucket lists its vertices in ascending order, so only those before the best
+             * found so far need a look
+             */
+            for (size_t k = weld->bucketStarts[bucket]; k < weld->bucketStarts[bucket + 1]; k++)
+            {
+                int j = weld->bucketVertices[k];
+                if (j >= representative)
+                {
+                    break;
+                }
+
+                double dx = vertices[i][0] - vertices[j][0];
+                double dy = vertices[i][1] - vertices[j][1];
+                double dz = vertices[i][2] - vertices[j][2];
+                if (dx * dx + dy * dy + dz * dz <= weld->epsilonSquared)
+                {
+                    representative = j;
+                    break;
+                }
+            }
+        }
+
+        weld->representatives[i] = representative;
+    }
+} /* findRepresentatives() */
+
+/**
+ * Copies each of a range of vertices which the others merge into to its welded index
+ * @param batch - The weld's shared state
+ * @param begin - The index of the first vertex as read
+ * @param end - One past the index of the last vertex as read
+ */
+static void copyVertices(void* batch, size_t begin, size_t end)
+{
+    WeldBatch* weld = static_cast<WeldBatch*>(batch);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        if (static_cast<int>(i) != weld->representatives[i])
+        {
+            continue;
+        }
+
+        int number = weld->numbers[i];
+        for (int j = 0; j < 3; j++)
+        {
+            weld->welded->vertices[number][j] = weld->source->vertices[i][j];
+            weld->welded->colors[number][j] = weld->source->colors[i][j];
+        }
+    }
+} /* copyVertices() */
+
+/**
+ * Rebuilds the indices of each of a range of faces which survive the weld
+ * @param batch - The weld's shared state
+ * @param begin - The index of the first face as read
+ * @param end - One past the index of the last face as read
+ */
+static void copyFaces(void* batch, size_t begin, size_t end)
+{
+    WeldBatch* weld = static_cast<WeldBatch*>(batch);
+    FaceList* welded = weld->welded;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        int f = weld->faceNumbers[i];
+        if (0 > f)
+        {
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            welded->faces[f][j] = weld->numbers[weld->source->faces[i][j]];
+        }
+    }
+} /* copyFaces() */
+
+/**
+ * Merges the vertices of a face list which lie within a distance of each other into the first
+ * of them, removes the faces which collapse, and finds the vertex normals again from the
+ * faces which now share the merged vertices
+ * The vertices are hashed into cells as large as the distance, so each vertex only compares
+ * itself with the vertices in the 27 cells around it; the search runs in parallel
+ * @param faceList - The triangles as read, centered on their bounding sphere
+ * @param epsilon - The distance within which vertices merge, relative to the bounding
+ * sphere's radius; 0 only merges exact duplicates
+ * @param weighting - How the faces around a welded vertex are weighted in its normal
+ * @param jobs - The job system which welds in parallel, or NULL
+ * @param stats - Returned with the number of vertices before and after and of faces removed
+ * @return - The welded triangles, which the caller must delete, or NULL if no vertices merged
+ */
+FaceList* MeshWelder::Weld(const FaceList* faceList, double epsilon,
+        NormalWeighting weighting, JobSystem* jobs, WeldStats& stats)
+{
+    size_t vertexCount = static_cast<size_t>(faceList->vc);
+    double radius = 0.0 < faceList->radius ? faceList->radius : 1.0;
+
+    stats.originalVertexCount = faceList->vc;
+    stats.weldedVertexCount = faceList->vc;
+    stats.removedFaceCount = 0;
+
+    WeldBatch batch;
+    batch.source = faceList;
+    batch.welded = NULL;
+    batch.cellSize = (epsilon > WELD_MIN_CELL_SIZE ? epsilon : WELD_MIN_CELL_SIZE) * radius;
+    batch.epsilonSquared = epsilon * radius * epsilon * radius;
+    batch.cells.resize(3 * vertexCount);
+    JobSystem::ParallelFor(jobs, vertexCount, WELD_GRAIN, findCells, &batch);
+
+    /* Bucket the vertices by their cells' hashes in ascending order, with twice as many
+     * buckets as vertices so that few cells share one
+     */
+    size_t bucketCount = 1;
+    while (bucketCount < 2 * vertexCount)
+    {
+        bucketCount *= 2;
+    }
+    batch.bucketMask = bucketCount - 1;
+    batch.bucketStarts.assign(bucketCount + 1, 0);
+    batch.bucketVertices.resize(vertexCount);
+    std::vector<size_t> buckets(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        buckets[i] = hashCell(&batch.cells[3 * i], batch.bucketMask);
+        batch.bucketStarts[buckets[i] + 1]++;
+    }
+    for (size_t b = 0; b < bucketCount; b++)
+    {
+        batch.bucketStarts[b + 1] += batch.bucketStarts[b];
+    }
+    std::vector<size_t> cursors(batch.bucketStarts.begin(), batch.bucketStarts.end() - 1);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        batch.bucketVertices[cursors[buckets[i]]++] = static_cast<int>(i);
+    }
+
+    batch.representatives.resize(vertexCount);
+    JobSystem::ParallelFor(jobs, vertexCount, WELD_GRAIN, findRepresentatives, &batch);
+
+    /* Follow each chain of merges to its first vertex, which always comes earlier, and number
+     * the vertices which remain
+     */
+    int weldedCount = 0;
+    batch.numbers.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        int& representative = batch.representatives[i];
+        representative = batch.representatives[representative];
+        batch.numbers[i] = static_cast<int>(i) == representative
+                ? weldedCount++ : batch.numbers[representative];
+    }
+    if (weldedCount == faceList->vc)
+    {
+        return NULL;
+    }
+
+    /* A face whose vertices merged has no area left */
+    int keptCount = 0;
+    batch.faceNumbers.resize(faceList->fc);
+    for (int i = 0; i < faceList->fc; i++)
+    {
+        int a = batch.numbers[faceList->faces[i][0]];
+        int b = batch.numbers[faceList->faces[i][1]];
+        int c = batch.numbers[faceList->faces[i][2]];
+        bool isCollapsed = a == b || b == c || c == a;
+        batch.faceNumbers[i] = isCollapsed ? -1 : keptCount++;
+    }
+
+    batch.welded = new FaceList(weldedCount, keptCount);
+    batch.welded->radius = faceList->radius;
+    for (int j = 0; j < 3; j++)
+    {
+        batch.welded->center[j] = faceList->center[j];
+    }
+    JobSystem::ParallelFor(jobs, vertexCount, WELD_GRAIN, copyVertices, &batch);
+    JobSystem::ParallelFor(jobs, static_cast<size_t>(faceList->fc), WELD_GRAIN, copyFaces, &batch);
+
+    MeshNormals::Generate(batch.welded, weighting, jobs);
+
+    stats.weldedVertexCount = weldedCount;
+    stats.removedFaceCount = faceList->fc - keptCount;
+
+    return batch.welded;
+} /* MeshWelder::Weld() */
+
+/**
+ * Returns the memory a weld saved, both in the face list and in the full detail buffers
+ * @param stats - What the weld did
+ * @return - The number of bytes saved
+ */
+long MeshWelder::GetBytesSaved(const WeldStats& stats)
+{
+    long vertexBytes = 9 * sizeof(double) + sizeof(GpuVertex);
+    long faceBytes = 3 * sizeof(int) + 3 * sizeof(double) + 3 * sizeof(GLuint);
+
+    return (stats.originalVertexCount - stats.weldedVertexCount) * vertexBytes
+            + stats.removedFaceCount * faceBytes;
+} /* MeshWelder::GetBytesSaved() */
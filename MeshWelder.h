@@ -0,0 +1,38 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: MeshWelder.h
+ *
+ * A C++ module implementing a vertex welder which merges
+ * the vertices of a face list lying within a distance of
+ * each other, found through a spatial hash, then rebuilds
+ * the faces' indices and the smooth vertex normals.
+ */
+
+#ifndef MESHWELDER_H_
+#define MESHWELDER_H_
+
+#include "FaceList.h"
+#include "JobSystem.h"
+#include "MeshNormals.h"
+
+/* What welding a mesh's vertices did */
+struct WeldStats
+{
+    long originalVertexCount;   /* the vertices read from the file */
+    long weldedVertexCount;     /* the vertices left once the duplicates merged */
+    long removedFaceCount;      /* the faces which collapsed once their vertices merged */
+}; /* WeldStats struct */
+
+class MeshWelder
+{
+public:
+    /* Static member functions */
+    static FaceList* Weld(const FaceList* faceList, double epsilon, NormalWeighting weighting,
+            JobSystem* jobs, WeldStats& stats);
+    static long GetBytesSaved(const WeldStats& stats);
+}; /* MeshWelder class */
+
+#endif /* MESHWELDER_H_ */
@@ -6,224 +6,195 @@
  * Filename: Model.cpp
  *
  * A C++ module implementing a 3D model class to represent
- * objects drawn on a display.
+ * objects drawn on a display. A model only keeps the data
+ * which is not touched every frame, namely where it loads
+ * from and the mesh it shares; the scene keeps the rest in
+ * arrays.
  */
 
 #include "Model.h"
 
 /**
  * Default constructor
+ * The model is not loaded until StartLoading() is called
  * @param filename - The filename of a PLY model to load
- * @param pos - The position of the center of the model in world space
+ * @param meshes - The cache which shares the model's mesh with other models
+ * @param jobs - The job system which loads the mesh in the background, or NULL
  */
-Model::Model(const char* filename, const Point3& pos)
-    : rotationSpeed(130.0f)
-    , translationSpeed(2.5f)
-    , isDrawingBoundingBox(false)
+Model::Model(const char* filename, MeshCache* meshes, JobSystem* jobs)
+    : filename(filename)
+    , meshes(meshes)
+    , jobs(jobs)
+    , isAcquired(0)
+    , references(1)
+    , mesh(NULL)
 {
-    /* Load the PLY model and initialize its position */
-    faceList = readPlyModel(filename);
-    faceList->center[0] = static_cast<double>(pos.x);
-    faceList->center[1] = static_cast<double>(pos.y);
-    faceList->center[2] = static_cast<double>(pos.z);
-
-    /* Set the model scaling */
-    scaleFactor = 0.5 / faceList->radius;
-    scaledRadius = scaleFactor * faceList->radius;
-
-    /* Initialize the starting height and rotation of the model */
-    startingHeight = static_cast<double>(pos.y);
-    randomDegrees = static_cast<double>(rand() % 360);
-    fprintf(stderr, "randomDegrees = %f\n", randomDegrees);
-    rotation = randomDegrees;
-    randomRadians = randomDegrees * (2.0 * M_PI) / 360.0;
+    /* empty */
 } /* Default constructor */
 
 /**
- * Destructor
+ * Destructor gives up the model's share of its mesh
  */
 Model::~Model()
 {
-    delete faceList;
+    if (NULL != mesh)
+    {
+        meshes->Release(mesh);
+    }
 } /* Destructor */
 
 /**
- * Updates the model's transformation
+ * Starts acquiring the model's mesh from the cache, in a background job if there is a job
+ * system or else at once
  */
-void Model::Update()
+void Model::StartLoading()
 {
-    float elapsedTime = static_cast<float>(GetElapsedTime());
+    if (NULL == jobs)
+    {
+        Load();
+        return;
+    }
 
-    /* Rotate the model */
-    rotation = randomDegrees + elapsedTime * rotationSpeed;
+    /* The job keeps the model alive until it finishes, even if the scene lets go of it */
+    __sync_add_and_fetch(&references, 1);
 
-    /* Translate the model */
-    faceList->center[1] =
-            startingHeight + (0.4 * sin(translationSpeed * (elapsedTime + randomRadians)));
-} /* Model::Update() */
+    Job* job = jobs->CreateBackground(RunLoad, this);
+    jobs->Run(job);
+    jobs->Release(job);
+} /* Model::StartLoading() */
 
 /**
- * Returns the model's bounding box
- * @return - The model's bounding box
+ * Returns how far the model has loaded, which is how far its shared mesh has
+ * @return - The model's state
  */
-AxisAlignedBoundingBox* Model::GetBoundingBox()
+ModelState Model::GetState() const
 {
-    return &boundingBox;
-} /* Model::GetBoundingBox() */
+    /* The atomic read also orders reading the mesh after seeing it acquired */
+    if (0 == __sync_fetch_and_add(const_cast<volatile int*>(&isAcquired), 0))
+    {
+        return MODEL_LOADING;
+    }
 
-/**
- * Returns the model's rotation
- * return - The model's rotation
- */
-float Model::GetRotation() const
-{
-    return rotation;
-} /* Model::GetRotation() */
+    switch (MeshCache::GetState(mesh))
+    {
+    case MESH_READY:
+        return MODEL_READY;
+    case MESH_LOADED:
+        return MODEL_LOADED;
+    default:
+        return MODEL_LOADING;
+    }
+} /* Model::GetState() */
 
 /**
- * Returns the model's scaling factor
+ * Returns the model's scaling factor, which scales its mesh to the common radius
+ * Only valid once the model is loaded
  * @return - The model's scaling factor
  */
 double Model::GetScaleFactor() const
 {
-    return scaleFactor;
+    return MODEL_SCALED_RADIUS / mesh->faceList->radius;
 } /* Model::GetScaleFactor() */
 
 /**
- * Returns the model's scaled radius
- * @return - The model's scaled radius
+ * Returns the model's list of faces, which it shares with the other models loaded from the
+ * same file and must not change
+ * Only valid once the model is loaded
+ * @return - The model's list of faces
  */
-double Model::GetScaledRadius() const
+const FaceList* Model::GetFaceList() const
 {
-    return scaledRadius;
-} /* Model::GetScaledRadius() */
+    return mesh->faceList;
+} /* Model::GetFaceList() */
 
 /**
- * Returns true if the model should draw its bounding box
- * @return - True if the model should draw its bounding box
+ * Returns the hierarchy over the model's triangles, which it shares with the other models
+ * loaded from the same file
+ * Only valid once the model is loaded
+ * @return - The hierarchy, in model space
  */
-bool Model::GetIsDrawingBoundingBox() const
+const MeshBvh* Model::GetBvh() const
 {
-    return isDrawingBoundingBox;
-} /* Model::GetIsDrawingBoundingBox() */
+    return &mesh->bvh;
+} /* Model::GetBvh() */
 
 /**
- * Sets whether the model should draw its bounding box
- * @param flag - True if the model should draw its bounding box
+ * Returns the model's triangles in buffer objects, which it shares with the other models
+ * loaded from the same file
+ * Only valid once the model is loaded; the meshes are empty until it is MODEL_READY
+ * @return - The model's GPU meshes, the full detail one followed by the MESH_LOD_COUNT - 1
+ * coarser levels of detail
  */
-void Model::SetIsDrawingBoundingBox(bool flag)
+GpuMesh* Model::GetGpuMesh()
 {
-    isDrawingBoundingBox = flag;
-} /* Model::SetIsDrawingBoundingBox() */
+    return mesh->gpuMeshes;
+} /* Model::GetGpuMesh() */
 
 /**
- * Toggles whether the model should draw its bounding box
+ * Returns the id of the model's mesh, which every model sharing the mesh has in common
+ * Only valid once the model is loaded
+ * @return - The mesh's id in the cache
  */
-void Model::ToggleDrawingBoundingBox()
+int Model::GetMeshId() const
 {
-    isDrawingBoundingBox = !isDrawingBoundingBox;
-} /* Model::ToggleDrawingBoundingBox() */
+    return mesh->id;
+} /* Model::GetMeshId() */
 
 /**
- * Tests if a ray intersects the model's bounding volume
- * @param ray - The ray with which to test for intersection
- * @return - True if the ray intersects the model's bounding volume;
- * otherwise, false
+ * Returns the box around the model's mesh in model space
+ * Only valid once the model is loaded
+ * @return - The minimum x, y and z followed by the maximum x, y and z
  */
-bool Model::Intersects(const Ray& ray) const
+const float* Model::GetBounds() const
 {
-    /* Slabs method of ray/AABB intersect from Real-Time Rendering, 3rd edition */
-    Point3 center = boundingBox.GetCenter();
-    float tMin = -999999999.0;
-    float tMax = +999999999.0;
-    Vec3 v = center - ray.origin;
-    float p[] = {v.x, v.y, v.z};
-    float d[] = {ray.direction.x, ray.direction.y, ray.direction.z};
-    float halfLengths[] = {(boundingBox.right - boundingBox.left) / 2,
-            (boundingBox.top - boundingBox.bottom) / 2, (boundingBox.front - boundingBox.back) / 2};
-
-    for (int i = 0; i < 3; i++)
-    {
-        float e = p[i];
-        float f = d[i];
-
-        if (fabs(f) > EPSILON)
-        {
-            float fInverse = 1 / f;
-            float t1 = (e + halfLengths[i]) * fInverse;
-            float t2 = (e - halfLengths[i]) * fInverse;
-
-            if (t1 > t2)
-            {
-                std::swap(t1, t2);
-            }
-
-            if (t1 > tMin)
-            {
-                tMin = t1;
-            }
-
-            if (t2 < tMax)
-            {
-                tMax = t2;
-            }
-
-            if (tMin > tMax || tMax < 0)
-            {
-                return false;
-            }
-        }
-        else if (-e - halfLengths[i] > 0 || -e + halfLengths[i] < 0)
-        {
-            return false;
-        }
-
-    }
-
-    return true;
-} /* Model::Intersects() */
+    return mesh->bounds;
+} /* Model::GetBounds() */
 
 /**
- * Returns the model's list of faces
- * @return - The model's list of faces
+ * Returns the radius of the cylinder around the y axis which contains the model's mesh in
+ * model space, whatever its rotation about the axis
+ * Only valid once the model is loaded
+ * @return - The farthest any vertex lies from the y axis
  */
-FaceList* Model::GetFaceList() const
+float Model::GetAxisRadius() const
 {
-    return faceList;
-} /* Model::GetFaceList() */
+    return mesh->axisRadius;
+} /* Model::GetAxisRadius() */
 
 /**
- * Calculates the elapsed time since the function is first called
- * from Professor Shafae
- * @return - The elapsed time since the function is first called
+ * Gives up a reference to a model, deleting it once neither the scene nor its load uses it
+ * @param model - The model to release
  */
-double Model::GetElapsedTime()
+void Model::Release(Model* model)
 {
-    static bool     isFirstTime = true; /* If this is the first function call */
-    static struct   timeval start;      /* The static start time */
-    struct          timeval now;        /* The current time */
-    struct          timeval elapsed;    /* The elapsed time (now - start) */
-
-    /* Save the start time if this is the first function call */
-    if (isFirstTime)
+    if (0 == __sync_sub_and_fetch(&model->references, 1))
     {
-        isFirstTime = false;
-        gettimeofday(&start, NULL);
+        delete model;
     }
+} /* Model::Release() */
 
-    /* Get the current time, and calculate the elapsed time */
-    gettimeofday(&now, NULL);
-    elapsed.tv_sec = now.tv_sec - start.tv_sec;
-    elapsed.tv_usec = now.tv_usec - start.tv_usec;
-    if (elapsed.tv_usec < 0)
-    {
-        --elapsed.tv_sec;
-        elapsed.tv_usec += 1000000;
-    }
+/**
+ * Acquires the model's mesh from the cache, loading it unless another model shares it
+ * This needs no OpenGL context, so it may run on a background thread while the model is
+ * drawn as a placeholder
+ */
+void Model::Load()
+{
+    mesh = meshes->Acquire(filename.c_str(), jobs);
+
+    /* The atomic write publishes the mesh before anyone can see it acquired */
+    __sync_bool_compare_and_swap(&isAcquired, 0, 1);
+} /* Model::Load() */
+
+/**
+ * Loads a model and releases the load's reference to it; this is the work of the background
+ * jobs which load the models
+ * @param model - The model to load
+ */
+void Model::RunLoad(void* model)
+{
+    Model* self = static_cast<Model*>(model);
 
-    /* Return the elapsed time in seconds */
-    return (static_cast<uint64_t>(elapsed.tv_sec)
-           * static_cast<uint64_t>(1000000)
-           + static_cast<uint64_t>(elapsed.tv_usec))
-           / 1000000.0;
-} /* Model::GetElapsedTime() */
+    self->Load();
+    Release(self);
+} /* Model::RunLoad() */
@@ -6,62 +6,66 @@
  * Filename: Model.h
  *
  * A C++ module implementing a 3D model class to represent
- * objects drawn on a display.
+ * objects drawn on a display. A model only keeps the data
+ * which is not touched every frame, namely where it loads
+ * from and the mesh it shares; the scene keeps the rest in
+ * arrays.
  */
 
 #ifndef MODEL_H_
 #define MODEL_H_
 
-#include <cmath>
-#include <cstdlib>
-#include <stdint.h>
-#include <sys/time.h>
+#include <string>
 
-#include "AxisAlignedBoundingBox.h"
-#include "PlyModel.h"
-#include "Ray.h"
-#include "Vec3.h"
-#include "VecMath.h"
+#include "FaceList.h"
+#include "GpuMesh.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
 
-#define EPSILON 0.00001
+/* The bounding sphere radius every model is scaled to, which is known before it loads */
+#define MODEL_SCALED_RADIUS 0.5
+
+/* How far a model has got from its file to the screen */
+enum ModelState
+{
+    MODEL_LOADING,  /* the mesh is being read and preprocessed */
+    MODEL_LOADED,   /* the mesh is ready to upload into buffer objects */
+    MODEL_READY     /* the mesh is uploaded, so the model can be drawn */
+}; /* ModelState enum */
 
 class Model
 {
 public:
     /* Overloaded constructor */
-    Model(const char* filename, const Point3& pos);
-
-    /* Destructor */
-    ~Model();
+    Model(const char* filename, MeshCache* meshes, JobSystem* jobs = NULL);
 
     /* Member functions */
-    void Update();
-    AxisAlignedBoundingBox* GetBoundingBox();
-    float GetRotation() const;
+    void StartLoading();
+    ModelState GetState() const;
     double GetScaleFactor() const;
-    double GetScaledRadius() const;
-    bool GetIsDrawingBoundingBox() const;
-    void SetIsDrawingBoundingBox(bool flag);
-    void ToggleDrawingBoundingBox();
-    bool Intersects(const Ray& ray) const;
-    FaceList* GetFaceList() const;
+    const FaceList* GetFaceList() const;
+    const MeshBvh* GetBvh() const;
+    GpuMesh* GetGpuMesh();
+    int GetMeshId() const;
+    const float* GetBounds() const;
+    float GetAxisRadius() const;
+    static void Release(Model* model);
 
 private:
-    /* Private data members */
-    FaceList* faceList; /* contains center and radius of bounding sphere */
-    AxisAlignedBoundingBox boundingBox;
-    float rotation;             /* the model's current rotation in degrees */
-    float rotationSpeed;        /* the number of degrees the model rotates per second */
-    double startingHeight;      /* the model's starting position's y component */
-    double randomDegrees;       /* the random offset to use in calculating rotation */
-    double randomRadians;       /* the random offset to use in calculating translation */
-    double translationSpeed;    /* the multiplier for the model's translation during update */
-    double scaleFactor;         /* the factor by which to scale the model */
-    double scaledRadius;        /* the bounding sphere's radius after scaling */
-    bool isDrawingBoundingBox;
+    /* Destructor, which Release() calls once the model is no longer used */
+    ~Model();
 
     /* Private helper functions */
-    double GetElapsedTime(); /* from Professor Shafae */
+    void Load();
+    static void RunLoad(void* model);
+
+    /* Private data members */
+    std::string filename;       /* the PLY file the model is loaded from */
+    MeshCache* meshes;          /* shares the mesh with the other models loaded from the file */
+    JobSystem* jobs;            /* preprocesses the mesh in parallel, or NULL */
+    volatile int isAcquired;    /* 1 once the mesh has been acquired from the cache */
+    volatile int references;    /* the scene's reference plus the load's until it finishes */
+    MeshAsset* mesh;            /* the shared mesh, or NULL until acquired */
 }; /* Model class */
 
 #endif /* MODEL_H_ */
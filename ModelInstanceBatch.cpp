@@ -0,0 +1,161 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: ModelInstanceBatch.cpp
+ *
+ * A C++ module implementing a batch of model instances which
+ * the vertex shader animates, drawing every visible instance
+ * of a mesh with a single instanced draw call from their
+ * animation parameters and the time.
+ */
+
+#include <cstddef>
+
+#include "ModelInstanceBatch.h"
+
+/* Converts a byte offset into a buffer object into the pointer argument OpenGL expects */
+#define BUFFER_OFFSET(offset) (reinterpret_cast<const GLvoid*>(offset))
+
+/**
+ * Default constructor creates an empty batch
+ * Init() must be called once an OpenGL context exists
+ */
+ModelInstanceBatch::ModelInstanceBatch()
+    : isInstanced(false)
+    , instanceBuffer(0)
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Creates the instance buffer if instanced arrays are supported
+ */
+void ModelInstanceBatch::Init()
+{
+    isInstanced = GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+
+    if (isInstanced)
+    {
+        glGenBuffers(1, &instanceBuffer);
+    }
+} /* ModelInstanceBatch::Init() */
+
+/**
+ * Binds the instance parameters of a shader program to their attribute locations
+ * Must be called before the program is linked
+ * @param program - The shader program, which declares instanceCenterScale and instanceMotion,
+ * and instanceId if it draws the id buffer
+ */
+void ModelInstanceBatch::BindAttributes(GLuint program)
+{
+    glBindAttribLocation(program, ATTRIB_INSTANCE_ID, "instanceId");
+    glBindAttribLocation(program, ATTRIB_INSTANCE_CENTER_SCALE, "instanceCenterScale");
+    glBindAttribLocation(program, ATTRIB_INSTANCE_MOTION, "instanceMotion");
+} /* ModelInstanceBatch::BindAttributes() */
+
+/**
+ * Returns true if the instances are drawn with a single instanced draw call
+ * @return - True if instanced arrays are supported; otherwise, false
+ */
+bool ModelInstanceBatch::IsInstanced() const
+{
+    return isInstanced;
+} /* ModelInstanceBatch::IsInstanced() */
+
+/**
+ * Sizes the instance buffer for a frame's instances, orphaning the last frame's storage so the
+ * upload does not wait for the GPU to finish drawing from it
+ * Called once per frame, before the lists are uploaded and drawn by every pass
+ * @param state - The state cache used to bind the buffer
+ * @param instanceCount - The instances of every list drawn this frame
+ */
+void ModelInstanceBatch::Allocate(GLStateCache& state, size_t instanceCount)
+{
+    if (!isInstanced || 0 == instanceCount)
+    {
+        return;
+    }
+
+    state.BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(ModelInstance), NULL, GL_STREAM_DRAW);
+} /* ModelInstanceBatch::Allocate() */
+
+/**
+ * Writes a list's instances into the instance buffer at its first instance, where every pass
+ * that draws the list this frame reads them
+ * @param state - The state cache used to bind the buffer
+ * @param list - The mesh and its instances
+ */
+void ModelInstanceBatch::Upload(GLStateCache& state, const ModelInstanceList& list)
+{
+    if (!isInstanced || list.instances.empty())
+    {
+        return;
+    }
+
+    state.BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, list.firstInstance * sizeof(ModelInstance),
+            list.instances.size() * sizeof(ModelInstance), &list.instances[0]);
+} /* ModelInstanceBatch::Upload() */
+
+/**
+ * Draws every instance in a list, posed by the bound shader program
+ * The caller binds a program which animates the instances and loads the viewing matrix
+ * The list must have been uploaded this frame
+ * @param state - The state cache used to bind the buffers
+ * @param list - The mesh and its instances
+ * @param isDepthOnly - True to skip the normals and colors, as in GpuMesh::Draw()
+ */
+void ModelInstanceBatch::Draw(GLStateCache& state, const ModelInstanceList& list,
+        bool isDepthOnly)
+{
+    if (list.instances.empty())
+    {
+        return;
+    }
+
+    GLsizei instanceCount = static_cast<GLsizei>(list.instances.size());
+
+    if (isInstanced)
+    {
+        /* Point the attributes at the list's instances in the frame's buffer */
+        size_t first = list.firstInstance * sizeof(ModelInstance);
+        state.BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+        glEnableVertexAttribArray(ATTRIB_INSTANCE_CENTER_SCALE);
+        glEnableVertexAttribArray(ATTRIB_INSTANCE_MOTION);
+        glEnableVertexAttribArray(ATTRIB_INSTANCE_ID);
+        glVertexAttribPointer(ATTRIB_INSTANCE_CENTER_SCALE, 4, GL_FLOAT, GL_FALSE,
+                sizeof(ModelInstance),
+                BUFFER_OFFSET(first + offsetof(ModelInstance, centerScale)));
+        glVertexAttribPointer(ATTRIB_INSTANCE_MOTION, 4, GL_FLOAT, GL_FALSE,
+                sizeof(ModelInstance), BUFFER_OFFSET(first + offsetof(ModelInstance, motion)));
+        glVertexAttribPointer(ATTRIB_INSTANCE_ID, 4, GL_FLOAT, GL_FALSE,
+                sizeof(ModelInstance), BUFFER_OFFSET(first + offsetof(ModelInstance, id)));
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_CENTER_SCALE, 1);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_MOTION, 1);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_ID, 1);
+
+        list.mesh->Draw(state, isDepthOnly, instanceCount);
+
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_CENTER_SCALE, 0);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_MOTION, 0);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_ID, 0);
+        glDisableVertexAttribArray(ATTRIB_INSTANCE_CENTER_SCALE);
+        glDisableVertexAttribArray(ATTRIB_INSTANCE_MOTION);
+        glDisableVertexAttribArray(ATTRIB_INSTANCE_ID);
+    }
+    else
+    {
+        /* Without instancing, the parameters are passed as constant attributes per instance */
+        for (GLsizei i = 0; i < instanceCount; i++)
+        {
+            glVertexAttrib4fv(ATTRIB_INSTANCE_CENTER_SCALE, list.instances[i].centerScale);
+            glVertexAttrib4fv(ATTRIB_INSTANCE_MOTION, list.instances[i].motion);
+            glVertexAttrib4fv(ATTRIB_INSTANCE_ID, list.instances[i].id);
+            list.mesh->Draw(state, isDepthOnly);
+        }
+    }
+} /* ModelInstanceBatch::Draw() */
@@ -0,0 +1,70 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: ModelInstanceBatch.h
+ *
+ * A C++ module implementing a batch of model instances which
+ * the vertex shader animates, drawing every visible instance
+ * of a mesh with a single instanced draw call from their
+ * animation parameters and the time.
+ */
+
+#ifndef MODELINSTANCEBATCH_H_
+#define MODELINSTANCEBATCH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "GpuMesh.h"
+
+/* Vertex attribute locations of the instance parameters, clear of the fixed function arrays;
+ * location 1 would only alias the vertex weights, which nothing draws with
+ */
+#define ATTRIB_INSTANCE_ID 1
+#define ATTRIB_INSTANCE_CENTER_SCALE 6
+#define ATTRIB_INSTANCE_MOTION 7
+
+/* The animation parameters of a model, stored per instance in the instance buffer */
+struct ModelInstance
+{
+    float centerScale[4];   /* the center's x, starting height, center's z and scale factor */
+    float motion[4];        /* the rotation phase in degrees, bounce phase in radians, rotation
+                             * speed in degrees per second and bounce speed */
+    float id[4];            /* the model's id in the id buffer, encoded as a color */
+}; /* ModelInstance struct */
+
+/* The visible instances of one mesh in a frame */
+struct ModelInstanceList
+{
+    GpuMesh* mesh;                          /* the mesh every instance draws */
+    std::vector<ModelInstance> instances;   /* the instances' animation parameters */
+    size_t firstInstance;                   /* where the instances start in the frame's
+                                             * instance buffer */
+}; /* ModelInstanceList struct */
+
+class ModelInstanceBatch
+{
+public:
+    /* Default constructor */
+    ModelInstanceBatch();
+
+    /* Member functions */
+    void Init();
+    static void BindAttributes(GLuint program);
+    bool IsInstanced() const;
+    void Allocate(GLStateCache& state, size_t instanceCount);
+    void Upload(GLStateCache& state, const ModelInstanceList& list);
+    void Draw(GLStateCache& state, const ModelInstanceList& list, bool isDepthOnly);
+
+private:
+    /* Private data members */
+    bool isInstanced;           /* true if instanced arrays are supported */
+    GLuint instanceBuffer;      /* the instances of every list drawn this frame */
+}; /* ModelInstanceBatch class */
+
+#endif /* MODELINSTANCEBATCH_H_ */
@@ -41,6 +41,8 @@
 #include <fstream>
 #include <cmath>
 #include <cassert>
+#include <vector>
+#include <cstdlib>
 
 #ifndef SQR
 #define SQR( x ) ((x) * (x))
@@ -134,8 +136,9 @@ void vecSum3d(double *c, double *a, double *b){
   }
 }
 
-double r(){
-  return double(rand( ))/double(RAND_MAX);
+// each model has its own seed, so models loading at once do not share rand()'s state
+double r(unsigned int *seed){
+  return double(rand_r(seed))/double(RAND_MAX);
 }
 
 void midpoint(double *m, double *a, double *b){
@@ -146,23 +149,52 @@ void midpoint(double *m, double *a, double *b){
   }
 }
 
-void calcBoundingSphere(double *center, double *radius, FaceList *fl){
-  double maxDistance = 0.0;
-  for( int i = 0; i < fl->vc-1; i++ ){
+// The farthest partner of each vertex among the vertices after it
+struct FarthestPairs{
+  FaceList *fl;
+  std::vector<double> distances;
+  std::vector<int> partners;
+};
+
+void findFarthestPartners(void *data, size_t begin, size_t end){
+  FarthestPairs *pairs = (FarthestPairs*)data;
+  FaceList *fl = pairs->fl;
+  for( size_t i = begin; i < end; i++ ){
+    double maxDistance = 0.0;
+    int partner = -1;
     for(int j = i + 1; j < fl->vc; j++){
-      double *a = fl->vertices[i];
-      double *b = fl->vertices[j];
-      double distance = vecSquaredDistanceBetween3d(a, b);
+      double distance = vecSquaredDistanceBetween3d(fl->vertices[i], fl->vertices[j]);
       if( distance > maxDistance){
-        midpoint(center, a, b);
-        *radius = sqrt(distance) * 0.5;
         maxDistance = distance;
+        partner = j;
       }
     }
+    pairs->distances[i] = maxDistance;
+    pairs->partners[i] = partner;
+  }
+}
+
+void calcBoundingSphere(double *center, double *radius, FaceList *fl, JobSystem *jobs){
+  // Each vertex's rows are searched in parallel, then the rows are compared in order,
+  // which picks the same pair as searching every pair one after another
+  FarthestPairs pairs;
+  pairs.fl = fl;
+  pairs.distances.resize(fl->vc);
+  pairs.partners.resize(fl->vc);
+  JobSystem::ParallelFor(jobs, fl->vc, 0, findFarthestPartners, &pairs);
+
+  double maxDistance = 0.0;
+  for( int i = 0; i < fl->vc-1; i++ ){
+    if( pairs.distances[i] > maxDistance){
+      midpoint(center, fl->vertices[i], fl->vertices[pairs.partners[i]]);
+      *radius = sqrt(pairs.distances[i]) * 0.5;
+      maxDistance = pairs.distances[i];
+    }
   }
 }
 
-FaceList* readPlyModel( const char* filename ){
+FaceList* readPlyModel( const char* filename, JobSystem *jobs, unsigned int seed,
+    NormalWeighting weighting ){
   char buffer[255], type[128], c;
   std::ifstream inputfile;
   unsigned int i;
@@ -287,31 +319,19 @@ FaceList* readPlyModel( const char* filename ){
 
   inputfile.close( );
 
-  calcBoundingSphere(fl->center, &(fl->radius), fl);
+  calcBoundingSphere(fl->center, &(fl->radius), fl, jobs);
   for( i = 0; i < nv; i++){
     vecDifference3d(fl->vertices[i], fl->vertices[i], fl->center);
   }
 
-  // compute face normals
-  for( i = 0; i < nf; i++){
-    vecCalcNormal3d(fl->f_normals[i],
-      fl->vertices[fl->faces[i][0]],
-      fl->vertices[fl->faces[i][1]],
-      fl->vertices[fl->faces[i][2]]);
-
-    for(int j = 0; j < 3; j++){
-      vecSum3d(fl->v_normals[fl->faces[i][j]],
-        fl->v_normals[fl->faces[i][j]], fl->f_normals[i] );
-    }
-  }
+  // compute the face and vertex normals in parallel
+  MeshNormals::Generate(fl, weighting, jobs);
 
-  // normalize the v_normals
+  // set some colors
   for( i = 0; i < nv; i++ ){
     for(int j = 0; j < 3; j++){
-      // set some colors
-      fl->colors[i][j] = r( );
+      fl->colors[i][j] = r( &seed );
     }
-    vecNormalize3d(fl->v_normals[i], fl->v_normals[i]);
   }
 
   puts("Done");
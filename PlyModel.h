@@ -39,7 +39,10 @@
 #define _PLYMODEL_H_
 
 #include "FaceList.h"
+#include "JobSystem.h"
+#include "MeshNormals.h"
 
-FaceList* readPlyModel( const char* filename );
+FaceList* readPlyModel( const char* filename, JobSystem *jobs = NULL, unsigned int seed = 1,
+    NormalWeighting weighting = NORMALS_UNIFORM );
 
 #endif
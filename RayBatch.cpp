@@ -0,0 +1,339 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: RayBatch.cpp
+ *
+ * A C++ module implementing a batch of rays laid out by axis
+ * with their inverse directions worked out once, which finds
+ * the nearest of a set of boxes each ray enters, testing four
+ * boxes at a time with SSE2, or the nearest triangle of a
+ * mesh's hierarchy each ray hits, four rays at a time.
+ */
+
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "RayBatch.h"
+
+/* The most rays, or packets of rays, in one job's range */
+#define RAY_BATCH_GRAIN 256
+
+/* The number of boxes tested against a ray at once, and the floats each group of them takes:
+ * the minimum x, y and z then the maximum x, y and z of every box in the group in turn
+ */
+#define BOX_GROUP_SIZE 4
+#define BOX_GROUP_FLOATS (6 * BOX_GROUP_SIZE)
+
+/* What the jobs which cast a batch's rays share */
+struct RayJob
+{
+    const RayBatch* rays;           /* the batch */
+    const float* origins[3];        /* the rays' origins by axis */
+    const float* inverses[3];       /* the reciprocals of the rays' directions by axis */
+    const float* maxDistances;      /* the farthest along each ray that counts */
+    const float* boxes;             /* the boxes in groups laid out by axis */
+    size_t groupCount;              /* the number of groups of boxes */
+    const MeshBvh* bvh;             /* the hierarchy the packets are cast against */
+    BoxHit* boxHits;                /* each ray's nearest box */
+    RayHit* rayHits;                /* each ray's nearest triangle */
+}; /* RayJob struct */
+
+/**
+ * Finds the nearest box each of a range of rays enters, testing a group of boxes at a time
+ * A ray along a slab's plane gives NaN, and it lies within that slab
+ * @param job - The rays' shared state
+ * @param begin - The index of the first ray
+ * @param end - One past the index of the last ray
+ */
+static void findBoxes(void* job, size_t begin, size_t end)
+{
+    RayJob* rayJob = static_cast<RayJob*>(job);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        float origin[3] = {rayJob->origins[0][i], rayJob->origins[1][i], rayJob->origins[2][i]};
+        float inverse[3] =
+        {
+            rayJob->inverses[0][i], rayJob->inverses[1][i], rayJob->inverses[2][i]
+        };
+        BoxHit& hit = rayJob->boxHits[i];
+        hit.distance = rayJob->maxDistances[i];
+        hit.box = -1;
+
+#ifdef __SSE2__
+        __m128 o[3];
+        __m128 d[3];
+        for (int j = 0; j < 3; j++)
+        {
+            o[j] = _mm_set1_ps(origin[j]);
+            d[j] = _mm_set1_ps(inverse[j]);
+        }
+        __m128 zero = _mm_setzero_ps();
+        __m128 best = _mm_set1_ps(hit.distance);
+        __m128i bestBox = _mm_set1_epi32(-1);
+        __m128i boxes = _mm_setr_epi32(0, 1, 2, 3);
+        __m128i step = _mm_set1_epi32(BOX_GROUP_SIZE);
+
+        /* Each lane keeps the nearest of its own boxes, the earliest on a tie */
+        for (size_t g = 0; g < rayJob->groupCount; g++)
+        {
+            const float* group = &rayJob->boxes[BOX_GROUP_FLOATS * g];
+            __m128 near = zero;
+            __m128 far = best;
+            for (int j = 0; j < 3; j++)
+            {
+                __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group + BOX_GROUP_SIZE * j),
+                        o[j]), d[j]);
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(group
+                        + BOX_GROUP_SIZE * (3 + j)), o[j]), d[j]);
+                __m128 isOrdered = _mm_cmpord_ps(t0, t1);
+                near = _mm_max_ps(_mm_or_ps(_mm_and_ps(isOrdered, _mm_min_ps(t0, t1)),
+                        _mm_andnot_ps(isOrdered, near)), near);
+                far = _mm_min_ps(_mm_or_ps(_mm_and_ps(isOrdered, _mm_max_ps(t0, t1)),
+                        _mm_andnot_ps(isOrdered, far)), far);
+            }
+            __m128 isHit = _mm_and_ps(_mm_cmple_ps(near, far), _mm_cmplt_ps(near, best));
+            __m128i isBox = _mm_castps_si128(isHit);
+            best = _mm_or_ps(_mm_and_ps(isHit, near), _mm_andnot_ps(isHit, best));
+            bestBox = _mm_or_si128(_mm_and_si128(isBox, boxes), _mm_andnot_si128(isBox, bestBox));
+            boxes = _mm_add_epi32(boxes, step);
+        }
+
+        /* Take the nearest of the lanes' boxes */
+        float distances[BOX_GROUP_SIZE];
+        int indices[BOX_GROUP_SIZE];
+        _mm_storeu_ps(distances, best);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), bestBox);
+        for (int k = 0; k < BOX_GROUP_SIZE; k++)
+        {
+            if (0 <= indices[k] && (distances[k] < hit.distance
+                    || (distances[k] == hit.distance && (0 > hit.box || indices[k] < hit.box))))
+            {
+                hit.distance = distances[k];
+                hit.box = indices[k];
+            }
+        }
+#else
+        for (size_t g = 0; g < BOX_GROUP_SIZE * rayJob->groupCount; g++)
+        {
+            const float* group = &rayJob->boxes[BOX_GROUP_FLOATS * (g / BOX_GROUP_SIZE)];
+            float bounds[6];
+            for (int j = 0; j < 6; j++)
+            {
+                bounds[j] = group[BOX_GROUP_SIZE * j + g % BOX_GROUP_SIZE];
+            }
+
+            float entry;
+            if (MeshBvh::IntersectBox(bounds, origin, inverse, hit.distance, entry)
+                    && entry < hit.distance)
+            {
+                hit.distance = entry;
+                hit.box = static_cast<int>(g);
+            }
+        }
+#endif
+    }
+} /* findBoxes() */
+
+/**
+ * Finds the nearest triangle each ray of a range of packets hits
+ * @param job - The rays' shared state
+ * @param begin - The index of the first packet
+ * @param end - One past the index of the last packet
+ */
+static void findTriangles(void* job, size_t begin, size_t end)
+{
+    RayJob* rayJob = static_cast<RayJob*>(job);
+    size_t rayCount = rayJob->rays->GetSize();
+
+    for (size_t p = begin; p < end; p++)
+    {
+        RayPacket packet;
+        RayHit hits[RAY_PACKET_SIZE];
+        size_t first = RAY_PACKET_SIZE * p;
+
+        rayJob->rays->GetPacket(first, packet);
+        rayJob->bvh->IntersectPacket(packet, hits);
+        for (size_t k = 0; k < RAY_PACKET_SIZE && first + k < rayCount; k++)
+        {
+            rayJob->rayHits[first + k] = hits[k];
+        }
+    }
+} /* findTriangles() */
+
+/**
+ * Removes every ray from the batch
+ */
+void RayBatch::Clear()
+{
+    for (int j = 0; j < 3; j++)
+    {
+        origins[j].clear();
+        directions[j].clear();
+        inverses[j].clear();
+    }
+    maxDistances.clear();
+} /* RayBatch::Clear() */
+
+/**
+ * Makes room for a number of rays, so adding them does not reallocate
+ * @param count - The number of rays the batch is to hold
+ */
+void RayBatch::Reserve(size_t count)
+{
+    for (int j = 0; j < 3; j++)
+    {
+        origins[j].reserve(count);
+        directions[j].reserve(count);
+        inverses[j].reserve(count);
+    }
+    maxDistances.reserve(count);
+} /* RayBatch::Reserve() */
+
+/**
+ * Adds a ray to the batch; rays added next to each other should start close together and
+ * point much the same way, since they are cast against a hierarchy four at a time
+ * @param origin - The ray's origin
+ * @param direction - The ray's direction, which need not be unit length
+ * @param maxDistance - The farthest along the ray that counts, in lengths of its direction
+ */
+void RayBatch::Add(const float origin[3], const float direction[3], float maxDistance)
+{
+    for (int j = 0; j < 3; j++)
+    {
+        origins[j].push_back(origin[j]);
+        directions[j].push_back(direction[j]);
+        inverses[j].push_back(1.0f / direction[j]);
+    }
+    maxDistances.push_back(maxDistance);
+} /* RayBatch::Add() */
+
+/**
+ * Returns the number of rays in the batch
+ * @return - The number of rays added since the batch was last cleared
+ */
+size_t RayBatch::GetSize() const
+{
+    return maxDistances.size();
+} /* RayBatch::GetSize() */
+
+/**
+ * Copies a ray out of the batch
+ * @param index - The index of the ray
+ * @param origin - Returned with the ray's origin
+ * @param direction - Returned with the ray's direction
+ * @param inverse - Returned with the reciprocals of the direction's components
+ * @param maxDistance - Returned with the farthest along the ray that counts
+ */
+void RayBatch::GetRay(size_t index, float origin[3], float direction[3], float inverse[3],
+        float& maxDistance) const
+{
+    for (int j = 0; j < 3; j++)
+    {
+        origin[j] = origins[j][index];
+        direction[j] = directions[j][index];
+        inverse[j] = inverses[j][index];
+    }
+    maxDistance = maxDistances[index];
+} /* RayBatch::GetRay() */
+
+/**
+ * Copies the rays from an index on into a packet; the lanes past the last ray are left with
+ * no ray
+ * @param first - The index of the packet's first ray
+ * @param packet - Returned with the rays
+ */
+void RayBatch::GetPacket(size_t first, RayPacket& packet) const
+{
+    for (size_t k = 0; k < RAY_PACKET_SIZE; k++)
+    {
+        size_t i = first + k < GetSize() ? first + k : first;
+        for (int j = 0; j < 3; j++)
+        {
+            packet.origins[j][k] = origins[j][i];
+            packet.directions[j][k] = directions[j][i];
+            packet.inverses[j][k] = inverses[j][i];
+        }
+        packet.maxDistances[k] = first + k < GetSize() ? maxDistances[i] : -1.0f;
+    }
+} /* RayBatch::GetPacket() */
+
+/**
+ * Finds the nearest box each ray enters, no farther than its farthest distance; a ray which
+ * starts inside a box enters it at 0
+ * The boxes are laid out by axis in groups once, then each ray is tested against a group at a
+ * time, with the rays split among the jobs
+ * @param bounds - Each box as minimum x, y, z then maximum x, y, z, in the rays' space
+ * @param boxCount - The number of boxes
+ * @param hits - Returned with each ray's nearest box, or -1 if it enters none; on a tie the
+ * earlier box is taken
+ * @param jobs - The job system which casts the rays in parallel, or NULL
+ */
+void RayBatch::IntersectBoxes(const float* bounds, size_t boxCount, std::vector<BoxHit>& hits,
+        JobSystem* jobs) const
+{
+    hits.resize(GetSize());
+    if (hits.empty())
+    {
+        return;
+    }
+
+    /* A box at infinity fills out the last group, which every ray misses */
+    size_t groupCount = (boxCount + BOX_GROUP_SIZE - 1) / BOX_GROUP_SIZE;
+    std::vector<float> boxes(BOX_GROUP_FLOATS * groupCount,
+            std::numeric_limits<float>::infinity());
+    for (size_t b = 0; b < boxCount; b++)
+    {
+        float* group = &boxes[BOX_GROUP_FLOATS * (b / BOX_GROUP_SIZE)];
+        for (int j = 0; j < 6; j++)
+        {
+            group[BOX_GROUP_SIZE * j + b % BOX_GROUP_SIZE] = bounds[6 * b + j];
+        }
+    }
+
+    RayJob job;
+    job.rays = this;
+    for (int j = 0; j < 3; j++)
+    {
+        job.origins[j] = &origins[j][0];
+        job.inverses[j] = &inverses[j][0];
+    }
+    job.maxDistances = &maxDistances[0];
+    job.boxes = boxes.empty() ? NULL : &boxes[0];
+    job.groupCount = groupCount;
+    job.bvh = NULL;
+    job.boxHits = &hits[0];
+    job.rayHits = NULL;
+    JobSystem::ParallelFor(jobs, GetSize(), RAY_BATCH_GRAIN, findBoxes, &job);
+} /* RayBatch::IntersectBoxes() */
+
+/**
+ * Finds the nearest triangle of a mesh's hierarchy each ray hits, no farther than its farthest
+ * distance, casting the rays in packets of consecutive rays split among the jobs
+ * @param bvh - The hierarchy, in the rays' space
+ * @param hits - Returned with each ray's nearest hit, or a face of -1 if it hits nothing
+ * @param jobs - The job system which casts the packets in parallel, or NULL
+ */
+void RayBatch::IntersectBvh(const MeshBvh& bvh, std::vector<RayHit>& hits, JobSystem* jobs) const
+{
+    hits.resize(GetSize());
+    if (hits.empty())
+    {
+        return;
+    }
+
+    RayJob job;
+    job.rays = this;
+    job.boxes = NULL;
+    job.groupCount = 0;
+    job.bvh = &bvh;
+    job.boxHits = NULL;
+    job.rayHits = &hits[0];
+    JobSystem::ParallelFor(jobs, (GetSize() + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE,
+            RAY_BATCH_GRAIN, findTriangles, &job);
+} /* RayBatch::IntersectBvh() */
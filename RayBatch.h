@@ -0,0 +1,54 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: RayBatch.h
+ *
+ * A C++ module implementing a batch of rays laid out by axis
+ * with their inverse directions worked out once, which finds
+ * the nearest of a set of boxes each ray enters, testing four
+ * boxes at a time with SSE2, or the nearest triangle of a
+ * mesh's hierarchy each ray hits, four rays at a time.
+ */
+
+#ifndef RAYBATCH_H_
+#define RAYBATCH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "JobSystem.h"
+#include "MeshBvh.h"
+
+/* Where a ray first enters one of a set of boxes */
+struct BoxHit
+{
+    float distance;     /* how far along the ray it enters the box, in lengths of its direction */
+    int box;            /* the index of the box, or -1 if the ray misses them all */
+}; /* BoxHit struct */
+
+class RayBatch
+{
+public:
+    /* Member functions */
+    void Clear();
+    void Reserve(size_t count);
+    void Add(const float origin[3], const float direction[3], float maxDistance);
+    size_t GetSize() const;
+    void GetRay(size_t index, float origin[3], float direction[3], float inverse[3],
+            float& maxDistance) const;
+    void GetPacket(size_t first, RayPacket& packet) const;
+    void IntersectBoxes(const float* bounds, size_t boxCount, std::vector<BoxHit>& hits,
+            JobSystem* jobs) const;
+    void IntersectBvh(const MeshBvh& bvh, std::vector<RayHit>& hits, JobSystem* jobs) const;
+
+private:
+    /* Private data members */
+    std::vector<float> origins[3];      /* the rays' origins, x then y then z */
+    std::vector<float> directions[3];   /* the rays' directions, x then y then z */
+    std::vector<float> inverses[3];     /* the reciprocals of the directions' components */
+    std::vector<float> maxDistances;    /* the farthest along each ray that counts */
+}; /* RayBatch class */
+
+#endif /* RAYBATCH_H_ */
@@ -0,0 +1,761 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: RayTracer.cpp
+ *
+ * A C++ module implementing an offline renderer which traces
+ * the scene on the CPU, one ray through each pixel, walking
+ * a hierarchy over the models' boxes and then each model's
+ * own hierarchy with packets of four rays, and shading the
+ * nearest hit as the Blinn-Phong program does. The image is
+ * split into tiles which the jobs trace in parallel.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "FrameProfiler.h"
+#include "RayTracer.h"
+#include "VecMath.h"
+
+/* The width and height of a tile in pixels, even so that the 2x2 packets fill it */
+#define RAY_TRACER_TILE_SIZE 16
+
+/* The most tiles in one job's range; a tile alone is plenty of work for a job */
+#define RAY_TRACER_GRAIN 1
+
+/* The most models in a leaf of the hierarchy over their boxes */
+#define RAY_TRACER_MAX_LEAF_SIZE 2
+
+/* The deepest a walk of the hierarchy over the models' boxes can go, which halving the models
+ * at every split keeps well within
+ */
+#define RAY_TRACER_STACK_SIZE 64
+
+/* The model index of a hit on the ground or the sky */
+#define RAY_TRACER_ENVIRONMENT -1
+
+/* A part of the models still to be split while building the hierarchy over their boxes */
+struct InstanceTask
+{
+    int begin;          /* the first model in the order */
+    int end;            /* one past the last model in the order */
+    int parent;         /* the inner node whose second child this is, or -1 */
+}; /* InstanceTask struct */
+
+/* Orders models by their boxes' centers along an axis */
+struct CentroidLess
+{
+    const float* bounds;    /* each model's swept box */
+    int axis;               /* the axis the centers are compared along */
+
+    /**
+     * Tells whether one model's box lies before another's
+     * @param a - The index of the first model
+     * @param b - The index of the second model
+     * @return - True if the first box's center is nearer the axis' minimum
+     */
+    bool operator()(int a, int b) const
+    {
+        return bounds[6 * a + axis] + bounds[6 * a + 3 + axis]
+                < bounds[6 * b + axis] + bounds[6 * b + 3 + axis];
+    } /* operator()() */
+}; /* CentroidLess struct */
+
+/* The nearest surface a ray of a packet hits */
+struct PixelHit
+{
+    int model;          /* the model hit, or RAY_TRACER_ENVIRONMENT */
+    int face;           /* the face hit, or -1 if the ray hits nothing */
+    float u;            /* the barycentric weight of the face's second vertex */
+    float v;            /* the barycentric weight of the face's third vertex */
+}; /* PixelHit struct */
+
+/* What the jobs which trace the tiles of an image share */
+struct TraceJob
+{
+    const ModelArrays* models;                  /* the models posed in world space */
+    const float* rotations;                     /* each model's rotation about the y axis as
+                                                 * drawn, in degrees */
+    const float* heights;                       /* each model's center's y component as drawn */
+    const BvhNode* instanceNodes;               /* the hierarchy over the models' boxes, or
+                                                 * NULL */
+    const int* instances;                       /* each model's index, in the leaves' order */
+    const FaceList* environment;                /* the ground and sky, or NULL */
+    const MeshBvh* environmentBvh;              /* the hierarchy over their triangles */
+    const BlinnPhongMaterial* const* environmentMaterials; /* each of their triangles' material */
+    const BlinnPhongMaterial* modelMaterial;    /* the models' material */
+    const float* light;                         /* the light's position in world space */
+    float eye[3];                               /* the eye's position in world space */
+    float inverse[16];                          /* takes normalized device coordinates back to
+                                                 * world space */
+    int width;                                  /* the image's width in pixels */
+    int height;                                 /* the image's height in pixels */
+    int tilesAcross;                            /* the tiles along each row */
+    unsigned char* pixels;                      /* the image, rows from the top */
+    long* modelHits;                            /* each tile's rays which hit a model */
+    long* environmentHits;                      /* each tile's rays which hit the environment */
+}; /* TraceJob struct */
+
+/**
+ * Carries a packet from world space into a model's space by undoing the model's translation,
+ * rotation about the y axis, and scale; distances along the rays are the same in both spaces
+ * @param job - The image's shared state, with the models' poses
+ * @param index - The index of the model
+ * @param packet - The rays in world space
+ * @param modelPacket - Returned with the rays in the model's space
+ */
+static void toModelSpace(const TraceJob* job, int index, const RayPacket& packet,
+        RayPacket& modelPacket)
+{
+    const ModelArrays* models = job->models;
+    float scale = models->scaleFactors[index];
+    float radians = job->rotations[index] * static_cast<float>(M_PI) / 180.0f;
+    float c = cosf(radians) / scale;
+    float s = sinf(radians) / scale;
+
+    for (int k = 0; k < RAY_PACKET_SIZE; k++)
+    {
+        float x = packet.origins[0][k] - models->worldCentersX[index];
+        float y = packet.origins[1][k] - job->heights[index];
+        float z = packet.origins[2][k] - models->worldCentersZ[index];
+        const float direction[3] =
+        {
+            packet.directions[0][k], packet.directions[1][k], packet.directions[2][k]
+        };
+
+        modelPacket.origins[0][k] = c * x - s * z;
+        modelPacket.origins[1][k] = y / scale;
+        modelPacket.origins[2][k] = s * x + c * z;
+        modelPacket.directions[0][k] = c * direction[0] - s * direction[2];
+        modelPacket.directions[1][k] = direction[1] / scale;
+        modelPacket.directions[2][k] = s * direction[0] + c * direction[2];
+        for (int j = 0; j < 3; j++)
+        {
+            modelPacket.inverses[j][k] = 1.0f / modelPacket.directions[j][k];
+        }
+        modelPacket.maxDistances[k] = packet.maxDistances[k];
+    }
+} /* toModelSpace() */
+
+/**
+ * Finds the nearest surface each ray of a packet hits, the environment first so that its hits
+ * cut the walk of the models short
+ * @param job - The image's shared state
+ * @param packet - The rays in world space, each returned with its farthest distance cut down
+ *                 to its nearest hit
+ * @param hits - Returned with each ray's nearest hit
+ */
+static void tracePacket(const TraceJob* job, RayPacket& packet, PixelHit hits[RAY_PACKET_SIZE])
+{
+    RayHit rayHits[RAY_PACKET_SIZE];
+
+    for (int k = 0; k < RAY_PACKET_SIZE; k++)
+    {
+        hits[k].model = RAY_TRACER_ENVIRONMENT;
+        hits[k].face = -1;
+    }
+
+    if (NULL != job->environment)
+    {
+        int mask = job->environmentBvh->IntersectPacket(packet, rayHits, true);
+        for (int k = 0; k < RAY_PACKET_SIZE; k++)
+        {
+            if (0 != (mask & (1 << k)))
+            {
+                packet.maxDistances[k] = rayHits[k].distance;
+                hits[k].face = rayHits[k].face;
+                hits[k].u = rayHits[k].u;
+                hits[k].v = rayHits[k].v;
+            }
+        }
+    }
+
+    if (NULL == job->instanceNodes)
+    {
+        return;
+    }
+
+    const ModelArrays* models = job->models;
+    int stack[RAY_TRACER_STACK_SIZE];
+    int top = 0;
+    int index = 0;
+
+    for (;;)
+    {
+        /* Skip a node which every ray misses or has found a nearer hit than */
+        const BvhNode& node = job->instanceNodes[index];
+        int active = MeshBvh::IntersectBoxPacket(node.bounds, packet);
+
+        if (0 != active && 0 == node.count)
+        {
+            /* Visit first the child whose center lies farther ahead along the first active
+             * ray, as the models' own hierarchies do
+             */
+            int lane = 0;
+            while (0 == (active & (1 << lane)))
+            {
+                lane++;
+            }
+            int first = index + 1;
+            int second = node.start;
+            const float* a = job->instanceNodes[first].bounds;
+            const float* b = job->instanceNodes[second].bounds;
+            float ahead = 0.0f;
+            for (int j = 0; j < 3; j++)
+            {
+                ahead += (b[j] + b[3 + j] - a[j] - a[3 + j]) * packet.directions[j][lane];
+            }
+            if (0.0f > ahead)
+            {
+                std::swap(first, second);
+            }
+            stack[top++] = second;
+            index = first;
+            continue;
+        }
+        else if (0 != active)
+        {
+            for (int i = node.start; i < node.start + node.count; i++)
+            {
+                int model = job->instances[i];
+                if (0 == MeshBvh::IntersectBoxPacket(&models->sweptBounds[6 * model], packet))
+                {
+                    continue;
+                }
+
+                RayPacket modelPacket;
+                toModelSpace(job, model, packet, modelPacket);
+                int mask = models->bvhs[model]->IntersectPacket(modelPacket, rayHits, true);
+                for (int k = 0; k < RAY_PACKET_SIZE; k++)
+                {
+                    if (0 != (mask & (1 << k)))
+                    {
+                        packet.maxDistances[k] = rayHits[k].distance;
+                        hits[k].model = model;
+                        hits[k].face = rayHits[k].face;
+                        hits[k].u = rayHits[k].u;
+                        hits[k].v = rayHits[k].v;
+                    }
+                }
+            }
+        }
+
+        if (0 == top)
+        {
+            break;
+        }
+        index = stack[--top];
+    }
+} /* tracePacket() */
+
+/**
+ * Normalizes a vector unless it has no length
+ * @param v - The vector, returned with unit length
+ */
+static void normalize(float v[3])
+{
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (0.0f < length)
+    {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+} /* normalize() */
+
+/**
+ * Shades a ray's nearest hit with the Blinn-Phong program's equation: the ambient color plus
+ * the diffuse and specular shares of the light, worked out in world space rather than eye
+ * space, which gives the same angles
+ * @param job - The image's shared state
+ * @param packet - The rays in world space, each cut down to its nearest hit
+ * @param k - The ray's lane in the packet
+ * @param hit - The ray's nearest hit, which must be on a face
+ * @param pixel - Returned with the red, green and blue of the hit
+ */
+static void shade(const TraceJob* job, const RayPacket& packet, int k, const PixelHit& hit,
+        unsigned char pixel[3])
+{
+    const FaceList* faceList = RAY_TRACER_ENVIRONMENT == hit.model
+            ? job->environment : job->models->faceLists[hit.model];
+    const BlinnPhongMaterial* material = RAY_TRACER_ENVIRONMENT == hit.model
+            ? job->environmentMaterials[hit.face] : job->modelMaterial;
+    const int* face = faceList->faces[hit.face];
+    float w = 1.0f - hit.u - hit.v;
+
+    /* Interpolate the vertex normals across the face, as the rasterizer does */
+    float position[3];
+    float normal[3];
+    for (int j = 0; j < 3; j++)
+    {
+        position[j] = packet.origins[j][k] + packet.maxDistances[k] * packet.directions[j][k];
+        normal[j] = static_cast<float>(w * faceList->v_normals[face[0]][j]
+                + hit.u * faceList->v_normals[face[1]][j]
+                + hit.v * faceList->v_normals[face[2]][j]);
+    }
+
+    /* A model's normal turns with it about the y axis; its scale is undone by normalizing */
+    if (RAY_TRACER_ENVIRONMENT != hit.model)
+    {
+        float radians = job->rotations[hit.model] * static_cast<float>(M_PI) / 180.0f;
+        float c = cosf(radians);
+        float s = sinf(radians);
+        float x = normal[0];
+        normal[0] = c * x + s * normal[2];
+        normal[2] = -s * x + c * normal[2];
+    }
+
+    float toLight[3];
+    float toEye[3];
+    float halfway[3];
+    for (int j = 0; j < 3; j++)
+    {
+        toLight[j] = job->light[j] - position[j];
+        toEye[j] = job->eye[j] - position[j];
+    }
+    normalize(normal);
+    normalize(toLight);
+    normalize(toEye);
+    for (int j = 0; j < 3; j++)
+    {
+        halfway[j] = toLight[j] + toEye[j];
+    }
+    normalize(halfway);
+
+    float nDotL = std::max(0.0f, normal[0] * toLight[0] + normal[1] * toLight[1]
+            + normal[2] * toLight[2]);
+    float nDotH = std::max(0.0f, normal[0] * halfway[0] + normal[1] * halfway[1]
+            + normal[2] * halfway[2]);
+    float highlight = powf(nDotH, material->shininess);
+    for (int j = 0; j < 3; j++)
+    {
+        float color = material->ambient[j]
+                + material->diffuse[j] * material->lightColor[j] * nDotL
+                + material->specular[j] * material->lightColor[j] * highlight;
+        color = std::min(1.0f, std::max(0.0f, color));
+        pixel[j] = static_cast<unsigned char>(255.0f * color + 0.5f);
+    }
+} /* shade() */
+
+/**
+ * Traces and shades a range of tiles, casting a ray through each pixel's center from the near
+ * plane to the far plane, 2x2 pixels to a packet
+ * @param job - The image's shared state
+ * @param begin - The index of the first tile
+ * @param end - One past the index of the last tile
+ */
+static void traceTiles(void* job, size_t begin, size_t end)
+{
+    TraceJob* traceJob = static_cast<TraceJob*>(job);
+    int width = traceJob->width;
+    int height = traceJob->height;
+
+    for (size_t tile = begin; tile < end; tile++)
+    {
+        int left = static_cast<int>(tile % traceJob->tilesAcross) * RAY_TRACER_TILE_SIZE;
+        int top = static_cast<int>(tile / traceJob->tilesAcross) * RAY_TRACER_TILE_SIZE;
+        int right = std::min(width, left + RAY_TRACER_TILE_SIZE);
+        int bottom = std::min(height, top + RAY_TRACER_TILE_SIZE);
+        long modelHits = 0;
+        long environmentHits = 0;
+
+        for (int y = top; y < bottom; y += 2)
+        {
+            for (int x = left; x < right; x += 2)
+            {
+                /* Unproject each pixel's center on the near and far planes; a lane past the
+                 * edge of the image has no ray
+                 */
+                RayPacket packet;
+                for (int k = 0; k < RAY_PACKET_SIZE; k++)
+                {
+                    int column = x + (k & 1);
+                    int row = y + (k >> 1);
+                    float ndcX = 2.0f * (column + 0.5f) / width - 1.0f;
+                    float ndcY = 1.0f - 2.0f * (row + 0.5f) / height;
+                    float nearPoint[4] = {ndcX, ndcY, -1.0f, 1.0f};
+                    float farPoint[4] = {ndcX, ndcY, 1.0f, 1.0f};
+                    matMultVec4f(nearPoint, nearPoint, traceJob->inverse);
+                    matMultVec4f(farPoint, farPoint, traceJob->inverse);
+
+                    for (int j = 0; j < 3; j++)
+                    {
+                        packet.origins[j][k] = nearPoint[j] / nearPoint[3];
+                        packet.directions[j][k] = farPoint[j] / farPoint[3]
+                                - packet.origins[j][k];
+                        packet.inverses[j][k] = 1.0f / packet.directions[j][k];
+                    }
+                    packet.maxDistances[k] = column < right && row < bottom ? 1.0f : -1.0f;
+                }
+
+                PixelHit hits[RAY_PACKET_SIZE];
+                tracePacket(traceJob, packet, hits);
+
+                /* A ray which hits nothing leaves the pixel the black the rasterizer clears
+                 * to
+                 */
+                for (int k = 0; k < RAY_PACKET_SIZE; k++)
+                {
+                    int column = x + (k & 1);
+                    int row = y + (k >> 1);
+                    if (column >= right || row >= bottom)
+                    {
+                        continue;
+                    }
+
+                    unsigned char* pixel = &traceJob->pixels[3 * (row * width + column)];
+                    pixel[0] = pixel[1] = pixel[2] = 0;
+                    if (0 > hits[k].face)
+                    {
+                        continue;
+                    }
+
+                    shade(traceJob, packet, k, hits[k], pixel);
+                    if (RAY_TRACER_ENVIRONMENT == hits[k].model)
+                    {
+                        environmentHits++;
+                    }
+                    else
+                    {
+                        modelHits++;
+                    }
+                }
+            }
+        }
+
+        traceJob->modelHits[tile] = modelHits;
+        traceJob->environmentHits[tile] = environmentHits;
+    }
+} /* traceTiles() */
+
+/**
+ * Default constructor
+ */
+RayTracer::RayTracer()
+    : environment(NULL)
+    , modelMaterial(NULL)
+{
+    light[0] = light[1] = light[2] = 0.0f;
+    memset(&stats, 0, sizeof(stats));
+} /* Default constructor */
+
+/**
+ * Destructor
+ */
+RayTracer::~RayTracer()
+{
+    delete environment;
+} /* Destructor */
+
+/**
+ * Adds static triangles in world space which the rays can hit besides the models, such as the
+ * ground and the sky; the hierarchy over them is built by the next Render()
+ * @param vertices - The triangles' vertices, whose positions and normals are used
+ * @param indices - Three vertices per triangle
+ * @param material - The triangles' material, which must outlive the ray tracer
+ */
+void RayTracer::AddEnvironment(const std::vector<GpuVertex>& vertices,
+        const std::vector<GLuint>& indices, const BlinnPhongMaterial* material)
+{
+    int first = static_cast<int>(environmentVertices.size() / 6);
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        environmentVertices.insert(environmentVertices.end(), vertices[i].position,
+                vertices[i].position + 3);
+        environmentVertices.insert(environmentVertices.end(), vertices[i].normal,
+                vertices[i].normal + 3);
+    }
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        environmentIndices.push_back(first + static_cast<int>(indices[i]));
+    }
+    environmentMaterials.resize(environmentIndices.size() / 3, material);
+
+    delete environment;
+    environment = NULL;
+} /* RayTracer::AddEnvironment() */
+
+/**
+ * Sets the material every model is shaded with
+ * @param material - The models' material, which must outlive the ray tracer
+ */
+void RayTracer::SetModelMaterial(const BlinnPhongMaterial* material)
+{
+    modelMaterial = material;
+} /* RayTracer::SetModelMaterial() */
+
+/**
+ * Sets where the light is
+ * @param position - The light's position in world space
+ */
+void RayTracer::SetLight(const float position[3])
+{
+    for (int j = 0; j < 3; j++)
+    {
+        light[j] = position[j];
+    }
+} /* RayTracer::SetLight() */
+
+/**
+ * Renders the ready models and the environment as the given camera sees them, splitting the
+ * image into tiles which the jobs trace
+ * Rays are traced only to the nearest hit, with no shadows, and miss the triangles facing away
+ * from them, so the image matches the rasterizer's lighting and face culling; the models are
+ * traced at their finest level of detail
+ * @param models - The models posed in world space
+ * @param modelCount - The number of models
+ * @param rotations - Each model's rotation about the y axis as drawn, in degrees, which differs
+ *                    from its pose in world space when the vertex shader posed it
+ * @param heights - Each model's center's y component as drawn
+ * @param view - The viewing matrix
+ * @param projection - The projection matrix, whose aspect ratio should match the image's
+ * @param width - The image's width in pixels
+ * @param height - The image's height in pixels
+ * @param jobs - The job system, or NULL to trace every tile on this thread
+ * @return - True if the image was rendered; otherwise, false
+ */
+bool RayTracer::Render(const ModelArrays* models, size_t modelCount,
+        const std::vector<float>& rotations, const std::vector<float>& heights,
+        const float view[16], const float projection[16], int width, int height,
+        JobSystem* jobs)
+{
+    TraceJob job;
+    float viewProjection[16];
+    float inverseView[16];
+
+    matMultMat4f(viewProjection, projection, view);
+    if (1 > width || 1 > height || NULL == modelMaterial || rotations.size() < modelCount
+            || heights.size() < modelCount
+            || !gluInvertMatrix(viewProjection, job.inverse)
+            || !gluInvertMatrix(view, inverseView))
+    {
+        return false;
+    }
+
+    double startTime = FrameProfiler::GetMilliseconds();
+    BuildEnvironment();
+    BuildInstances(models, modelCount);
+    stats.buildTime = FrameProfiler::GetMilliseconds() - startTime;
+
+    int tilesAcross = (width + RAY_TRACER_TILE_SIZE - 1) / RAY_TRACER_TILE_SIZE;
+    int tilesDown = (height + RAY_TRACER_TILE_SIZE - 1) / RAY_TRACER_TILE_SIZE;
+    int tileCount = tilesAcross * tilesDown;
+    std::vector<long> modelHits(tileCount);
+    std::vector<long> environmentHits(tileCount);
+    pixels.assign(3 * width * height, 0);
+
+    job.models = models;
+    job.rotations = rotations.empty() ? NULL : &rotations[0];
+    job.heights = heights.empty() ? NULL : &heights[0];
+    job.instanceNodes = instanceNodes.empty() ? NULL : &instanceNodes[0];
+    job.instances = instances.empty() ? NULL : &instances[0];
+    job.environment = environment;
+    job.environmentBvh = &environmentBvh;
+    job.environmentMaterials = environmentMaterials.empty() ? NULL : &environmentMaterials[0];
+    job.modelMaterial = modelMaterial;
+    job.light = light;
+    for (int j = 0; j < 3; j++)
+    {
+        job.eye[j] = inverseView[12 + j];
+    }
+    job.width = width;
+    job.height = height;
+    job.tilesAcross = tilesAcross;
+    job.pixels = &pixels[0];
+    job.modelHits = &modelHits[0];
+    job.environmentHits = &environmentHits[0];
+
+    startTime = FrameProfiler::GetMilliseconds();
+    JobSystem::ParallelFor(jobs, tileCount, RAY_TRACER_GRAIN, traceTiles, &job);
+    stats.traceTime = FrameProfiler::GetMilliseconds() - startTime;
+
+    stats.width = width;
+    stats.height = height;
+    stats.tileCount = tileCount;
+    stats.instanceCount = static_cast<int>(instances.size());
+    stats.instanceNodeCount = static_cast<int>(instanceNodes.size());
+    stats.rayCount = static_cast<long>(width) * height;
+    stats.modelHitCount = 0;
+    stats.environmentHitCount = 0;
+    for (int i = 0; i < tileCount; i++)
+    {
+        stats.modelHitCount += modelHits[i];
+        stats.environmentHitCount += environmentHits[i];
+    }
+
+    return true;
+} /* RayTracer::Render() */
+
+/**
+ * Writes the last image rendered as a binary PPM file
+ * @param filename - The file to write
+ * @return - True if the image was written; otherwise, false
+ */
+bool RayTracer::WriteImage(const char* filename) const
+{
+    if (pixels.empty())
+    {
+        return false;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (NULL == file)
+    {
+        perror(filename);
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", stats.width, stats.height);
+    bool isWritten = pixels.size() == fwrite(&pixels[0], 1, pixels.size(), file);
+    if (!isWritten)
+    {
+        perror(filename);
+    }
+
+    return 0 == fclose(file) && isWritten;
+} /* RayTracer::WriteImage() */
+
+/**
+ * Returns how long the last image took and what its rays hit
+ * @return - The last image's statistics
+ */
+const RayTraceStats& RayTracer::GetStats() const
+{
+    return stats;
+} /* RayTracer::GetStats() */
+
+/**
+ * Copies the environment's triangles into a face list and builds the hierarchy over them,
+ * unless that was done since the last triangles were added
+ */
+void RayTracer::BuildEnvironment()
+{
+    if (NULL != environment || environmentIndices.empty())
+    {
+        return;
+    }
+
+    int vertexCount = static_cast<int>(environmentVertices.size() / 6);
+    int faceCount = static_cast<int>(environmentIndices.size() / 3);
+    environment = new FaceList(vertexCount, faceCount);
+    for (int i = 0; i < vertexCount; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            environment->vertices[i][j] = environmentVertices[6 * i + j];
+            environment->v_normals[i][j] = environmentVertices[6 * i + 3 + j];
+        }
+    }
+    for (int i = 0; i < faceCount; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            environment->faces[i][k] = environmentIndices[3 * i + k];
+        }
+    }
+
+    environmentBvh.Build(environment);
+} /* RayTracer::BuildEnvironment() */
+
+/**
+ * Builds the hierarchy over the swept boxes of the models which can be hit, halving the
+ * models at the median of their boxes' centers along the widest axis
+ * @param models - The models posed in world space
+ * @param modelCount - The number of models
+ */
+void RayTracer::BuildInstances(const ModelArrays* models, size_t modelCount)
+{
+    instanceNodes.clear();
+    instances.clear();
+
+    for (size_t i = 0; i < modelCount; i++)
+    {
+        if (models->isReady[i] && NULL != models->bvhs[i] && NULL != models->faceLists[i])
+        {
+            instances.push_back(static_cast<int>(i));
+        }
+    }
+    if (instances.empty())
+    {
+        return;
+    }
+
+    /* Split depth first, so that each inner node's first child comes right after it */
+    const float* bounds = &models->sweptBounds[0];
+    int instanceCount = static_cast<int>(instances.size());
+    instanceNodes.reserve(2 * instanceCount);
+    std::vector<InstanceTask> tasks;
+    InstanceTask root = {0, instanceCount, -1};
+    tasks.push_back(root);
+    while (!tasks.empty())
+    {
+        InstanceTask task = tasks.back();
+        tasks.pop_back();
+
+        int index = static_cast<int>(instanceNodes.size());
+        if (0 <= task.parent)
+        {
+            instanceNodes[task.parent].start = index;
+        }
+
+        BvhNode node;
+        float centroidBounds[6] = {FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for (int j = 0; j < 3; j++)
+        {
+            node.bounds[j] = FLT_MAX;
+            node.bounds[3 + j] = -FLT_MAX;
+        }
+        for (int i = task.begin; i < task.end; i++)
+        {
+            const float* box = &bounds[6 * instances[i]];
+            for (int j = 0; j < 3; j++)
+            {
+                float center = 0.5f * (box[j] + box[3 + j]);
+                node.bounds[j] = std::min(node.bounds[j], box[j]);
+                node.bounds[3 + j] = std::max(node.bounds[3 + j], box[3 + j]);
+                centroidBounds[j] = std::min(centroidBounds[j], center);
+                centroidBounds[3 + j] = std::max(centroidBounds[3 + j], center);
+            }
+        }
+
+        if (RAY_TRACER_MAX_LEAF_SIZE >= task.end - task.begin)
+        {
+            node.start = task.begin;
+            node.count = task.end - task.begin;
+            instanceNodes.push_back(node);
+            continue;
+        }
+
+        CentroidLess less;
+        less.bounds = bounds;
+        less.axis = 0;
+        for (int j = 1; j < 3; j++)
+        {
+            if (centroidBounds[3 + j] - centroidBounds[j]
+                    > centroidBounds[3 + less.axis] - centroidBounds[less.axis])
+            {
+                less.axis = j;
+            }
+        }
+        int middle = (task.begin + task.end) / 2;
+        std::nth_element(instances.begin() + task.begin, instances.begin() + middle,
+                instances.begin() + task.end, less);
+
+        node.start = -1;
+        node.count = 0;
+        instanceNodes.push_back(node);
+
+        /* The first child is popped next, so it lands right after its parent */
+        InstanceTask second = {middle, task.end, index};
+        InstanceTask first = {task.begin, middle, -1};
+        tasks.push_back(second);
+        tasks.push_back(first);
+    }
+} /* RayTracer::BuildInstances() */
@@ -0,0 +1,98 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: RayTracer.h
+ *
+ * A C++ module implementing an offline renderer which traces
+ * the scene on the CPU, one ray through each pixel, walking
+ * a hierarchy over the models' boxes and then each model's
+ * own hierarchy with packets of four rays, and shading the
+ * nearest hit as the Blinn-Phong program does. The image is
+ * split into tiles which the jobs trace in parallel.
+ */
+
+#ifndef RAYTRACER_H_
+#define RAYTRACER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "FaceList.h"
+#include "GpuMesh.h"
+#include "JobSystem.h"
+#include "MeshBvh.h"
+#include "Scene.h"
+
+/* A surface's uniforms in the Blinn-Phong program */
+struct BlinnPhongMaterial
+{
+    float lightColor[4];    /* the light's color on the surface */
+    float ambient[4];       /* the color the surface has unlit */
+    float diffuse[4];       /* the share of the light scattered evenly */
+    float specular[4];      /* the share of the light reflected toward the halfway vector */
+    float shininess;        /* the exponent of the specular highlight */
+}; /* BlinnPhongMaterial struct */
+
+/* How long the last image took and what its rays hit */
+struct RayTraceStats
+{
+    int width;              /* the image's width in pixels */
+    int height;             /* the image's height in pixels */
+    int tileCount;          /* the tiles the image was split into */
+    int instanceCount;      /* the models the rays were traced against */
+    int instanceNodeCount;  /* the nodes of the hierarchy over the models' boxes */
+    long rayCount;          /* the rays traced, one per pixel */
+    long modelHitCount;     /* the rays whose nearest hit was a model */
+    long environmentHitCount; /* the rays whose nearest hit was the ground or the sky */
+    double buildTime;       /* ms to build the hierarchy over the models' boxes */
+    double traceTime;       /* ms to trace and shade every tile */
+}; /* RayTraceStats struct */
+
+class RayTracer
+{
+public:
+    /* Default constructor */
+    RayTracer();
+
+    /* Destructor */
+    ~RayTracer();
+
+    /* Member functions */
+    void AddEnvironment(const std::vector<GpuVertex>& vertices,
+            const std::vector<GLuint>& indices, const BlinnPhongMaterial* material);
+    void SetModelMaterial(const BlinnPhongMaterial* material);
+    void SetLight(const float position[3]);
+    bool Render(const ModelArrays* models, size_t modelCount,
+            const std::vector<float>& rotations, const std::vector<float>& heights,
+            const float view[16], const float projection[16], int width, int height,
+            JobSystem* jobs);
+    bool WriteImage(const char* filename) const;
+    const RayTraceStats& GetStats() const;
+
+private:
+    /* Private helper functions */
+    void BuildEnvironment();
+    void BuildInstances(const ModelArrays* models, size_t modelCount);
+
+    /* Private data members */
+    std::vector<float> environmentVertices;     /* the ground's and sky's positions then
+                                                 * normals, 6 floats apiece */
+    std::vector<int> environmentIndices;        /* three vertices per triangle */
+    std::vector<const BlinnPhongMaterial*> environmentMaterials; /* each triangle's material */
+    FaceList* environment;                      /* the triangles, once they are all added */
+    MeshBvh environmentBvh;                     /* the hierarchy over the triangles */
+    const BlinnPhongMaterial* modelMaterial;    /* the models' material */
+    float light[3];                             /* the light's position in world space */
+    std::vector<BvhNode> instanceNodes;         /* the hierarchy over the models' boxes, depth
+                                                 * first from the root */
+    std::vector<int> instances;                 /* each model's index, in the leaves' order */
+    std::vector<unsigned char> pixels;          /* the red, green and blue of each pixel, rows
+                                                 * from the top */
+    RayTraceStats stats;                        /* how long the last image took */
+}; /* RayTracer class */
+
+#endif /* RAYTRACER_H_ */
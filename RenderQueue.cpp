@@ -0,0 +1,159 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: RenderQueue.cpp
+ *
+ * A C++ module implementing a queue of draw items which
+ * are sorted by a 64-bit key so that items sharing the
+ * same state are drawn together, opaque items are drawn
+ * front-to-back and transparent items back-to-front.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "RenderQueue.h"
+
+/*
+ * Sort key layout, from the most significant bit down:
+ *
+ *   opaque:       pass:2 | program:8 | material:8 | mesh:16 | unused:6 | depth:24
+ *   transparent:  pass:2 | ~depth:24 | program:8 | material:8 | mesh:16 | unused:6
+ *
+ * Opaque items are grouped by state first and then drawn nearest first for early-Z.
+ * Transparent items must be blended farthest first, so their depth outranks the state.
+ */
+#define SORT_KEY_PASS_SHIFT 62
+#define SORT_KEY_DEPTH_BITS 24
+#define SORT_KEY_DEPTH_MASK 0xFFFFFFu
+
+/**
+ * Quantizes a non-negative depth so that its integer order matches its float order
+ * @param depth - The distance from the eye
+ * @return - A 24-bit integer which increases with depth
+ */
+static uint64_t quantizeDepth(float depth)
+{
+    uint32_t bits;
+
+    /* Clamp to zero so that the sign bit is never set */
+    if (!(depth > 0.0f))
+    {
+        depth = 0.0f;
+    }
+
+    /* The bit patterns of non-negative IEEE floats sort in the same order as their values */
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits >> (31 - SORT_KEY_DEPTH_BITS)) & SORT_KEY_DEPTH_MASK;
+} /* quantizeDepth() */
+
+/**
+ * Default constructor
+ */
+RenderQueue::RenderQueue()
+{
+    /* empty */
+} /* Default constructor */
+
+/**
+ * Removes all the items from the queue, keeping the allocated storage for the next frame
+ */
+void RenderQueue::Clear()
+{
+    items.clear();
+    order.clear();
+} /* RenderQueue::Clear() */
+
+/**
+ * Adds a draw item to the queue
+ * @param pass - The pass the item is drawn in
+ * @param program - The index of the shader program used to draw the item
+ * @param material - The index of the material used to draw the item
+ * @param mesh - The index of the mesh drawn by the item
+ * @param depth - The item's distance from the eye along the gaze vector
+ * @param object - The object to draw
+ * @return - The new item, so the caller can fill in its modelview matrix
+ */
+DrawItem& RenderQueue::Push(RenderPass pass, unsigned int program, unsigned int material,
+        unsigned int mesh, float depth, void* object)
+{
+    DrawItem item;
+    item.sortKey = MakeSortKey(pass, program, material, mesh, depth);
+    item.pass = pass;
+    item.program = program;
+    item.material = material;
+    item.mesh = mesh;
+    item.depth = depth;
+    item.object = object;
+    item.id = 0;
+
+    order.push_back(std::make_pair(item.sortKey, items.size()));
+    items.push_back(item);
+
+    return items.back();
+} /* RenderQueue::Push() */
+
+/**
+ * Sorts the items by their sort keys
+ * Items with equal keys keep their submission order
+ */
+void RenderQueue::Sort()
+{
+    /* The item index breaks ties, so the sort is stable */
+    std::sort(order.begin(), order.end());
+} /* RenderQueue::Sort() */
+
+/**
+ * Returns the number of items in the queue
+ * @return - The number of items in the queue
+ */
+size_t RenderQueue::GetSize() const
+{
+    return items.size();
+} /* RenderQueue::GetSize() */
+
+/**
+ * Returns an item in sorted order
+ * @param index - The position of the item after sorting
+ * @return - The item at the given position
+ */
+const DrawItem& RenderQueue::operator[](size_t index) const
+{
+    return items[order[index].second];
+} /* RenderQueue::operator[]() */
+
+/**
+ * Builds the 64-bit key that draw items are sorted by
+ * @param pass - The pass the item is drawn in
+ * @param program - The index of the shader program used to draw the item
+ * @param material - The index of the material used to draw the item
+ * @param mesh - The index of the mesh drawn by the item
+ * @param depth - The item's distance from the eye along the gaze vector
+ * @return - The sort key
+ */
+uint64_t RenderQueue::MakeSortKey(RenderPass pass, unsigned int program, unsigned int material,
+        unsigned int mesh, float depth)
+{
+    uint64_t key = static_cast<uint64_t>(pass & 0x3u) << SORT_KEY_PASS_SHIFT;
+    uint64_t state = (static_cast<uint64_t>(program & 0xFFu) << 24)
+                   | (static_cast<uint64_t>(material & 0xFFu) << 16)
+                   | static_cast<uint64_t>(mesh & 0xFFFFu);
+    uint64_t depthBits = quantizeDepth(depth);
+
+    if (PASS_TRANSPARENT == pass)
+    {
+        /* Back-to-front: farther items get smaller keys */
+        key |= (~depthBits & SORT_KEY_DEPTH_MASK) << 38;
+        key |= state << 6;
+    }
+    else
+    {
+        /* Grouped by state, then front-to-back */
+        key |= state << 30;
+        key |= depthBits;
+    }
+
+    return key;
+} /* RenderQueue::MakeSortKey() */
@@ -0,0 +1,63 @@
+/*
+ * Programmer: Brian Mitzel
+ * Email: bmitzel@csu.fullerton.edu
+ * Course: CPSC 486
+ *
+ * Filename: RenderQueue.h
+ *
+ * A C++ module implementing a queue of draw items which
+ * are sorted by a 64-bit key so that items sharing the
+ * same state are drawn together, opaque items are drawn
+ * front-to-back and transparent items back-to-front.
+ */
+
+#ifndef RENDERQUEUE_H_
+#define RENDERQUEUE_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/* Render passes in the order they are drawn */
+enum RenderPass {PASS_OPAQUE, PASS_TRANSPARENT};
+
+/* A single draw submitted to the render queue */
+struct DrawItem
+{
+    uint64_t sortKey;       /* the key the queue is sorted by */
+    RenderPass pass;        /* the pass the item is drawn in */
+    unsigned int program;   /* the index of the shader program used to draw the item */
+    unsigned int material;  /* the index of the material used to draw the item */
+    unsigned int mesh;      /* the index of the mesh drawn by the item */
+    float depth;            /* the item's distance from the eye along the gaze vector */
+    void* object;           /* the object to draw, interpreted according to the material */
+    unsigned int id;        /* the id the item is drawn with in the id buffer, or 0 */
+    float modelview[16];    /* the modelview matrix to draw the item with */
+}; /* DrawItem struct */
+
+class RenderQueue
+{
+public:
+    /* Default constructor */
+    RenderQueue();
+
+    /* Member functions */
+    void Clear();
+    DrawItem& Push(RenderPass pass, unsigned int program, unsigned int material,
+            unsigned int mesh, float depth, void* object);
+    void Sort();
+    size_t GetSize() const;
+    const DrawItem& operator[](size_t index) const;
+
+    /* Static member functions */
+    static uint64_t MakeSortKey(RenderPass pass, unsigned int program, unsigned int material,
+            unsigned int mesh, float depth);
+
+private:
+    /* Private data members */
+    std::vector<DrawItem> items;                        /* the items in submission order */
+    std::vector<std::pair<uint64_t, size_t> > order;    /* sort keys and item indices */
+}; /* RenderQueue class */
+
+#endif /* RENDERQUEUE_H_ */
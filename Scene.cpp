@@ -6,16 +6,49 @@
  * Filename: Scene.cpp
  *
  * This is a C++ implementation of a Scene object which
- * contains a list of 3D Models and a Camera object.
+ * contains 3D Models and a Camera object. The data the
+ * models touch every frame is kept in one array per
+ * component, in the same dense order, so that each pass
+ * over the models streams through memory.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
 #include "Scene.h"
+#include "VecMath.h"
+
+/* The number of models animated in one batch, whose sines fit on the stack */
+#define MODEL_ANIMATION_BATCH 256
+
+/**
+ * Copies an element of a component array over another
+ * @param elements - The component array
+ * @param from - The index of the model to copy
+ * @param to - The index of the model to overwrite
+ * @param width - The number of elements per model
+ */
+template <class T>
+static void copyComponent(std::vector<T>& elements, size_t from, size_t to, size_t width)
+{
+    for (size_t i = 0; i < width; i++)
+    {
+        elements[width * to + i] = elements[width * from + i];
+    }
+} /* copyComponent() */
 
 /**
  * Default constructor initializes the camera
  */
 Scene::Scene()
-    : camera(0.0f, 1.5f, 6.0f, 0.0f, 1.5f, 5.0f, 0.0f, 1.0f, 0.0f)
+    : readyCount(0)
+    , attachedCount(0)
+    , isHierarchyChanged(false)
+    , camera(0.0f, 1.5f, 6.0f, 0.0f, 1.5f, 5.0f, 0.0f, 1.0f, 0.0f)
+    , jobs(NULL)
 {
     /* empty */
 } /* Default constructor */
@@ -25,33 +58,483 @@ Scene::Scene()
  */
 Scene::~Scene()
 {
-    while (!models.empty())
+    while (!models.models.empty())
     {
-        delete models.back();
-        models.pop_back();
+        Model::Release(models.models.back());
+        PopModel();
     }
 } /* Destructor */
 
+/**
+ * Sets the job system which loads the models inserted from now on
+ * The job system must finish the loads, such as by stopping, before the scene is destroyed
+ * @param jobs - The job system, or NULL to load each model on the calling thread as inserted
+ */
+void Scene::SetJobSystem(JobSystem* jobs)
+{
+    this->jobs = jobs;
+} /* SetJobSystem() */
+
 /**
  * Inserts a new model into the scene
+ * With a job system the model loads in the background and the call returns at once; until
+ * UpdateReadiness() finds its mesh uploaded, the model stands still and is bounded by a cube
+ * around its bounding sphere
+ * A model which rides on another is placed in its parent's frame, so it is carried along as
+ * the parent spins and bounces, on top of its own animation
  * @param filename - The name of the file containing a PLY model to insert
- * @param pos - The 3D position where the center of the model will be located
+ * @param pos - The 3D position where the center of the model will be located, in the parent's
+ *              frame if it has one
+ * @param parent - The handle of the model it rides on, or MODEL_INVALID_HANDLE
+ * @return - The new model's handle
  */
-void Scene::Insert(const char* filename, const Point3& pos)
+ModelHandle Scene::Insert(const char* filename, const Point3& pos, ModelHandle parent)
 {
-    Model* newModel = new Model(filename, pos);
-    models.push_back(newModel);
+    float randomDegrees = static_cast<float>(rand() % 360);
+
+    /* Reuse the handle of a removed model, if any */
+    ModelHandle handle;
+    if (freeHandles.empty())
+    {
+        handle = static_cast<ModelHandle>(handleIndices.size());
+        handleIndices.push_back(models.handles.size());
+    }
+    else
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        handleIndices[handle] = models.handles.size();
+    }
+
+    /* Initialize the starting height and rotation of the model */
+    models.rotations.push_back(randomDegrees);
+    models.previousRotations.push_back(randomDegrees);
+    models.nextRotations.push_back(randomDegrees);
+    models.heights.push_back(pos.y);
+    models.previousHeights.push_back(pos.y);
+    models.nextHeights.push_back(pos.y);
+    models.startingHeights.push_back(pos.y);
+    models.phaseDegrees.push_back(randomDegrees);
+    models.phaseRadians.push_back(randomDegrees * (2.0 * M_PI) / 360.0);
+    models.rotationSpeeds.push_back(130.0f);
+    models.translationSpeeds.push_back(2.5f);
+
+    /* Bound the model by a cube around its bounding sphere until its mesh is uploaded */
+    models.centersX.push_back(pos.x);
+    models.centersZ.push_back(pos.z);
+    models.scaleFactors.push_back(1.0f);
+    models.modelviews.resize(models.modelviews.size() + 16, 0.0f);
+    models.worldCentersX.push_back(pos.x);
+    models.worldHeights.push_back(pos.y);
+    models.worldCentersZ.push_back(pos.z);
+    models.worldRotations.push_back(0.0f);
+    for (int i = 0; i < 6; i++)
+    {
+        models.localBounds.push_back(3 > i ? -MODEL_SCALED_RADIUS : MODEL_SCALED_RADIUS);
+    }
+    models.sweptBounds.resize(models.sweptBounds.size() + 6);
+    models.subtreeBounds.resize(models.subtreeBounds.size() + 6);
+    models.isSubtreeChanged.push_back(1);
+    models.worldBounds.push_back(AxisAlignedBoundingBox());
+    models.isVisible.push_back(0);
+    models.isExactBoxDeferred.push_back(0);
+    models.sweptTests.push_back(0);
+    models.isPoseChanged.push_back(1);
+    models.isBoundsChanged.push_back(1);
+    models.isDrawingBoundingBox.push_back(0);
+
+    models.isReady.push_back(0);
+    models.faceLists.push_back(NULL);
+    models.bvhs.push_back(NULL);
+    models.gpuMeshes.push_back(NULL);
+    models.meshIds.push_back(-1);
+    models.lodLevels.push_back(0);
+
+    Model* model = new Model(filename, &meshes, jobs);
+    models.models.push_back(model);
+    models.handles.push_back(handle);
+
+    /* The order of the hierarchy is built again before the next frame */
+    if (MODEL_NO_INDEX == GetIndex(parent))
+    {
+        parent = MODEL_INVALID_HANDLE;
+    }
+    else
+    {
+        attachedCount++;
+    }
+    models.parents.push_back(parent);
+    isHierarchyChanged = true;
+    SweepBounds(models.handles.size() - 1);
+
+    model->StartLoading();
+
+    return handle;
 } /* Insert() */
 
 /**
- * Returns the list of models contained in the scene
- * @return A constant reference to the list of models contained in the scene
+ * Removes a model from the scene, moving the last model into its place in the arrays
+ * The models which rode on it ride on its parent instead, keeping their place in the frame
+ * Must not be called while a frame is being updated, bounded or culled
+ * @param handle - The handle of the model to remove, which may be reused afterwards
+ */
+void Scene::Remove(ModelHandle handle)
+{
+    size_t index = GetIndex(handle);
+    if (MODEL_NO_INDEX == index)
+    {
+        return;
+    }
+
+    readyCount -= models.isReady[index] ? 1 : 0;
+    Model::Release(models.models[index]);
+
+    /* Hand the model's riders down to its parent */
+    ModelHandle parent = models.parents[index];
+    attachedCount -= MODEL_INVALID_HANDLE == parent ? 0 : 1;
+    for (size_t i = 0; i < models.parents.size(); i++)
+    {
+        if (handle == models.parents[i])
+        {
+            models.parents[i] = parent;
+            attachedCount -= MODEL_INVALID_HANDLE == parent ? 1 : 0;
+        }
+    }
+    isHierarchyChanged = true;
+
+    size_t last = models.handles.size() - 1;
+    if (index != last)
+    {
+        MoveModel(last, index);
+        handleIndices[models.handles[index]] = index;
+    }
+    PopModel();
+
+    handleIndices[handle] = MODEL_NO_INDEX;
+    freeHandles.push_back(handle);
+} /* Remove() */
+
+/**
+ * Returns the number of models in the scene
+ * @return - The number of elements per model in each array
+ */
+size_t Scene::GetModelCount() const
+{
+    return models.handles.size();
+} /* GetModelCount() */
+
+/**
+ * Returns where a model is in the arrays, which changes when other models are removed
+ * @param handle - The model's handle
+ * @return - The model's index, or MODEL_NO_INDEX if the handle refers to no model
+ */
+size_t Scene::GetIndex(ModelHandle handle) const
+{
+    return handle < handleIndices.size() ? handleIndices[handle] : MODEL_NO_INDEX;
+} /* GetIndex() */
+
+/**
+ * Returns the handle of the model at an index in the arrays
+ * @param index - The model's index, less than GetModelCount()
+ * @return - The model's handle
  */
-std::list<Model*>* Scene::GetModels()
+ModelHandle Scene::GetHandle(size_t index) const
+{
+    return models.handles[index];
+} /* GetHandle() */
+
+/**
+ * Returns the models' component arrays
+ * Elements may be changed, but only the scene adds or removes them
+ * @return - The models' components
+ */
+ModelArrays* Scene::GetModels()
 {
     return &models;
 } /* GetModels() */
 
+/**
+ * Fills in the mesh components of the models whose meshes have been uploaded since the last
+ * call, which lets them animate and be drawn
+ * Must not be called while a frame is being updated, bounded or culled
+ * @return - True if every model is ready to draw
+ */
+bool Scene::UpdateReadiness()
+{
+    for (size_t i = 0; readyCount < models.isReady.size() && i < models.isReady.size(); i++)
+    {
+        Model* model = models.models[i];
+        if (models.isReady[i] || MODEL_READY != model->GetState())
+        {
+            continue;
+        }
+
+        models.isReady[i] = 1;
+        models.faceLists[i] = model->GetFaceList();
+        models.bvhs[i] = model->GetBvh();
+        models.gpuMeshes[i] = model->GetGpuMesh();
+        models.meshIds[i] = model->GetMeshId();
+        models.scaleFactors[i] = static_cast<float>(model->GetScaleFactor());
+        for (int j = 0; j < 6; j++)
+        {
+            models.localBounds[6 * i + j] = model->GetBounds()[j];
+        }
+        SweepBounds(i);
+        models.isPoseChanged[i] = 1;
+        models.isBoundsChanged[i] = 1;
+        readyCount++;
+    }
+
+    return readyCount == models.isReady.size();
+} /* UpdateReadiness() */
+
+/**
+ * Runs a frame's simulation ticks for a range of models and interpolates them, keeping the
+ * previous tick's transformation for interpolation; models which are not ready stand still
+ * Each tick is a pure function of its time, so replaying the same tick times gives the same
+ * bits however the models are split between calls
+ * @param begin - The index of the first model
+ * @param end - One past the index of the last model
+ * @param tickTimes - The simulation time of each tick in seconds
+ * @param tickCount - The number of ticks
+ * @param alpha - The interpolation factor between 0 (previous tick) and 1 (latest tick)
+ */
+void Scene::Animate(size_t begin, size_t end, const double* tickTimes, int tickCount,
+        double alpha)
+{
+    float sines[MODEL_ANIMATION_BATCH];
+    float interpolation = static_cast<float>(alpha);
+
+    /* Animate the models a batch at a time, so the sines are taken in one vectorized pass */
+    for (size_t first = begin; first < end; first += MODEL_ANIMATION_BATCH)
+    {
+        size_t count = std::min(end - first, static_cast<size_t>(MODEL_ANIMATION_BATCH));
+        float* rotations = &models.rotations[first];
+        float* previousRotations = &models.previousRotations[first];
+        float* nextRotations = &models.nextRotations[first];
+        float* heights = &models.heights[first];
+        float* previousHeights = &models.previousHeights[first];
+        float* nextHeights = &models.nextHeights[first];
+        const float* startingHeights = &models.startingHeights[first];
+        const float* phaseDegrees = &models.phaseDegrees[first];
+        const float* phaseRadians = &models.phaseRadians[first];
+        const float* rotationSpeeds = &models.rotationSpeeds[first];
+        const float* translationSpeeds = &models.translationSpeeds[first];
+        const char* isReady = &models.isReady[first];
+        char* isPoseChanged = &models.isPoseChanged[first];
+
+        for (int j = 0; j < tickCount; j++)
+        {
+            float elapsedTime = static_cast<float>(tickTimes[j]);
+
+            /* Rotate the models and find where they are in their bounce */
+            for (size_t i = 0; i < count; i++)
+            {
+                previousRotations[i] = nextRotations[i];
+                previousHeights[i] = nextHeights[i];
+                nextRotations[i] = phaseDegrees[i] + elapsedTime * rotationSpeeds[i];
+                sines[i] = translationSpeeds[i] * (elapsedTime + phaseRadians[i]);
+            }
+
+            vecSinf(sines, sines, count);
+
+            /* Translate the models */
+            for (size_t i = 0; i < count; i++)
+            {
+                nextHeights[i] = startingHeights[i] + MODEL_BOUNCE_HEIGHT * sines[i];
+            }
+        }
+
+        /* Draw the models between the last two ticks so that motion is smooth at any frame
+         * rate; a model which is not ready keeps its starting pose until it is drawn, and the
+         * models which moved are marked so that only they are culled again
+         */
+        for (size_t i = 0; i < count; i++)
+        {
+            float rotation = previousRotations[i]
+                    + interpolation * (nextRotations[i] - previousRotations[i]);
+            float height = isReady[i] ? previousHeights[i]
+                    + interpolation * (nextHeights[i] - previousHeights[i]) : startingHeights[i];
+
+            isPoseChanged[i] |= rotation != rotations[i] || height != heights[i];
+            rotations[i] = rotation;
+            heights[i] = height;
+        }
+    }
+} /* Animate() */
+
+/**
+ * Finds a model's pose at any time from the same formulas the ticks use, such as the time the
+ * vertex shader poses the models at
+ * @param index - The model's index
+ * @param time - The simulation time in seconds
+ * @param rotation - Receives the rotation in degrees
+ * @param height - Receives the center's y component
+ */
+void Scene::PoseAt(size_t index, double time, float* rotation, float* height) const
+{
+    float elapsedTime = static_cast<float>(time);
+
+    *rotation = models.phaseDegrees[index] + elapsedTime * models.rotationSpeeds[index];
+    *height = models.startingHeights[index] + MODEL_BOUNCE_HEIGHT
+            * sinf(models.translationSpeeds[index] * (elapsedTime + models.phaseRadians[index]));
+} /* PoseAt() */
+
+/**
+ * Carries the models' poses down the hierarchy into world space, then bounds each subtree
+ * Only the models whose pose changed, or whose parent's did, are posed again, and only the
+ * subtrees around them are bounded again; a parent comes before its descendants in the order,
+ * so one pass down and two passes up suffice
+ * Must be called after the models are animated and before they are culled
+ * @return - The number of models posed again in world space
+ */
+int Scene::UpdateHierarchy()
+{
+    if (isHierarchyChanged)
+    {
+        BuildHierarchy();
+        isHierarchyChanged = false;
+    }
+
+    size_t count = hierarchyOrder.size();
+    int posedCount = 0;
+    bool isAnySubtreeChanged = false;
+
+    /* Pose the changed models in world space, parents first */
+    for (size_t p = 0; p < count; p++)
+    {
+        size_t i = hierarchyOrder[p];
+        float rotation = models.isReady[i] ? models.rotations[i] : 0.0f;
+
+        if (MODEL_NO_INDEX == hierarchyParents[p])
+        {
+            if (models.isPoseChanged[i])
+            {
+                models.worldCentersX[i] = models.centersX[i];
+                models.worldHeights[i] = models.heights[i];
+                models.worldCentersZ[i] = models.centersZ[i];
+                models.worldRotations[i] = rotation;
+            }
+        }
+        else
+        {
+            /* A model moves whenever its parent does; every rotation is about the y axis, so
+             * the parent's frame is just its center and its angle
+             */
+            size_t parent = hierarchyOrder[hierarchyParents[p]];
+            models.isPoseChanged[i] |= models.isPoseChanged[parent];
+            if (models.isPoseChanged[i])
+            {
+                float radians = models.worldRotations[parent] * static_cast<float>(M_PI) / 180.0f;
+                float c = cosf(radians);
+                float s = sinf(radians);
+
+                models.worldCentersX[i] = models.worldCentersX[parent]
+                        + c * models.centersX[i] + s * models.centersZ[i];
+                models.worldHeights[i] = models.worldHeights[parent] + models.heights[i];
+                models.worldCentersZ[i] = models.worldCentersZ[parent]
+                        - s * models.centersX[i] + c * models.centersZ[i];
+                models.worldRotations[i] = models.worldRotations[parent] + rotation;
+
+                /* The box around its current pose moves with it */
+                SweepBounds(i);
+                models.isBoundsChanged[i] = 1;
+            }
+        }
+
+        posedCount += models.isPoseChanged[i] ? 1 : 0;
+        models.isSubtreeChanged[i] |= models.isBoundsChanged[i];
+        isAnySubtreeChanged = isAnySubtreeChanged || models.isSubtreeChanged[i];
+    }
+
+    if (!isAnySubtreeChanged)
+    {
+        return posedCount;
+    }
+
+    /* Mark the ancestors of each changed box, children first; each model's mark is final once
+     * its descendants are passed, so its subtree's box starts again from its own box then
+     */
+    for (size_t p = count; 0 < p--; )
+    {
+        size_t i = hierarchyOrder[p];
+        if (!models.isSubtreeChanged[i])
+        {
+            continue;
+        }
+
+        if (MODEL_NO_INDEX != hierarchyParents[p])
+        {
+            models.isSubtreeChanged[hierarchyOrder[hierarchyParents[p]]] = 1;
+        }
+        for (int j = 0; j < 6; j++)
+        {
+            models.subtreeBounds[6 * i + j] = models.sweptBounds[6 * i + j];
+        }
+    }
+
+    /* Grow each changed subtree's box around its children's, children first */
+    for (size_t p = count; 0 < p--; )
+    {
+        size_t i = hierarchyOrder[p];
+        if (MODEL_NO_INDEX != hierarchyParents[p])
+        {
+            size_t parent = hierarchyOrder[hierarchyParents[p]];
+            if (models.isSubtreeChanged[parent])
+            {
+                float* parentBounds = &models.subtreeBounds[6 * parent];
+                const float* bounds = &models.subtreeBounds[6 * i];
+                for (int j = 0; j < 3; j++)
+                {
+                    parentBounds[j] = std::min(parentBounds[j], bounds[j]);
+                    parentBounds[3 + j] = std::max(parentBounds[3 + j], bounds[3 + j]);
+                }
+            }
+        }
+        models.isSubtreeChanged[i] = 0;
+    }
+
+    return posedCount;
+} /* UpdateHierarchy() */
+
+/**
+ * Returns the number of models which ride on another
+ * @return - The number of models with a parent
+ */
+size_t Scene::GetAttachedCount() const
+{
+    return attachedCount;
+} /* GetAttachedCount() */
+
+/**
+ * Returns the models' indices in the order of the hierarchy, where each model is followed by
+ * all its descendants; valid after UpdateHierarchy() until models are inserted or removed
+ * @return - The index of the model at each position
+ */
+const std::vector<size_t>& Scene::GetHierarchyOrder() const
+{
+    return hierarchyOrder;
+} /* GetHierarchyOrder() */
+
+/**
+ * Returns where each model's subtree ends in the order of the hierarchy, so that a pass over
+ * the order can skip a whole subtree
+ * @return - One past the position of the last descendant of the model at each position
+ */
+const std::vector<size_t>& Scene::GetSubtreeEnds() const
+{
+    return subtreeEnds;
+} /* GetSubtreeEnds() */
+
+/**
+ * Returns the cache of the meshes the models share
+ * @return - The mesh cache
+ */
+MeshCache* Scene::GetMeshCache()
+{
+    return &meshes;
+} /* GetMeshCache() */
+
 /**
  * Returns the camera
  * @return A constant reference to the camera object
@@ -60,3 +543,221 @@ Camera* Scene::GetCamera()
 {
     return &camera;
 } /* GetCamera() */
+
+/**
+ * Bounds every pose a model takes in world space: a model spins about the y axis through its
+ * center and bounces up and down, so its mesh stays inside a cylinder around the axis which
+ * reaches the bounce height above and below the mesh's box; a model which is not ready stands
+ * still inside its placeholder cube
+ * @param index - The model's index
+ */
+void Scene::SweepBounds(size_t index)
+{
+    const float* localBounds = &models.localBounds[6 * index];
+    float* sweptBounds = &models.sweptBounds[6 * index];
+    float scale = models.scaleFactors[index];
+    float bounce = models.isReady[index] ? MODEL_BOUNCE_HEIGHT : 0.0f;
+    float centerX = models.centersX[index];
+    float height = models.startingHeights[index];
+    float centerZ = models.centersZ[index];
+
+    /* The corners of a placeholder cube turned by its parent reach farther than its faces */
+    float radius = MODEL_SCALED_RADIUS * static_cast<float>(M_SQRT2);
+    if (models.isReady[index])
+    {
+        radius = scale * models.models[index]->GetAxisRadius();
+    }
+
+    /* A model which rides on another is carried around by it, so only its current pose is
+     * bounded, and only while its parent stays still
+     */
+    if (MODEL_INVALID_HANDLE != models.parents[index])
+    {
+        centerX = models.worldCentersX[index];
+        height = models.worldHeights[index];
+        centerZ = models.worldCentersZ[index];
+        bounce = 0.0f;
+    }
+
+    sweptBounds[0] = centerX - radius;
+    sweptBounds[1] = height + scale * localBounds[1] - bounce;
+    sweptBounds[2] = centerZ - radius;
+    sweptBounds[3] = centerX + radius;
+    sweptBounds[4] = height + scale * localBounds[4] + bounce;
+    sweptBounds[5] = centerZ + radius;
+} /* SweepBounds() */
+
+/**
+ * Builds the order of the hierarchy, walking each tree depth first from its root so that every
+ * model is followed by all its descendants; the roots keep the order of the arrays
+ */
+void Scene::BuildHierarchy()
+{
+    size_t count = models.handles.size();
+    std::vector<size_t> parents(count);
+    std::vector<size_t> childStarts(count + 1, 0);
+    std::vector<size_t> children(count);
+
+    /* List the children of each model together, in the order of the arrays */
+    for (size_t i = 0; i < count; i++)
+    {
+        parents[i] = GetIndex(models.parents[i]);
+        if (MODEL_NO_INDEX != parents[i])
+        {
+            childStarts[parents[i] + 1]++;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        childStarts[i + 1] += childStarts[i];
+    }
+    std::vector<size_t> childEnds(childStarts.begin(), childStarts.end() - 1);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (MODEL_NO_INDEX != parents[i])
+        {
+            children[childEnds[parents[i]]++] = i;
+        }
+    }
+
+    /* Walk each tree with a stack of the models to visit and their parents' positions */
+    hierarchyOrder.clear();
+    hierarchyParents.clear();
+    std::vector<std::pair<size_t, size_t> > stack;
+    for (size_t root = 0; root < count; root++)
+    {
+        if (MODEL_NO_INDEX != parents[root])
+        {
+            continue;
+        }
+
+        stack.push_back(std::make_pair(root, MODEL_NO_INDEX));
+        while (!stack.empty())
+        {
+            size_t i = stack.back().first;
+            size_t position = hierarchyOrder.size();
+            hierarchyOrder.push_back(i);
+            hierarchyParents.push_back(stack.back().second);
+            stack.pop_back();
+
+            /* Push the children last first, so they are visited in the order of the arrays */
+            for (size_t j = childStarts[i + 1]; j > childStarts[i]; j--)
+            {
+                stack.push_back(std::make_pair(children[j - 1], position));
+            }
+        }
+    }
+
+    /* Each subtree ends where the last of its children's subtrees does */
+    subtreeEnds.resize(count);
+    for (size_t p = 0; p < count; p++)
+    {
+        subtreeEnds[p] = p + 1;
+    }
+    for (size_t p = count; 0 < p--; )
+    {
+        if (MODEL_NO_INDEX != hierarchyParents[p])
+        {
+            subtreeEnds[hierarchyParents[p]] = std::max(subtreeEnds[hierarchyParents[p]],
+                    subtreeEnds[p]);
+        }
+    }
+
+    /* The models may have new parents, so pose and bound them all again */
+    models.isPoseChanged.assign(count, 1);
+    models.isSubtreeChanged.assign(count, 1);
+} /* BuildHierarchy() */
+
+/**
+ * Copies every component of one model over another's
+ * @param from - The index of the model to copy
+ * @param to - The index of the model to overwrite
+ */
+void Scene::MoveModel(size_t from, size_t to)
+{
+    copyComponent(models.rotations, from, to, 1);
+    copyComponent(models.previousRotations, from, to, 1);
+    copyComponent(models.nextRotations, from, to, 1);
+    copyComponent(models.heights, from, to, 1);
+    copyComponent(models.previousHeights, from, to, 1);
+    copyComponent(models.nextHeights, from, to, 1);
+    copyComponent(models.startingHeights, from, to, 1);
+    copyComponent(models.phaseDegrees, from, to, 1);
+    copyComponent(models.phaseRadians, from, to, 1);
+    copyComponent(models.rotationSpeeds, from, to, 1);
+    copyComponent(models.translationSpeeds, from, to, 1);
+    copyComponent(models.centersX, from, to, 1);
+    copyComponent(models.centersZ, from, to, 1);
+    copyComponent(models.scaleFactors, from, to, 1);
+    copyComponent(models.modelviews, from, to, 16);
+    copyComponent(models.worldCentersX, from, to, 1);
+    copyComponent(models.worldHeights, from, to, 1);
+    copyComponent(models.worldCentersZ, from, to, 1);
+    copyComponent(models.worldRotations, from, to, 1);
+    copyComponent(models.localBounds, from, to, 6);
+    copyComponent(models.sweptBounds, from, to, 6);
+    copyComponent(models.subtreeBounds, from, to, 6);
+    copyComponent(models.isSubtreeChanged, from, to, 1);
+    copyComponent(models.worldBounds, from, to, 1);
+    copyComponent(models.isVisible, from, to, 1);
+    copyComponent(models.isExactBoxDeferred, from, to, 1);
+    copyComponent(models.sweptTests, from, to, 1);
+    copyComponent(models.isPoseChanged, from, to, 1);
+    copyComponent(models.isBoundsChanged, from, to, 1);
+    copyComponent(models.isDrawingBoundingBox, from, to, 1);
+    copyComponent(models.isReady, from, to, 1);
+    copyComponent(models.faceLists, from, to, 1);
+    copyComponent(models.bvhs, from, to, 1);
+    copyComponent(models.gpuMeshes, from, to, 1);
+    copyComponent(models.meshIds, from, to, 1);
+    copyComponent(models.lodLevels, from, to, 1);
+    copyComponent(models.models, from, to, 1);
+    copyComponent(models.handles, from, to, 1);
+    copyComponent(models.parents, from, to, 1);
+} /* MoveModel() */
+
+/**
+ * Removes the last model's components
+ */
+void Scene::PopModel()
+{
+    models.rotations.pop_back();
+    models.previousRotations.pop_back();
+    models.nextRotations.pop_back();
+    models.heights.pop_back();
+    models.previousHeights.pop_back();
+    models.nextHeights.pop_back();
+    models.startingHeights.pop_back();
+    models.phaseDegrees.pop_back();
+    models.phaseRadians.pop_back();
+    models.rotationSpeeds.pop_back();
+    models.translationSpeeds.pop_back();
+    models.centersX.pop_back();
+    models.centersZ.pop_back();
+    models.scaleFactors.pop_back();
+    models.modelviews.resize(models.modelviews.size() - 16);
+    models.worldCentersX.pop_back();
+    models.worldHeights.pop_back();
+    models.worldCentersZ.pop_back();
+    models.worldRotations.pop_back();
+    models.localBounds.resize(models.localBounds.size() - 6);
+    models.sweptBounds.resize(models.sweptBounds.size() - 6);
+    models.subtreeBounds.resize(models.subtreeBounds.size() - 6);
+    models.isSubtreeChanged.pop_back();
+    models.worldBounds.pop_back();
+    models.isVisible.pop_back();
+    models.isExactBoxDeferred.pop_back();
+    models.sweptTests.pop_back();
+    models.isPoseChanged.pop_back();
+    models.isBoundsChanged.pop_back();
+    models.isDrawingBoundingBox.pop_back();
+    models.isReady.pop_back();
+    models.faceLists.pop_back();
+    models.bvhs.pop_back();
+    models.gpuMeshes.pop_back();
+    models.meshIds.pop_back();
+    models.lodLevels.pop_back();
+    models.models.pop_back();
+    models.handles.pop_back();
+    models.parents.pop_back();
+} /* PopModel() */
@@ -6,17 +6,106 @@
  * Filename: Scene.h
  *
  * This is a C++ definition of a Scene object which
- * contains a list of 3D Models and a Camera object.
+ * contains 3D Models and a Camera object. The data the
+ * models touch every frame is kept in one array per
+ * component, in the same dense order, so that each pass
+ * over the models streams through memory. Models may ride
+ * on other models, which carry them along as they move.
  */
 
 #ifndef SCENE_H_
 #define SCENE_H_
 
-#include <list>
+#include <cstddef>
+#include <vector>
 
+#include "AxisAlignedBoundingBox.h"
 #include "Camera.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
 #include "Model.h"
 
+/* Refers to a model for as long as it is in the scene, however the arrays are reordered */
+typedef unsigned int ModelHandle;
+
+/* A handle which refers to no model */
+#define MODEL_INVALID_HANDLE 0xFFFFFFFFu
+
+/* The index of a handle which refers to no model */
+#define MODEL_NO_INDEX (~static_cast<size_t>(0))
+
+/* The height of the models' bounce above and below their starting height, on the CPU and in
+ * the vertex shaders alike
+ */
+#define MODEL_BOUNCE_HEIGHT 0.4f
+
+/* The models' components, each holding one element per model in the same order; index i
+ * of every array belongs to the same model
+ */
+struct ModelArrays
+{
+    /* Animation state, changed by every simulation tick */
+    std::vector<float> rotations;           /* the current rotation in degrees */
+    std::vector<float> previousRotations;   /* the rotation at the previous simulation tick */
+    std::vector<float> nextRotations;       /* the rotation at the latest simulation tick */
+    std::vector<float> heights;             /* the current center's y component */
+    std::vector<float> previousHeights;     /* the height at the previous simulation tick */
+    std::vector<float> nextHeights;         /* the height at the latest simulation tick */
+
+    /* Animation parameters, set when the model is inserted */
+    std::vector<float> startingHeights;     /* the starting position's y component */
+    std::vector<float> phaseDegrees;        /* the random offset of the rotation */
+    std::vector<float> phaseRadians;        /* the random offset of the translation */
+    std::vector<float> rotationSpeeds;      /* the degrees the model rotates per second */
+    std::vector<float> translationSpeeds;   /* the multiplier of the model's translation */
+
+    /* Transforms, relative to the parent's frame for a model which rides on another */
+    std::vector<float> centersX;            /* the center's x component */
+    std::vector<float> centersZ;            /* the center's z component */
+    std::vector<float> scaleFactors;        /* scales the mesh to the common radius */
+    std::vector<float> modelviews;          /* the modelview matrix, 16 floats apiece */
+    std::vector<float> worldCentersX;       /* the center's x component in world space */
+    std::vector<float> worldHeights;        /* the center's y component in world space */
+    std::vector<float> worldCentersZ;       /* the center's z component in world space */
+    std::vector<float> worldRotations;      /* the rotation about the y axis in world space */
+
+    /* Bounds */
+    std::vector<float> localBounds;         /* the mesh's box in model space, 6 floats apiece
+                                             * as minimum x, y, z then maximum x, y, z */
+    std::vector<float> sweptBounds;         /* the box in world space around every pose the
+                                             * model takes, or around its current pose if it
+                                             * rides on another, 6 floats apiece */
+    std::vector<float> subtreeBounds;       /* the box in world space around the swept boxes
+                                             * of the model and those riding on it */
+    std::vector<char> isSubtreeChanged;     /* whether the subtree's box must be found again */
+    std::vector<AxisAlignedBoundingBox> worldBounds; /* the box in eye space this frame */
+    std::vector<char> isVisible;            /* whether the box is in the view frustum */
+    std::vector<char> isExactBoxDeferred;   /* whether the box is still the swept one because
+                                             * the swept box alone decided the culling */
+    std::vector<char> sweptTests;           /* the last frustum test of the swept box */
+    std::vector<char> isPoseChanged;        /* whether the pose changed since the model was
+                                             * last culled */
+    std::vector<char> isBoundsChanged;      /* whether the swept box or whether the box is
+                                             * drawn changed since the model was last culled */
+    std::vector<char> isDrawingBoundingBox; /* whether the box is drawn */
+
+    /* Meshes, filled in once each model is uploaded */
+    std::vector<char> isReady;              /* whether the mesh can be drawn */
+    std::vector<const FaceList*> faceLists; /* the shared triangles, or NULL */
+    std::vector<const MeshBvh*> bvhs;       /* the shared hierarchy over the triangles, or
+                                             * NULL */
+    std::vector<GpuMesh*> gpuMeshes;        /* the shared buffer objects of each level of
+                                             * detail, finest first, or NULL */
+    std::vector<int> meshIds;               /* the shared mesh's id, or -1 */
+    std::vector<char> lodLevels;            /* the level of detail drawn last frame */
+
+    /* Bookkeeping */
+    std::vector<Model*> models;             /* where each model loads from */
+    std::vector<ModelHandle> handles;       /* the handle which refers to each model */
+    std::vector<ModelHandle> parents;       /* the model each one rides on, or
+                                             * MODEL_INVALID_HANDLE */
+}; /* ModelArrays struct */
+
 class Scene
 {
 public:
@@ -27,14 +116,47 @@ public:
     ~Scene();
 
     /* Member functions */
-    void Insert(const char* filename, const Point3& pos);
-    std::list<Model*>* GetModels();
+    void SetJobSystem(JobSystem* jobs);
+    ModelHandle Insert(const char* filename, const Point3& pos,
+            ModelHandle parent = MODEL_INVALID_HANDLE);
+    void Remove(ModelHandle handle);
+    size_t GetModelCount() const;
+    size_t GetIndex(ModelHandle handle) const;
+    ModelHandle GetHandle(size_t index) const;
+    ModelArrays* GetModels();
+    bool UpdateReadiness();
+    void Animate(size_t begin, size_t end, const double* tickTimes, int tickCount, double alpha);
+    void PoseAt(size_t index, double time, float* rotation, float* height) const;
+    int UpdateHierarchy();
+    size_t GetAttachedCount() const;
+    const std::vector<size_t>& GetHierarchyOrder() const;
+    const std::vector<size_t>& GetSubtreeEnds() const;
+    MeshCache* GetMeshCache();
     Camera* GetCamera();
 
 private:
+    /* Private helper functions */
+    void SweepBounds(size_t index);
+    void BuildHierarchy();
+    void MoveModel(size_t from, size_t to);
+    void PopModel();
+
     /* Private member variables */
-    std::list<Model*> models;
+    MeshCache meshes;                       /* the meshes the models share; outlives them */
+    ModelArrays models;                     /* the models' components in dense order */
+    std::vector<size_t> handleIndices;      /* each handle's index in the arrays, if in use */
+    std::vector<ModelHandle> freeHandles;   /* the handles of removed models, for reuse */
+    size_t readyCount;                      /* the number of models whose meshes are uploaded */
+    std::vector<size_t> hierarchyOrder;     /* the models' indices, each parent followed by its
+                                             * descendants */
+    std::vector<size_t> hierarchyParents;   /* the position in the order of each position's
+                                             * parent, or MODEL_NO_INDEX */
+    std::vector<size_t> subtreeEnds;        /* one past the position of each position's last
+                                             * descendant */
+    size_t attachedCount;                   /* the number of models which ride on another */
+    bool isHierarchyChanged;                /* whether the order must be built again */
     Camera camera;
+    JobSystem* jobs;    /* loads the inserted models in the background, or NULL */
 }; /* Scene class */
 
 #endif /* SCENE_H_ */
@@ -9,8 +9,24 @@
  * math operations.
  */
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "VecMath.h"
 
+/* Splits 2 pi so that subtracting whole turns keeps the bits the float product would lose */
+#define TWO_PI_HIGH 6.28125f
+#define TWO_PI_LOW 1.9353071795864769e-3f
+#define INVERSE_TWO_PI 0.15915494309189535f
+
+/* The Taylor coefficients of sin(x) / x, which is within 1e-7 of exact up to pi / 2 */
+#define SIN_C3 (-1.0f / 6.0f)
+#define SIN_C5 (1.0f / 120.0f)
+#define SIN_C7 (-1.0f / 5040.0f)
+#define SIN_C9 (1.0f / 362880.0f)
+#define SIN_C11 (-1.0f / 39916800.0f)
+
 /**
  * Returns the dot product of two 3D vectors
  * @param a - The first 3D vector to multiply
@@ -272,3 +288,125 @@ void matMultMat4f(float C[16], const float A[16], const float B[16])
     C[14] = A20 * B03 + A21 * B13 + A22 * B23 + A23 * B33;
     C[15] = A30 * B03 + A31 * B13 + A32 * B23 + A33 * B33;
 } /* matMultMat4f() */
+
+/**
+ * Builds the same viewing matrix as gluLookAt() without an OpenGL context
+ * @param m - The returned matrix
+ * @param eye - The eye position
+ * @param ref - The reference point the eye looks at
+ * @param up - The up vector
+ */
+void matLookAt4f(float m[16], const Vec3& eye, const Vec3& ref, const Vec3& up)
+{
+    Vec3 f = (ref - eye).Normalize();
+    Vec3 s = cross(f, up).Normalize();
+    Vec3 u = cross(s, f);
+
+    m[0] = s.x;  m[4] = s.y;  m[8]  = s.z;  m[12] = -dot(s, eye);
+    m[1] = u.x;  m[5] = u.y;  m[9]  = u.z;  m[13] = -dot(u, eye);
+    m[2] = -f.x; m[6] = -f.y; m[10] = -f.z; m[14] = dot(f, eye);
+    m[3] = 0.0f; m[7] = 0.0f; m[11] = 0.0f; m[15] = 1.0f;
+} /* matLookAt4f() */
+
+/**
+ * Builds the matrix of glTranslatef(), then glRotatef() about the y axis, then a uniform
+ * glScalef() without an OpenGL context
+ * @param m - The returned matrix
+ * @param translation - The translation
+ * @param degrees - The rotation about the y axis in degrees
+ * @param scale - The uniform scale factor
+ */
+void matTranslateRotateYScale4f(float m[16], const Vec3& translation, float degrees, float scale)
+{
+    float radians = degrees * static_cast<float>(M_PI) / 180.0f;
+    float c = cosf(radians) * scale;
+    float s = sinf(radians) * scale;
+
+    m[0] = c;     m[4] = 0.0f;  m[8]  = s;     m[12] = translation.x;
+    m[1] = 0.0f;  m[5] = scale; m[9]  = 0.0f;  m[13] = translation.y;
+    m[2] = -s;    m[6] = 0.0f;  m[10] = c;     m[14] = translation.z;
+    m[3] = 0.0f;  m[7] = 0.0f;  m[11] = 0.0f;  m[15] = 1.0f;
+} /* matTranslateRotateYScale4f() */
+
+/**
+ * Returns the sine of one angle with the same operations, in the same order, as each lane of
+ * the vectorized loop in vecSinf(), so that both give the same bits
+ * @param x - The angle in radians
+ * @return - The sine of the angle
+ */
+static float sinfLane(float x)
+{
+    /* Subtract the whole turns, leaving an angle between -pi and pi */
+    float turns = rintf(x * INVERSE_TWO_PI);
+    float r = (x - turns * TWO_PI_HIGH) - turns * TWO_PI_LOW;
+
+    /* Reflect the angle into the first quadrant, where the polynomial is accurate */
+    float a = fabsf(r);
+    if (a > static_cast<float>(M_PI_2))
+    {
+        a = static_cast<float>(M_PI) - a;
+    }
+
+    float a2 = a * a;
+    float p = SIN_C11;
+    p = p * a2 + SIN_C9;
+    p = p * a2 + SIN_C7;
+    p = p * a2 + SIN_C5;
+    p = p * a2 + SIN_C3;
+    p = p * a2 + 1.0f;
+
+    /* Flip the sign exactly as the sign bit of the angle would */
+    return copysignf(1.0f, r) * (p * a);
+} /* sinfLane() */
+
+/**
+ * Computes the sines of an array of angles, four at a time where SSE2 is available
+ * The results do not depend on the alignment or the count, so a batch gives the same bits
+ * however it is split up
+ * @param out - The returned sines, which may be the angles' array
+ * @param in - The angles in radians, within a million radians of zero
+ * @param count - The number of angles
+ */
+void vecSinf(float* out, const float* in, size_t count)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 halfPi = _mm_set1_ps(static_cast<float>(M_PI_2));
+    const __m128 pi = _mm_set1_ps(static_cast<float>(M_PI));
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(in + i);
+
+        /* Subtract the whole turns, rounding to nearest even like rintf() */
+        __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(
+                _mm_mul_ps(x, _mm_set1_ps(INVERSE_TWO_PI))));
+        __m128 r = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(TWO_PI_HIGH))),
+                _mm_mul_ps(turns, _mm_set1_ps(TWO_PI_LOW)));
+
+        /* Reflect the angles into the first quadrant */
+        __m128 sign = _mm_and_ps(r, signMask);
+        __m128 a = _mm_andnot_ps(signMask, r);
+        __m128 isReflected = _mm_cmpgt_ps(a, halfPi);
+        a = _mm_or_ps(_mm_and_ps(isReflected, _mm_sub_ps(pi, a)),
+                _mm_andnot_ps(isReflected, a));
+
+        __m128 a2 = _mm_mul_ps(a, a);
+        __m128 p = _mm_set1_ps(SIN_C11);
+        p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C9));
+        p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C7));
+        p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C5));
+        p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C3));
+        p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f));
+
+        _mm_storeu_ps(out + i, _mm_xor_ps(_mm_mul_ps(p, a), sign));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        out[i] = sinfLane(in[i]);
+    }
+} /* vecSinf() */
@@ -12,6 +12,8 @@
 #ifndef VECMATH_H_
 #define VECMATH_H_
 
+#include <cstddef>
+
 #include "Vec3.h"
 
 #define EPSILON 0.00001
@@ -22,5 +24,8 @@ void vecCopy4f(float *dest, const float *src); /* from Professor Shafae */
 bool gluInvertMatrix(const float m[16], float invOut[16]); /* from StackOverflow.com */
 void matMultVec4f(float vout[4], const float v[4], const float m[16]); /* from Professor Shafae */
 void matMultMat4f(float C[16], const float A[16], const float B[16]);
+void matLookAt4f(float m[16], const Vec3& eye, const Vec3& ref, const Vec3& up);
+void matTranslateRotateYScale4f(float m[16], const Vec3& translation, float degrees, float scale);
+void vecSinf(float* out, const float* in, size_t count);
 
 #endif /* VECMATH_H_ */
@@ -28,8 +28,32 @@
 varying vec3 myNormal;
 varying vec4 myVertex;
 
+// 1.0 when the instance attributes pose the model and the modelview matrix
+// only holds the viewing matrix; 0.0 for the fixed function matrices
+uniform float isAnimated;
+
+// Poses a vertex of a model drawn as an instance at the simulation time;
+// see instance_pose.vert.glsl
+vec4 poseInstance(vec3 vertex, out vec2 turn);
+
+// The depth-only shader repeats this computation, so the position must be
+// computed the same way in both programs for the GL_EQUAL depth test.
+invariant gl_Position;
+
 void main() {
-    gl_Position = gl_ProjectionMatrix * gl_ModelViewMatrix * gl_Vertex;
-    myNormal = gl_Normal;
-    myVertex = gl_Vertex;
+    if (isAnimated > 0.5) {
+        // The normal turns about the y axis along with the vertex
+        vec2 turn;
+        myVertex = poseInstance(gl_Vertex.xyz, turn);
+        myNormal = vec3(turn.x * gl_Normal.x + turn.y * gl_Normal.z,
+                        gl_Normal.y,
+                        -turn.y * gl_Normal.x + turn.x * gl_Normal.z);
+        gl_Position = gl_ModelViewProjectionMatrix * myVertex;
+    } else {
+        // ftransform() is invariant with the fixed function pipeline and the
+        // depth-only shader, so the depth pre-pass can shade with GL_EQUAL.
+        gl_Position = ftransform();
+        myNormal = gl_Normal;
+        myVertex = gl_Vertex;
+    }
 }
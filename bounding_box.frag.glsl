@@ -0,0 +1,15 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * A fragment shader for drawing the bounding boxes in a
+ * single flat, translucent color.
+ *
+ */
+
+uniform vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
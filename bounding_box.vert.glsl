@@ -0,0 +1,23 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * A vertex shader for drawing many axis-aligned bounding
+ * boxes with a single instanced draw call. Every instance
+ * draws the same unit cube, which is stretched between the
+ * instance's eye space minimum and maximum corners.
+ *
+ */
+
+// The corner of the unit cube, with each component either 0 or 1
+attribute vec3 unitPosition;
+
+// The eye space corners of the box, advanced once per instance
+attribute vec3 boxMin;
+attribute vec3 boxMax;
+
+void main() {
+    vec3 eyePosition = mix(boxMin, boxMax, unitPosition);
+    gl_Position = gl_ProjectionMatrix * vec4(eyePosition, 1.0);
+}
@@ -0,0 +1,14 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * A trivial fragment shader for the depth pre-pass. Color
+ * writes are masked off while it runs, so only the depth
+ * of each fragment matters.
+ *
+ */
+
+void main() {
+    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
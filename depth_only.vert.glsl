@@ -0,0 +1,33 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * A trivial vertex shader for the depth pre-pass. It only
+ * transforms the vertex position so that the depth buffer
+ * can be filled before the scene is shaded.
+ *
+ * ftransform() produces exactly the same position as the
+ * Blinn-Phong shader and the fixed function pipeline, which
+ * the GL_EQUAL depth test of the shading pass relies on.
+ * Models drawn as animated instances are posed exactly as
+ * the Blinn-Phong shader poses them.
+ *
+ */
+
+// Whether the instances are drawn; see blinn_phong.vert.glsl
+uniform float isAnimated;
+
+// Poses a vertex of an instance; see instance_pose.vert.glsl
+vec4 poseInstance(vec3 vertex, out vec2 turn);
+
+invariant gl_Position;
+
+void main() {
+    if (isAnimated > 0.5) {
+        vec2 turn;
+        gl_Position = gl_ModelViewProjectionMatrix * poseInstance(gl_Vertex.xyz, turn);
+    } else {
+        gl_Position = ftransform();
+    }
+}
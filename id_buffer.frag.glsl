@@ -0,0 +1,17 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * A fragment shader for the id buffer used to pick models on
+ * the GPU. Every vertex of a model carries the same id, so it
+ * reaches each fragment whole and is written unlit, 8 bits
+ * per channel.
+ *
+ */
+
+varying vec4 id;
+
+void main() {
+    gl_FragColor = id;
+}
@@ -0,0 +1,40 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * A vertex shader for the id buffer used to pick models on
+ * the GPU. It transforms the vertex position exactly as the
+ * depth pre-pass does, so the ids cover the same pixels as
+ * the shaded models, and passes on the id of the model.
+ *
+ * A model drawn by itself takes its id from a uniform; one
+ * drawn as an animated instance takes it from the instance
+ * buffer along with its pose.
+ *
+ */
+
+// The id of a model drawn as an instance, and whether the instances are drawn
+attribute vec4 instanceId;
+uniform float isAnimated;
+
+// Poses a vertex of an instance; see instance_pose.vert.glsl
+vec4 poseInstance(vec3 vertex, out vec2 turn);
+
+// The id of a model drawn by itself, encoded as a color
+uniform vec4 objectId;
+
+varying vec4 id;
+
+invariant gl_Position;
+
+void main() {
+    if (isAnimated > 0.5) {
+        vec2 turn;
+        gl_Position = gl_ModelViewProjectionMatrix * poseInstance(gl_Vertex.xyz, turn);
+        id = instanceId;
+    } else {
+        gl_Position = ftransform();
+        id = objectId;
+    }
+}
@@ -0,0 +1,44 @@
+# version 120
+/*
+ * Brian Mitzel
+ * bmitzel at csu.fullerton.edu
+ *
+ * The pose of a model drawn as an animated instance, linked
+ * into every vertex shader which draws the instances, so
+ * the Blinn-Phong shader, the depth pre-pass and the id
+ * buffer all place a vertex the same way. The GL_EQUAL
+ * depth test of the shading pass relies on that.
+ *
+ */
+
+// The animation of a model drawn as an instance, advanced once per instance:
+// its center's x, starting height, center's z and scale factor, then its
+// rotation phase in degrees, bounce phase in radians, rotation speed in
+// degrees per second and bounce speed
+attribute vec4 instanceCenterScale;
+attribute vec4 instanceMotion;
+
+// The simulation time in seconds the instances are posed at
+uniform float animationTime;
+
+// How far the models bounce above and below their starting height; set from
+// MODEL_BOUNCE_HEIGHT, which Scene::Animate() bounces them by on the CPU
+uniform float bounceHeight;
+
+// Spins a vertex about the y axis and bounces it, like Scene::Animate() does
+// on the CPU, then scales and translates it as matTranslateRotateYScale4f()
+// does. The cosine and sine of the rotation are returned in turn, so that a
+// normal can be turned along with the vertex.
+vec4 poseInstance(vec3 vertex, out vec2 turn) {
+    float degrees = mod(instanceMotion.x + animationTime * instanceMotion.z, 360.0);
+    float height = instanceCenterScale.y
+        + bounceHeight * sin(instanceMotion.w * (animationTime + instanceMotion.y));
+    float c = cos(radians(degrees));
+    float s = sin(radians(degrees));
+    vec3 p = instanceCenterScale.w * vertex;
+    turn = vec2(c, s);
+    return vec4(c * p.x + s * p.z + instanceCenterScale.x,
+                p.y + height,
+                -s * p.x + c * p.z + instanceCenterScale.z,
+                1.0);
+}
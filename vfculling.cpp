@@ -36,15 +36,20 @@
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <cfloat>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <unistd.h>
 
 #include <GL/glew.h>
 
 #ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
 #include <GLUT/glut.h>
 #else
+#include <GL/glxew.h>
 #include <GL/glut.h>
 #endif
 
@@ -52,7 +57,28 @@
 #include <GL/freeglut_ext.h>
 #endif
 
+#include "BoundingBoxBatch.h"
+#include "CameraPath.h"
+#include "FramePipeline.h"
+#include "FrameProfiler.h"
+#include "FrameScheduler.h"
 #include "GLSLShader.h"
+#include "GLStateCache.h"
+#include "GpuMesh.h"
+#include "GpuTimer.h"
+#include "HeadlessContext.h"
+#include "IdBuffer.h"
+#include "InputQueue.h"
+#include "JobSystem.h"
+#include "MeshBvh.h"
+#include "MeshNormals.h"
+#include "MeshOptimizer.h"
+#include "MeshWelder.h"
+#include "ModelInstanceBatch.h"
+#include "Ray.h"
+#include "RayBatch.h"
+#include "RayTracer.h"
+#include "RenderQueue.h"
 #include "Scene.h"
 #include "Trackball.h"
 
@@ -66,6 +92,112 @@
 #define WINDOW_MIN_HEIGHT 200
 #define WINDOW_MAX_WIDTH glutGet(GLUT_SCREEN_WIDTH)
 #define WINDOW_MAX_HEIGHT glutGet(GLUT_SCREEN_HEIGHT)
+#define VIEW_FIELD_OF_VIEW 45.0
+#define VIEW_NEAR_PLANE 1.0
+#define VIEW_FAR_PLANE 25.0
+#define GROUND_DEFAULT_TESSELLATION 1
+#define GROUND_MAX_TESSELLATION 1024
+#define MODEL_MAX_INSTANCES 1000000
+#define MODEL_MAX_SPACING 1.5f
+#define MODEL_MAX_PROPS 8
+#define MODEL_PROP_DISTANCE 1.0f
+#define MODEL_PROP_HEIGHT 1.0f
+#define MODEL_LOD_HYSTERESIS 0.15f
+#define ENVIRONMENT_HALF_SIZE 12.0f
+#define ENVIRONMENT_HEIGHT 12.0f
+#define HEADLESS_DEFAULT_FRAMES 300
+#define HEADLESS_MAX_FRAMES 1000000
+#define HEADLESS_MAX_WIDTH 8192
+#define HEADLESS_MAX_HEIGHT 8192
+#define HEADLESS_TIME_STEP (1.0 / 60.0)
+#define FRAME_MAX_TARGET_FPS 1000
+#define FRAME_MAX_SLEEP_MICROSECONDS 1000
+#define HEADLESS_RANDOM_SEED 486
+#define HEADLESS_MAX_RAY_QUERIES 16777216
+#define MODEL_UPDATE_GRAIN 64
+#define MODEL_CULL_GRAIN 4
+
+//
+// Enumerations
+//
+
+/* Shader programs referenced by render queue sort keys; the animated models are drawn by the
+ * Blinn-Phong program too, but with the vertex shader posing them
+ * Opaque items are sorted by pass, program, material, mesh and then depth, so the animated
+ * models come first, ahead of the environment drawn by the other programs
+ */
+enum ProgramId {PROGRAM_ANIMATED_BLINN_PHONG, PROGRAM_FIXED_FUNCTION, PROGRAM_BLINN_PHONG};
+
+/* Materials referenced by render queue sort keys; within a program the models come before the
+ * environment
+ */
+enum MaterialId {MATERIAL_MODEL, MATERIAL_HIGHLIGHTED_MODEL, MATERIAL_GROUND, MATERIAL_SKY,
+        MATERIAL_BOUNDING_BOX};
+
+/* Meshes referenced by render queue sort keys; the models' meshes follow these */
+enum MeshId {MESH_GROUND, MESH_SKY, MESH_FIRST_MODEL};
+
+/* What a pixel is read back from the id buffer for */
+enum IdTag {ID_TAG_HOVER, ID_TAG_CLICK};
+
+/* Where a bounding volume lies with respect to the view frustum */
+enum FrustumTest {FRUSTUM_OUTSIDE, FRUSTUM_INTERSECTING, FRUSTUM_INSIDE};
+
+/* The passes of a frame timed on the GPU, within the scene's time but for the id buffer */
+enum GpuPhase {GPU_PHASE_PREPASS, GPU_PHASE_OPAQUE, GPU_PHASE_TRANSPARENT, GPU_PHASE_ID_BUFFER,
+        GPU_PHASE_COUNT};
+
+//
+// Structures
+//
+
+/* What the jobs which update, bound and cull the models of a frame share */
+struct ModelBatch
+{
+    const FrameInput* input;            /* the frame's simulation ticks and projection matrix */
+    const float* view;                  /* the frame's viewing matrix */
+    ModelArrays* models;                /* the scene's model components */
+    const std::vector<size_t>* order;   /* the models' indices in the order of the hierarchy */
+    const std::vector<size_t>* subtreeEnds; /* where each position's subtree ends */
+    bool isViewChanged;                 /* whether the view changed since the last frame */
+    bool isTimeChanged;                 /* whether the shader's time changed since then */
+    bool isLeavingGpu;                  /* whether the shader posed the models last frame but
+                                         * the ticks pose them this frame */
+    double seedTickTimes[2];            /* the two ticks before the frame's, which the ticks
+                                         * are seeded from when leaving the GPU */
+    ProduceCounters* counters;          /* the work the jobs did and skipped */
+}; /* ModelBatch struct */
+
+/* What the last frame was produced from, so that the next can skip what did not change */
+struct FrameHistory
+{
+    bool isValid;                       /* whether a frame has been produced yet */
+    unsigned long cameraVersion;        /* the camera's version */
+    float projection[16];               /* the projection matrix */
+    bool isAnimatingOnGpu;              /* whether the vertex shader posed the models */
+    double animationTime;               /* the time the vertex shader posed the models at */
+    double alpha;                       /* the interpolation factor between the last ticks */
+    bool isEveryModelReady;             /* whether every model was drawable */
+}; /* FrameHistory struct */
+
+/* How long the headless ray queries took each way, and whether the ways agreed */
+struct RayQueryStats
+{
+    int rayCount;                       /* the rays cast from the eye through the view */
+    int boxCount;                       /* the swept boxes of the models they were cast against */
+    int boxHitCount;                    /* the rays which entered a box */
+    int boxMismatchCount;               /* the rays whose nearest box differed between ways */
+    double boxSingleTime;               /* ms to test each ray against each box on its own */
+    double boxBatchTime;                /* ms to test each ray against four boxes at once */
+    double boxParallelTime;             /* ms to do so with the rays split among the jobs */
+    long model;                         /* the model whose hierarchy the rays were cast
+                                         * against, or -1 */
+    int triangleHitCount;               /* the rays which hit one of its triangles */
+    int triangleMismatchCount;          /* the rays whose nearest hit differed between ways */
+    double triangleSingleTime;          /* ms to walk its hierarchy one ray at a time */
+    double trianglePacketTime;          /* ms to walk it with packets of four rays */
+    double triangleParallelTime;        /* ms to do so with the packets split among the jobs */
+}; /* RayQueryStats struct */
 
 //
 // Function Prototypes
@@ -75,30 +207,62 @@
 void validateArgs(int argc, char* argv[]);
 void initProgram();
 void initGL();
+int runHeadless();
+void runRayQueries(RayQueryStats& stats);
+bool runRayTrace();
+void printHeadlessReport(FILE* file);
+void insertModels(int count);
+void insertModel(const char* filename, const Point3& position);
+void buildGroundPlane(int tessellation);
+void buildSkyBox();
 
 /* User interface functions */
 void printHelpMessage();
+void printFrameStatistics();
+void printJobStatistics();
+void printGpuTimings();
 void calcWindowCoords(int mouseX, int mouseY, const GLint viewport[],
         GLdouble& windowX, GLdouble& windowY);
 void pick(int mouseX, int mouseY);
+bool castRay(const Ray& ray, size_t& index, RayHit& hit);
+void getDrawnPose(size_t index, bool isAnimatingOnGpu, double animationTime, float& rotation,
+        float& height);
+void toModelSpace(size_t index, bool isAnimatingOnGpu, double animationTime,
+        const float origin[3], const float direction[3], float modelOrigin[3],
+        float modelDirection[3]);
+void pushInput(const InputEvent& event);
+
+/* Simulation functions */
+void produceFrame(const FrameInput& input, RenderList& list);
+void applyInput(const InputEvent& event);
+void updateModels(void* batch, size_t begin, size_t end);
+void cullModels(void* batch, size_t begin, size_t end);
 
 /* Drawing functions */
-void drawGroundPlane(Camera*);
-void drawSkyBox(Camera*);
-void drawBoundingBox(AxisAlignedBoundingBox* bv);
-void drawScene(Camera*);
+void applyMaterial(MaterialId material);
+void applyBlinnPhongMaterial(const BlinnPhongMaterial& material);
+void applyRenderPass(RenderPass pass);
+GpuPhase getGpuPhase(RenderPass pass);
+void drawDepthPrepass(const RenderQueue& queue, float animationTime);
+void drawIdBuffer(const RenderList& list);
+void collectIdBuffer();
+void drawScene(const RenderList& list);
 
 /* GLUT callback functions */
+void renderFrame();
+void uploadModels();
 void displayCallback();
 void reshapeCallback(int width, int height);
 void keyboardCallback(unsigned char key, int x, int y);
 void mouseCallback(int button, int state, int x, int y);
 void motionCallback(int x, int y);
-void timerCallback(int x);
+void idleCallback();
+void applyFrameMode(FrameMode mode);
 
 /* Math functions */
-bool inFrustum(AxisAlignedBoundingBox* bv);
-void transformVecByModelView(float outVec[4], const float inVec[4]); /* from Professor Shafae */
+bool inFrustum(const AxisAlignedBoundingBox* bv, const float projection[16]);
+FrustumTest classifyFrustum(const AxisAlignedBoundingBox* bv, const float projection[16]);
+int selectLod(float diameter, int level);
 
 /* Debugging functions */
 void msglPrintMatrix16dv(const char *varName, double matrix[16]); /* from Professor Shafae */
@@ -111,34 +275,115 @@ void msglVersion(); /* from Professor Shafae */
 
 /* Global constants */
 static const char   windowTitle[]       = "Picking";    /* window title */
+static const char*  gpuPhaseNames[GPU_PHASE_COUNT] = {"prepass", "opaque", "transparent",
+        "id_buffer"};                                   /* the GPU phases' names in the report */
+static const float  lodDiameters[MESH_LOD_COUNT - 1] = {240.0f, 120.0f, 60.0f}; /* the projected
+                                                         * diameters in pixels below which each
+                                                         * coarser level of detail is drawn */
+
+/* The Blinn-Phong program's materials by MaterialId, which the ray tracer shades with too: light
+ * color, ambient, diffuse, specular, then shininess
+ */
+static const BlinnPhongMaterial blinnPhongMaterials[MATERIAL_BOUNDING_BOX] =
+{
+    {{0.7f, 0.7f, 0.7f, 1.0f}, {0.2f, 0.2f, 0.2f, 1.0f}, {0.5f, 0.5f, 0.5f, 1.0f},
+            {1.0f, 1.0f, 1.0f, 1.0f}, 1.0f},
+    {{0.9f, 0.6f, 0.2f, 1.0f}, {0.3f, 0.2f, 0.1f, 1.0f}, {0.6f, 0.6f, 0.6f, 1.0f},
+            {1.0f, 1.0f, 1.0f, 1.0f}, 1.0f},
+    {{0.0f, 0.7f, 0.0f, 1.0f}, {0.2f, 0.2f, 0.2f, 1.0f}, {0.5f, 0.5f, 0.5f, 1.0f},
+            {1.0f, 1.0f, 1.0f, 1.0f}, 1.0f},
+    {{0.0f, 0.0f, 0.7f, 1.0f}, {0.2f, 0.2f, 0.2f, 1.0f}, {0.5f, 0.5f, 0.5f, 1.0f},
+            {1.0f, 1.0f, 1.0f, 1.0f}, 1.0f}
+};
 
 /* Global variables */
 static int          windowInitialWidth;                 /* initial window width */
 static int          windowInitialHeight;                /* initial window height */
 static int          windowWidth;                        /* current window width */
 static int          windowHeight;                       /* current window height */
+static int          groundTessellation;                 /* ground plane quads along each side */
+static int          modelInstances;                     /* the number of models, or 0 for three */
+static int          modelProps;                         /* the props riding on each model */
 static int          mouseX;                             /* the mouse's current x position value */
 static int          mouseY;                             /* the mouse's current y position value */
 static bool         isFullScreen;                       /* window full screen flag */
 static bool         isDrawingBoundingVolumes;           /* drawing bounding volumes flag */
 static bool         isUsingGLSLShader;                  /* using GLSL shader program flag */
+static bool         isUsingDepthPrepass;                /* drawing a depth pre-pass flag */
+static bool         isDrawingWireframeBoxes;            /* drawing bounding volume edges flag */
+static bool         isAnimatingOnGpu;                   /* posing the models in the vertex shader flag */
+static bool         isPaused;                           /* animation paused flag */
+static bool         isUsingLod;                         /* drawing distant models coarser flag */
+static bool         isPickingOnGpu;                     /* picking through the id buffer flag */
+static bool         isClickPending;                     /* a click waiting for the id buffer flag */
+static size_t       cursorModel;                        /* the model last read back under the cursor */
+static size_t       hoveredModel;                       /* the model the simulation highlights */
+static double       weldEpsilon;                        /* the distance vertices are welded within */
+static NormalWeighting normalWeighting;                 /* how faces weight the vertex normals */
+static double       pausedSeconds;                      /* the simulation time spent paused */
+static double       pausedAlpha;                        /* the interpolation factor when paused */
+static bool         isHeadless;                         /* rendering offscreen without a window flag */
+static bool         isUsingPipeline;                    /* culling on a worker thread flag */
+static int          jobWorkers;                         /* the number of job system workers */
+static bool         isJobOrderFixed;                    /* running jobs in a deterministic order flag */
+static int          headlessFrames;                     /* the number of frames to render headless */
+static const char*  cameraPathFile;                     /* the camera path to follow, or NULL */
+static const char*  reportFile;                         /* the headless timing report, or NULL */
+static const char*  imageFile;                          /* the final headless frame image, or NULL */
+static int          rayQueryCount;                      /* the rays the headless run casts, or 0 */
+static RayQueryStats rayQueryStats;                     /* how long the headless ray queries took */
+static const char*  rayTraceFile;                       /* the ray traced image to write, or NULL */
+static int          rayTraceWidth;                      /* the ray traced image's width */
+static int          rayTraceHeight;                     /* the ray traced image's height */
+static double       rayTraceSingleTime;                 /* ms to trace the image on one thread */
 static Scene        scene;                              /* the scene to render */
+static FrameHistory frameHistory;                       /* what the last frame was produced from */
 static Trackball    trackball;                          /* virtual trackball for camera control */
-
-/* GLSL shader program */
+static GLStateCache glState;                            /* shadow of the OpenGL state */
+static float        projectionMatrix[16];               /* the projection set by the reshape callback */
+static unsigned long materialChanges;                   /* material changes during the last frame */
+static GpuTimer     sceneTimer;                         /* GPU time of the scene without pre-pass */
+static GpuTimer     scenePrepassTimer;                  /* GPU time of the scene with pre-pass */
+static GpuTimer     gpuPhaseTimers[GPU_PHASE_COUNT];    /* GPU time of each pass of the frame */
+static IdBuffer     idBuffer;                           /* the ids of the models under the cursor */
+static RayTracer    rayTracer;                          /* traces the final headless frame */
+static GpuMesh      groundPlaneMesh;                    /* static geometry of the ground plane */
+static GpuMesh      skyBoxMesh;                         /* static geometry of the sky box */
+static BoundingBoxBatch boundingBoxBatch;               /* the bounding volumes of the current frame */
+static ModelInstanceBatch modelInstanceBatch;           /* draws the models the vertex shader poses */
+static FrameProfiler profiler;                          /* CPU time of each phase of the frame */
+static FrameScheduler frameScheduler;                   /* simulation ticks and frame pacing */
+static CameraPath   cameraPath;                         /* camera keyframes for headless runs */
+static InputQueue   inputQueue;                         /* input on its way to the simulation */
+static JobSystem    jobSystem;                          /* runs work in parallel on every core */
+static FramePipeline pipeline;                          /* produces the render lists to draw */
+static double       startTime;                          /* when the program started in ms */
+static double       firstFrameTime;                     /* ms from start to the first frame, or -1 */
+static double       modelsReadyTime;                    /* ms from start to the last upload, or -1 */
+
+/* GLSL shader programs */
 GLSLProgram* shaderProgram;
+GLSLProgram* depthProgram;
+GLSLProgram* idProgram;
 
 /* Shader program values */
 const float light0_world_pos[] = {0.0f, 11.5f, 0.0f, 1.0f}; /* light position in world space */
 float light0_model_pos[4];                                  /* light position in modelview space */
 
 /* Shader program uniform variables */
-unsigned int uLight0_position;
-unsigned int uLight0_color;
-unsigned int uAmbient;
-unsigned int uDiffuse;
-unsigned int uSpecular;
-unsigned int uShininess;
+GLint uLight0_position;
+GLint uLight0_color;
+GLint uAmbient;
+GLint uDiffuse;
+GLint uSpecular;
+GLint uShininess;
+GLint uIsAnimated;
+GLint uAnimationTime;
+GLint uDepthIsAnimated;
+GLint uDepthAnimationTime;
+GLint uIdIsAnimated;
+GLint uIdAnimationTime;
+GLint uIdObjectId;
 
 //
 // Function Definitions
@@ -152,8 +397,22 @@ unsigned int uShininess;
  */
 int main(int argc, char* argv[])
 {
-    /* Initialize GLUT */
-    glutInit(&argc, argv);
+    /* Measure the startup from here */
+    ::startTime = FrameProfiler::GetMilliseconds();
+    ::firstFrameTime = -1.0;
+    ::modelsReadyTime = -1.0;
+
+    /* Initialize GLUT, unless running headless where there may be no display to connect to */
+    bool isHeadlessRequested = false;
+    for (int i = 1; i < argc; i++)
+    {
+        isHeadlessRequested = isHeadlessRequested || 0 == strcmp(argv[i], "--headless");
+    }
+
+    if (!isHeadlessRequested)
+    {
+        glutInit(&argc, argv);
+    }
 
     /* Validate and process the command line arguments */
     validateArgs(argc, argv);
@@ -161,6 +420,12 @@ int main(int argc, char* argv[])
     /* Initialize program parameters */
     initProgram();
 
+    /* Render the requested number of frames offscreen and exit */
+    if (::isHeadless)
+    {
+        return runHeadless();
+    }
+
     /* Create the window */
     glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
     glutInitWindowSize(::windowWidth, ::windowHeight);
@@ -196,11 +461,253 @@ int main(int argc, char* argv[])
  */
 void validateArgs(int argc, char* argv[])
 {
+    char* positionalArgs[2];
+    int numPositionalArgs = 0;
+    bool isUsageError = false;
+
+    ::groundTessellation = GROUND_DEFAULT_TESSELLATION;
+    ::modelInstances = 0;
+    ::modelProps = 0;
+    ::isAnimatingOnGpu = false;
+    ::isPaused = false;
+    ::isUsingLod = true;
+    ::isPickingOnGpu = false;
+    ::isClickPending = false;
+    ::cursorModel = MODEL_NO_INDEX;
+    ::hoveredModel = MODEL_NO_INDEX;
+    ::weldEpsilon = MESH_DEFAULT_WELD_EPSILON;
+    ::normalWeighting = NORMALS_UNIFORM;
+    ::isHeadless = false;
+    ::isUsingPipeline = true;
+    ::jobWorkers = JobSystem::GetProcessorCount();
+    ::isJobOrderFixed = false;
+    ::headlessFrames = HEADLESS_DEFAULT_FRAMES;
+    ::cameraPathFile = NULL;
+    ::reportFile = NULL;
+    ::imageFile = NULL;
+    ::rayQueryCount = 0;
+    ::rayTraceFile = NULL;
+    ::rayTraceWidth = 0;
+    ::rayTraceHeight = 0;
+
+    /* Process the options and collect the positional arguments */
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--ground-tessellation") && i + 1 < argc)
+        {
+            /* Set the number of ground plane quads along each side */
+            ::groundTessellation = strtol(argv[++i], NULL, 0);
+
+            if (1 > ::groundTessellation || GROUND_MAX_TESSELLATION < ::groundTessellation)
+            {
+                fprintf(stderr, "Error: ground tessellation must be between 1 and %d\n",
+                        GROUND_MAX_TESSELLATION);
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--instances") && i + 1 < argc)
+        {
+            /* Set the number of models laid out on a grid */
+            ::modelInstances = strtol(argv[++i], NULL, 0);
+
+            if (1 > ::modelInstances || MODEL_MAX_INSTANCES < ::modelInstances)
+            {
+                fprintf(stderr, "Error: instances must be between 1 and %d\n",
+                        MODEL_MAX_INSTANCES);
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--props") && i + 1 < argc)
+        {
+            /* Set the number of props riding on each model */
+            ::modelProps = strtol(argv[++i], NULL, 0);
+
+            if (0 > ::modelProps || MODEL_MAX_PROPS < ::modelProps)
+            {
+                fprintf(stderr, "Error: props must be between 0 and %d\n", MODEL_MAX_PROPS);
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--gpu-animation"))
+        {
+            /* Pose the models in the vertex shader instead of on the CPU */
+            ::isAnimatingOnGpu = true;
+        }
+        else if (0 == strcmp(argv[i], "--paused"))
+        {
+            /* Start with the animation paused, so that only the camera moves */
+            ::isPaused = true;
+        }
+        else if (0 == strcmp(argv[i], "--weld-epsilon") && i + 1 < argc)
+        {
+            /* Set the distance within which the meshes' vertices are welded */
+            ::weldEpsilon = strtod(argv[++i], NULL);
+
+            if (!(0.0 <= ::weldEpsilon && MESH_MAX_WELD_EPSILON >= ::weldEpsilon))
+            {
+                fprintf(stderr, "Error: weld epsilon must be between 0 and %g\n",
+                        MESH_MAX_WELD_EPSILON);
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--normals") && i + 1 < argc)
+        {
+            /* Set how the faces around each vertex weight its normal */
+            if (!MeshNormals::Parse(argv[++i], ::normalWeighting))
+            {
+                fprintf(stderr, "Error: normals must be uniform, area or angle\n");
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--no-lod"))
+        {
+            /* Draw every model at full detail however small it is on screen */
+            ::isUsingLod = false;
+        }
+        else if (0 == strcmp(argv[i], "--gpu-picking"))
+        {
+            /* Pick and highlight the models through the id buffer instead of casting rays */
+            ::isPickingOnGpu = true;
+        }
+        else if (0 == strcmp(argv[i], "--frame-rate") && i + 1 < argc)
+        {
+            /* Set the frame pacing mode */
+            i++;
+            if (0 == strcmp(argv[i], "vsync"))
+            {
+                ::frameScheduler.SetMode(FRAME_MODE_VSYNC);
+            }
+            else if (0 == strcmp(argv[i], "uncapped"))
+            {
+                ::frameScheduler.SetMode(FRAME_MODE_UNCAPPED);
+            }
+            else
+            {
+                double fps = strtod(argv[i], NULL);
+
+                if (1.0 > fps || FRAME_MAX_TARGET_FPS < fps)
+                {
+                    fprintf(stderr, "Error: frame rate must be vsync, uncapped, or between 1 and %d\n",
+                            FRAME_MAX_TARGET_FPS);
+                    exit(-1);
+                }
+
+                ::frameScheduler.SetMode(FRAME_MODE_TARGET);
+                ::frameScheduler.SetTargetFps(fps);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--no-pipeline"))
+        {
+            /* Update and cull the scene on the OpenGL thread instead of a worker thread */
+            ::isUsingPipeline = false;
+        }
+        else if (0 == strcmp(argv[i], "--jobs") && i + 1 < argc)
+        {
+            /* Set the number of job system workers, or run the jobs in a fixed order */
+            i++;
+            if (0 == strcmp(argv[i], "deterministic"))
+            {
+                ::jobWorkers = 1;
+                ::isJobOrderFixed = true;
+            }
+            else
+            {
+                ::jobWorkers = strtol(argv[i], NULL, 0);
+
+                if (1 > ::jobWorkers || JOB_MAX_WORKERS < ::jobWorkers)
+                {
+                    fprintf(stderr, "Error: jobs must be deterministic or between 1 and %d\n",
+                            JOB_MAX_WORKERS);
+                    exit(-1);
+                }
+            }
+        }
+        else if (0 == strcmp(argv[i], "--headless"))
+        {
+            /* Render offscreen without a window */
+            ::isHeadless = true;
+        }
+        else if (0 == strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            /* Set the number of frames to render headless */
+            ::headlessFrames = strtol(argv[++i], NULL, 0);
+
+            if (1 > ::headlessFrames || HEADLESS_MAX_FRAMES < ::headlessFrames)
+            {
+                fprintf(stderr, "Error: frames must be between 1 and %d\n", HEADLESS_MAX_FRAMES);
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--camera-path") && i + 1 < argc)
+        {
+            /* Set the camera path to follow */
+            ::cameraPathFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--report") && i + 1 < argc)
+        {
+            /* Set the file to write the timing report to */
+            ::reportFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--dump-frame") && i + 1 < argc)
+        {
+            /* Set the image file to write the final frame to */
+            ::imageFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--ray-queries") && i + 1 < argc)
+        {
+            /* Set the number of rays to cast through the final frame */
+            ::rayQueryCount = strtol(argv[++i], NULL, 0);
+
+            if (1 > ::rayQueryCount || HEADLESS_MAX_RAY_QUERIES < ::rayQueryCount)
+            {
+                fprintf(stderr, "Error: ray queries must be between 1 and %d\n",
+                        HEADLESS_MAX_RAY_QUERIES);
+                exit(-1);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--ray-trace") && i + 1 < argc)
+        {
+            /* Set the image file to ray trace the final frame into */
+            ::rayTraceFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--ray-trace-size") && i + 1 < argc)
+        {
+            /* Set the ray traced image's size, which defaults to the view's */
+            if (2 != sscanf(argv[++i], "%dx%d", &::rayTraceWidth, &::rayTraceHeight)
+                    || 1 > ::rayTraceWidth || HEADLESS_MAX_WIDTH < ::rayTraceWidth
+                    || 1 > ::rayTraceHeight || HEADLESS_MAX_HEIGHT < ::rayTraceHeight)
+            {
+                fprintf(stderr, "Error: ray trace size must be <width>x<height>, each between "
+                        "1 and %d\n", HEADLESS_MAX_WIDTH);
+                exit(-1);
+            }
+        }
+        else if (0 == strncmp(argv[i], "--", 2) || 2 == numPositionalArgs)
+        {
+            isUsageError = true;
+        }
+        else
+        {
+            positionalArgs[numPositionalArgs++] = argv[i];
+        }
+    }
+
+    /* The benchmark options only apply to headless runs */
+    if (!::isHeadless && (::cameraPathFile || ::reportFile || ::imageFile || ::rayQueryCount
+            || ::rayTraceFile || ::rayTraceWidth))
+    {
+        isUsageError = true;
+    }
+
+    /* Without a window the size is only limited by the framebuffer object */
+    int maxWidth = ::isHeadless ? HEADLESS_MAX_WIDTH : WINDOW_MAX_WIDTH;
+    int maxHeight = ::isHeadless ? HEADLESS_MAX_HEIGHT : WINDOW_MAX_HEIGHT;
+
     /* Validate command line arguments */
-    if (3 == argc)
+    if (!isUsageError && 2 == numPositionalArgs)
     {
         /* Set initial window width */
-        ::windowInitialWidth = strtol(argv[1], NULL, 0);
+        ::windowInitialWidth = strtol(positionalArgs[0], NULL, 0);
 
         /* Check for value out of range */
         if (ERANGE == errno)
@@ -210,7 +717,7 @@ void validateArgs(int argc, char* argv[])
         }
 
         /* Set initial window height */
-        ::windowInitialHeight = strtol(argv[2], NULL, 0);
+        ::windowInitialHeight = strtol(positionalArgs[1], NULL, 0);
 
         /* Check for value out of range */
         if (ERANGE == errno)
@@ -225,20 +732,20 @@ void validateArgs(int argc, char* argv[])
 
         /* Validate window width */
         if (WINDOW_MIN_WIDTH > ::windowInitialWidth
-                || WINDOW_MAX_WIDTH < ::windowInitialWidth)
+                || maxWidth < ::windowInitialWidth)
         {
             snprintf(errorMsgs[numErrors++], 79,
                     "Error: width must be between %d and %d\n",
-                    WINDOW_MIN_WIDTH, WINDOW_MAX_WIDTH);
+                    WINDOW_MIN_WIDTH, maxWidth);
         }
 
         /* Validate window height */
         if (WINDOW_MIN_HEIGHT > ::windowInitialHeight
-                || WINDOW_MAX_HEIGHT < ::windowInitialHeight)
+                || maxHeight < ::windowInitialHeight)
         {
             snprintf(errorMsgs[numErrors++], 79,
                     "Error: height must be between %d and %d\n",
-                    WINDOW_MIN_HEIGHT, WINDOW_MAX_HEIGHT);
+                    WINDOW_MIN_HEIGHT, maxHeight);
         }
 
         /* Print error messages and exit */
@@ -252,13 +759,13 @@ void validateArgs(int argc, char* argv[])
             exit(-1);
         }
     }
-    /* No command line arguments */
-    else if (1 == argc)
+    /* No window size arguments */
+    else if (!isUsageError && 0 == numPositionalArgs)
     {
         /* Clamp to screen width and set window width */
-        if (WINDOW_MAX_WIDTH < WINDOW_DEFAULT_WIDTH)
+        if (maxWidth < WINDOW_DEFAULT_WIDTH)
         {
-            ::windowInitialWidth = WINDOW_MAX_WIDTH;
+            ::windowInitialWidth = maxWidth;
         }
         else
         {
@@ -266,9 +773,9 @@ void validateArgs(int argc, char* argv[])
         }
 
         /* Clamp to screen height and set window height */
-        if (WINDOW_MAX_HEIGHT < WINDOW_DEFAULT_HEIGHT)
+        if (maxHeight < WINDOW_DEFAULT_HEIGHT)
         {
-            ::windowInitialHeight = WINDOW_MAX_HEIGHT;
+            ::windowInitialHeight = maxHeight;
         }
         else
         {
@@ -279,7 +786,19 @@ void validateArgs(int argc, char* argv[])
     else
     {
         /* Print command line usage and exit */
-        fprintf(stderr, "Usage: %s [<width> <height>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--ground-tessellation <n>] [--frame-rate vsync|uncapped|<fps>]\n"
+                "           [--no-pipeline] [--jobs deterministic|<n>] [--instances <n>]\n"
+                "           [--props <n>] [--gpu-animation] [--paused] [--no-lod]\n"
+                "           [--weld-epsilon <e>] [--normals uniform|area|angle]\n"
+                "           [--gpu-picking] [<width> <height>]\n"
+                "       %s --headless [--frames <n>] [--camera-path <file>] [--report <file>]\n"
+                "           [--dump-frame <file>] [--ground-tessellation <n>] [--no-pipeline]\n"
+                "           [--jobs deterministic|<n>] [--instances <n>] [--props <n>]\n"
+                "           [--gpu-animation] [--paused] [--no-lod] [--weld-epsilon <e>]\n"
+                "           [--normals uniform|area|angle] [--gpu-picking]\n"
+                "           [--ray-queries <n>] [--ray-trace <file>]\n"
+                "           [--ray-trace-size <width>x<height>] [<width> <height>]\n",
+                argv[0], argv[0]);
         exit(-1);
     }
 } /* validateArgs() */
@@ -294,14 +813,23 @@ void initProgram()
     ::isFullScreen = false;
     ::isDrawingBoundingVolumes = false;
     ::isUsingGLSLShader = true;
+    ::isUsingDepthPrepass = false;
+    ::isDrawingWireframeBoxes = false;
 
     /* Initialize the center and radius of the virtual trackball */
     ::trackball.SetCenter(::windowWidth / 2, ::windowHeight / 2);
     ::trackball.SetRadius(std::max(::windowWidth, ::windowHeight) / 2);
 
     /* Seed the random number generator for setting the
-     * initial height and rotation of models in the scene */
-    srand(time(NULL));
+     * initial height and rotation of models in the scene;
+     * headless runs use a fixed seed so that they are repeatable */
+    srand(::isHeadless ? HEADLESS_RANDOM_SEED : time(NULL));
+
+    /* Start the workers which load the models in the background and bound and cull them in
+     * parallel
+     */
+    ::jobSystem.Start(::jobWorkers, ::isJobOrderFixed);
+    ::scene.SetJobSystem(&::jobSystem);
 } /* initProgram() */
 
 /**
@@ -311,30 +839,37 @@ void initGL()
 {
     /* Set the OpenGL state */
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   /* uses black for clearing the color buffers */
-    glEnable(GL_DEPTH_TEST);                /* enables z-buffer depth testing */
+    ::glState.Enable(GL_DEPTH_TEST);        /* enables z-buffer depth testing */
     glDepthRange(0.0, 1.0);                 /* set the range for the z-buffer */
-    glDepthFunc(GL_LEQUAL);                 /* depth test uses <= comparison function */
-    glEnable(GL_CULL_FACE);                 /* enables face culling */
+    ::glState.DepthFunc(GL_LEQUAL);         /* depth test uses <= comparison function */
+    ::glState.Enable(GL_CULL_FACE);         /* enables face culling */
     glCullFace(GL_BACK);                    /* back faces are culled */
     glFrontFace(GL_CCW);                    /* front faces are calculated using CCW winding */
-    glEnable(GL_NORMALIZE);                 /* normalizes all normals in fixed function pipeline */
+    ::glState.Enable(GL_NORMALIZE);         /* normalizes all normals in fixed function pipeline */
+    ::glState.Disable(GL_BLEND);            /* blending is only used for the bounding volumes */
+    ::glState.Disable(GL_COLOR_MATERIAL);   /* material colors come from glMaterial() */
 
-    /* Load the shader program */
+    /* Load the shader program; every program which draws the animated instances links in the
+     * one vertex shader which poses them
+     */
     const char* vertexShaderSource = "blinn_phong.vert.glsl";
     const char* fragmentShaderSource = "blinn_phong.frag.glsl";
+    VertexShader poseShader("instance_pose.vert.glsl");
     FragmentShader fragmentShader(fragmentShaderSource);
     VertexShader vertexShader(vertexShaderSource);
     ::shaderProgram = new GLSLProgram();
     ::shaderProgram->attach(vertexShader);
+    ::shaderProgram->attach(poseShader);
     ::shaderProgram->attach(fragmentShader);
-    ::shaderProgram->link();
+    ModelInstanceBatch::BindAttributes(::shaderProgram->id());
+    bool isLinked = ::shaderProgram->link();
 
     /* Activate the shader program */
     if (::isUsingGLSLShader)
     {
-        ::shaderProgram->activate();
+        ::glState.UseProgram(::shaderProgram->id());
         printf("Shader program built from %s and %s.\n", vertexShaderSource, fragmentShaderSource);
-        if (::shaderProgram->isActive())
+        if (isLinked && !msglError() && ::glState.IsProgramActive(::shaderProgram->id()))
         {
             printf("Shader program is loaded and active with id %d.\n", ::shaderProgram->id());
         }
@@ -352,354 +887,1894 @@ void initGL()
     ::uDiffuse = glGetUniformLocation(::shaderProgram->id(), "diffuse");
     ::uSpecular = glGetUniformLocation(::shaderProgram->id(), "specular");
     ::uShininess = glGetUniformLocation(::shaderProgram->id(), "shininess");
+    ::uIsAnimated = glGetUniformLocation(::shaderProgram->id(), "isAnimated");
+    ::uAnimationTime = glGetUniformLocation(::shaderProgram->id(), "animationTime");
+
+    /* Load the depth-only shader program used by the depth pre-pass */
+    FragmentShader depthFragmentShader("depth_only.frag.glsl");
+    VertexShader depthVertexShader("depth_only.vert.glsl");
+    ::depthProgram = new GLSLProgram();
+    ::depthProgram->attach(depthVertexShader);
+    ::depthProgram->attach(poseShader);
+    ::depthProgram->attach(depthFragmentShader);
+    ModelInstanceBatch::BindAttributes(::depthProgram->id());
+    if (!::depthProgram->link())
+    {
+        printf("Depth-only shader program did not link correctly. Exiting.\n");
+        exit(1);
+    }
+    ::uDepthIsAnimated = glGetUniformLocation(::depthProgram->id(), "isAnimated");
+    ::uDepthAnimationTime = glGetUniformLocation(::depthProgram->id(), "animationTime");
+
+    /* Load the shader program which draws the models' ids for picking on the GPU */
+    FragmentShader idFragmentShader("id_buffer.frag.glsl");
+    VertexShader idVertexShader("id_buffer.vert.glsl");
+    ::idProgram = new GLSLProgram();
+    ::idProgram->attach(idVertexShader);
+    ::idProgram->attach(poseShader);
+    ::idProgram->attach(idFragmentShader);
+    ModelInstanceBatch::BindAttributes(::idProgram->id());
+    if (!::idProgram->link())
+    {
+        printf("Id buffer shader program did not link correctly. Exiting.\n");
+        exit(1);
+    }
+    ::uIdIsAnimated = glGetUniformLocation(::idProgram->id(), "isAnimated");
+    ::uIdAnimationTime = glGetUniformLocation(::idProgram->id(), "animationTime");
+    ::uIdObjectId = glGetUniformLocation(::idProgram->id(), "objectId");
+
+    /* The instances bounce as high as the models animated on the CPU */
+    GLSLProgram* posingPrograms[] = {::shaderProgram, ::depthProgram, ::idProgram};
+    GLuint activeProgram = ::glState.GetProgram();
+    for (size_t i = 0; i < sizeof(posingPrograms) / sizeof(posingPrograms[0]); i++)
+    {
+        ::glState.UseProgram(posingPrograms[i]->id());
+        ::glState.Uniform1f(glGetUniformLocation(posingPrograms[i]->id(), "bounceHeight"),
+                MODEL_BOUNCE_HEIGHT);
+    }
+    ::glState.UseProgram(activeProgram);
+
+    /* Create the id buffer and the pixel buffer objects it is read back through */
+    ::idBuffer.Init();
+    if (::isPickingOnGpu && !::idBuffer.IsSupported())
+    {
+        puts("The id buffer is not supported; picking casts rays instead.");
+        ::isPickingOnGpu = false;
+    }
+
+    /* Create the instance buffer of the models the vertex shader poses */
+    ::modelInstanceBatch.Init();
+
+    /* Build the unit cube and shader program that draw all the bounding volumes at once */
+    ::boundingBoxBatch.Init(::glState, "bounding_box.vert.glsl", "bounding_box.frag.glsl");
+
+    /* Create the GPU timers for comparing the scene with and without the depth pre-pass, and
+     * for each of the frame's passes
+     */
+    ::sceneTimer.Init();
+    ::scenePrepassTimer.Init();
+    for (int i = 0; i < GPU_PHASE_COUNT; i++)
+    {
+        ::gpuPhaseTimers[i].Init();
+    }
 
     /* Initialize the lighting for the fixed function pipeline */
     glShadeModel(GL_SMOOTH);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
     GLfloat light0_ambient[]  = { 0.0f,  0.0f, 0.0f, 1.0f};
     GLfloat light0_diffuse[]  = { 1.0f,  1.0f, 1.0f, 1.0f};
     GLfloat light0_position[] = {-2.0f, 14.5f, 2.0f, 1.0f};
     glLightfv(GL_LIGHT0, GL_AMBIENT , light0_ambient );
     glLightfv(GL_LIGHT0, GL_DIFFUSE , light0_diffuse );
     glLightfv(GL_LIGHT0, GL_POSITION, light0_position);
-    glEnable (GL_LIGHT0);
+    ::glState.Enable(GL_LIGHT0);
 
     /* Enable the lighting for the fixed function pipeline */
     if (!::isUsingGLSLShader)
     {
-        glEnable(GL_LIGHTING);
+        ::glState.Enable(GL_LIGHTING);
     }
 
-    /* Add the PLY models to the scene */
-    ::scene.Insert("data/dragon_vrip_res4.ply", Point3(-2.0f, 1.5f, -0.5f));
-    ::scene.Insert("data/dragon_vrip_res4.ply", Point3(2.0f, 1.5f, -0.5f));
-    ::scene.Insert("data/bun_zipper_res2.ply", Point3(0.0f, 1.5f, 0.5f));
+    /* Bake the ground plane and sky box into static buffer objects */
+    buildGroundPlane(::groundTessellation);
+    buildSkyBox();
+
+    /* Add the PLY models to the scene; they load in the background and are drawn as their
+     * bounding volumes until renderFrame() uploads them
+     */
+    ::scene.GetMeshCache()->SetWeldEpsilon(::weldEpsilon);
+    ::scene.GetMeshCache()->SetNormalWeighting(::normalWeighting);
+    insertModels(::modelInstances);
+
+    /* Update and cull the next frame on a worker thread while this thread draws */
+    if (!::pipeline.Start(produceFrame, ::isUsingPipeline))
+    {
+        ::isUsingPipeline = false;
+    }
 
     /* Register GLUT callback functions */
-    glutDisplayFunc(displayCallback);
-    glutReshapeFunc(reshapeCallback);
-    glutKeyboardFunc(keyboardCallback);
-    glutMotionFunc(motionCallback);
-    glutMouseFunc(mouseCallback);
-    glutPassiveMotionFunc(motionCallback);
-    glutTimerFunc(16, timerCallback, 0);
+    if (!::isHeadless)
+    {
+        glutDisplayFunc(displayCallback);
+        glutReshapeFunc(reshapeCallback);
+        glutKeyboardFunc(keyboardCallback);
+        glutMotionFunc(motionCallback);
+        glutMouseFunc(mouseCallback);
+        glutPassiveMotionFunc(motionCallback);
+        glutIdleFunc(idleCallback);
+        applyFrameMode(::frameScheduler.GetMode());
+    }
 
     msglError();
 } /* initGL() */
 
 /**
- * Prints user help text to the console
+ * Renders the scene offscreen for a fixed number of frames and reports the timings
+ * The camera follows the camera path, if any, and the models are animated with a fixed
+ * time step so that every run draws the same frames
+ * @return - The exit code
  */
-void printHelpMessage()
+int runHeadless()
 {
-    puts("Press 'b' to toggle rendering the bounding volumes.");
-    puts("Press 'f' to toggle full screen mode (freeglut only).");
-    puts("Press 'g' to toggle between the GLSL program and the fixed function pipeline.");
-    puts("Press 'o' to reset the window to its original resolution.");
-    puts("Press ESC or 'q' to quit.");
-    puts("Press 'h' to print this message again.");
-} /* printHelpMessage() */
+    HeadlessContext context;
+
+    /* Load the camera path before spending time on the context */
+    if (NULL != ::cameraPathFile && !::cameraPath.Load(::cameraPathFile))
+    {
+        return 1;
+    }
+
+    if (!context.CreateContext())
+    {
+        return 1;
+    }
+
+    /* Initialize GLEW; without a window there is no GLX display, which only GLX itself needs */
+    glewExperimental = true;
+    GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (GLEW_ERROR_NO_GLX_DISPLAY == status)
+    {
+        status = GLEW_OK;
+    }
+#endif
+    if (GLEW_OK != status)
+    {
+        fprintf(stderr, "GLEW init failed.\n");
+        return 1;
+    }
+
+    if (!context.CreateFramebuffer(::windowWidth, ::windowHeight))
+    {
+        return 1;
+    }
+
+    /* Initialize OpenGL and the projection as the window would */
+    initGL();
+    msglVersion();
+    reshapeCallback(::windowWidth, ::windowHeight);
+
+    /* The camera belongs to the simulation, so the path moves a copy and sends its poses */
+    Camera camera = *::scene.GetCamera();
+    ::profiler.SetEnabled(true);
+
+    /* Only count the jobs from the first frame on */
+    ::jobSystem.ResetStats();
+
+    /* Without a mouse the id buffer reads back the center of the view */
+    ::mouseX = ::windowWidth / 2;
+    ::mouseY = ::windowHeight / 2;
+
+    for (int frame = 0; frame < ::headlessFrames; frame++)
+    {
+        ::profiler.Begin(PHASE_FRAME);
+
+        if (!::cameraPath.IsEmpty())
+        {
+            float t = ::headlessFrames > 1 ? static_cast<float>(frame) / (::headlessFrames - 1) : 0.0f;
+            ::cameraPath.Apply(t, &camera);
+
+            InputEvent event;
+            event.type = INPUT_SET_CAMERA;
+            event.points[0] = camera.eyePosition;
+            event.points[1] = camera.refPoint;
+            pushInput(event);
+        }
+        ::frameScheduler.BeginFrame(frame * HEADLESS_TIME_STEP);
+
+        renderFrame();
+
+        /* Wait for the GPU where the window would swap buffers, so the frame time includes it */
+        glFinish();
+
+        ::profiler.End(PHASE_FRAME);
+    }
+
+    /* Let the worker thread finish the frame it started, which is never drawn */
+    ::pipeline.Stop();
+
+    /* Cast the rays through the final frame while nothing else touches the models */
+    if (0 < ::rayQueryCount)
+    {
+        runRayQueries(::rayQueryStats);
+    }
+
+    /* Trace the final frame on the CPU once nothing else touches the models either */
+    if (NULL != ::rayTraceFile && !runRayTrace())
+    {
+        return 1;
+    }
+
+    /* Collect the GPU timings which are still in flight */
+    ::sceneTimer.Finish();
+    ::scenePrepassTimer.Finish();
+    for (int i = 0; i < GPU_PHASE_COUNT; i++)
+    {
+        ::gpuPhaseTimers[i].Finish();
+    }
+    ::idBuffer.Finish(::glState);
+    msglError();
+
+    if (NULL != ::imageFile && !context.WriteImage(::imageFile))
+    {
+        return 1;
+    }
+
+    FILE* file = NULL == ::reportFile ? stdout : fopen(::reportFile, "w");
+    if (NULL == file)
+    {
+        perror(::reportFile);
+        return 1;
+    }
+
+    printHeadlessReport(file);
+
+    if (stdout != file)
+    {
+        fclose(file);
+    }
+
+    context.Destroy();
+
+    return 0;
+} /* runHeadless() */
+
+/**
+ * Casts rays from the eye through a grid over the final frame's view, each out to the far
+ * plane, first against every drawable model's swept box and then against the hierarchy of the
+ * model whose box the most of them enter first
+ * Each query is timed one ray at a time, in batches on one thread, and in batches split among
+ * the jobs, and the batches' answers are checked against the single rays'
+ * The grid is walked in 2x2 blocks, so each packet of four rays is coherent
+ * @param stats - Returned with the timings and the number of hits
+ */
+void runRayQueries(RayQueryStats& stats)
+{
+    const RenderList& list = ::pipeline.GetFront();
+    const ModelArrays* models = ::scene.GetModels();
+    RayBatch rays;
+    float viewProjection[16];
+    float inverse[16];
+
+    memset(&stats, 0, sizeof(stats));
+    stats.rayCount = ::rayQueryCount;
+    stats.model = -1;
+
+    /* Unproject the grid's points on the near and far planes */
+    matMultMat4f(viewProjection, ::projectionMatrix, list.view);
+    if (!gluInvertMatrix(viewProjection, inverse))
+    {
+        return;
+    }
+    float aspect = static_cast<float>(::windowWidth) / ::windowHeight;
+    int columns = 2 * std::max(1, static_cast<int>(ceil(0.5 * sqrt(::rayQueryCount * aspect))));
+    int rows = 2 * ((::rayQueryCount + 2 * columns - 1) / (2 * columns));
+    rays.Reserve(::rayQueryCount);
+    for (int block = 0; rays.GetSize() < static_cast<size_t>(::rayQueryCount); block++)
+    {
+        for (int k = 0; k < 4 && rays.GetSize() < static_cast<size_t>(::rayQueryCount); k++)
+        {
+            int column = 2 * (block % (columns / 2)) + (k & 1);
+            int row = 2 * (block / (columns / 2)) + (k >> 1);
+            float x = 2.0f * (column + 0.5f) / columns - 1.0f;
+            float y = 2.0f * (row + 0.5f) / rows - 1.0f;
+            float nearPoint[4] = {x, y, -1.0f, 1.0f};
+            float farPoint[4] = {x, y, 1.0f, 1.0f};
+            matMultVec4f(nearPoint, nearPoint, inverse);
+            matMultVec4f(farPoint, farPoint, inverse);
+
+            float origin[3];
+            float direction[3];
+            for (int j = 0; j < 3; j++)
+            {
+                origin[j] = nearPoint[j] / nearPoint[3];
+                direction[j] = farPoint[j] / farPoint[3] - origin[j];
+            }
+            rays.Add(origin, direction, 1.0f);
+        }
+    }
+
+    /* Gather the swept boxes of the models which can be hit */
+    std::vector<float> bounds;
+    std::vector<size_t> boxModels;
+    for (size_t i = 0; i < ::scene.GetModelCount(); i++)
+    {
+        if (models->isReady[i])
+        {
+            bounds.insert(bounds.end(), &models->sweptBounds[6 * i], &models->sweptBounds[6 * i]
+                    + 6);
+            boxModels.push_back(i);
+        }
+    }
+    stats.boxCount = static_cast<int>(boxModels.size());
+
+    /* Find each ray's nearest box one ray and one box at a time, as castRay() does */
+    std::vector<BoxHit> singleBoxes(rays.GetSize());
+    double startTime = FrameProfiler::GetMilliseconds();
+    for (size_t r = 0; r < rays.GetSize(); r++)
+    {
+        float origin[3];
+        float direction[3];
+        float inverseDirection[3];
+        rays.GetRay(r, origin, direction, inverseDirection, singleBoxes[r].distance);
+        singleBoxes[r].box = -1;
+        for (size_t b = 0; b < boxModels.size(); b++)
+        {
+            float entry;
+            if (MeshBvh::IntersectBox(&bounds[6 * b], origin, inverseDirection,
+                    singleBoxes[r].distance, entry) && entry < singleBoxes[r].distance)
+            {
+                singleBoxes[r].distance = entry;
+                singleBoxes[r].box = static_cast<int>(b);
+            }
+        }
+    }
+    stats.boxSingleTime = FrameProfiler::GetMilliseconds() - startTime;
+
+    std::vector<BoxHit> boxes;
+    startTime = FrameProfiler::GetMilliseconds();
+    rays.IntersectBoxes(bounds.empty() ? NULL : &bounds[0], boxModels.size(), boxes, NULL);
+    stats.boxBatchTime = FrameProfiler::GetMilliseconds() - startTime;
+    startTime = FrameProfiler::GetMilliseconds();
+    rays.IntersectBoxes(bounds.empty() ? NULL : &bounds[0], boxModels.size(), boxes, &::jobSystem);
+    stats.boxParallelTime = FrameProfiler::GetMilliseconds() - startTime;
+
+    std::vector<int> firstHits(boxModels.size(), 0);
+    for (size_t r = 0; r < rays.GetSize(); r++)
+    {
+        if (0 <= boxes[r].box)
+        {
+            stats.boxHitCount++;
+            firstHits[boxes[r].box]++;
+        }
+        if (boxes[r].box != singleBoxes[r].box)
+        {
+            stats.boxMismatchCount++;
+        }
+    }
+    if (firstHits.empty() || 0 == stats.boxHitCount)
+    {
+        return;
+    }
+
+    /* Cast every ray against the hierarchy of the model whose box the most of them enter
+     * first, in its space; one transform for all of them keeps the packets coherent
+     */
+    size_t box = std::max_element(firstHits.begin(), firstHits.end()) - firstHits.begin();
+    size_t model = boxModels[box];
+    const MeshBvh* bvh = models->bvhs[model];
+    RayBatch modelRays;
+    modelRays.Reserve(rays.GetSize());
+    for (size_t r = 0; r < rays.GetSize(); r++)
+    {
+        float origin[3];
+        float direction[3];
+        float inverseDirection[3];
+        float maxDistance;
+        float modelOrigin[3];
+        float modelDirection[3];
+        rays.GetRay(r, origin, direction, inverseDirection, maxDistance);
+        toModelSpace(model, list.isAnimatingOnGpu, list.animationTime, origin, direction,
+                modelOrigin, modelDirection);
+        modelRays.Add(modelOrigin, modelDirection, maxDistance);
+    }
+    stats.model = static_cast<long>(model);
+
+    std::vector<RayHit> singleHits(modelRays.GetSize());
+    std::vector<bool> isSingleHit(modelRays.GetSize());
+    startTime = FrameProfiler::GetMilliseconds();
+    for (size_t r = 0; r < modelRays.GetSize(); r++)
+    {
+        float origin[3];
+        float direction[3];
+        float inverseDirection[3];
+        float maxDistance;
+        modelRays.GetRay(r, origin, direction, inverseDirection, maxDistance);
+        isSingleHit[r] = bvh->Intersect(origin, direction, maxDistance, singleHits[r]);
+    }
+    stats.triangleSingleTime = FrameProfiler::GetMilliseconds() - startTime;
+
+    std::vector<RayHit> hits;
+    startTime = FrameProfiler::GetMilliseconds();
+    modelRays.IntersectBvh(*bvh, hits, NULL);
+    stats.trianglePacketTime = FrameProfiler::GetMilliseconds() - startTime;
+    startTime = FrameProfiler::GetMilliseconds();
+    modelRays.IntersectBvh(*bvh, hits, &::jobSystem);
+    stats.triangleParallelTime = FrameProfiler::GetMilliseconds() - startTime;
+
+    /* Two triangles sharing an edge may be hit at the same distance, so only the distances
+     * are compared
+     */
+    for (size_t r = 0; r < modelRays.GetSize(); r++)
+    {
+        bool isHit = 0 <= hits[r].face;
+        stats.triangleHitCount += isHit ? 1 : 0;
+        if (isHit != isSingleHit[r] || (isHit && fabs(hits[r].distance - singleHits[r].distance)
+                > 1e-5 * std::max(1.0f, singleHits[r].distance)))
+        {
+            stats.triangleMismatchCount++;
+        }
+    }
+} /* runRayQueries() */
+
+/**
+ * Ray traces the final frame's view on the CPU into the image file, once on this thread and
+ * once with the tiles split among the jobs, so the report can tell how well it scales
+ * @return - True if the image was rendered and written; otherwise, false
+ */
+bool runRayTrace()
+{
+    const RenderList& list = ::pipeline.GetFront();
+    int width = 0 < ::rayTraceWidth ? ::rayTraceWidth : ::windowWidth;
+    int height = 0 < ::rayTraceHeight ? ::rayTraceHeight : ::windowHeight;
+    float projection[16];
+
+    /* The image gets the view's field of view and clipping planes at its own aspect ratio */
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluPerspective(VIEW_FIELD_OF_VIEW, static_cast<double>(width) / height, VIEW_NEAR_PLANE,
+            VIEW_FAR_PLANE);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+
+    /* The models are traced in the pose they were drawn in */
+    size_t modelCount = ::scene.GetModelCount();
+    std::vector<float> rotations(modelCount);
+    std::vector<float> heights(modelCount);
+    for (size_t i = 0; i < modelCount; i++)
+    {
+        getDrawnPose(i, list.isAnimatingOnGpu, list.animationTime, rotations[i], heights[i]);
+    }
+
+    ::rayTracer.SetModelMaterial(&::blinnPhongMaterials[MATERIAL_MODEL]);
+    ::rayTracer.SetLight(::light0_world_pos);
+    if (!::rayTracer.Render(::scene.GetModels(), modelCount, rotations, heights, list.view,
+            projection, width, height, NULL))
+    {
+        fprintf(stderr, "The final frame could not be ray traced.\n");
+        return false;
+    }
+    ::rayTraceSingleTime = ::rayTracer.GetStats().traceTime;
+    ::rayTracer.Render(::scene.GetModels(), modelCount, rotations, heights, list.view,
+            projection, width, height, &::jobSystem);
+
+    return ::rayTracer.WriteImage(::rayTraceFile);
+} /* runRayTrace() */
+
+/**
+ * Inserts the PLY models into the scene, each with its props riding on it
+ * @param count - The number of models to lay out on a square grid over the ground plane, two
+ *                dragons for every bunny, or 0 for the two dragons and the bunny on their own
+ */
+void insertModels(int count)
+{
+    if (0 == count)
+    {
+        insertModel("data/dragon_vrip_res4.ply", Point3(-2.0f, 1.5f, -0.5f));
+        insertModel("data/dragon_vrip_res4.ply", Point3(2.0f, 1.5f, -0.5f));
+        insertModel("data/bun_zipper_res2.ply", Point3(0.0f, 1.5f, 0.5f));
+        return;
+    }
+
+    /* Spread the grid over most of the ground plane, but keep small grids close together */
+    int side = static_cast<int>(ceil(sqrt(static_cast<double>(count))));
+    float spacing = std::min(MODEL_MAX_SPACING, 2.0f * ENVIRONMENT_HALF_SIZE * 0.9f / side);
+    float start = -0.5f * spacing * (side - 1);
+
+    for (int i = 0; i < count; i++)
+    {
+        Point3 position(start + spacing * (i % side), 1.5f, start + spacing * (i / side));
+        insertModel(2 == i % 3 ? "data/bun_zipper_res2.ply" : "data/dragon_vrip_res4.ply",
+                position);
+    }
+} /* insertModels() */
+
+/**
+ * Inserts a model into the scene along with the props riding on it, which stand in a ring
+ * above it and are carried along as it spins and bounces
+ * @param filename - The name of the model's PLY file
+ * @param position - Where the model's center starts
+ */
+void insertModel(const char* filename, const Point3& position)
+{
+    ModelHandle platform = ::scene.Insert(filename, position);
+
+    for (int i = 0; i < ::modelProps; i++)
+    {
+        float radians = 2.0f * static_cast<float>(M_PI) * i / ::modelProps;
+        Point3 offset(MODEL_PROP_DISTANCE * cosf(radians), MODEL_PROP_HEIGHT,
+                MODEL_PROP_DISTANCE * sinf(radians));
+        ::scene.Insert("data/bun_zipper_res2.ply", offset, platform);
+    }
+} /* insertModel() */
+
+/**
+ * Bakes the ground plane into a static mesh
+ * A finer grid gives per-vertex lighting more samples without any per-frame CPU cost
+ * @param tessellation - The number of quads along each side of the ground plane
+ */
+void buildGroundPlane(int tessellation)
+{
+    std::vector<GpuVertex> vertices;
+    std::vector<GLuint> indices;
+    float step = 2.0f * ENVIRONMENT_HALF_SIZE / tessellation;
+
+    /* Lay out a (tessellation + 1)^2 grid of vertices facing up */
+    for (int i = 0; i <= tessellation; i++)
+    {
+        for (int j = 0; j <= tessellation; j++)
+        {
+            GpuVertex vertex =
+            {
+                {-ENVIRONMENT_HALF_SIZE + j * step, 0.0f, -ENVIRONMENT_HALF_SIZE + i * step},
+                {0.0f, 1.0f, 0.0f},
+                {1.0f, 1.0f, 1.0f}
+            };
+            vertices.push_back(vertex);
+        }
+    }
+
+    /* Split each quad into two triangles, counter-clockwise when seen from above */
+    for (int i = 0; i < tessellation; i++)
+    {
+        for (int j = 0; j < tessellation; j++)
+        {
+            GLuint backLeft = i * (tessellation + 1) + j;
+            GLuint backRight = backLeft + 1;
+            GLuint frontLeft = backLeft + (tessellation + 1);
+            GLuint frontRight = frontLeft + 1;
+
+            indices.push_back(backLeft);
+            indices.push_back(frontLeft);
+            indices.push_back(frontRight);
+            indices.push_back(backLeft);
+            indices.push_back(frontRight);
+            indices.push_back(backRight);
+        }
+    }
+
+    ::groundPlaneMesh.Upload(::glState, vertices, indices);
+    if (NULL != ::rayTraceFile)
+    {
+        ::rayTracer.AddEnvironment(vertices, indices, &::blinnPhongMaterials[MATERIAL_GROUND]);
+    }
+} /* buildGroundPlane() */
+
+/**
+ * Bakes the sky box into a static mesh
+ * Its five quads keep the slanted normals of the original immediate mode sky box
+ */
+void buildSkyBox()
+{
+    const float s = ENVIRONMENT_HALF_SIZE;
+    const float h = ENVIRONMENT_HEIGHT;
+
+    /* Four vertices per quad: position, then normal */
+    const float quads[5][4][6] =
+    {
+        /* Front sky */
+        {{ s, 0.0f, -s, -1.0f,  0.0f,  1.0f}, { s, h, -s, -1.0f, -1.0f,  1.0f},
+         {-s, h, -s,  1.0f, -1.0f,  1.0f}, {-s, 0.0f, -s,  1.0f,  0.0f,  1.0f}},
+        /* Rear sky */
+        {{-s, 0.0f,  s,  1.0f,  0.0f, -1.0f}, {-s, h,  s,  1.0f, -1.0f, -1.0f},
+         { s, h,  s, -1.0f, -1.0f, -1.0f}, { s, 0.0f,  s, -1.0f,  0.0f, -1.0f}},
+        /* Left sky */
+        {{-s, 0.0f, -s,  1.0f,  0.0f,  1.0f}, {-s, h, -s,  1.0f, -1.0f,  1.0f},
+         {-s, h,  s,  1.0f, -1.0f, -1.0f}, {-s, 0.0f,  s,  1.0f,  0.0f, -1.0f}},
+        /* Right sky */
+        {{ s, 0.0f,  s, -1.0f,  0.0f, -1.0f}, { s, h,  s, -1.0f, -1.0f, -1.0f},
+         { s, h, -s, -1.0f, -1.0f,  1.0f}, { s, 0.0f, -s, -1.0f,  0.0f,  1.0f}},
+        /* Top sky */
+        {{ s, h, -s, -1.0f, -1.0f,  1.0f}, { s, h,  s, -1.0f, -1.0f, -1.0f},
+         {-s, h,  s,  1.0f, -1.0f, -1.0f}, {-s, h, -s,  1.0f, -1.0f,  1.0f}}
+    };
+
+    std::vector<GpuVertex> vertices;
+    std::vector<GLuint> indices;
+
+    for (int i = 0; i < 5; i++)
+    {
+        GLuint first = vertices.size();
+
+        for (int j = 0; j < 4; j++)
+        {
+            GpuVertex vertex;
+            for (int k = 0; k < 3; k++)
+            {
+                vertex.position[k] = quads[i][j][k];
+                vertex.normal[k] = quads[i][j][k + 3];
+                vertex.color[k] = 1.0f;
+            }
+            vertices.push_back(vertex);
+        }
+
+        /* Split the quad into two triangles with the quad's winding */
+        indices.push_back(first);
+        indices.push_back(first + 1);
+        indices.push_back(first + 2);
+        indices.push_back(first);
+        indices.push_back(first + 2);
+        indices.push_back(first + 3);
+    }
+
+    ::skyBoxMesh.Upload(::glState, vertices, indices);
+    if (NULL != ::rayTraceFile)
+    {
+        ::rayTracer.AddEnvironment(vertices, indices, &::blinnPhongMaterials[MATERIAL_SKY]);
+    }
+} /* buildSkyBox() */
+
+/**
+ * Prints user help text to the console
+ */
+void printHelpMessage()
+{
+    puts("Press 'a' to toggle posing the models in the vertex shader instead of on the CPU.");
+    puts("Press 'b' to toggle rendering the bounding volumes.");
+    puts("Press 'f' to toggle full screen mode (freeglut only).");
+    puts("Press 'g' to toggle between the GLSL program and the fixed function pipeline.");
+    puts("Press 'i' to print statistics about the last frame.");
+    puts("Press 'k' to toggle picking and highlighting the models through the id buffer.");
+    puts("Press 'l' to toggle drawing distant models at coarser levels of detail.");
+    puts("Press 'o' to reset the window to its original resolution.");
+    puts("Press 'p' to toggle drawing a depth pre-pass before shading the models.");
+    puts("Press 'v' to cycle the frame pacing between vsync, uncapped and a target frame rate.");
+    puts("Press 'w' to toggle drawing the bounding volumes as wireframes.");
+    puts("Press the space bar to pause or resume the animation.");
+    puts("Press ESC or 'q' to quit.");
+    puts("Press 'h' to print this message again.");
+} /* printHelpMessage() */
+
+/**
+ * Prints statistics about the last rendered frame to the console
+ */
+void printFrameStatistics()
+{
+    const GLStateCounters& frame = ::glState.GetFrameCounters();
+    const GLStateCounters& total = ::glState.GetTotalCounters();
+    unsigned long frameCalls = frame.issued + frame.elided;
+    unsigned long totalCalls = total.issued + total.elided;
+
+    printf("GL state changes last frame: %lu issued, %lu elided (%.1f%% elided)\n",
+            frame.issued, frame.elided, frameCalls ? 100.0 * frame.elided / frameCalls : 0.0);
+    printf("GL state changes in total: %lu issued, %lu elided (%.1f%% elided)\n",
+            total.issued, total.elided, totalCalls ? 100.0 * total.elided / totalCalls : 0.0);
+    printf("Render queue last frame: %lu draw items, %lu material changes\n",
+            static_cast<unsigned long>(::pipeline.GetFront().queue.GetSize()), ::materialChanges);
+    printf("Frame pipeline: %s\n", ::pipeline.IsThreaded()
+            ? "culling the next frame on a worker thread" : "culling each frame as it is drawn");
+    printJobStatistics();
+    printf("Startup: first frame after %.1f ms, ", ::firstFrameTime);
+    if (0.0 > ::modelsReadyTime)
+    {
+        puts("models still loading");
+    }
+    else
+    {
+        printf("models ready after %.1f ms\n", ::modelsReadyTime);
+    }
+    printf("Mesh cache: %d meshes shared by %d models\n",
+            ::scene.GetMeshCache()->GetMeshCount(), ::scene.GetMeshCache()->GetReferenceCount());
+    VertexCacheStats originalCache;
+    VertexCacheStats optimizedCache;
+    ::scene.GetMeshCache()->GetVertexCacheStats(originalCache, optimizedCache);
+    WeldStats weld;
+    ::scene.GetMeshCache()->GetWeldStats(weld);
+    printf("Vertex welding: %ld of %ld vertices merged and %ld faces removed, saving %.1f KB\n",
+            weld.originalVertexCount - weld.weldedVertexCount, weld.originalVertexCount,
+            weld.removedFaceCount, MeshWelder::GetBytesSaved(weld) / 1024.0);
+    long bvhNodes;
+    long bvhBytes;
+    ::scene.GetMeshCache()->GetBvhStats(bvhNodes, bvhBytes);
+    printf("Triangle hierarchies for picking: %ld nodes in %.1f KB\n", bvhNodes,
+            bvhBytes / 1024.0);
+    if (::isPickingOnGpu)
+    {
+        printf("Id buffer: %lu pixels read back, %lu skipped while every readback was in "
+                "flight; ", ::idBuffer.GetReadbackCount(), ::idBuffer.GetSkippedCount());
+        if (MODEL_NO_INDEX == ::cursorModel)
+        {
+            puts("no model under the cursor");
+        }
+        else
+        {
+            printf("model %lu under the cursor\n", static_cast<unsigned long>(::cursorModel));
+        }
+    }
+    else
+    {
+        printf("Id buffer: %s\n", ::idBuffer.IsSupported()
+                ? "off; picking casts rays against the triangle hierarchies" : "not supported");
+    }
+    printf("Vertex cache at full detail: ACMR %.3f and ATVR %.3f in the files' order, "
+            "ACMR %.3f and ATVR %.3f optimized\n", MeshOptimizer::GetAcmr(originalCache),
+            MeshOptimizer::GetAtvr(originalCache), MeshOptimizer::GetAcmr(optimizedCache),
+            MeshOptimizer::GetAtvr(optimizedCache));
+    if (::isAnimatingOnGpu && ::isUsingGLSLShader && 0 < ::scene.GetAttachedCount())
+    {
+        puts("Animation: posed on the CPU, since some models ride on others");
+    }
+    else
+    {
+        printf("Animation: %s\n", ::isAnimatingOnGpu && ::isUsingGLSLShader
+                ? "posed by the vertex shader from per-instance parameters" : "posed on the CPU");
+    }
+    const ProduceCounters& counters = ::pipeline.GetFront().counters;
+    printf("Culling last frame: %d models outside and %d inside the view frustum by their "
+            "swept boxes, %d by their exact boxes\n", counters.sweptOutsideCount,
+            counters.sweptInsideCount, counters.exactCount);
+    printf("Change tracking last frame: the view %s; skipped %d model updates and %d model "
+            "cullings of %lu models\n", counters.isViewChanged ? "changed" : "stayed the same",
+            counters.updateSkippedCount, counters.cullSkippedCount,
+            static_cast<unsigned long>(::scene.GetModelCount()));
+    printf("Transform hierarchy: %lu models riding on others; last frame posed %d models in "
+            "world space and culled %d with their subtrees\n",
+            static_cast<unsigned long>(::scene.GetAttachedCount()), counters.posedCount,
+            counters.subtreeCulledCount);
+    printf("Levels of detail last frame: %d triangles drawn instead of %d at full detail; "
+            "%d, %d, %d and %d models from the finest level to the coarsest\n",
+            counters.triangleCount, counters.fullDetailTriangleCount, counters.lodCounts[0],
+            counters.lodCounts[1], counters.lodCounts[2], counters.lodCounts[3]);
+    printf("Bounding volumes last frame: %lu boxes in %s\n",
+            static_cast<unsigned long>(::boundingBoxBatch.GetSize()),
+            ::boundingBoxBatch.IsInstanced() ? "one instanced draw call" : "one draw call each");
+    printf("Frame pacing: %s", FrameScheduler::GetModeName(::frameScheduler.GetMode()));
+    if (FRAME_MODE_TARGET == ::frameScheduler.GetMode())
+    {
+        printf(" at %.0f fps", ::frameScheduler.GetTargetFps());
+    }
+    printf(", %lu simulation ticks in %lu frames\n",
+            ::frameScheduler.GetTickCount(), ::frameScheduler.GetFrameCount());
+    printf("Frame time over the last %lu frames: %.2f ms median, %.2f ms 95th, "
+            "%.2f ms 99th percentile, %.2f ms worst\n",
+            static_cast<unsigned long>(::frameScheduler.GetFrameTimeCount()),
+            ::frameScheduler.GetFrameTimePercentile(50.0),
+            ::frameScheduler.GetFrameTimePercentile(95.0),
+            ::frameScheduler.GetFrameTimePercentile(99.0),
+            ::frameScheduler.GetFrameTimePercentile(100.0));
+    printGpuTimings();
+} /* printFrameStatistics() */
+
+/**
+ * Prints how much work each job system worker has done to the console
+ */
+void printJobStatistics()
+{
+    printf("Job system: %d workers%s\n", ::jobSystem.GetWorkerCount(),
+            ::jobSystem.IsDeterministic() ? ", running jobs in a fixed order" : "");
+
+    for (int i = 0; i < ::jobSystem.GetWorkerCount(); i++)
+    {
+        JobWorkerStats stats = ::jobSystem.GetWorkerStats(i);
+        printf("    worker %d: %lu jobs (%lu stolen), %.2f ms busy\n",
+                i, stats.jobs, stats.steals, stats.busyMilliseconds);
+    }
+} /* printJobStatistics() */
+
+/**
+ * Prints the average GPU time of the scene with and without the depth pre-pass, and of each of
+ * the frame's passes
+ */
+void printGpuTimings()
+{
+    if (!::sceneTimer.IsSupported())
+    {
+        puts("Scene GPU time: timer queries are not supported");
+        return;
+    }
+
+    printf("Scene GPU time without depth pre-pass: %.3f ms average over %lu frames\n",
+            ::sceneTimer.GetAverageMilliseconds(), ::sceneTimer.GetSampleCount());
+    printf("Scene GPU time with depth pre-pass:    %.3f ms average over %lu frames\n",
+            ::scenePrepassTimer.GetAverageMilliseconds(), ::scenePrepassTimer.GetSampleCount());
+    for (int i = 0; i < GPU_PHASE_COUNT; i++)
+    {
+        printf("  %-11s GPU time: %.3f ms average over %lu frames\n", ::gpuPhaseNames[i],
+                ::gpuPhaseTimers[i].GetAverageMilliseconds(),
+                ::gpuPhaseTimers[i].GetSampleCount());
+    }
+} /* printGpuTimings() */
+
+/**
+ * Prints the CPU time of each phase and the GPU time of the headless frames as JSON
+ * @param file - The file to print the report to
+ */
+void printHeadlessReport(FILE* file)
+{
+    const GLStateCounters& frame = ::glState.GetFrameCounters();
+    const ProduceCounters& counters = ::pipeline.GetFront().counters;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"frames\": %d,\n", ::headlessFrames);
+    fprintf(file, "  \"width\": %d,\n", ::windowWidth);
+    fprintf(file, "  \"height\": %d,\n", ::windowHeight);
+    fprintf(file, "  \"camera_keyframes\": %lu,\n",
+            static_cast<unsigned long>(::cameraPath.GetKeyframeCount()));
+    fprintf(file, "  \"pipeline\": %s,\n", ::isUsingPipeline ? "true" : "false");
+    fprintf(file, "  \"gpu_animation\": %s,\n",
+            ::isAnimatingOnGpu && 0 == ::scene.GetAttachedCount() ? "true" : "false");
+    fprintf(file, "  \"attached_models\": %lu,\n",
+            static_cast<unsigned long>(::scene.GetAttachedCount()));
+    fprintf(file, "  \"lod\": %s,\n", ::isUsingLod ? "true" : "false");
+
+    /* Startup times are null if the event never happened */
+    fprintf(file, "  \"startup_ms\": {\"first_frame\": ");
+    if (0.0 > ::firstFrameTime)
+    {
+        fputs("null", file);
+    }
+    else
+    {
+        fprintf(file, "%.4f", ::firstFrameTime);
+    }
+    fprintf(file, ", \"models_ready\": ");
+    if (0.0 > ::modelsReadyTime)
+    {
+        fputs("null", file);
+    }
+    else
+    {
+        fprintf(file, "%.4f", ::modelsReadyTime);
+    }
+    fprintf(file, "},\n");
+    fprintf(file, "  \"mesh_cache\": {\"meshes\": %d, \"models\": %d},\n",
+            ::scene.GetMeshCache()->GetMeshCount(), ::scene.GetMeshCache()->GetReferenceCount());
+    WeldStats weld;
+    ::scene.GetMeshCache()->GetWeldStats(weld);
+    fprintf(file, "  \"weld\": {\"epsilon\": %g, \"vertices_before\": %ld, "
+            "\"vertices_after\": %ld, \"faces_removed\": %ld, \"bytes_saved\": %ld},\n",
+            ::weldEpsilon, weld.originalVertexCount, weld.weldedVertexCount,
+            weld.removedFaceCount, MeshWelder::GetBytesSaved(weld));
+    fprintf(file, "  \"normals\": \"%s\",\n", MeshNormals::GetName(::normalWeighting));
+    long bvhNodes;
+    long bvhBytes;
+    ::scene.GetMeshCache()->GetBvhStats(bvhNodes, bvhBytes);
+    fprintf(file, "  \"bvh\": {\"nodes\": %ld, \"bytes\": %ld},\n", bvhNodes, bvhBytes);
+    fprintf(file, "  \"id_buffer\": {\"enabled\": %s, \"supported\": %s, \"readbacks\": %lu, "
+            "\"skipped\": %lu, \"hovered_model\": ", ::isPickingOnGpu ? "true" : "false",
+            ::idBuffer.IsSupported() ? "true" : "false", ::idBuffer.GetReadbackCount(),
+            ::idBuffer.GetSkippedCount());
+    if (MODEL_NO_INDEX == ::cursorModel)
+    {
+        fputs("null", file);
+    }
+    else
+    {
+        fprintf(file, "%lu", static_cast<unsigned long>(::cursorModel));
+    }
+    fprintf(file, "},\n");
+
+    /* The rates are in millions of rays a second */
+    const RayQueryStats& rayStats = ::rayQueryStats;
+    if (0 < ::rayQueryCount)
+    {
+        fprintf(file, "  \"ray_queries\": {\"rays\": %d, \"boxes\": {\"count\": %d, "
+                "\"hits\": %d, \"mismatches\": %d, \"single_ms\": %.4f, \"batch_ms\": %.4f, "
+                "\"parallel_ms\": %.4f, \"mrays_per_second\": %.4f}, ", rayStats.rayCount,
+                rayStats.boxCount, rayStats.boxHitCount, rayStats.boxMismatchCount,
+                rayStats.boxSingleTime, rayStats.boxBatchTime, rayStats.boxParallelTime,
+                0.0 < rayStats.boxParallelTime
+                ? rayStats.rayCount / (1000.0 * rayStats.boxParallelTime) : 0.0);
+        fprintf(file, "\"triangles\": {\"model\": %ld, \"hits\": %d, \"mismatches\": %d, "
+                "\"single_ms\": %.4f, \"packet_ms\": %.4f, \"parallel_ms\": %.4f, "
+                "\"mrays_per_second\": %.4f}},\n", rayStats.model, rayStats.triangleHitCount,
+                rayStats.triangleMismatchCount, rayStats.triangleSingleTime,
+                rayStats.trianglePacketTime, rayStats.triangleParallelTime,
+                0.0 < rayStats.triangleParallelTime
+                ? rayStats.rayCount / (1000.0 * rayStats.triangleParallelTime) : 0.0);
+    }
+    else
+    {
+        fprintf(file, "  \"ray_queries\": null,\n");
+    }
+
+    /* The ray traced image's rates are those of the trace split among the jobs */
+    const RayTraceStats& traceStats = ::rayTracer.GetStats();
+    if (NULL != ::rayTraceFile)
+    {
+        fprintf(file, "  \"ray_trace\": {\"width\": %d, \"height\": %d, \"tiles\": %d, "
+                "\"instances\": %d, \"instance_nodes\": %d, \"rays\": %ld, "
+                "\"model_hits\": %ld, \"environment_hits\": %ld, \"build_ms\": %.4f, "
+                "\"single_ms\": %.4f, \"parallel_ms\": %.4f, \"speedup\": %.4f, "
+                "\"images_per_second\": %.4f, \"mrays_per_second\": %.4f},\n",
+                traceStats.width, traceStats.height, traceStats.tileCount,
+                traceStats.instanceCount, traceStats.instanceNodeCount, traceStats.rayCount,
+                traceStats.modelHitCount, traceStats.environmentHitCount, traceStats.buildTime,
+                ::rayTraceSingleTime, traceStats.traceTime,
+                0.0 < traceStats.traceTime ? ::rayTraceSingleTime / traceStats.traceTime : 0.0,
+                0.0 < traceStats.traceTime ? 1000.0 / traceStats.traceTime : 0.0,
+                0.0 < traceStats.traceTime
+                ? traceStats.rayCount / (1000.0 * traceStats.traceTime) : 0.0);
+    }
+    else
+    {
+        fprintf(file, "  \"ray_trace\": null,\n");
+    }
+    VertexCacheStats originalCache;
+    VertexCacheStats optimizedCache;
+    ::scene.GetMeshCache()->GetVertexCacheStats(originalCache, optimizedCache);
+    fprintf(file, "  \"vertex_cache\": {\"acmr_before\": %.4f, \"atvr_before\": %.4f, "
+            "\"acmr_after\": %.4f, \"atvr_after\": %.4f},\n",
+            MeshOptimizer::GetAcmr(originalCache), MeshOptimizer::GetAtvr(originalCache),
+            MeshOptimizer::GetAcmr(optimizedCache), MeshOptimizer::GetAtvr(optimizedCache));
+
+    fprintf(file, "  \"cpu_ms\": {\n");
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        ProfilePhase phase = static_cast<ProfilePhase>(i);
+
+        fprintf(file, "    \"%s\": {\"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, "
+                "\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+                FrameProfiler::GetPhaseName(phase),
+                ::profiler.GetAverageMilliseconds(phase),
+                ::profiler.GetMinMilliseconds(phase),
+                ::profiler.GetPercentileMilliseconds(phase, 50.0),
+                ::profiler.GetPercentileMilliseconds(phase, 95.0),
+                ::profiler.GetPercentileMilliseconds(phase, 99.0),
+                ::profiler.GetMaxMilliseconds(phase),
+                PHASE_COUNT - 1 == i ? "" : ",");
+    }
+    fprintf(file, "  },\n");
+
+    /* The passes' GPU times sit beside the CPU phases; the scene's time with or without the
+     * pre-pass spans the pre-pass, opaque and transparent passes
+     */
+    if (::sceneTimer.IsSupported())
+    {
+        fprintf(file, "  \"gpu_ms\": {\n");
+        fprintf(file, "    \"scene\": {\"mean\": %.4f, \"samples\": %lu},\n",
+                ::sceneTimer.GetAverageMilliseconds(), ::sceneTimer.GetSampleCount());
+        fprintf(file, "    \"scene_prepass\": {\"mean\": %.4f, \"samples\": %lu},\n",
+                ::scenePrepassTimer.GetAverageMilliseconds(),
+                ::scenePrepassTimer.GetSampleCount());
+        for (int i = 0; i < GPU_PHASE_COUNT; i++)
+        {
+            fprintf(file, "    \"%s\": {\"mean\": %.4f, \"samples\": %lu}%s\n",
+                    ::gpuPhaseNames[i], ::gpuPhaseTimers[i].GetAverageMilliseconds(),
+                    ::gpuPhaseTimers[i].GetSampleCount(), GPU_PHASE_COUNT - 1 == i ? "" : ",");
+        }
+        fprintf(file, "  },\n");
+    }
+    else
+    {
+        fprintf(file, "  \"gpu_ms\": null,\n");
+    }
+
+    /* A worker's utilization is the share of the frames' wall clock time it spent in jobs */
+    double elapsed = ::profiler.GetAverageMilliseconds(PHASE_FRAME)
+            * ::profiler.GetSampleCount(PHASE_FRAME);
+    fprintf(file, "  \"jobs\": {\"deterministic\": %s, \"workers\": [\n",
+            ::jobSystem.IsDeterministic() ? "true" : "false");
+    for (int i = 0; i < ::jobSystem.GetWorkerCount(); i++)
+    {
+        JobWorkerStats stats = ::jobSystem.GetWorkerStats(i);
+        fprintf(file, "    {\"jobs\": %lu, \"steals\": %lu, \"busy_ms\": %.4f, "
+                "\"utilization\": %.4f}%s\n",
+                stats.jobs, stats.steals, stats.busyMilliseconds,
+                0.0 < elapsed ? stats.busyMilliseconds / elapsed : 0.0,
+                ::jobSystem.GetWorkerCount() - 1 == i ? "" : ",");
+    }
+    fprintf(file, "  ]},\n");
+
+    fprintf(file, "  \"last_frame\": {\"draw_items\": %lu, \"material_changes\": %lu, "
+            "\"state_changes_issued\": %lu, \"state_changes_elided\": %lu, "
+            "\"swept_outside\": %d, \"swept_inside\": %d, \"exact\": %d, "
+            "\"view_changed\": %s, \"updates_skipped\": %d, \"cullings_skipped\": %d, "
+            "\"models_posed\": %d, \"subtree_culled\": %d, \"triangles\": %d, "
+            "\"full_detail_triangles\": %d, \"lod_models\": [%d, %d, %d, %d]}\n",
+            static_cast<unsigned long>(::pipeline.GetFront().queue.GetSize()), ::materialChanges,
+            frame.issued, frame.elided, counters.sweptOutsideCount, counters.sweptInsideCount,
+            counters.exactCount, counters.isViewChanged ? "true" : "false",
+            counters.updateSkippedCount, counters.cullSkippedCount, counters.posedCount,
+            counters.subtreeCulledCount, counters.triangleCount, counters.fullDetailTriangleCount,
+            counters.lodCounts[0], counters.lodCounts[1], counters.lodCounts[2],
+            counters.lodCounts[3]);
+    fprintf(file, "}\n");
+} /* printHeadlessReport() */
+
+/**
+ * Sets the material properties used by the current lighting pipeline
+ * @param material - The material to apply
+ */
+void applyMaterial(MaterialId material)
+{
+    switch (material)
+    {
+    /* Set the material properties for the ground plane */
+    case MATERIAL_GROUND:
+        if (::isUsingGLSLShader)
+        {
+            applyBlinnPhongMaterial(::blinnPhongMaterials[MATERIAL_GROUND]);
+        }
+        else
+        {
+            GLfloat mAmbient[]  = {0.8f, 0.8f, 0.8f};
+            GLfloat mDiffuse[]  = {0.1f, 0.8f, 0.1f};
+            GLfloat mSpecular[] = {0.6f, 0.7f, 0.6f};
+            GLfloat mShininess  =  0.6f;
+            glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
+            glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
+            glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
+            glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+        }
+        break;
+    /* Set the material properties for the sky box */
+    case MATERIAL_SKY:
+        if (::isUsingGLSLShader)
+        {
+            applyBlinnPhongMaterial(::blinnPhongMaterials[MATERIAL_SKY]);
+        }
+        else
+        {
+            GLfloat mAmbient[]  = {1.0f, 1.0f, 1.0f};
+            GLfloat mDiffuse[]  = {0.1f, 0.1f, 1.0f};
+            GLfloat mSpecular[] = {0.0f, 0.0f, 0.0f};
+            GLfloat mShininess  =  0.0f;
+            glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
+            glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
+            glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
+            glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+        }
+        break;
+    /* Set the material properties for the models */
+    case MATERIAL_MODEL:
+        if (::isUsingGLSLShader)
+        {
+            applyBlinnPhongMaterial(::blinnPhongMaterials[MATERIAL_MODEL]);
+        }
+        else
+        {
+            GLfloat mAmbient[]  = {0.5f, 0.5f, 0.5f};
+            GLfloat mDiffuse[]  = {0.9f, 0.9f, 0.9f};
+            GLfloat mSpecular[] = {0.0f, 0.0f, 0.0f};
+            GLfloat mShininess  =  0.0f;
+            glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
+            glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
+            glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
+            glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+        }
+        break;
+    /* Set the material properties for the model under the cursor */
+    case MATERIAL_HIGHLIGHTED_MODEL:
+        if (::isUsingGLSLShader)
+        {
+            applyBlinnPhongMaterial(::blinnPhongMaterials[MATERIAL_HIGHLIGHTED_MODEL]);
+        }
+        else
+        {
+            GLfloat mAmbient[]  = {0.6f, 0.4f, 0.2f};
+            GLfloat mDiffuse[]  = {1.0f, 0.7f, 0.3f};
+            GLfloat mSpecular[] = {0.0f, 0.0f, 0.0f};
+            GLfloat mShininess  =  0.0f;
+            glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
+            glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
+            glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
+            glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+        }
+        break;
+    /* The bounding volumes are drawn by their own shader program with a flat color */
+    case MATERIAL_BOUNDING_BOX:
+        break;
+    }
+} /* applyMaterial() */
+
+/**
+ * Sets the Blinn-Phong program's material uniforms
+ * @param material - The material to apply
+ */
+void applyBlinnPhongMaterial(const BlinnPhongMaterial& material)
+{
+    ::glState.Uniform4fv(::uLight0_color, material.lightColor);
+    ::glState.Uniform4fv(::uAmbient     , material.ambient   );
+    ::glState.Uniform4fv(::uDiffuse     , material.diffuse   );
+    ::glState.Uniform4fv(::uSpecular    , material.specular  );
+    ::glState.Uniform1f (::uShininess   , material.shininess );
+} /* applyBlinnPhongMaterial() */
+
+/**
+ * Sets the blending and depth state used by a render pass
+ * @param pass - The render pass about to be drawn
+ */
+void applyRenderPass(RenderPass pass)
+{
+    if (PASS_TRANSPARENT == pass)
+    {
+        /* Enable transparency */
+        ::glState.Enable(GL_BLEND);
+        ::glState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        ::glState.Enable(GL_COLOR_MATERIAL);
+        ::glState.DepthFunc(GL_LEQUAL);
+        ::glState.DepthMask(GL_TRUE);
+    }
+    else
+    {
+        /* Disable transparency */
+        ::glState.Disable(GL_COLOR_MATERIAL);
+        ::glState.Disable(GL_BLEND);
+
+        /* After a depth pre-pass only the nearest fragment of each pixel is shaded,
+         * and its depth is already in the depth buffer
+         */
+        if (::isUsingDepthPrepass)
+        {
+            ::glState.DepthFunc(GL_EQUAL);
+            ::glState.DepthMask(GL_FALSE);
+        }
+        else
+        {
+            ::glState.DepthFunc(GL_LEQUAL);
+            ::glState.DepthMask(GL_TRUE);
+        }
+    }
+} /* applyRenderPass() */
+
+/**
+ * Returns the GPU timer phase a render pass is timed in
+ * @param pass - The render pass
+ * @return - The phase of the pass
+ */
+GpuPhase getGpuPhase(RenderPass pass)
+{
+    return PASS_OPAQUE == pass ? GPU_PHASE_OPAQUE : GPU_PHASE_TRANSPARENT;
+} /* getGpuPhase() */
+
+/**
+ * Fills the depth buffer with the opaque items in the render queue using a trivial shader
+ * so that the shading pass only shades the nearest fragment of each pixel
+ * @param queue - The sorted draw items of the frame
+ * @param animationTime - The time the vertex shader poses the animated models at
+ */
+void drawDepthPrepass(const RenderQueue& queue, float animationTime)
+{
+    ::glState.UseProgram(::depthProgram->id());
+    ::glState.ColorMask(GL_FALSE);
+    ::glState.DepthFunc(GL_LEQUAL);
+    ::glState.DepthMask(GL_TRUE);
+
+    /* The opaque items come first in the sorted queue, nearest first within each group */
+    for (size_t i = 0; i < queue.GetSize(); i++)
+    {
+        const DrawItem& item = queue[i];
+
+        if (PASS_OPAQUE != item.pass)
+        {
+            break;
+        }
+
+        glLoadMatrixf(item.modelview);
+        if (PROGRAM_ANIMATED_BLINN_PHONG == item.program)
+        {
+            ::glState.Uniform1f(::uDepthIsAnimated, 1.0f);
+            ::glState.Uniform1f(::uDepthAnimationTime, animationTime);
+            ::modelInstanceBatch.Draw(::glState, *static_cast<ModelInstanceList*>(item.object),
+                    true);
+        }
+        else
+        {
+            ::glState.Uniform1f(::uDepthIsAnimated, 0.0f);
+            static_cast<GpuMesh*>(item.object)->Draw(::glState, true);
+        }
+    }
+
+    /* Restore color writes and the lighting pipeline for the shading pass */
+    ::glState.ColorMask(GL_TRUE);
+    ::glState.UseProgram(::isUsingGLSLShader ? ::shaderProgram->id() : 0);
+} /* drawDepthPrepass() */
+
+/**
+ * Produces the render list of a frame
+ * The pending input is applied and the simulation ticks are run, then the models are bounded
+ * and culled, and the visible ones are queued as draw items along with the environment,
+ * which are sorted to minimize state changes
+ * When pipelined this runs on the worker thread, so it must not call OpenGL
+ * @param input - The frame's simulation ticks and projection matrix
+ * @param list - The render list to fill
+ */
+void produceFrame(const FrameInput& input, RenderList& list)
+{
+    ModelArrays* models = ::scene.GetModels();
+    Camera* camera = ::scene.GetCamera();
+    unsigned int program = input.isUsingGLSLShader ? PROGRAM_BLINN_PHONG : PROGRAM_FIXED_FUNCTION;
+
+    /* Apply the input which arrived since the last frame */
+    ::profiler.Begin(PHASE_UPDATE);
+    InputEvent event;
+    while (::inputQueue.Pop(event))
+    {
+        applyInput(event);
+    }
+
+    /* Take in the models uploaded since the last frame, since the OpenGL thread may upload
+     * more during the frame
+     */
+    list.isEveryModelReady = ::scene.UpdateReadiness();
+
+    /* Find what changed since the last frame; the models only move if the clock moved, and
+     * the culling only changes for every model if the camera or the projection did
+     */
+    FrameHistory& history = ::frameHistory;
+    ModelBatch batch;
+    batch.input = &input;
+    batch.view = list.view;
+    batch.models = models;
+    batch.isViewChanged = !history.isValid || camera->GetVersion() != history.cameraVersion
+            || 0 != memcmp(input.projection, history.projection, sizeof(history.projection))
+            || input.isAnimatingOnGpu != history.isAnimatingOnGpu;
+    batch.isTimeChanged = !history.isValid || input.animationTime != history.animationTime;
+    batch.counters = &list.counters;
+    memset(&list.counters, 0, sizeof(list.counters));
+    list.counters.isViewChanged = batch.isViewChanged;
+
+    /* Animate the models in parallel; each model only touches its own elements; the vertex
+     * shader poses them instead when animating on the GPU
+     */
+    size_t modelCount = ::scene.GetModelCount();
+    bool isClockStopped = history.isValid && 0 == input.tickCount && input.alpha == history.alpha
+            && history.isEveryModelReady && !history.isAnimatingOnGpu;
+    if (input.isAnimatingOnGpu || isClockStopped)
+    {
+        list.counters.updateSkippedCount = isClockStopped ? static_cast<int>(modelCount) : 0;
+    }
+    else
+    {
+        /* The ticks stood still while the shader posed the models, so reseed them from the
+         * last two ticks before this frame's, which animationTime lies between
+         */
+        batch.isLeavingGpu = history.isValid && history.isAnimatingOnGpu;
+        batch.seedTickTimes[1] = input.animationTime
+                + (1.0 - input.alpha - input.tickCount) * SIMULATION_TICK_SECONDS;
+        batch.seedTickTimes[0] = batch.seedTickTimes[1] - SIMULATION_TICK_SECONDS;
+        ::jobSystem.ParallelFor(modelCount, MODEL_UPDATE_GRAIN, updateModels, &batch);
+    }
+    list.isAnimatingOnGpu = input.isAnimatingOnGpu;
+    list.animationTime = static_cast<float>(input.animationTime);
+
+    /* Carry the poses which changed down to the models riding on them */
+    list.counters.posedCount = ::scene.UpdateHierarchy();
+    batch.order = &::scene.GetHierarchyOrder();
+    batch.subtreeEnds = &::scene.GetSubtreeEnds();
+
+    history.isValid = true;
+    history.cameraVersion = camera->GetVersion();
+    memcpy(history.projection, input.projection, sizeof(history.projection));
+    history.isAnimatingOnGpu = input.isAnimatingOnGpu;
+    history.animationTime = input.animationTime;
+    history.alpha = input.alpha;
+    history.isEveryModelReady = list.isEveryModelReady;
+    ::profiler.End(PHASE_UPDATE);
+
+    ::profiler.Begin(PHASE_CULL);
+    list.queue.Clear();
+    list.boxes.clear();
+
+    /* Build the viewing matrix once for the whole frame */
+    matLookAt4f(list.view, camera->eyePosition, camera->refPoint, camera->upVector);
+
+    /* Bound and cull a few models per job in the order of the hierarchy, since each may walk
+     * all of its vertices
+     */
+    ::jobSystem.ParallelFor(modelCount, MODEL_CULL_GRAIN, cullModels, &batch);
+
+    /* Queue the ground plane and sky box, which are already in world space */
+    DrawItem& groundItem = list.queue.Push(PASS_OPAQUE, program, MATERIAL_GROUND, MESH_GROUND,
+            0.0f, &::groundPlaneMesh);
+    memcpy(groundItem.modelview, list.view, sizeof(list.view));
+    DrawItem& skyItem = list.queue.Push(PASS_OPAQUE, program, MATERIAL_SKY, MESH_SKY,
+            0.0f, &::skyBoxMesh);
+    memcpy(skyItem.modelview, list.view, sizeof(list.view));
+
+    /* Gather the visible models the vertex shader poses into one list per mesh and level of
+     * detail
+     */
+    for (size_t i = 0; i < list.instanceLists.size(); i++)
+    {
+        list.instanceLists[i].instances.clear();
+    }
+    list.highlightedInstances.instances.clear();
+
+    /* Queue the visible models in the scene's order, so the queue is the same however the
+     * jobs were scheduled
+     */
+    for (size_t i = 0; i < modelCount; i++)
+    {
+        if (!models->isVisible[i])
+        {
+            continue;
+        }
+
+        /* A model which has not been uploaded yet is drawn as its placeholder box */
+        const AxisAlignedBoundingBox& boundingBox = models->worldBounds[i];
+        if (!models->isReady[i])
+        {
+            list.boxes.push_back(boundingBox);
+            continue;
+        }
+
+        /* Keep a copy of the bounding volume, since the model's own changes next frame; the
+         * culling found the exact box of every model whose box is drawn
+         */
+        if (models->isDrawingBoundingBox[i])
+        {
+            list.boxes.push_back(boundingBox);
+        }
+
+        /* Draw the model at the level of detail its size on screen calls for; the camera
+         * looks down the -z axis, and a model it is inside of is drawn at full detail
+         */
+        int level = 0;
+        if (input.isUsingLod)
+        {
+            const float* view = list.view;
+            float centerDepth = -(view[2] * models->worldCentersX[i]
+                    + view[6] * models->worldHeights[i] + view[10] * models->worldCentersZ[i]
+                    + view[14]);
+            if (MODEL_SCALED_RADIUS < centerDepth)
+            {
+                float diameter = static_cast<float>(MODEL_SCALED_RADIUS) * input.projection[5]
+                        * input.viewportHeight / centerDepth;
+                level = selectLod(diameter, models->lodLevels[i]);
+            }
+        }
+        models->lodLevels[i] = static_cast<char>(level);
+        GpuMesh* gpuMesh = models->gpuMeshes[i] + level;
+        list.counters.lodCounts[level]++;
+        list.counters.triangleCount += gpuMesh->GetIndexCount() / 3;
+        list.counters.fullDetailTriangleCount += models->gpuMeshes[i]->GetIndexCount() / 3;
+
+        if (input.isAnimatingOnGpu)
+        {
+            size_t lodId = MESH_LOD_COUNT * static_cast<size_t>(models->meshIds[i]) + level;
+            if (list.instanceLists.size() <= lodId)
+            {
+                list.instanceLists.resize(lodId + 1);
+            }
+
+            ModelInstance instance =
+            {
+                {models->centersX[i], models->startingHeights[i], models->centersZ[i],
+                        models->scaleFactors[i]},
+                {models->phaseDegrees[i], models->phaseRadians[i], models->rotationSpeeds[i],
+                        models->translationSpeeds[i]},
+                {0.0f, 0.0f, 0.0f, 0.0f}
+            };
+            IdBuffer::EncodeId(static_cast<unsigned int>(i + 1), instance.id);
+
+            /* The hovered model is drawn on its own in the highlighted material */
+            ModelInstanceList& instanceList = i == ::hoveredModel
+                    ? list.highlightedInstances : list.instanceLists[lodId];
+            instanceList.mesh = gpuMesh;
+            instanceList.instances.push_back(instance);
+            continue;
+        }
+
+        /* The box is in eye space, where the camera looks down the -z axis */
+        float depth = -0.5f * (boundingBox.front + boundingBox.back);
+
+        /* Models which share a mesh and a level of detail share an id, so the queue draws
+         * them back to back
+         */
+        DrawItem& item = list.queue.Push(PASS_OPAQUE, program,
+                i == ::hoveredModel ? MATERIAL_HIGHLIGHTED_MODEL : MATERIAL_MODEL,
+                MESH_FIRST_MODEL + MESH_LOD_COUNT * models->meshIds[i] + level, depth, gpuMesh);
+        memcpy(item.modelview, &models->modelviews[16 * i], sizeof(item.modelview));
+        item.id = static_cast<unsigned int>(i + 1);
+    }
+
+    /* Queue each level's animated instances as a single item under the viewing matrix, and
+     * lay the lists out back to back in the frame's instance buffer
+     */
+    list.instanceCount = 0;
+    for (size_t i = 0; i < list.instanceLists.size(); i++)
+    {
+        list.instanceLists[i].firstInstance = list.instanceCount;
+        list.instanceCount += list.instanceLists[i].instances.size();
+        if (list.instanceLists[i].instances.empty())
+        {
+            continue;
+        }
+
+        DrawItem& item = list.queue.Push(PASS_OPAQUE, PROGRAM_ANIMATED_BLINN_PHONG,
+                MATERIAL_MODEL, MESH_FIRST_MODEL + i, 0.0f, &list.instanceLists[i]);
+        memcpy(item.modelview, list.view, sizeof(list.view));
+    }
+    list.highlightedInstances.firstInstance = list.instanceCount;
+    list.instanceCount += list.highlightedInstances.instances.size();
+    if (!list.highlightedInstances.instances.empty())
+    {
+        DrawItem& item = list.queue.Push(PASS_OPAQUE, PROGRAM_ANIMATED_BLINN_PHONG,
+                MATERIAL_HIGHLIGHTED_MODEL, MESH_FIRST_MODEL, 0.0f, &list.highlightedInstances);
+        memcpy(item.modelview, list.view, sizeof(list.view));
+    }
+
+    /* Queue all the bounding volumes as a single item, which sorts its boxes itself */
+    if (!list.boxes.empty())
+    {
+        list.queue.Push(PASS_TRANSPARENT, program, MATERIAL_BOUNDING_BOX, 0, 0.0f,
+                &::boundingBoxBatch);
+    }
+
+    ::profiler.End(PHASE_CULL);
+
+    /* Group the draw items by state and depth */
+    ::profiler.Begin(PHASE_SORT);
+    list.queue.Sort();
+    ::profiler.End(PHASE_SORT);
+} /* produceFrame() */
+
+/**
+ * Runs the simulation ticks of a frame for a range of models and interpolates them, first
+ * seeding the ticks if the vertex shader posed the models until now
+ * This is the work of the jobs which update the models
+ * @param batch - The frame's model batch
+ * @param begin - The index of the first model
+ * @param end - One past the index of the last model
+ */
+void updateModels(void* batch, size_t begin, size_t end)
+{
+    const ModelBatch* modelBatch = static_cast<ModelBatch*>(batch);
+    const FrameInput* input = modelBatch->input;
+
+    if (modelBatch->isLeavingGpu)
+    {
+        ::scene.Animate(begin, end, modelBatch->seedTickTimes, 2, input->alpha);
+    }
+    ::scene.Animate(begin, end, input->tickTimes, input->tickCount, input->alpha);
+} /* updateModels() */
+
+/**
+ * Transforms and bounds a range of models and checks them against the view frustum
+ * This is the work of the jobs which cull the models
+ * @param batch - The frame's model batch
+ * @param begin - The position in the hierarchy's order of the first model
+ * @param end - One past the position of the last model
+ */
+void cullModels(void* batch, size_t begin, size_t end)
+{
+    ModelBatch* modelBatch = static_cast<ModelBatch*>(batch);
+    const FrameInput* input = modelBatch->input;
+    ModelArrays* models = modelBatch->models;
+    int sweptOutsideCount = 0;
+    int sweptInsideCount = 0;
+    int exactCount = 0;
+    int skippedCount = 0;
+    int subtreeCount = 0;
+
+    for (size_t p = begin; p < end; p++)
+    {
+        size_t i = (*modelBatch->order)[p];
+        GLfloat* modelview = &models->modelviews[16 * i];
+        AxisAlignedBoundingBox& boundingBox = models->worldBounds[i];
+        float rotation = models->worldRotations[i];
+        float height = models->worldHeights[i];
+
+        /* Cull a model with others riding on it along with all of them if the box around
+         * their subtree is outside the view frustum; a subtree which runs past this job's
+         * range is culled again by the next
+         */
+        size_t subtreeEnd = (*modelBatch->subtreeEnds)[p];
+        if (p + 1 < subtreeEnd)
+        {
+            AxisAlignedBoundingBox subtreeBox;
+            subtreeBox.RecalculateBox(&models->subtreeBounds[6 * i], modelBatch->view);
+            if (FRUSTUM_OUTSIDE == classifyFrustum(&subtreeBox, input->projection))
+            {
+                for (subtreeEnd = std::min(subtreeEnd, end); p < subtreeEnd; p++)
+                {
+                    size_t j = (*modelBatch->order)[p];
+                    models->isVisible[j] = 0;
+                    models->isExactBoxDeferred[j] = 0;
+                    models->isPoseChanged[j] = 0;
+                    models->isBoundsChanged[j] = 0;
+                    subtreeCount++;
+                }
+                p--;
+                continue;
+            }
+        }
+
+        /* Keep the last culling of a model if neither it nor the view changed; the vertex
+         * shader moves a model between frames, but only a model which straddles the view
+         * frustum is culled by its pose
+         */
+        bool isPoseSame = !models->isPoseChanged[i];
+        if (input->isAnimatingOnGpu && models->isReady[i])
+        {
+            isPoseSame = !modelBatch->isTimeChanged || FRUSTUM_INTERSECTING != models->sweptTests[i];
+        }
+        bool isSame = isPoseSame && !models->isBoundsChanged[i] && !modelBatch->isViewChanged;
+        models->isPoseChanged[i] = 0;
+        models->isBoundsChanged[i] = 0;
+        if (isSame)
+        {
+            skippedCount++;
+            continue;
+        }
+
+        /* The model is somewhere inside the box around all its poses, which is fixed in world
+         * space, so that box settles the models wholly outside or inside the view frustum
+         * without walking their vertices; a model which is not uploaded yet is bounded by a
+         * cube, which is just as cheap
+         */
+        FrustumTest test = FRUSTUM_INTERSECTING;
+        models->isExactBoxDeferred[i] = 0;
+        if (models->isReady[i])
+        {
+            boundingBox.RecalculateBox(&models->sweptBounds[6 * i], modelBatch->view);
+            test = classifyFrustum(&boundingBox, input->projection);
+            models->sweptTests[i] = test;
+
+            /* A model whose box is drawn needs its exact box anyway */
+            if (FRUSTUM_INSIDE == test && models->isDrawingBoundingBox[i])
+            {
+                test = FRUSTUM_INTERSECTING;
+            }
+
+            if (FRUSTUM_INTERSECTING == test)
+            {
+                exactCount++;
+            }
+            else
+            {
+                models->isVisible[i] = FRUSTUM_INSIDE == test;
+                (FRUSTUM_INSIDE == test ? sweptInsideCount : sweptOutsideCount)++;
+
+                /* Without a modelview matrix to draw by, the swept box is all there is */
+                if (input->isAnimatingOnGpu)
+                {
+                    continue;
+                }
+                models->isExactBoxDeferred[i] = 1;
+            }
+
+            /* The vertex shader poses the model at the frame's time rather than between ticks */
+            if (input->isAnimatingOnGpu)
+            {
+                ::scene.PoseAt(i, input->animationTime, &rotation, &height);
+            }
+        }
+
+        /* Translate, rotate, and scale the model; one which is not uploaded yet stands still */
+        GLfloat transform[16];
+        Vec3 center(models->worldCentersX[i], height, models->worldCentersZ[i]);
+        matTranslateRotateYScale4f(transform, center, rotation, models->scaleFactors[i]);
+
+        /* Apply the viewing matrix to the transform matrix */
+        matMultMat4f(modelview, modelBatch->view, transform);
+
+        if (FRUSTUM_INTERSECTING != test)
+        {
+            continue;
+        }
+
+        /* Recalculate the model's bounding box; until the model is uploaded, bound a cube
+         * around its bounding sphere instead
+         */
+        if (models->isReady[i])
+        {
+            boundingBox.Recalculate(models->faceLists[i], modelview);
+        }
+        else
+        {
+            boundingBox.RecalculateBox(&models->localBounds[6 * i], modelview);
+        }
+
+        /* Only draw the model if its bounding volume is entirely contained within the view
+         * frustum
+         */
+        models->isVisible[i] = inFrustum(&boundingBox, input->projection);
+    }
+
+    __sync_fetch_and_add(&modelBatch->counters->sweptOutsideCount, sweptOutsideCount);
+    __sync_fetch_and_add(&modelBatch->counters->sweptInsideCount, sweptInsideCount);
+    __sync_fetch_and_add(&modelBatch->counters->exactCount, exactCount);
+    __sync_fetch_and_add(&modelBatch->counters->cullSkippedCount, skippedCount);
+    __sync_fetch_and_add(&modelBatch->counters->subtreeCulledCount, subtreeCount);
+} /* cullModels() */
+
+/**
+ * Applies an input event to the simulation
+ * @param event - The event to apply
+ */
+void applyInput(const InputEvent& event)
+{
+    ModelArrays* models = ::scene.GetModels();
+    Camera* camera = ::scene.GetCamera();
+
+    switch (event.type)
+    {
+    /* Rotate the camera with the virtual trackball */
+    case INPUT_ROTATE_CAMERA:
+        camera->Rotate(event.rotation);
+        break;
+    /* Move the camera to a pose */
+    case INPUT_SET_CAMERA:
+        camera->MoveTo(event.points[0], event.points[1]);
+        break;
+    /* Cast a ray and check for intersection with scene objects */
+    case INPUT_PICK:
+        {
+            Ray ray(event.points[0], event.points[1]);
+            size_t index;
+            RayHit hit;
+            double startTime = FrameProfiler::GetMilliseconds();
+            bool isHit = castRay(ray, index, hit);
+            double elapsedTime = FrameProfiler::GetMilliseconds() - startTime;
+
+            if (!isHit)
+            {
+                printf("Missed every model in %.1f us\n", 1000.0 * elapsedTime);
+                break;
+            }
+
+            /* Only the nearest model hit is picked; showing its box finds its exact box */
+            printf("Picked model %lu, face %d at distance %.3f, barycentric (%.3f, %.3f, "
+                    "%.3f) in %.1f us\n", static_cast<unsigned long>(index), hit.face,
+                    hit.distance, 1.0f - hit.u - hit.v, hit.u, hit.v, 1000.0 * elapsedTime);
+            models->isDrawingBoundingBox[index] = !models->isDrawingBoundingBox[index];
+            models->isBoundsChanged[index] = 1;
+        }
+        break;
+    /* Pick the model the id buffer found under a click */
+    case INPUT_PICK_MODEL:
+        if (event.index < ::scene.GetModelCount())
+        {
+            printf("Picked model %lu from the id buffer\n",
+                    static_cast<unsigned long>(event.index));
+            models->isDrawingBoundingBox[event.index] = !models->isDrawingBoundingBox[event.index];
+            models->isBoundsChanged[event.index] = 1;
+        }
+        else
+        {
+            puts("Clicked on no model");
+        }
+        break;
+    /* Highlight the model the id buffer found under the cursor */
+    case INPUT_HOVER:
+        ::hoveredModel = event.index;
+        break;
+    /* Show or hide all the bounding volumes at once */
+    case INPUT_SHOW_BOUNDING_BOXES:
+        models->isDrawingBoundingBox.assign(::scene.GetModelCount(), event.flag ? 1 : 0);
+        models->isBoundsChanged.assign(::scene.GetModelCount(), 1);
+        break;
+    }
+} /* applyInput() */
 
 /**
- * Draws the ground plane
- * @param camera - The camera used for the viewing matrix
+ * Draws a render list of the ground plane, sky box and PLY models in the scene
+ * The draw items are drawn in sorted order, only changing the state between items that differ
+ * @param list - The render list to draw
  */
-void drawGroundPlane(Camera* camera)
+void drawScene(const RenderList& list)
 {
-    /* Set the material properties for the ground plane */
-    if (::isUsingGLSLShader)
-    {
-        float light0_color[] = {0.0f, 0.7f, 0.0f, 1.0f};
-        float specular[]     = {1.0f, 1.0f, 1.0f, 1.0f};
-        float diffuse[]      = {0.5f, 0.5f, 0.5f, 1.0f};
-        float ambient[]      = {0.2f, 0.2f, 0.2f, 1.0f};
-        float shininess[]    = {1.0f};
-        glUniform4fv(::uLight0_color, 1, light0_color);
-        glUniform4fv(::uAmbient     , 1, ambient     );
-        glUniform4fv(::uDiffuse     , 1, diffuse     );
-        glUniform4fv(::uSpecular    , 1, specular    );
-        glUniform1fv(::uShininess   , 1, shininess   );
-    }
-    else
+    const RenderQueue& queue = list.queue;
+
+    /* Batch the bounding volumes, which are already in eye space */
+    ::boundingBoxBatch.Clear();
+    for (size_t i = 0; i < list.boxes.size(); i++)
     {
-        GLfloat mAmbient[]  = {0.8f, 0.8f, 0.8f};
-        GLfloat mDiffuse[]  = {0.1f, 0.8f, 0.1f};
-        GLfloat mSpecular[] = {0.6f, 0.7f, 0.6f};
-        GLfloat mShininess  =  0.6f;
-        glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
-        glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
-        glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
-        glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+        ::boundingBoxBatch.Add(list.boxes[i]);
     }
 
-    /* Set the viewing matrix */
-    glLoadIdentity();
-    gluLookAt(camera->eyePosition.x, camera->eyePosition.y, camera->eyePosition.z,
-              camera->refPoint.x   , camera->refPoint.y   , camera->refPoint.z   ,
-              camera->upVector.x   , camera->upVector.y   , camera->upVector.z   );
-
-    /* Draw the ground plane */
-    glBegin(GL_QUADS);
-    glNormal3f(  0.0f, 1.0f,   0.0f);
-    glVertex3f(-12.0f, 0.0f, -12.0f);
-    glVertex3f(-12.0f, 0.0f,  12.0f);
-    glVertex3f( 12.0f, 0.0f,  12.0f);
-    glVertex3f( 12.0f, 0.0f, -12.0f);
-    glEnd();
-} /* drawGroundPlane() */
+    /* Time the scene on the GPU separately with and without the depth pre-pass */
+    GpuTimer& timer = ::isUsingDepthPrepass ? ::scenePrepassTimer : ::sceneTimer;
+    ::profiler.Begin(PHASE_SUBMIT);
+    timer.Begin();
 
-/**
- * Draws the sky box
- * @param camera - The camera used for the viewing matrix
- */
-void drawSkyBox(Camera* camera)
-{
-    /* Set the material properties for the sky box */
-    if (::isUsingGLSLShader)
+    /* Upload the animated instances once for every pass that draws them */
+    ::modelInstanceBatch.Allocate(::glState, list.instanceCount);
+    for (size_t i = 0; i < list.instanceLists.size(); i++)
     {
-        float light0_color[] = {0.0f, 0.0f, 0.7f, 1.0f};
-        float specular[]     = {1.0f, 1.0f, 1.0f, 1.0f};
-        float diffuse[]      = {0.5f, 0.5f, 0.5f, 1.0f};
-        float ambient[]      = {0.2f, 0.2f, 0.2f, 1.0f};
-        float shininess[]    = {1.0f};
-        glUniform4fv(::uLight0_color, 1, light0_color);
-        glUniform4fv(::uAmbient     , 1, ambient     );
-        glUniform4fv(::uDiffuse     , 1, diffuse     );
-        glUniform4fv(::uSpecular    , 1, specular    );
-        glUniform1fv(::uShininess   , 1, shininess   );
+        ::modelInstanceBatch.Upload(::glState, list.instanceLists[i]);
     }
-    else
+    ::modelInstanceBatch.Upload(::glState, list.highlightedInstances);
+
+    /* Lay down the depth of the opaque items before shading them */
+    if (::isUsingDepthPrepass)
     {
-        GLfloat mAmbient[]  = {1.0f, 1.0f, 1.0f};
-        GLfloat mDiffuse[]  = {0.1f, 0.1f, 1.0f};
-        GLfloat mSpecular[] = {0.0f, 0.0f, 0.0f};
-        GLfloat mShininess  =  0.0f;
-        glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
-        glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
-        glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
-        glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+        ::gpuPhaseTimers[GPU_PHASE_PREPASS].Begin();
+        drawDepthPrepass(queue, list.animationTime);
+        ::gpuPhaseTimers[GPU_PHASE_PREPASS].End();
     }
 
-    /* Set the viewing matrix */
-    glLoadIdentity();
-    gluLookAt(camera->eyePosition.x, camera->eyePosition.y, camera->eyePosition.z,
-              camera->refPoint.x   , camera->refPoint.y   , camera->refPoint.z   ,
-              camera->upVector.x   , camera->upVector.y   , camera->upVector.z   );
-
-    /* Draw the sky box */
-    glBegin(GL_QUADS);
-    /* Front sky */
-    glNormal3f( -1.0f,  0.0f,   1.0f);
-    glVertex3f( 12.0f,  0.0f, -12.0f);
-    glNormal3f( -1.0f, -1.0f,   1.0f);
-    glVertex3f( 12.0f, 12.0f, -12.0f);
-    glNormal3f(  1.0f, -1.0f,   1.0f);
-    glVertex3f(-12.0f, 12.0f, -12.0f);
-    glNormal3f(  1.0f,  0.0f,   1.0f);
-    glVertex3f(-12.0f,  0.0f, -12.0f);
-    /* Rear sky */
-    glNormal3f(  1.0f,  0.0f,  -1.0f);
-    glVertex3f(-12.0f,  0.0f,  12.0f);
-    glNormal3f(  1.0f, -1.0f,  -1.0f);
-    glVertex3f(-12.0f, 12.0f,  12.0f);
-    glNormal3f( -1.0f, -1.0f,  -1.0f);
-    glVertex3f( 12.0f, 12.0f,  12.0f);
-    glNormal3f( -1.0f,  0.0f,  -1.0f);
-    glVertex3f( 12.0f,  0.0f,  12.0f);
-    /* Left sky */
-    glNormal3f(  1.0f,  0.0f,   1.0f);
-    glVertex3f(-12.0f,  0.0f, -12.0f);
-    glNormal3f(  1.0f, -1.0f,   1.0f);
-    glVertex3f(-12.0f, 12.0f, -12.0f);
-    glNormal3f(  1.0f, -1.0f,  -1.0f);
-    glVertex3f(-12.0f, 12.0f,  12.0f);
-    glNormal3f(  1.0f,  0.0f,  -1.0f);
-    glVertex3f(-12.0f,  0.0f,  12.0f);
-    /* Right sky */
-    glNormal3f( -1.0f,  0.0f,  -1.0f);
-    glVertex3f( 12.0f,  0.0f,  12.0f);
-    glNormal3f( -1.0f, -1.0f,  -1.0f);
-    glVertex3f( 12.0f, 12.0f,  12.0f);
-    glNormal3f( -1.0f, -1.0f,   1.0f);
-    glVertex3f( 12.0f, 12.0f, -12.0f);
-    glNormal3f( -1.0f,  0.0f,   1.0f);
-    glVertex3f( 12.0f,  0.0f, -12.0f);
-    /* Top sky */
-    glNormal3f( -1.0f, -1.0f,   1.0f);
-    glVertex3f( 12.0f, 12.0f, -12.0f);
-    glNormal3f( -1.0f, -1.0f,  -1.0f);
-    glVertex3f( 12.0f, 12.0f,  12.0f);
-    glNormal3f(  1.0f, -1.0f,  -1.0f);
-    glVertex3f(-12.0f, 12.0f,  12.0f);
-    glNormal3f(  1.0f, -1.0f,   1.0f);
-    glVertex3f(-12.0f, 12.0f, -12.0f);
-    glEnd();
-} /* drawSkyBox() */
+    /* Draw the items, only changing the state between items that differ */
+    int currentPass = -1;
+    int currentMaterial = -1;
+    ::materialChanges = 0;
 
-/**
- * Draws a bounding box
- * @param bv - The bounding box (volume) to draw
- */
-void drawBoundingBox(AxisAlignedBoundingBox* bv)
-{
-    glColor4f(1.0f, 0.33f, 1.0f, 0.5f);
-
-    glBegin(GL_QUADS);
-    /* Front */
-    glVertex3f(bv->right, bv->top, bv->front);
-    glVertex3f(bv->left, bv->top, bv->front);
-    glVertex3f(bv->left, bv->bottom, bv->front);
-    glVertex3f(bv->right, bv->bottom, bv->front);
-    /* Back */
-    glVertex3f(bv->left, bv->top, bv->back);
-    glVertex3f(bv->right, bv->top, bv->back);
-    glVertex3f(bv->right, bv->bottom, bv->back);
-    glVertex3f(bv->left, bv->bottom, bv->back);
-    /* Left */
-    glVertex3f(bv->left, bv->top, bv->front);
-    glVertex3f(bv->left, bv->top, bv->back);
-    glVertex3f(bv->left, bv->bottom, bv->back);
-    glVertex3f(bv->left, bv->bottom, bv->front);
-    /* Right */
-    glVertex3f(bv->right, bv->top, bv->back);
-    glVertex3f(bv->right, bv->top, bv->front);
-    glVertex3f(bv->right, bv->bottom, bv->front);
-    glVertex3f(bv->right, bv->bottom, bv->back);
-    /* Top */
-    glVertex3f(bv->right, bv->top, bv->back);
-    glVertex3f(bv->left, bv->top, bv->back);
-    glVertex3f(bv->left, bv->top, bv->front);
-    glVertex3f(bv->right, bv->top, bv->front);
-    /* Bottom */
-    glVertex3f(bv->right, bv->bottom, bv->front);
-    glVertex3f(bv->left, bv->bottom, bv->front);
-    glVertex3f(bv->left, bv->bottom, bv->back);
-    glVertex3f(bv->right, bv->bottom, bv->back);
-    glEnd();
-} /* drawBoundingBox() */
+    for (size_t i = 0; i < queue.GetSize(); i++)
+    {
+        const DrawItem& item = queue[i];
+
+        if (static_cast<int>(item.pass) != currentPass)
+        {
+            if (0 <= currentPass)
+            {
+                ::gpuPhaseTimers[getGpuPhase(static_cast<RenderPass>(currentPass))].End();
+            }
+            ::gpuPhaseTimers[getGpuPhase(item.pass)].Begin();
+            applyRenderPass(item.pass);
+            currentPass = item.pass;
+        }
+
+        if (static_cast<int>(item.material) != currentMaterial)
+        {
+            applyMaterial(static_cast<MaterialId>(item.material));
+            currentMaterial = item.material;
+            ::materialChanges++;
+        }
+
+        if (MATERIAL_BOUNDING_BOX == item.material)
+        {
+            BoundingBoxBatch* batch = static_cast<BoundingBoxBatch*>(item.object);
+            batch->Draw(::glState, ::isDrawingWireframeBoxes
+                    || batch->GetSize() > BOUNDING_BOX_WIREFRAME_THRESHOLD);
+        }
+        else if (PROGRAM_ANIMATED_BLINN_PHONG == item.program)
+        {
+            /* Only the GLSL program can pose the models, so skip them for the one frame
+             * produced before the fixed function pipeline was switched on
+             */
+            if (::isUsingGLSLShader)
+            {
+                glLoadMatrixf(item.modelview);
+                ::glState.Uniform1f(::uIsAnimated, 1.0f);
+                ::glState.Uniform1f(::uAnimationTime, list.animationTime);
+                ::modelInstanceBatch.Draw(::glState,
+                        *static_cast<ModelInstanceList*>(item.object), false);
+            }
+        }
+        else
+        {
+            if (::isUsingGLSLShader)
+            {
+                ::glState.Uniform1f(::uIsAnimated, 0.0f);
+            }
+            glLoadMatrixf(item.modelview);
+            static_cast<GpuMesh*>(item.object)->Draw(::glState, false);
+        }
+    }
+
+    if (0 <= currentPass)
+    {
+        ::gpuPhaseTimers[getGpuPhase(static_cast<RenderPass>(currentPass))].End();
+    }
+    timer.End();
+    ::profiler.End(PHASE_SUBMIT);
+
+    /* Leave the default state behind for the next frame */
+    ::glState.UseProgram(::isUsingGLSLShader ? ::shaderProgram->id() : 0);
+    ::glState.Disable(GL_COLOR_MATERIAL);
+    ::glState.Disable(GL_BLEND);
+    ::glState.DepthFunc(GL_LEQUAL);
+    ::glState.DepthMask(GL_TRUE);
+} /* drawScene() */
 
 /**
- * Draws the PLY models in the scene
- * @param camera - The camera used for the viewing matrix
+ * Draws the opaque items of a render list into the id buffer, each in its model's id, but only
+ * at the pixel under the cursor, and starts reading the pixel back
+ * The models are drawn exactly as the depth pre-pass draws them, so the id read back is the
+ * model seen at the pixel
+ * @param list - The render list drawn this frame
  */
-void drawScene(Camera* camera)
+void drawIdBuffer(const RenderList& list)
 {
-    std::list<Model*>* models = ::scene.GetModels();
+    const RenderQueue& queue = list.queue;
+    GLint viewport[4];
+    GLdouble windowX;
+    GLdouble windowY;
 
-    /* Iterate through all the models in the scene */
-    for (std::list<Model*>::const_iterator itr = models->begin(); itr != models->end(); itr++)
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    calcWindowCoords(::mouseX, ::mouseY, viewport, windowX, windowY);
+
+    /* A click is answered by the first pixel read back after it; if every readback is still
+     * in flight, the click waits for the next frame
+     */
+    IdTag tag = ::isClickPending ? ID_TAG_CLICK : ID_TAG_HOVER;
+    if (!::idBuffer.Begin(::glState, viewport[2], viewport[3], static_cast<int>(windowX),
+            static_cast<int>(windowY), tag))
     {
-        /* Update the model's transformation */
-        (*itr)->Update();
+        return;
+    }
+    ::isClickPending = false;
+    ::gpuPhaseTimers[GPU_PHASE_ID_BUFFER].Begin();
+
+    /* The ids must reach the buffer unchanged */
+    ::glState.UseProgram(::idProgram->id());
+    ::glState.Disable(GL_DITHER);
+    ::glState.DepthFunc(GL_LEQUAL);
+    ::glState.DepthMask(GL_TRUE);
+
+    /* The opaque items come first in the sorted queue; the ground plane and sky box hide the
+     * models behind them with the id of no model
+     */
+    for (size_t i = 0; i < queue.GetSize(); i++)
+    {
+        const DrawItem& item = queue[i];
+        float id[4];
 
-        /* Set the material properties for the models */
-        if (::isUsingGLSLShader)
+        if (PASS_OPAQUE != item.pass)
+        {
+            break;
+        }
+
+        glLoadMatrixf(item.modelview);
+        if (PROGRAM_ANIMATED_BLINN_PHONG == item.program)
         {
-            float light0_color[] = {0.7f, 0.7f, 0.7f, 1.0f};
-            float specular[]     = {1.0f, 1.0f, 1.0f, 1.0f};
-            float diffuse[]      = {0.5f, 0.5f, 0.5f, 1.0f};
-            float ambient[]      = {0.2f, 0.2f, 0.2f, 1.0f};
-            float shininess[]    = {1.0f};
-            glUniform4fv(::uLight0_color, 1, light0_color);
-            glUniform4fv(::uAmbient     , 1, ambient     );
-            glUniform4fv(::uDiffuse     , 1, diffuse     );
-            glUniform4fv(::uSpecular    , 1, specular    );
-            glUniform1fv(::uShininess   , 1, shininess   );
+            ::glState.Uniform1f(::uIdIsAnimated, 1.0f);
+            ::glState.Uniform1f(::uIdAnimationTime, list.animationTime);
+            ::modelInstanceBatch.Draw(::glState, *static_cast<ModelInstanceList*>(item.object),
+                    true);
         }
         else
         {
-            GLfloat mAmbient[]  = {0.5f, 0.5f, 0.5f};
-            GLfloat mDiffuse[]  = {0.9f, 0.9f, 0.9f};
-            GLfloat mSpecular[] = {0.0f, 0.0f, 0.0f};
-            GLfloat mShininess  =  0.0f;
-            glMaterialfv(GL_FRONT, GL_AMBIENT  , mAmbient          );
-            glMaterialfv(GL_FRONT, GL_DIFFUSE  , mDiffuse          );
-            glMaterialfv(GL_FRONT, GL_SPECULAR , mSpecular         );
-            glMaterialf (GL_FRONT, GL_SHININESS, mShininess * 128.0);
+            IdBuffer::EncodeId(item.id, id);
+            ::glState.Uniform1f(::uIdIsAnimated, 0.0f);
+            ::glState.Uniform4fv(::uIdObjectId, id);
+            static_cast<GpuMesh*>(item.object)->Draw(::glState, true);
         }
+    }
 
-        /* Get the face list */
-        FaceList* faceList = (*itr)->GetFaceList();
-
-        /* Translate, rotate, and scale the model */
-        glLoadIdentity();
-        glTranslatef(faceList->center[0], faceList->center[1], faceList->center[2]);
-        glRotatef((*itr)->GetRotation(), 0.0f, 1.0f, 0.0f);
-        glScalef((*itr)->GetScaleFactor(), (*itr)->GetScaleFactor(), (*itr)->GetScaleFactor());
-
-        /* Save the current transform matrix */
-        GLfloat transform[16];
-        glGetFloatv(GL_MODELVIEW_MATRIX, transform);
+    ::idBuffer.End(::glState);
+    ::gpuPhaseTimers[GPU_PHASE_ID_BUFFER].End();
 
-        /* Set the viewing matrix and reapply the transform matrix */
-        glLoadIdentity();
-        gluLookAt(camera->eyePosition.x, camera->eyePosition.y, camera->eyePosition.z,
-                  camera->refPoint.x   , camera->refPoint.y   , camera->refPoint.z   ,
-                  camera->upVector.x   , camera->upVector.y   , camera->upVector.z   );
-        glMultMatrixf(transform);
+    /* Restore the lighting pipeline */
+    ::glState.Enable(GL_DITHER);
+    ::glState.UseProgram(::isUsingGLSLShader ? ::shaderProgram->id() : 0);
+} /* drawIdBuffer() */
 
-        /* Get the current modelview matrix */
-        GLfloat modelview[16];
-        glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+/**
+ * Collects the pixels the GPU has finished reading back from the id buffer, without waiting
+ * for the rest, and hands the models found under the cursor to the simulation
+ */
+void collectIdBuffer()
+{
+    IdReadback readback;
 
-        /* Recalculate the model's bounding box */
-        AxisAlignedBoundingBox* boundingBox = (*itr)->GetBoundingBox();
-        boundingBox->Recalculate(faceList, modelview, transform);
+    while (::idBuffer.Poll(::glState, readback))
+    {
+        size_t index = ID_BUFFER_NONE == readback.id ? MODEL_NO_INDEX
+                : static_cast<size_t>(readback.id - 1);
+        InputEvent event;
+        event.index = index;
 
-        /* Only draw the model and its bounding volume if the bounding volume is
-         * entirely contained within the view frustum
-         */
-        if (inFrustum(boundingBox))
+        if (ID_TAG_CLICK == readback.tag)
         {
-            /* Draw the model */
-            glBegin(GL_TRIANGLES);
-            for (int i = 0; i < faceList->fc; i++)
-            {
-                for (int j = 0; j < 3; j++)
-                {
-                    glColor3dv(faceList->colors[faceList->faces[i][j]]);
-                    glNormal3dv(faceList->v_normals[faceList->faces[i][j]]);
-                    glVertex3dv(faceList->vertices[faceList->faces[i][j]]);
-                }
-            }
-            glEnd();
-
-            /* Draw the bounding volumes */
-            if ((*itr)->GetIsDrawingBoundingBox())
-            {
-                /* Set the material properties for the bounding volumes */
-                if (::isUsingGLSLShader)
-                {
-                    float light0_color[] = {0.2f, 0.2f, 0.0f, 0.4f};
-                    float specular[]     = {0.0f, 0.0f, 0.0f, 0.4f};
-                    float diffuse[]      = {0.4f, 0.4f, 0.4f, 0.4f};
-                    float ambient[]      = {0.2f, 0.2f, 0.2f, 0.4f};
-                    float shininess[]    = {1.0f};
-                    glUniform4fv(::uLight0_color, 1, light0_color);
-                    glUniform4fv(::uAmbient     , 1, ambient     );
-                    glUniform4fv(::uDiffuse     , 1, diffuse     );
-                    glUniform4fv(::uSpecular    , 1, specular    );
-                    glUniform1fv(::uShininess   , 1, shininess   );
-                }
+            event.type = INPUT_PICK_MODEL;
+            pushInput(event);
+        }
 
-                /* Enable transparency */
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                glEnable(GL_COLOR_MATERIAL);
-                glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-
-                /* Draw the box */
-                glPushMatrix();
-                glLoadIdentity();
-                drawBoundingBox(boundingBox);
-                glPopMatrix();
-
-                /* Disable transparency */
-                glDisable(GL_COLOR_MATERIAL);
-                glDisable(GL_BLEND);
-            }
+        /* The simulation only hears about the cursor when it moves onto another model */
+        if (index != ::cursorModel)
+        {
+            ::cursorModel = index;
+            event.type = INPUT_HOVER;
+            pushInput(event);
         }
     }
-} /* drawScene() */
+} /* collectIdBuffer() */
 
 /**
  * Calculates window coordinates from mouse coordinates
@@ -723,26 +2798,30 @@ void calcWindowCoords(int mouseX, int mouseY, const GLint viewport[],
  */
 void pick(int mouseX, int mouseY)
 {
+    /* The id buffer answers the click once the GPU has drawn the pixel under it */
+    if (::isPickingOnGpu)
+    {
+        ::mouseX = mouseX;
+        ::mouseY = mouseY;
+        ::isClickPending = true;
+        return;
+    }
+
     GLint viewport[4];
     GLdouble modelview[16];
     GLdouble projection[16];
     GLdouble windowX;
     GLdouble windowY;
 
-    /* Get the camera and the modelview matrix */
-    Camera* camera = ::scene.GetCamera();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-
-    /* Set the viewing matrix */
-    glLoadIdentity();
-    gluLookAt(camera->eyePosition.x, camera->eyePosition.y, camera->eyePosition.z,
-              camera->refPoint.x   , camera->refPoint.y   , camera->refPoint.z   ,
-              camera->upVector.x   , camera->upVector.y   , camera->upVector.z   );
+    /* Pick from the view of the frame on screen, which the simulation may have moved on from */
+    const RenderList& list = ::pipeline.GetFront();
+    for (int i = 0; i < 16; i++)
+    {
+        modelview[i] = list.view[i];
+    }
 
     /* Initialize matrices and window coordinates */
     glGetIntegerv(GL_VIEWPORT, viewport);
-    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);   // deprecated
     glGetDoublev(GL_PROJECTION_MATRIX, projection); // deprecated
     calcWindowCoords(mouseX, mouseY, viewport, windowX, windowY);
 
@@ -750,48 +2829,259 @@ void pick(int mouseX, int mouseY)
     GLdouble xx;
     GLdouble yy;
     GLdouble zz;
+    InputEvent event;
+    event.type = INPUT_PICK;
     gluUnProject(windowX, windowY, 0.0, modelview, projection, viewport, &xx, &yy, &zz);
-    Point3 near(xx, yy, zz); // point on front of view frustum
+    event.points[0] = Point3(xx, yy, zz); // point on front of view frustum
     gluUnProject(windowX, windowY, 1.0, modelview, projection, viewport, &xx, &yy, &zz);
-    Point3 far(xx, yy, zz);  // point on back of view frustum
+    event.points[1] = Point3(xx, yy, zz); // point on back of view frustum
 
-    /* Cast a ray and check for intersection with scene objects */
-    Ray ray(near, far);
-    std::list<Model*>* models = ::scene.GetModels();
-    for (std::list<Model*>::const_iterator itr = models->begin(); itr != models->end(); itr++)
+    /* The simulation casts the ray when it produces the next frame */
+    pushInput(event);
+} /* pick() */
+
+/**
+ * Finds the nearest triangle which a ray hits among the models drawn last frame: each model's
+ * swept box is tested first, then the ray is carried into the model's space and cast against
+ * its mesh's hierarchy, no farther than the nearest hit found so far
+ * @param ray - The ray in world space, with a unit direction
+ * @param index - Returned with the index of the model hit
+ * @param hit - Returned with the face hit, its barycentric weights, and the distance to it in
+ * world units
+ * @return - True if the ray hits a model
+ */
+bool castRay(const Ray& ray, size_t& index, RayHit& hit)
+{
+    const ModelArrays* models = ::scene.GetModels();
+    const FrameHistory& history = ::frameHistory;
+    bool isAnimatingOnGpu = history.isValid && history.isAnimatingOnGpu;
+    float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+    float inverse[3] = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    bool isHit = false;
+    hit.distance = FLT_MAX;
+
+    for (size_t i = 0; i < ::scene.GetModelCount(); i++)
     {
-        if ((*itr)->Intersects(ray))
+        /* Only the models drawn last frame can be clicked on */
+        float entry;
+        if (!models->isVisible[i] || !models->isReady[i] || !MeshBvh::IntersectBox(
+                &models->sweptBounds[6 * i], origin, inverse, hit.distance, entry))
+        {
+            continue;
+        }
+
+        /* The direction is scaled along with the origin, so distances along it stay in world
+         * units
+         */
+        float modelOrigin[3];
+        float modelDirection[3];
+        toModelSpace(i, isAnimatingOnGpu, history.animationTime, origin, direction,
+                modelOrigin, modelDirection);
+
+        if (models->bvhs[i]->Intersect(modelOrigin, modelDirection, hit.distance, hit))
         {
-            puts("Intersect");
-            (*itr)->ToggleDrawingBoundingBox();
+            index = i;
+            isHit = true;
         }
     }
 
-    glPopMatrix();
-} /* pick() */
+    return isHit;
+} /* castRay() */
 
 /**
- * Renders the scene
- * This is the GLUT display callback function
+ * Finds the pose a model was drawn at; when animating on the GPU the vertex shader posed it at
+ * the frame's time, and its pose in world space was left as it was
+ * @param index - The index of the model
+ * @param isAnimatingOnGpu - Whether the vertex shader posed the models
+ * @param animationTime - The time the vertex shader posed the models at
+ * @param rotation - Returned with the rotation about the y axis in degrees
+ * @param height - Returned with the center's y component
  */
-void displayCallback()
+void getDrawnPose(size_t index, bool isAnimatingOnGpu, double animationTime, float& rotation,
+        float& height)
 {
-    msglError();
+    const ModelArrays* models = ::scene.GetModels();
+    if (isAnimatingOnGpu)
+    {
+        ::scene.PoseAt(index, animationTime, &rotation, &height);
+    }
+    else
+    {
+        rotation = models->worldRotations[index];
+        height = models->worldHeights[index];
+    }
+} /* getDrawnPose() */
+
+/**
+ * Carries a ray from world space into a model's space by undoing the model's translation,
+ * rotation about the y axis, and scale; the ray's direction is scaled along with its origin,
+ * so a distance along it is the same in both spaces
+ * @param index - The index of the model
+ * @param isAnimatingOnGpu - Whether the vertex shader posed the models
+ * @param animationTime - The time the vertex shader posed the models at
+ * @param origin - The ray's origin in world space
+ * @param direction - The ray's direction in world space
+ * @param modelOrigin - Returned with the ray's origin in the model's space
+ * @param modelDirection - Returned with the ray's direction in the model's space
+ */
+void toModelSpace(size_t index, bool isAnimatingOnGpu, double animationTime,
+        const float origin[3], const float direction[3], float modelOrigin[3],
+        float modelDirection[3])
+{
+    const ModelArrays* models = ::scene.GetModels();
+    float rotation;
+    float height;
+    getDrawnPose(index, isAnimatingOnGpu, animationTime, rotation, height);
+    float radians = rotation * static_cast<float>(M_PI) / 180.0f;
+    float c = cosf(radians) / models->scaleFactors[index];
+    float s = sinf(radians) / models->scaleFactors[index];
+    float x = origin[0] - models->worldCentersX[index];
+    float y = origin[1] - height;
+    float z = origin[2] - models->worldCentersZ[index];
+
+    modelOrigin[0] = c * x - s * z;
+    modelOrigin[1] = y / models->scaleFactors[index];
+    modelOrigin[2] = s * x + c * z;
+    modelDirection[0] = c * direction[0] - s * direction[2];
+    modelDirection[1] = direction[1] / models->scaleFactors[index];
+    modelDirection[2] = s * direction[0] + c * direction[2];
+} /* toModelSpace() */
+
+/**
+ * Queues an input event for the simulation, which applies it when it produces the next frame
+ * @param event - The event to queue
+ */
+void pushInput(const InputEvent& event)
+{
+    if (!::inputQueue.Push(event))
+    {
+        fputs("Input queue is full; the event is dropped\n", stderr);
+    }
+} /* pushInput() */
+
+/**
+ * Hands the frame's simulation ticks to the frame pipeline, then clears the buffers and draws
+ * the render list it returns
+ */
+void renderFrame()
+{
+    FrameInput input;
+
+    /* Collect the simulation ticks which fell due since the last frame */
+    memcpy(input.projection, ::projectionMatrix, sizeof(input.projection));
+    input.isUsingGLSLShader = ::isUsingGLSLShader;
+    input.tickCount = 0;
+    while (::frameScheduler.Tick())
+    {
+        /* The animation's clock stands still while it is paused */
+        if (::isPaused)
+        {
+            ::pausedSeconds += SIMULATION_TICK_SECONDS;
+            continue;
+        }
+        input.tickTimes[input.tickCount++] = ::frameScheduler.GetSimulationTime()
+                - ::pausedSeconds;
+    }
+    if (!::isPaused)
+    {
+        ::pausedAlpha = ::frameScheduler.GetAlpha();
+    }
+    input.alpha = ::pausedAlpha;
+    input.isAnimatingOnGpu = ::isAnimatingOnGpu && ::isUsingGLSLShader
+            && 0 == ::scene.GetAttachedCount();
+    input.animationTime = ::frameScheduler.GetSimulationTime() - ::pausedSeconds
+            - (1.0 - input.alpha) * SIMULATION_TICK_SECONDS;
+    input.isUsingLod = ::isUsingLod;
+    input.viewportHeight = ::windowHeight;
+
+    /* Upload the models which finished loading, so the next render list produced draws them */
+    uploadModels();
+
+    /* Take the render list the worker thread finished while the last frame was drawn */
+    bool isPipelined = ::pipeline.IsThreaded();
+    if (isPipelined)
+    {
+        ::profiler.Begin(PHASE_WAIT);
+    }
+    const RenderList& list = ::pipeline.Advance(input);
+    if (isPipelined)
+    {
+        ::profiler.End(PHASE_WAIT);
+    }
+
+    /* Start counting the state changes of this frame */
+    ::glState.BeginFrame();
 
     /* Clear buffers and use the modelview matrix */
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glMatrixMode(GL_MODELVIEW);
 
-    /* Get the camera */
-    Camera* camera = ::scene.GetCamera();
-
     /* Set the light position for the shader program */
     if (::isUsingGLSLShader)
     {
-        transformVecByModelView(::light0_model_pos, ::light0_world_pos);
-        glUniform4fv(::uLight0_position, 1, ::light0_model_pos);
+        matMultVec4f(::light0_model_pos, ::light0_world_pos, list.view);
+        ::glState.Uniform4fv(::uLight0_position, ::light0_model_pos);
+    }
+
+    /* Draw the ground plane, sky box and PLY models */
+    glPushMatrix();
+    drawScene(list);
+    glPopMatrix();
+
+    /* Find the model under the cursor from the frames the GPU has finished, then start on
+     * this one's
+     */
+    if (::isPickingOnGpu)
+    {
+        collectIdBuffer();
+        glPushMatrix();
+        drawIdBuffer(list);
+        glPopMatrix();
+    }
+
+    if (0.0 > ::firstFrameTime)
+    {
+        ::firstFrameTime = FrameProfiler::GetMilliseconds() - ::startTime;
+        printf("First frame drawn %.1f ms after startup.\n", ::firstFrameTime);
     }
 
+    /* The render list knows whether every model was uploaded before it was produced */
+    if (0.0 > ::modelsReadyTime && list.isEveryModelReady)
+    {
+        ::modelsReadyTime = FrameProfiler::GetMilliseconds() - ::startTime;
+        printf("All models loaded and uploaded %.1f ms after startup.\n", ::modelsReadyTime);
+    }
+} /* renderFrame() */
+
+/**
+ * Deletes the buffer objects of the meshes no model shares anymore, and uploads the meshes
+ * which have finished loading in the background
+ * Runs on the OpenGL thread, since the loads and the releases cannot call OpenGL
+ */
+void uploadModels()
+{
+    GpuMesh::DeleteReleasedBuffers();
+
+    if (0.0 <= ::modelsReadyTime)
+    {
+        return;
+    }
+
+    ::scene.GetMeshCache()->Upload(::glState);
+} /* uploadModels() */
+
+/**
+ * Renders the scene
+ * This is the GLUT display callback function
+ */
+void displayCallback()
+{
+    msglError();
+
+    /* Start the frame on the wall clock, which decides the simulation ticks to run */
+    ::frameScheduler.BeginFrame(FrameProfiler::GetMilliseconds() / 1000.0);
+
     /* Calculate the virtual trackball rotation */
     if (trackball.GetState() == ON)
     {
@@ -805,22 +3095,14 @@ void displayCallback()
         calcWindowCoords(::mouseX, ::mouseY, viewport, winX, winY);
         trackball.SetPoint2(winX, winY);
 
-        /* Calculate the trackball rotation and update the camera */
-        camera->Rotate(trackball.GetRotation());
+        /* Calculate the trackball rotation and send it to the camera */
+        InputEvent event;
+        event.type = INPUT_ROTATE_CAMERA;
+        event.rotation = trackball.GetRotation();
+        pushInput(event);
     }
 
-    /* Draw the ground plane and sky box */
-    glPushMatrix();
-    drawGroundPlane(camera);
-    glPopMatrix();
-    glPushMatrix();
-    drawSkyBox(camera);
-    glPopMatrix();
-
-    /* Draw the PLY models */
-    glPushMatrix();
-    drawScene(camera);
-    glPopMatrix();
+    renderFrame();
 
     glutSwapBuffers();
 
@@ -857,15 +3139,14 @@ void reshapeCallback(int width, int height)
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     glViewport(0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
-    gluPerspective(45.0, ratio, 1.0, 25.0);
+    gluPerspective(VIEW_FIELD_OF_VIEW, ratio, VIEW_NEAR_PLANE, VIEW_FAR_PLANE);
 
-    /* Reset the modelview matrix */
-    Camera* camera = ::scene.GetCamera();
+    /* Keep a copy of the projection matrix to cull against without reading it back */
+    glGetFloatv(GL_PROJECTION_MATRIX, ::projectionMatrix);
+
+    /* Reset the modelview matrix; every draw item loads its own */
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-    gluLookAt(camera->eyePosition.x, camera->eyePosition.y, camera->eyePosition.z,
-              camera->refPoint.x   , camera->refPoint.y   , camera->refPoint.z   ,
-              camera->upVector.x   , camera->upVector.y   , camera->upVector.z   );
 } /* reshapeCallback() */
 
 /**
@@ -877,18 +3158,22 @@ void reshapeCallback(int width, int height)
  */
 void keyboardCallback(unsigned char key, int x, int y)
 {
-    std::list<Model*>* models = ::scene.GetModels();
+    InputEvent event;
 
     switch(toupper(key))
     {
+    /* Toggle posing the models in the vertex shader */
+    case 'A':
+        ::isAnimatingOnGpu = !::isAnimatingOnGpu;
+        printf("GPU Animation is %s\n", ::isAnimatingOnGpu ? "on" : "off");
+        break;
     /* Toggle drawing bounding volumes */
     case 'B':
         ::isDrawingBoundingVolumes = !::isDrawingBoundingVolumes;
         printf("Drawing Bounding Volumes is %s\n", ::isDrawingBoundingVolumes ? "on" : "off");
-        for (std::list<Model*>::const_iterator itr = models->begin(); itr != models->end(); itr++)
-        {
-            (*itr)->SetIsDrawingBoundingBox(::isDrawingBoundingVolumes);
-        }
+        event.type = INPUT_SHOW_BOUNDING_BOXES;
+        event.flag = ::isDrawingBoundingVolumes;
+        pushInput(event);
         break;
 #ifdef FREEGLUT
     /* Toggle full screen mode */
@@ -914,15 +3199,15 @@ void keyboardCallback(unsigned char key, int x, int y)
         if (::isUsingGLSLShader)
         {
             /* Disable GLSL shader */
-            glEnable(GL_LIGHTING);
-            ::shaderProgram->deactivate();
+            ::glState.Enable(GL_LIGHTING);
+            ::glState.UseProgram(0);
             puts("GLSL Shader Program is off");
         }
         else
         {
             /* Enable GLSL shader */
-            glDisable(GL_LIGHTING);
-            ::shaderProgram->activate();
+            ::glState.Disable(GL_LIGHTING);
+            ::glState.UseProgram(::shaderProgram->id());
             puts("GLSL Shader Program is on");
         }
         ::isUsingGLSLShader = !::isUsingGLSLShader;
@@ -944,6 +3229,23 @@ void keyboardCallback(unsigned char key, int x, int y)
 #endif
         puts("Original Window Resolution is restored");
         break;
+    /* Toggle drawing a depth pre-pass */
+    case 'P':
+        ::isUsingDepthPrepass = !::isUsingDepthPrepass;
+        printf("Depth Pre-Pass is %s\n", ::isUsingDepthPrepass ? "on" : "off");
+        printGpuTimings();
+        break;
+    /* Cycle the frame pacing modes */
+    case 'V':
+        applyFrameMode(static_cast<FrameMode>((::frameScheduler.GetMode() + 1)
+                % (FRAME_MODE_TARGET + 1)));
+        printf("Frame Pacing is %s\n", FrameScheduler::GetModeName(::frameScheduler.GetMode()));
+        break;
+    /* Toggle drawing the bounding volumes as wireframes */
+    case 'W':
+        ::isDrawingWireframeBoxes = !::isDrawingWireframeBoxes;
+        printf("Wireframe Bounding Volumes is %s\n", ::isDrawingWireframeBoxes ? "on" : "off");
+        break;
     /* Quit the program */
     case 'Q':
     case  27:   /* ESC key */
@@ -958,6 +3260,37 @@ void keyboardCallback(unsigned char key, int x, int y)
     case 'H':
         printHelpMessage();
         break;
+    /* Print frame statistics */
+    case 'I':
+        printFrameStatistics();
+        break;
+    /* Toggle picking through the id buffer */
+    case 'K':
+        if (!::idBuffer.IsSupported())
+        {
+            puts("The id buffer is not supported");
+            break;
+        }
+        ::isPickingOnGpu = !::isPickingOnGpu;
+        ::isClickPending = false;
+        printf("GPU Picking is %s\n", ::isPickingOnGpu ? "on" : "off");
+
+        /* Nothing is under the cursor until the id buffer is read back again */
+        ::cursorModel = MODEL_NO_INDEX;
+        event.type = INPUT_HOVER;
+        event.index = MODEL_NO_INDEX;
+        pushInput(event);
+        break;
+    /* Toggle the levels of detail */
+    case 'L':
+        ::isUsingLod = !::isUsingLod;
+        printf("Levels of Detail is %s\n", ::isUsingLod ? "on" : "off");
+        break;
+    /* Pause or resume the animation */
+    case ' ':
+        ::isPaused = !::isPaused;
+        printf("Animation is %s\n", ::isPaused ? "paused" : "running");
+        break;
     }
 } /* keyboardCallback() */
 
@@ -1016,23 +3349,63 @@ void motionCallback(int x, int y)
 } /* motionCallback() */
 
 /**
- * Redraws the scene every 16ms
- * This is the GLUT timer callback function
- * @param x - Unused value parameter
+ * Redraws the scene as soon as the frame scheduler says the next frame is due
+ * Waits in short sleeps so that input is still handled promptly
+ * This is the GLUT idle callback function
+ */
+void idleCallback()
+{
+    double delay = ::frameScheduler.GetDelaySeconds(FrameProfiler::GetMilliseconds() / 1000.0);
+
+    if (0.0 < delay)
+    {
+        usleep(std::min(static_cast<useconds_t>(delay * 1000000.0),
+                static_cast<useconds_t>(FRAME_MAX_SLEEP_MICROSECONDS)));
+    }
+    else
+    {
+        glutPostRedisplay();
+    }
+} /* idleCallback() */
+
+/**
+ * Switches how the frames are paced, including the display's swap interval
+ * @param mode - The new pacing mode
  */
-void timerCallback(int x)
+void applyFrameMode(FrameMode mode)
 {
-    glutPostRedisplay();
-    glutTimerFunc(16, timerCallback, 0);
-} /* timerCallback() */
+    int interval = FRAME_MODE_VSYNC == mode ? 1 : 0;
+
+    ::frameScheduler.SetMode(mode);
+
+    /* Only vsync waits for the display; the other modes must not block in glutSwapBuffers() */
+#ifdef __APPLE__
+    GLint swapInterval = interval;
+    CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &swapInterval);
+#else
+    if (GLXEW_EXT_swap_control)
+    {
+        glXSwapIntervalEXT(glXGetCurrentDisplay(), glXGetCurrentDrawable(), interval);
+    }
+    else if (GLXEW_MESA_swap_control)
+    {
+        glXSwapIntervalMESA(interval);
+    }
+    else if (GLXEW_SGI_swap_control && 0 < interval)
+    {
+        glXSwapIntervalSGI(interval);
+    }
+#endif
+} /* applyFrameMode() */
 
 /**
  * Checks if an axis-aligned bounding box is contained entirely inside the view frustum
- * @param bv - An axis-aligned bounding box
+ * @param bv - An axis-aligned bounding box in eye space
+ * @param projection - The projection matrix
  * @return - True if the axis-aligned bounding box is contained entirely inside the view frustum;
  * otherwise, false
  */
-bool inFrustum(AxisAlignedBoundingBox* bv)
+bool inFrustum(const AxisAlignedBoundingBox* bv, const float projection[16])
 {
     float minW;
     float maxW;
@@ -1040,10 +3413,8 @@ bool inFrustum(AxisAlignedBoundingBox* bv)
     float topRightFrontCorner[] = {bv->right, bv->top, bv->front, 1.0f};
     float minVector[4];
     float maxVector[4];
-    GLfloat projection[16];
 
-    /* Get the current projection matrix and apply it to the corners of the bounding box */
-    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    /* Apply the projection matrix to the corners of the bounding box */
     matMultVec4f(minVector, bottomLeftFrontCorner, projection);
     minW = minVector[3];
     matMultVec4f(maxVector, topRightFrontCorner, projection);
@@ -1055,17 +3426,86 @@ bool inFrustum(AxisAlignedBoundingBox* bv)
 } /* inFrustum() */
 
 /**
- * Transforms a vector by the current modelview matrix
- * from Professor Shafae
- * @param outVec - The transformed vector to be returned
- * @param inVec - The input vector to transform
+ * Classifies a bounding volume against the view frustum by its eight corners in clip space;
+ * the volume is wholly outside if all its corners are outside the same clipping plane, and
+ * wholly inside if all its corners are inside every plane
+ * @param bv - The bounding volume in eye space
+ * @param projection - The projection matrix
+ * @return - FRUSTUM_OUTSIDE, FRUSTUM_INSIDE, or else FRUSTUM_INTERSECTING
+ */
+FrustumTest classifyFrustum(const AxisAlignedBoundingBox* bv, const float projection[16])
+{
+    int outsideCounts[6] = {0, 0, 0, 0, 0, 0};
+    int insideCount = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        float corner[] = {i & 1 ? bv->right : bv->left, i & 2 ? bv->top : bv->bottom,
+                i & 4 ? bv->front : bv->back, 1.0f};
+        float vector[4];
+        bool isInside = true;
+
+        /* Apply the projection matrix to the corner, then compare it to each pair of planes */
+        matMultVec4f(vector, corner, projection);
+        for (int j = 0; j < 3; j++)
+        {
+            if (!(-vector[3] < vector[j]))
+            {
+                outsideCounts[2 * j]++;
+                isInside = false;
+            }
+            if (!(vector[j] < vector[3]))
+            {
+                outsideCounts[2 * j + 1]++;
+                isInside = false;
+            }
+        }
+
+        if (isInside)
+        {
+            insideCount++;
+        }
+    }
+
+    if (8 == insideCount)
+    {
+        return FRUSTUM_INSIDE;
+    }
+
+    for (int j = 0; j < 6; j++)
+    {
+        if (8 == outsideCounts[j])
+        {
+            return FRUSTUM_OUTSIDE;
+        }
+    }
+
+    return FRUSTUM_INTERSECTING;
+} /* classifyFrustum() */
+
+/**
+ * Chooses the level of detail to draw a model at from its size on screen
+ * The model only leaves the level it was drawn at once its size is well past the level's
+ * bounds, so that a model hovering about a bound does not pop back and forth between levels
+ * @param diameter - The diameter of the model's bounding sphere on screen in pixels
+ * @param level - The level the model was drawn at last frame
+ * @return - The level to draw the model at, 0 being full detail
  */
-void transformVecByModelView(float outVec[4], const float inVec[4])
+int selectLod(float diameter, int level)
 {
-    float modelview[16];
-    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
-    matMultVec4f(outVec, inVec, modelview);
-} /* transformVecByModelView() */
+    while (0 < level && diameter > ::lodDiameters[level - 1] * (1.0f + MODEL_LOD_HYSTERESIS))
+    {
+        level--;
+    }
+
+    while (MESH_LOD_COUNT - 1 > level
+            && diameter < ::lodDiameters[level] * (1.0f - MODEL_LOD_HYSTERESIS))
+    {
+        level++;
+    }
+
+    return level;
+} /* selectLod() */
 
 /**
  * Prints the contents of a 4x4 matrix of doubles